@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "structure.h"
+#include "memory_utils.h"
+
+/*
+ * Measures the speed/accuracy trade-off of the structure models available in
+ * kstruct. Random sequences are folded with every model, and the per-nucleotide
+ * pairing probabilities are compared against the full partition function.
+ *
+ * Usage: kstruct_bench [num_seqs] [length] [max_bp_span] [samples] [seed] [beam_size]
+ */
+
+struct model_result {
+	const char *label;
+	double seconds;
+	double abs_error;    /* Sum of absolute differences to the partition function */
+	double max_error;    /* Largest absolute difference to the partition function */
+	double sum_x, sum_y, sum_xx, sum_yy, sum_xy;
+	unsigned long long count;
+};
+typedef struct model_result model_result;
+
+#define NUM_MODELS 5
+
+static double
+wall_time(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static char *
+random_sequence(int length, unsigned long long *state)
+{
+	static const char nucleotides[] = "ACGU";
+	char *sequence = s_malloc(length + 1);
+	for(int i = 0; i < length; i++) {
+		*state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+		sequence[i] = nucleotides[(*state >> 62) & 3];
+	}
+	sequence[length] = '\0';
+	return sequence;
+}
+
+static void
+compare(model_result *result, const float *reference, const float *probabilities, int length)
+{
+	for(int i = 0; i < length; i++) {
+		double x = reference[i];
+		double y = probabilities[i];
+		double difference = fabs(x - y);
+		result->abs_error += difference;
+		if(difference > result->max_error)
+			result->max_error = difference;
+		result->sum_x  += x;
+		result->sum_y  += y;
+		result->sum_xx += x * x;
+		result->sum_yy += y * y;
+		result->sum_xy += x * y;
+		result->count++;
+	}
+}
+
+static double
+pearson(model_result *result)
+{
+	double n = (double)result->count;
+	double cov   = result->sum_xy - result->sum_x * result->sum_y / n;
+	double var_x = result->sum_xx - result->sum_x * result->sum_x / n;
+	double var_y = result->sum_yy - result->sum_y * result->sum_y / n;
+	if(var_x <= 0. || var_y <= 0.)
+		return 0.;
+	return cov / sqrt(var_x * var_y);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int num_seqs    = argc > 1 ? atoi(argv[1]) : 200;
+	int length      = argc > 2 ? atoi(argv[2]) : 100;
+	int max_bp_span = argc > 3 ? atoi(argv[3]) : 50;
+	int num_samples = argc > 4 ? atoi(argv[4]) : 100;
+	unsigned long long state = argc > 5 ? strtoull(argv[5], NULL, 10) : 1;
+	int beam_size   = argc > 6 ? atoi(argv[6]) : 100;
+
+	if(num_seqs < 1 || length < 1 || max_bp_span < 1 || num_samples < 1 || beam_size < 0) {
+		fprintf(stderr, "Usage: %s [num_seqs] [length] [max_bp_span] [samples] [seed] [beam_size]\n",
+		        argv[0]);
+		return 1;
+	}
+
+	BppOptions opts[NUM_MODELS];
+	model_result results[NUM_MODELS];
+	char labels[NUM_MODELS][64];
+	BppStructureModel models[NUM_MODELS] = {BPP_MODEL_PF, BPP_MODEL_SPAN, BPP_MODEL_LINEAR,
+	                                        BPP_MODEL_SAMPLE, BPP_MODEL_MFE};
+	for(int m = 0; m < NUM_MODELS; m++) {
+		katss_bpp_init_default_opts(&opts[m]);
+		opts[m].structure_model = models[m];
+		opts[m].max_bp_span = max_bp_span;
+		opts[m].num_samples = num_samples;
+		opts[m].beam_size = beam_size;
+		memset(&results[m], 0, sizeof results[m]);
+		results[m].label = labels[m];
+	}
+	snprintf(labels[0], sizeof labels[0], "pf");
+	snprintf(labels[1], sizeof labels[1], "span (max-bp-span=%d)", max_bp_span);
+	snprintf(labels[2], sizeof labels[2], "linear (beam-size=%d)", beam_size);
+	snprintf(labels[3], sizeof labels[3], "sample (samples=%d)", num_samples);
+	snprintf(labels[4], sizeof labels[4], "mfe");
+
+	for(int s = 0; s < num_seqs; s++) {
+		char *sequence = random_sequence(length, &state);
+		float *probabilities[NUM_MODELS];
+		for(int m = 0; m < NUM_MODELS; m++) {
+			double start = wall_time();
+			probabilities[m] = katss_bpp_fold(sequence, &opts[m]);
+			results[m].seconds += wall_time() - start;
+		}
+		for(int m = 0; m < NUM_MODELS; m++) {
+			compare(&results[m], probabilities[0], probabilities[m], length);
+			free(probabilities[m]);
+		}
+		free(sequence);
+	}
+
+	printf("Folded %d random sequences of length %d\n\n", num_seqs, length);
+	printf("%-24s %10s %9s %10s %10s %9s\n",
+	       "model", "seconds", "speedup", "mean |err|", "max |err|", "pearson");
+	for(int m = 0; m < NUM_MODELS; m++) {
+		model_result *r = &results[m];
+		printf("%-24s %10.3f %8.1fx %10.4f %10.4f %9.4f\n",
+		       r->label, r->seconds, results[0].seconds / r->seconds,
+		       r->abs_error / (double)r->count, r->max_error, pearson(r));
+	}
+
+	return 0;
+}
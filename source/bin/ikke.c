@@ -18,18 +18,32 @@ typedef struct Options {
 
 	int  kmer;          /** Length of k-mer to count */
 	int  iterations;    /** Number of ikke iterations */
+	int  batch;         /** Most k-mers removed at once every iteration */
+	double batch_gap;   /** Enrichment gap between a batch and the k-mers overlapping it */
 	int  threads;       /** Number of threads to use */
+	bool dedup;         /** Count each distinct read only once */
+	char *umi;          /** Where to find the UMIs of PCR duplicates to collapse */
+	int  umi_start;     /** Nucleotides after the UMI that duplicates share */
+	char *adapter;      /** 3' adapter to trim off the reads */
+	int  quality_cutoff; /** Quality to trim the 3' end of reads down to */
+	int  mask_quality;  /** Quality under which nucleotides are masked */
+	int  min_length;    /** Reads shorter than this after trimming are left out */
 	char delimiter;     /** File delimiter for output file */
 	bool no_log;        /** Don't normalize outputs to log2 */
 
 	bool enrichments;   /** Compute regular enrichments */
 	bool shuffle;       /** Shuffle the sequences */
 	int  klet;          /** Length of k-let to preserve during shuffling */
+	bool expected;      /** Use the expected counts of the shuffles instead */
+	int  shuffles;      /** Number of shuffles of every read */
 	bool probabilistic; /** Enable probabilistic enrichments */
+	int  order;         /** Markov order of the probabilistic background */
 	bool bootstrap;     /** Enable bootstrap */
 	int  bs_runs;       /** Bootstrap iterations to perform */
 	int  sample;        /** Percent of file to sample */
 	int  seed;          /** Seed to be used by bootstrap */
+	double tolerance;   /** Change in stdev under which bootstrap stops early */
+	bool analytic;      /** Compute stdev and pval from the counts instead */
 } Options;
 
 char 
@@ -53,15 +67,29 @@ init_default_options(Options *opt)
 
 	opt->kmer       = 5;
 	opt->iterations = 1;
+	opt->batch      = 1;
+	opt->batch_gap  = 0.05;
 	opt->threads    = 1;
+	opt->dedup      = false;
+	opt->umi        = NULL;
+	opt->umi_start  = 16;
+	opt->adapter    = NULL;
+	opt->quality_cutoff = 0;
+	opt->mask_quality   = 0;
+	opt->min_length     = 0;
 	opt->delimiter  = ',';
 	opt->no_log     = false;
 
 	opt->enrichments   = false;
 	opt->probabilistic = false;
+	opt->order         = -1;
 	opt->bootstrap     = false;
 	opt->bs_runs       = 10;
 	opt->sample        = 10;
+	opt->tolerance     = 0;
+	opt->analytic      = false;
+	opt->expected      = false;
+	opt->shuffles      = 1;
 }
 
 
@@ -93,6 +121,12 @@ main(int argc, char *argv[])
 	if(args_info.control_given)
 		opt.ctrl_file = strdup(args_info.control_arg);
 
+	if(args_info.umi_given)
+		opt.umi = strdup(args_info.umi_arg);
+
+	if(args_info.adapter_given)
+		opt.adapter = strdup(args_info.adapter_arg);
+
 	if(args_info.delimiter_given)
 		opt.delimiter = delimiter_to_char(args_info.delimiter_arg);
 
@@ -101,13 +135,25 @@ main(int argc, char *argv[])
 
 	opt.kmer          = args_info.kmer_arg;
 	opt.iterations    = args_info.iterations_arg;
+	opt.batch         = args_info.batch_arg;
+	opt.batch_gap     = args_info.batch_gap_arg;
 	opt.threads       = args_info.threads_arg;
+	opt.dedup         = (bool)args_info.dedup_flag;
+	opt.umi_start     = args_info.umi_start_arg;
+	opt.quality_cutoff = args_info.quality_cutoff_arg;
+	opt.mask_quality  = args_info.mask_quality_arg;
+	opt.min_length    = args_info.min_length_arg;
 	opt.sample        = args_info.sample_arg;
 	opt.bs_runs       = args_info.bootstrap_arg;
 	opt.bootstrap     = args_info.bootstrap_given;
 	opt.klet          = args_info.klet_arg;
+	opt.order         = args_info.markov_order_arg;
 	opt.seed          = args_info.seed_arg;
+	opt.tolerance     = args_info.tolerance_arg;
+	opt.analytic      = (bool)args_info.analytic_flag;
 	opt.shuffle       = (bool)args_info.shuffle_flag;
+	opt.expected      = (bool)args_info.expected_shuffle_flag;
+	opt.shuffles      = args_info.shuffles_arg;
 	opt.no_log        = (bool)args_info.no_log_flag;
 	opt.enrichments   = (bool)args_info.enrichments_flag;
 	opt.probabilistic = (bool)args_info.independent_probs_flag;
@@ -127,6 +173,17 @@ main(int argc, char *argv[])
 	if(opt.probabilistic && opt.ctrl_file != NULL)
 		warning_message("Ignoring control file: %s", opt.ctrl_file);
 
+	if(!opt.probabilistic && args_info.markov_order_given) {
+		warning_message("Ignoring markov-order. It only applies to --independent-probs.");
+		opt.order = -1;
+	}
+
+	if(opt.order < -1 || opt.order >= opt.kmer) {
+		error_message("Option 'markov-order' must be a value between 0 and %d, or -1. "
+		              "Given: %d", opt.kmer - 1, opt.order);
+		goto cleanup_args;
+	}
+
 	if(opt.iterations < 1) {
 		warning_message("Iterations can not be below 1. Defaulting to 1.");
 		opt.iterations = 1;
@@ -147,6 +204,74 @@ main(int argc, char *argv[])
 		opt.sample = 10;
 	}
 
+	if(!opt.bootstrap && args_info.tolerance_given)
+		warning_message("Ignoring tolerance. Bootstrap must be enabled to stop it early.");
+
+	if(opt.bootstrap && !opt.enrichments && opt.tolerance > 0) {
+		warning_message("Ignoring tolerance. Only the bootstrap of --enrichments stops early.");
+		opt.tolerance = 0;
+	}
+
+	if(opt.tolerance < 0) {
+		warning_message("Invalid tolerance: %g. Tolerance can not be negative. "
+		                "Defaulting to 0.", opt.tolerance);
+		opt.tolerance = 0;
+	}
+
+	if(opt.analytic && opt.bootstrap) {
+		warning_message("Ignoring analytic. The bootstrap already computes the standard deviations.");
+		opt.analytic = false;
+	}
+
+	if(opt.analytic && (!opt.enrichments || opt.shuffle)) {
+		warning_message("Ignoring analytic. It needs --enrichments, without --shuffle.");
+		opt.analytic = false;
+	}
+
+	if(opt.expected && (!opt.enrichments || !opt.shuffle)) {
+		warning_message("Ignoring expected-shuffle. It needs --enrichments and --shuffle.");
+		opt.expected = false;
+	}
+
+	if(opt.expected && opt.kmer > 12) {
+		error_message("Option 'kmer' must be at most 12 with --expected-shuffle. "
+		              "Given: %d", opt.kmer);
+		goto cleanup_args;
+	}
+
+	if(opt.expected && opt.klet > 8 && opt.klet < opt.kmer) {
+		error_message("Option 'klet' must be at most 8 with --expected-shuffle. "
+		              "Given: %d", opt.klet);
+		goto cleanup_args;
+	}
+
+	if(opt.shuffles < 1) {
+		error_message("Option 'shuffles' must be greater than 0. Given: %d", opt.shuffles);
+		goto cleanup_args;
+	}
+
+	if(opt.shuffles > 1 && (!opt.enrichments || !opt.shuffle || opt.expected)) {
+		warning_message("Ignoring shuffles. It needs --enrichments and --shuffle, without "
+		                "--expected-shuffle.");
+		opt.shuffles = 1;
+	}
+
+	if(opt.batch < 1) {
+		error_message("Option 'batch' must be greater than 0. Given: %d", opt.batch);
+		goto cleanup_args;
+	}
+
+	if(opt.batch_gap < 0) {
+		error_message("Option 'batch-gap' can't be negative. Given: %g", opt.batch_gap);
+		goto cleanup_args;
+	}
+
+	if(opt.batch > 1 && (opt.enrichments || opt.bootstrap)) {
+		warning_message("Ignoring batch. It needs ikke iterations, without --enrichments or "
+		                "--bootstrap.");
+		opt.batch = 1;
+	}
+
 	if(opt.no_log)
 		warning_message("ikke: option --no-log is being ignored. Values are no longer normalized to log2");
 	opt.no_log = true;
@@ -159,13 +284,27 @@ main(int argc, char *argv[])
 
 	katss_opts.kmer = opt.kmer;
 	katss_opts.iters = opt.iterations;
+	katss_opts.batch = opt.batch;
+	katss_opts.batch_gap = opt.batch_gap;
 	katss_opts.threads = opt.threads;
 	katss_opts.normalize = !opt.no_log;
 	katss_opts.sort_enrichments = true;
 	katss_opts.bootstrap_iters = opt.bootstrap ? opt.bs_runs : 0;
 	katss_opts.bootstrap_sample = opt.sample*1000;
+	katss_opts.bootstrap_tolerance = opt.tolerance;
+	katss_opts.analytic = opt.analytic;
 	katss_opts.probs_ntprec = opt.klet;
+	katss_opts.shuffle_expected = opt.expected;
+	katss_opts.shuffles = opt.shuffles;
+	katss_opts.probs_order = opt.order;
 	katss_opts.seed = opt.seed;
+	katss_opts.dedup = opt.dedup;
+	katss_opts.umi = opt.umi;
+	katss_opts.umi_start = opt.umi_start;
+	katss_opts.adapter = opt.adapter;
+	katss_opts.quality_cutoff = opt.quality_cutoff;
+	katss_opts.mask_quality = opt.mask_quality;
+	katss_opts.min_length = opt.min_length;
 	if(opt.probabilistic && opt.shuffle) {
 		katss_opts.probs_algo = KATSS_PROBS_BOTH;
 	} else if(opt.probabilistic) {
@@ -261,8 +400,15 @@ set_out_file(Options *opt, char *name)
 void
 katssdata_to_file(KatssData *data, Options *opt)
 {
-	/* Print the header */
-	if(opt->bootstrap) {
+	/* Print the header, after the replicates used if the bootstrap could stop early */
+	if(opt->bootstrap && opt->enrichments && opt->tolerance > 0)
+		fprintf(opt->out_file, "# bootstrap-replicates=%d\n", data->bootstrap_iters);
+	bool stats = opt->bootstrap || opt->analytic;
+	bool stability = opt->bootstrap && !opt->enrichments;
+	if(stability) {
+		fprintf(opt->out_file, "kmer%crval%cstdev%cpval%cstability\n",
+		  opt->delimiter, opt->delimiter, opt->delimiter, opt->delimiter);
+	} else if(stats) {
 		fprintf(opt->out_file, "kmer%crval%cstdev%cpval\n",
 		  opt->delimiter, opt->delimiter, opt->delimiter);
 	} else {
@@ -275,7 +421,11 @@ katssdata_to_file(KatssData *data, Options *opt)
 		if(isnan(rval))
 			continue;
 		katss_unhash(kseq, data->kmers[i].kmer, opt->kmer, true);
-		if(opt->bootstrap) {
+		if(stability) {
+			fprintf(opt->out_file, "%s%c%f%c%f%c%E%c%f\n", kseq, opt->delimiter,
+			  rval, opt->delimiter, data->kmers[i].stdev, opt->delimiter,
+			  data->kmers[i].pval, opt->delimiter, data->kmers[i].stability);
+		} else if(stats) {
 			fprintf(opt->out_file, "%s%c%f%c%f%c%E\n", kseq, opt->delimiter,
 			  rval, opt->delimiter, data->kmers[i].stdev, opt->delimiter,
 			  data->kmers[i].pval);
@@ -293,6 +443,10 @@ options_free(Options *opt)
 		free(opt->test_file);
 	if(opt->ctrl_file)
 		free(opt->ctrl_file);
+	if(opt->umi)
+		free(opt->umi);
+	if(opt->adapter)
+		free(opt->adapter);
 	if(opt->out_file)
 		fclose(opt->out_file);
 }
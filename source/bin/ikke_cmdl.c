@@ -48,8 +48,26 @@ const char *ikke_args_info_detailed_help[] = {
   "  Specify the length of the k-mers you want to perform the enrichment analysis\n  on.\n",
   "  -i, --iterations=INT     Set the number of iterations for ikke.\n                             (default=`1')",
   "  ",
+  "      --batch=INT          Most k-mers every iteration of ikke removes at once.\n                             (default=`1')",
+  "  Every iteration of ikke removes the top k-mer, and then the next most enriched\n  k-mers that overlap none of the k-mers removed before them (so that crossing\n  those out can't change their counts), as long as each is more enriched than\n  the k-mers overlapping those by --batch-gap. Up to this many k-mers are then\n  removed in a single recount of the files, in the order sequential iterations\n  would remove them, and each is written as one iteration. Set it to 1 to remove\n  one k-mer per iteration. It doesn't apply to --bootstrap.\n",
+  "      --batch-gap=DOUBLE   Enrichment gap between the k-mers of a batch and\n                             the k-mers overlapping them.  (default=`0.05')",
+  "  Every k-mer a --batch removes after the top k-mer must be more enriched than\n  the k-mers overlapping the ones removed before it by this factor (minus 1,\n  e.g. 0.05 for 5%), so that the changes in their enrichments after removing the\n  batch can't reorder them. Larger gaps give batches closer to sequential\n  iterations, smaller gaps larger batches.\n",
   "      --threads=INT        Set the number of threads to use in ikke. This\n                             allows to process calculations in parallel using\n                             multiple threads.  (default=`1')",
   "  By default, processing of the test and control files is computed serially.\n  Specifying this options allows for parallelization of the computations.\n  Though, this not only increases memory consumption as each thread requires\n  storing sequences, but it is possible to that it can provide incorrect counts\n  or even fail when the files have long sequences (>16000nt). In other words,\n  if you have long sequences in your file, it is not recommended to turn on\n  threads.\n",
+  "      --dedup              Count each distinct read only once.  (default=off)",
+  "  Identical reads are collapsed into a single entry along with the number of\n  times they were seen, and every count, recount, shuffle and bootstrap sample\n  is done over the distinct reads with their multiplicity as weight, so the\n  counts are the same as without this option. Libraries with many PCR\n  duplicates (such as CLIP libraries) then skip most of the work of every\n  iteration, at the cost of holding the distinct reads (2-bit packed) in\n  memory. Files whose distinct reads take up more than 4 GiB are counted as\n  they are.\n",
+  "      --umi=pattern        Collapse PCR duplicates, reads sharing a UMI and\n                             their first nucleotides, before counting.",
+  "  Of the reads with the same unique molecular identifier (UMI) and the same\n  first `--umi-start` nucleotides after it, only the first one is counted. The\n  pattern tells where the UMI of a read is:\n  \theader: after the last '_' in the first word of the header\n  \theader:SEP: after the last SEP in the first word of the header\n  \tprefix:N: the first N nucleotides of the read, which are removed before\n  counting\n  Duplicates are collapsed while the distinct reads are read as with `--dedup`,\n  and the number of collapsed reads of each file is reported. Reads without a\n  UMI are kept. Fails if the reads of a file take up more than 4 GiB.\n",
+  "      --umi-start=INT      Set the number of nucleotides after the UMI that\n                             duplicates have to share.  (default=`16')",
+  "  Reads with the same UMI are only collapsed if their first nucleotides after\n  the UMI also match, which keeps reads of different fragments that happen to\n  get the same UMI. Set it to 0 to collapse every read with the same UMI.\n",
+  "      --adapter=sequence   Trim a 3' adapter off the reads before counting.",
+  "  The leftmost occurrence of the adapter in a read, with up to one mismatch\n  per 10 nucleotides, is cut off along with everything after it. Adapters only partially read at the 3' end are cut off if at least\n  3 of their nucleotides are there. Reads are trimmed while the distinct reads\n  are read as with `--dedup`, and the number of trimmed reads of each file is\n  reported. Fails if the reads of a file take up more than 4 GiB.\n",
+  "      --quality-cutoff=INT  Trim low-quality nucleotides off the 3' end of FASTQ\n                             reads before counting.  (default=`0')",
+  "  The 3' end is trimmed as in BWA and cutadapt, cutting off the suffix that\n  maximizes the sum of the cutoff minus the quality of each of its nucleotides.\n  Qualities are read as Phred+33. Set it to 0 to not trim.\n",
+  "      --mask-quality=INT   Mask nucleotides of FASTQ reads with a quality below\n                             this with 'N'.  (default=`0')",
+  "  Masked nucleotides don't form k-mers, so calls of low quality don't add to\n  the counts. Set it to 0 to not mask.\n",
+  "      --min-length=INT     Leave out reads shorter than this after trimming.\n                             (default=`0')",
+  "  Reads that are too short after trimming the adapter and the low-quality\n  nucleotides, or after removing a UMI prefix, are not counted, and their\n  number is reported for each file. Set it to 0 to keep every read.\n",
   "  -d, --delimiter=char     Set the delimiter used to separate the values in the\n                             output file.  (default=`,')",
   "  The output of ikke is by default in CSV format, meaning the values are\n  comma-delimited. By specifying this option, you can change the delimiter used\n  to separate the values. The available delimiters are: comma (,), tab (t),\n  colon (:), vertical bar (|), and space (\" \"). For example, setting\n  `--delimiter=\" \"` will change the delimiter to be space-delimited. If using\n  the comma delimiter, the file extension will be \".csv\"; if using the tab\n  delimiter, the file extension will be \".tsv\"; otherwise, the extension will\n  be \".dsv\". Support for other delimiters is currently unavailable.\n",
   "      --no-log             Don't normalize enrichments to log2.  (default=off)",
@@ -62,14 +80,24 @@ const char *ikke_args_info_detailed_help[] = {
   "  ",
   "      --klet=INT           Specify the k-let to be used by ushuffle\n                             (default=`-1')",
   "  ",
+  "      --expected-shuffle   Use the expected counts of the shuffled sequences\n                             instead of shuffling.  (default=off)",
+  "  With --enrichments and --shuffle, the number of times every k-mer is expected\n  to be in a random shuffle of each read is computed exactly, from the number\n  of shuffles with and without it (BEST theorem), and added up instead of\n  shuffling every read once. The background is then the average of infinitely\n  many shuffles, with no shuffling noise. Each read takes time in proportion to\n  the number of k-mers made from its k-lets, so it suits shorter k-mers, and\n  the k-mers can be at most 12 long. Runs of nucleotides between other\n  characters are shuffled on their own.\n",
+  "      --shuffles=INT       Number of shuffles of every read in the background\n                             of --shuffle.  (default=`1')",
+  "  With --enrichments and --shuffle, every read is shuffled this many times, and\n  all its shuffles are counted in the background. The graph of the read's\n  k-lets is built once, and every shuffle is drawn from it while the read is\n  still in cache, so more shuffles cost a fraction of reading the file again.\n  The enrichments are normalized by the totals, and the control counts of the\n  bootstrap t-test by the number of shuffles.\n",
   "  -p, --independent-probs  Calculate the enrichments without the input reads.\n                             (default=off)",
   "  Using the dinucleotide and mononucleotide frequencies of the target data,\n  ikke can make an accurate prediction as to what the enrichment values should\n  be. As such, when computing the actual frequencies for all k-mers, the values\n  that deviate the most from the predictions are the most significant, and are\n  used to discover the motif.\n",
+  "      --markov-order=INT   Order of the Markov model predicting the enrichments\n                             of --independent-probs.  (default=`-1')",
+  "  The frequency of every k-mer is predicted from the frequencies of the\n  (m+1)-mers and m-mers of the target data, for a Markov model of order m. The\n  default (-1) uses the mono- and dinucleotides (order 1), and higher orders\n  account for longer biases of the sequences, up to k-1. All k-mers are\n  predicted at once, extending the (m+1)-mers one nucleotide at a time.\n",
   "  -b, --bootstrap[=INT]    Bootstrap the enrichments the specified number of\n                             times.  (default=`10')",
-  "  This calculates the enrichments from a randomly subsampled (by default 10%)\n  region from the provided sequences. It then repeats this process the\n  specified number of times, calculates the mean enrichments from the\n  subsampled sequences, and the standard deviation.\n",
+  "  This calculates the enrichments from a randomly subsampled (by default 10%)\n  region from the provided sequences. It then repeats this process the\n  specified number of times, calculates the mean enrichments from the\n  subsampled sequences, and the standard deviation. With --threads, that many\n  subsamples are processed at the same time, each on one thread, and the\n  results are the same for any number of threads.\n",
   "      --sample=INT         Percent to randomly subsample sequences from the\n                             test and control files.  (default=`10')",
   "  Should be a number between 1 and 100. By default, katss subsamples 10% of the\n  files (equivalent to `--sample=10`).",
   "      --seed=INT           Specify the seed to be used by bootstrap\n                             (default=`-1')",
   "  Since bootstrap subsamples random sequences, seeding alters which random\n  sequences will be picked. This helps to ensure deterministic output which can\n  be achieved by using the same seed. To pick a random seed, set `seed=-1`.",
+  "      --tolerance=DOUBLE   Stop bootstrapping once the standard deviations of\n                             the top k-mers converge.  (default=`0')",
+  "  With a tolerance, --bootstrap sets the most replicates to run. After every\n  replicate, the standard deviations of the 10 most enriched k-mers are\n  compared to those of the previous replicate, and the bootstrap stops once\n  their relative change stays below the tolerance for 3 replicates in a row\n  (e.g. 0.01 for 1%). The number of replicates used is written to the first\n  line of the output file. Set it to 0 to always run every replicate. Only the\n  bootstrap of --enrichments stops early, the replicates of IKKE always run.\n",
+  "      --analytic           Compute the standard deviations and p-values without\n                             bootstrapping.  (default=off)",
+  "  With --enrichments and a control file or --independent-probs, the standard\n  deviation and p-value of every enrichment are computed from the counts of the\n  whole files, in a single pass instead of one per bootstrap replicate. Against\n  a control file, the test count of each k-mer is tested against the sum of\n  both counts with a binomial test, and against --independent-probs, against\n  the number of k-mers of the test file and the probability of the Markov\n  model. The variance is scaled by the overdispersion of the counts, estimated\n  from all k-mers, and the standard deviation follows from it by the delta\n  method.\n",
     0
 };
 
@@ -90,24 +118,39 @@ init_help_array(void)
   ikke_args_info_help[11] = ikke_args_info_detailed_help[17];
   ikke_args_info_help[12] = ikke_args_info_detailed_help[19];
   ikke_args_info_help[13] = ikke_args_info_detailed_help[21];
-  ikke_args_info_help[14] = ikke_args_info_detailed_help[22];
-  ikke_args_info_help[15] = ikke_args_info_detailed_help[23];
-  ikke_args_info_help[16] = ikke_args_info_detailed_help[25];
-  ikke_args_info_help[17] = ikke_args_info_detailed_help[27];
-  ikke_args_info_help[18] = ikke_args_info_detailed_help[29];
-  ikke_args_info_help[19] = ikke_args_info_detailed_help[31];
-  ikke_args_info_help[20] = ikke_args_info_detailed_help[33];
-  ikke_args_info_help[21] = ikke_args_info_detailed_help[35];
-  ikke_args_info_help[22] = 0; 
+  ikke_args_info_help[14] = ikke_args_info_detailed_help[23];
+  ikke_args_info_help[15] = ikke_args_info_detailed_help[25];
+  ikke_args_info_help[16] = ikke_args_info_detailed_help[27];
+  ikke_args_info_help[17] = ikke_args_info_detailed_help[29];
+  ikke_args_info_help[18] = ikke_args_info_detailed_help[31];
+  ikke_args_info_help[19] = ikke_args_info_detailed_help[33];
+  ikke_args_info_help[20] = ikke_args_info_detailed_help[35];
+  ikke_args_info_help[21] = ikke_args_info_detailed_help[37];
+  ikke_args_info_help[22] = ikke_args_info_detailed_help[39];
+  ikke_args_info_help[23] = ikke_args_info_detailed_help[40];
+  ikke_args_info_help[24] = ikke_args_info_detailed_help[41];
+  ikke_args_info_help[25] = ikke_args_info_detailed_help[43];
+  ikke_args_info_help[26] = ikke_args_info_detailed_help[45];
+  ikke_args_info_help[27] = ikke_args_info_detailed_help[47];
+  ikke_args_info_help[28] = ikke_args_info_detailed_help[49];
+  ikke_args_info_help[29] = ikke_args_info_detailed_help[51];
+  ikke_args_info_help[30] = ikke_args_info_detailed_help[53];
+  ikke_args_info_help[31] = ikke_args_info_detailed_help[55];
+  ikke_args_info_help[32] = ikke_args_info_detailed_help[57];
+  ikke_args_info_help[33] = ikke_args_info_detailed_help[59];
+  ikke_args_info_help[34] = ikke_args_info_detailed_help[61];
+  ikke_args_info_help[35] = ikke_args_info_detailed_help[63];
+  ikke_args_info_help[36] = 0; 
   
 }
 
-const char *ikke_args_info_help[23];
+const char *ikke_args_info_help[37];
 
 typedef enum {ARG_NO
   , ARG_FLAG
   , ARG_STRING
   , ARG_INT
+  , ARG_DOUBLE
 } ikke_cmdline_parser_arg_type;
 
 static
@@ -134,16 +177,30 @@ void clear_given (struct ikke_args_info *args_info)
   args_info->output_given = 0 ;
   args_info->kmer_given = 0 ;
   args_info->iterations_given = 0 ;
+  args_info->batch_given = 0 ;
+  args_info->batch_gap_given = 0 ;
   args_info->threads_given = 0 ;
+  args_info->dedup_given = 0 ;
+  args_info->umi_given = 0 ;
+  args_info->umi_start_given = 0 ;
+  args_info->adapter_given = 0 ;
+  args_info->quality_cutoff_given = 0 ;
+  args_info->mask_quality_given = 0 ;
+  args_info->min_length_given = 0 ;
   args_info->delimiter_given = 0 ;
   args_info->no_log_given = 0 ;
   args_info->enrichments_given = 0 ;
   args_info->shuffle_given = 0 ;
   args_info->klet_given = 0 ;
+  args_info->expected_shuffle_given = 0 ;
+  args_info->shuffles_given = 0 ;
   args_info->independent_probs_given = 0 ;
+  args_info->markov_order_given = 0 ;
   args_info->bootstrap_given = 0 ;
   args_info->sample_given = 0 ;
   args_info->seed_given = 0 ;
+  args_info->tolerance_given = 0 ;
+  args_info->analytic_given = 0 ;
 }
 
 static
@@ -160,8 +217,25 @@ void clear_args (struct ikke_args_info *args_info)
   args_info->kmer_orig = NULL;
   args_info->iterations_arg = 1;
   args_info->iterations_orig = NULL;
+  args_info->batch_arg = 1;
+  args_info->batch_orig = NULL;
+  args_info->batch_gap_arg = 0.05;
+  args_info->batch_gap_orig = NULL;
   args_info->threads_arg = 1;
   args_info->threads_orig = NULL;
+  args_info->dedup_flag = 0;
+  args_info->umi_arg = NULL;
+  args_info->umi_orig = NULL;
+  args_info->umi_start_arg = 16;
+  args_info->umi_start_orig = NULL;
+  args_info->adapter_arg = NULL;
+  args_info->adapter_orig = NULL;
+  args_info->quality_cutoff_arg = 0;
+  args_info->quality_cutoff_orig = NULL;
+  args_info->mask_quality_arg = 0;
+  args_info->mask_quality_orig = NULL;
+  args_info->min_length_arg = 0;
+  args_info->min_length_orig = NULL;
   args_info->delimiter_arg = gengetopt_strdup (",");
   args_info->delimiter_orig = NULL;
   args_info->no_log_flag = 0;
@@ -169,13 +243,21 @@ void clear_args (struct ikke_args_info *args_info)
   args_info->shuffle_flag = 0;
   args_info->klet_arg = -1;
   args_info->klet_orig = NULL;
+  args_info->expected_shuffle_flag = 0;
+  args_info->shuffles_arg = 1;
+  args_info->shuffles_orig = NULL;
   args_info->independent_probs_flag = 0;
+  args_info->markov_order_arg = -1;
+  args_info->markov_order_orig = NULL;
   args_info->bootstrap_arg = 10;
   args_info->bootstrap_orig = NULL;
   args_info->sample_arg = 10;
   args_info->sample_orig = NULL;
   args_info->seed_arg = -1;
   args_info->seed_orig = NULL;
+  args_info->tolerance_arg = 0;
+  args_info->tolerance_orig = NULL;
+  args_info->analytic_flag = 0;
   
 }
 
@@ -192,16 +274,30 @@ void init_args_info(struct ikke_args_info *args_info)
   args_info->output_help = ikke_args_info_detailed_help[9] ;
   args_info->kmer_help = ikke_args_info_detailed_help[11] ;
   args_info->iterations_help = ikke_args_info_detailed_help[13] ;
-  args_info->threads_help = ikke_args_info_detailed_help[15] ;
-  args_info->delimiter_help = ikke_args_info_detailed_help[17] ;
-  args_info->no_log_help = ikke_args_info_detailed_help[19] ;
-  args_info->enrichments_help = ikke_args_info_detailed_help[23] ;
-  args_info->shuffle_help = ikke_args_info_detailed_help[25] ;
-  args_info->klet_help = ikke_args_info_detailed_help[27] ;
-  args_info->independent_probs_help = ikke_args_info_detailed_help[29] ;
-  args_info->bootstrap_help = ikke_args_info_detailed_help[31] ;
-  args_info->sample_help = ikke_args_info_detailed_help[33] ;
-  args_info->seed_help = ikke_args_info_detailed_help[35] ;
+  args_info->batch_help = ikke_args_info_detailed_help[15] ;
+  args_info->batch_gap_help = ikke_args_info_detailed_help[17] ;
+  args_info->threads_help = ikke_args_info_detailed_help[19] ;
+  args_info->dedup_help = ikke_args_info_detailed_help[21] ;
+  args_info->umi_help = ikke_args_info_detailed_help[23] ;
+  args_info->umi_start_help = ikke_args_info_detailed_help[25] ;
+  args_info->adapter_help = ikke_args_info_detailed_help[27] ;
+  args_info->quality_cutoff_help = ikke_args_info_detailed_help[29] ;
+  args_info->mask_quality_help = ikke_args_info_detailed_help[31] ;
+  args_info->min_length_help = ikke_args_info_detailed_help[33] ;
+  args_info->delimiter_help = ikke_args_info_detailed_help[35] ;
+  args_info->no_log_help = ikke_args_info_detailed_help[37] ;
+  args_info->enrichments_help = ikke_args_info_detailed_help[41] ;
+  args_info->shuffle_help = ikke_args_info_detailed_help[43] ;
+  args_info->klet_help = ikke_args_info_detailed_help[45] ;
+  args_info->expected_shuffle_help = ikke_args_info_detailed_help[47] ;
+  args_info->shuffles_help = ikke_args_info_detailed_help[49] ;
+  args_info->independent_probs_help = ikke_args_info_detailed_help[51] ;
+  args_info->markov_order_help = ikke_args_info_detailed_help[53] ;
+  args_info->bootstrap_help = ikke_args_info_detailed_help[55] ;
+  args_info->sample_help = ikke_args_info_detailed_help[57] ;
+  args_info->seed_help = ikke_args_info_detailed_help[59] ;
+  args_info->tolerance_help = ikke_args_info_detailed_help[61] ;
+  args_info->analytic_help = ikke_args_info_detailed_help[63] ;
   
 }
 
@@ -308,13 +404,26 @@ ikke_cmdline_parser_release (struct ikke_args_info *args_info)
   free_string_field (&(args_info->output_orig));
   free_string_field (&(args_info->kmer_orig));
   free_string_field (&(args_info->iterations_orig));
+  free_string_field (&(args_info->batch_orig));
+  free_string_field (&(args_info->batch_gap_orig));
   free_string_field (&(args_info->threads_orig));
+  free_string_field (&(args_info->umi_arg));
+  free_string_field (&(args_info->umi_orig));
+  free_string_field (&(args_info->umi_start_orig));
+  free_string_field (&(args_info->adapter_arg));
+  free_string_field (&(args_info->adapter_orig));
+  free_string_field (&(args_info->quality_cutoff_orig));
+  free_string_field (&(args_info->mask_quality_orig));
+  free_string_field (&(args_info->min_length_orig));
   free_string_field (&(args_info->delimiter_arg));
   free_string_field (&(args_info->delimiter_orig));
   free_string_field (&(args_info->klet_orig));
+  free_string_field (&(args_info->shuffles_orig));
+  free_string_field (&(args_info->markov_order_orig));
   free_string_field (&(args_info->bootstrap_orig));
   free_string_field (&(args_info->sample_orig));
   free_string_field (&(args_info->seed_orig));
+  free_string_field (&(args_info->tolerance_orig));
   
   
 
@@ -361,8 +470,26 @@ ikke_cmdline_parser_dump(FILE *outfile, struct ikke_args_info *args_info)
     write_into_file(outfile, "kmer", args_info->kmer_orig, 0);
   if (args_info->iterations_given)
     write_into_file(outfile, "iterations", args_info->iterations_orig, 0);
+  if (args_info->batch_given)
+    write_into_file(outfile, "batch", args_info->batch_orig, 0);
+  if (args_info->batch_gap_given)
+    write_into_file(outfile, "batch-gap", args_info->batch_gap_orig, 0);
   if (args_info->threads_given)
     write_into_file(outfile, "threads", args_info->threads_orig, 0);
+  if (args_info->dedup_given)
+    write_into_file(outfile, "dedup", 0, 0 );
+  if (args_info->umi_given)
+    write_into_file(outfile, "umi", args_info->umi_orig, 0);
+  if (args_info->umi_start_given)
+    write_into_file(outfile, "umi-start", args_info->umi_start_orig, 0);
+  if (args_info->adapter_given)
+    write_into_file(outfile, "adapter", args_info->adapter_orig, 0);
+  if (args_info->quality_cutoff_given)
+    write_into_file(outfile, "quality-cutoff", args_info->quality_cutoff_orig, 0);
+  if (args_info->mask_quality_given)
+    write_into_file(outfile, "mask-quality", args_info->mask_quality_orig, 0);
+  if (args_info->min_length_given)
+    write_into_file(outfile, "min-length", args_info->min_length_orig, 0);
   if (args_info->delimiter_given)
     write_into_file(outfile, "delimiter", args_info->delimiter_orig, 0);
   if (args_info->no_log_given)
@@ -373,14 +500,24 @@ ikke_cmdline_parser_dump(FILE *outfile, struct ikke_args_info *args_info)
     write_into_file(outfile, "shuffle", 0, 0 );
   if (args_info->klet_given)
     write_into_file(outfile, "klet", args_info->klet_orig, 0);
+  if (args_info->expected_shuffle_given)
+    write_into_file(outfile, "expected-shuffle", 0, 0 );
+  if (args_info->shuffles_given)
+    write_into_file(outfile, "shuffles", args_info->shuffles_orig, 0);
   if (args_info->independent_probs_given)
     write_into_file(outfile, "independent-probs", 0, 0 );
+  if (args_info->markov_order_given)
+    write_into_file(outfile, "markov-order", args_info->markov_order_orig, 0);
   if (args_info->bootstrap_given)
     write_into_file(outfile, "bootstrap", args_info->bootstrap_orig, 0);
   if (args_info->sample_given)
     write_into_file(outfile, "sample", args_info->sample_orig, 0);
   if (args_info->seed_given)
     write_into_file(outfile, "seed", args_info->seed_orig, 0);
+  if (args_info->tolerance_given)
+    write_into_file(outfile, "tolerance", args_info->tolerance_orig, 0);
+  if (args_info->analytic_given)
+    write_into_file(outfile, "analytic", 0, 0 );
   
 
   i = EXIT_SUCCESS;
@@ -1145,6 +1282,9 @@ int update_arg(void *field, char **orig_field,
   case ARG_INT:
     if (val) *((int *)field) = strtol (val, &stop_char, 0);
     break;
+  case ARG_DOUBLE:
+    if (val) *((double *)field) = strtod (val, &stop_char);
+    break;
   case ARG_STRING:
     if (val) {
       string_field = (char **)field;
@@ -1160,6 +1300,7 @@ int update_arg(void *field, char **orig_field,
   /* check numeric conversion */
   switch(arg_type) {
   case ARG_INT:
+  case ARG_DOUBLE:
     if (val && !(stop_char && *stop_char == '\0')) {
       fprintf(stderr, "%s: invalid numeric value: %s\n", package_name, val);
       return 1; /* failure */
@@ -1246,16 +1387,30 @@ ikke_cmdline_parser_internal (
         { "output",	1, NULL, 'o' },
         { "kmer",	1, NULL, 'k' },
         { "iterations",	1, NULL, 'i' },
+        { "batch",	1, NULL, 0 },
+        { "batch-gap",	1, NULL, 0 },
         { "threads",	1, NULL, 0 },
+        { "dedup",	0, NULL, 0 },
+        { "umi",	1, NULL, 0 },
+        { "umi-start",	1, NULL, 0 },
+        { "adapter",	1, NULL, 0 },
+        { "quality-cutoff",	1, NULL, 0 },
+        { "mask-quality",	1, NULL, 0 },
+        { "min-length",	1, NULL, 0 },
         { "delimiter",	1, NULL, 'd' },
         { "no-log",	0, NULL, 0 },
         { "enrichments",	0, NULL, 'R' },
         { "shuffle",	0, NULL, 's' },
         { "klet",	1, NULL, 0 },
+        { "expected-shuffle",	0, NULL, 0 },
+        { "shuffles",	1, NULL, 0 },
         { "independent-probs",	0, NULL, 'p' },
+        { "markov-order",	1, NULL, 0 },
         { "bootstrap",	2, NULL, 'b' },
         { "sample",	1, NULL, 0 },
         { "seed",	1, NULL, 0 },
+        { "tolerance",	1, NULL, 0 },
+        { "analytic",	0, NULL, 0 },
         { 0,  0, 0, 0 }
       };
 
@@ -1474,6 +1629,196 @@ ikke_cmdline_parser_internal (
                 additional_error))
               goto failure;
           
+          }
+          /* Count each distinct read only once..  */
+          else if (strcmp (long_options[option_index].name, "dedup") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->dedup_flag), 0, &(args_info->dedup_given),
+                &(local_args_info.dedup_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "dedup", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Collapse PCR duplicates, reads sharing a UMI and their first nucleotides, before counting..  */
+          else if (strcmp (long_options[option_index].name, "umi") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->umi_arg), 
+                 &(args_info->umi_orig), &(args_info->umi_given),
+                &(local_args_info.umi_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "umi", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Set the number of nucleotides after the UMI that duplicates have to share..  */
+          else if (strcmp (long_options[option_index].name, "umi-start") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->umi_start_arg), 
+                 &(args_info->umi_start_orig), &(args_info->umi_start_given),
+                &(local_args_info.umi_start_given), optarg, 0, "16", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "umi-start", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Trim a 3' adapter off the reads before counting..  */
+          else if (strcmp (long_options[option_index].name, "adapter") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->adapter_arg), 
+                 &(args_info->adapter_orig), &(args_info->adapter_given),
+                &(local_args_info.adapter_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "adapter", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Trim low-quality nucleotides off the 3' end of FASTQ reads before counting..  */
+          else if (strcmp (long_options[option_index].name, "quality-cutoff") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->quality_cutoff_arg), 
+                 &(args_info->quality_cutoff_orig), &(args_info->quality_cutoff_given),
+                &(local_args_info.quality_cutoff_given), optarg, 0, "0", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "quality-cutoff", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Mask nucleotides of FASTQ reads with a quality below this with 'N'..  */
+          else if (strcmp (long_options[option_index].name, "mask-quality") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->mask_quality_arg), 
+                 &(args_info->mask_quality_orig), &(args_info->mask_quality_given),
+                &(local_args_info.mask_quality_given), optarg, 0, "0", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "mask-quality", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Leave out reads shorter than this after trimming..  */
+          else if (strcmp (long_options[option_index].name, "min-length") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->min_length_arg), 
+                 &(args_info->min_length_orig), &(args_info->min_length_given),
+                &(local_args_info.min_length_given), optarg, 0, "0", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "min-length", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Stop bootstrapping once the standard deviations of the top k-mers converge..  */
+          else if (strcmp (long_options[option_index].name, "tolerance") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->tolerance_arg), 
+                 &(args_info->tolerance_orig), &(args_info->tolerance_given),
+                &(local_args_info.tolerance_given), optarg, 0, "0", ARG_DOUBLE,
+                check_ambiguity, override, 0, 0,
+                "tolerance", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Compute the standard deviations and p-values without bootstrapping..  */
+          else if (strcmp (long_options[option_index].name, "analytic") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->analytic_flag), 0, &(args_info->analytic_given),
+                &(local_args_info.analytic_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "analytic", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Order of the Markov model predicting the enrichments of --independent-probs..  */
+          else if (strcmp (long_options[option_index].name, "markov-order") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->markov_order_arg), 
+                 &(args_info->markov_order_orig), &(args_info->markov_order_given),
+                &(local_args_info.markov_order_given), optarg, 0, "-1", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "markov-order", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Use the expected counts of the shuffled sequences instead of shuffling..  */
+          else if (strcmp (long_options[option_index].name, "expected-shuffle") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->expected_shuffle_flag), 0, &(args_info->expected_shuffle_given),
+                &(local_args_info.expected_shuffle_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "expected-shuffle", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Number of shuffles of every read in the background of --shuffle..  */
+          else if (strcmp (long_options[option_index].name, "shuffles") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->shuffles_arg), 
+                 &(args_info->shuffles_orig), &(args_info->shuffles_given),
+                &(local_args_info.shuffles_given), optarg, 0, "1", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "shuffles", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Most k-mers every iteration of ikke removes at once..  */
+          else if (strcmp (long_options[option_index].name, "batch") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->batch_arg), 
+                 &(args_info->batch_orig), &(args_info->batch_given),
+                &(local_args_info.batch_given), optarg, 0, "1", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "batch", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Enrichment gap between the k-mers of a batch and the k-mers overlapping them..  */
+          else if (strcmp (long_options[option_index].name, "batch-gap") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->batch_gap_arg), 
+                 &(args_info->batch_gap_orig), &(args_info->batch_gap_given),
+                &(local_args_info.batch_gap_given), optarg, 0, "0.05", ARG_DOUBLE,
+                check_ambiguity, override, 0, 0,
+                "batch-gap", '-',
+                additional_error))
+              goto failure;
+          
           }
           
           break;
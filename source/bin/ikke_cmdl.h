@@ -55,9 +55,35 @@ struct ikke_args_info
   int iterations_arg;	/**< @brief Set the number of iterations for ikke. (default='1').  */
   char * iterations_orig;	/**< @brief Set the number of iterations for ikke. original value given at command line.  */
   const char *iterations_help; /**< @brief Set the number of iterations for ikke. help description.  */
+  int batch_arg;	/**< @brief Most k-mers every iteration of ikke removes at once. (default='1').  */
+  char * batch_orig;	/**< @brief Most k-mers every iteration of ikke removes at once. original value given at command line.  */
+  const char *batch_help; /**< @brief Most k-mers every iteration of ikke removes at once. help description.  */
+  double batch_gap_arg;	/**< @brief Enrichment gap between the k-mers of a batch and the k-mers overlapping them. (default='0.05').  */
+  char * batch_gap_orig;	/**< @brief Enrichment gap between the k-mers of a batch and the k-mers overlapping them. original value given at command line.  */
+  const char *batch_gap_help; /**< @brief Enrichment gap between the k-mers of a batch and the k-mers overlapping them. help description.  */
   int threads_arg;	/**< @brief Set the number of threads to use in ikke. This allows to process calculations in parallel using multiple threads. (default='1').  */
   char * threads_orig;	/**< @brief Set the number of threads to use in ikke. This allows to process calculations in parallel using multiple threads. original value given at command line.  */
   const char *threads_help; /**< @brief Set the number of threads to use in ikke. This allows to process calculations in parallel using multiple threads. help description.  */
+  int dedup_flag;	/**< @brief Count each distinct read only once. (default=off).  */
+  const char *dedup_help; /**< @brief Count each distinct read only once. help description.  */
+  char * umi_arg;	/**< @brief Collapse PCR duplicates, reads sharing a UMI and their first nucleotides, before counting..  */
+  char * umi_orig;	/**< @brief Collapse PCR duplicates, reads sharing a UMI and their first nucleotides, before counting. original value given at command line.  */
+  const char *umi_help; /**< @brief Collapse PCR duplicates, reads sharing a UMI and their first nucleotides, before counting. help description.  */
+  int umi_start_arg;	/**< @brief Set the number of nucleotides after the UMI that duplicates have to share. (default='16').  */
+  char * umi_start_orig;	/**< @brief Set the number of nucleotides after the UMI that duplicates have to share. original value given at command line.  */
+  const char *umi_start_help; /**< @brief Set the number of nucleotides after the UMI that duplicates have to share. help description.  */
+  char * adapter_arg;	/**< @brief Trim a 3' adapter off the reads before counting..  */
+  char * adapter_orig;	/**< @brief Trim a 3' adapter off the reads before counting. original value given at command line.  */
+  const char *adapter_help; /**< @brief Trim a 3' adapter off the reads before counting. help description.  */
+  int quality_cutoff_arg;	/**< @brief Trim low-quality nucleotides off the 3' end of FASTQ reads before counting. (default='0').  */
+  char * quality_cutoff_orig;	/**< @brief Trim low-quality nucleotides off the 3' end of FASTQ reads before counting. original value given at command line.  */
+  const char *quality_cutoff_help; /**< @brief Trim low-quality nucleotides off the 3' end of FASTQ reads before counting. help description.  */
+  int mask_quality_arg;	/**< @brief Mask nucleotides of FASTQ reads with a quality below this with 'N'. (default='0').  */
+  char * mask_quality_orig;	/**< @brief Mask nucleotides of FASTQ reads with a quality below this with 'N'. original value given at command line.  */
+  const char *mask_quality_help; /**< @brief Mask nucleotides of FASTQ reads with a quality below this with 'N'. help description.  */
+  int min_length_arg;	/**< @brief Leave out reads shorter than this after trimming. (default='0').  */
+  char * min_length_orig;	/**< @brief Leave out reads shorter than this after trimming. original value given at command line.  */
+  const char *min_length_help; /**< @brief Leave out reads shorter than this after trimming. help description.  */
   char * delimiter_arg;	/**< @brief Set the delimiter used to separate the values in the output file. (default=',').  */
   char * delimiter_orig;	/**< @brief Set the delimiter used to separate the values in the output file. original value given at command line.  */
   const char *delimiter_help; /**< @brief Set the delimiter used to separate the values in the output file. help description.  */
@@ -70,8 +96,16 @@ struct ikke_args_info
   int klet_arg;	/**< @brief Specify the k-let to be used by ushuffle (default='-1').  */
   char * klet_orig;	/**< @brief Specify the k-let to be used by ushuffle original value given at command line.  */
   const char *klet_help; /**< @brief Specify the k-let to be used by ushuffle help description.  */
+  int expected_shuffle_flag;	/**< @brief Use the expected counts of the shuffled sequences instead of shuffling. (default=off).  */
+  const char *expected_shuffle_help; /**< @brief Use the expected counts of the shuffled sequences instead of shuffling. help description.  */
+  int shuffles_arg;	/**< @brief Number of shuffles of every read in the background of --shuffle. (default='1').  */
+  char * shuffles_orig;	/**< @brief Number of shuffles of every read in the background of --shuffle. original value given at command line.  */
+  const char *shuffles_help; /**< @brief Number of shuffles of every read in the background of --shuffle. help description.  */
   int independent_probs_flag;	/**< @brief Calculate the enrichments without the input reads. (default=off).  */
   const char *independent_probs_help; /**< @brief Calculate the enrichments without the input reads. help description.  */
+  int markov_order_arg;	/**< @brief Order of the Markov model predicting the enrichments of --independent-probs. (default='-1').  */
+  char * markov_order_orig;	/**< @brief Order of the Markov model predicting the enrichments of --independent-probs. original value given at command line.  */
+  const char *markov_order_help; /**< @brief Order of the Markov model predicting the enrichments of --independent-probs. help description.  */
   int bootstrap_arg;	/**< @brief Bootstrap the enrichments the specified number of times. (default='10').  */
   char * bootstrap_orig;	/**< @brief Bootstrap the enrichments the specified number of times. original value given at command line.  */
   const char *bootstrap_help; /**< @brief Bootstrap the enrichments the specified number of times. help description.  */
@@ -81,6 +115,11 @@ struct ikke_args_info
   int seed_arg;	/**< @brief Specify the seed to be used by bootstrap (default='-1').  */
   char * seed_orig;	/**< @brief Specify the seed to be used by bootstrap original value given at command line.  */
   const char *seed_help; /**< @brief Specify the seed to be used by bootstrap help description.  */
+  double tolerance_arg;	/**< @brief Stop bootstrapping once the standard deviations of the top k-mers converge. (default='0').  */
+  char * tolerance_orig;	/**< @brief Stop bootstrapping once the standard deviations of the top k-mers converge. original value given at command line.  */
+  const char *tolerance_help; /**< @brief Stop bootstrapping once the standard deviations of the top k-mers converge. help description.  */
+  int analytic_flag;	/**< @brief Compute the standard deviations and p-values without bootstrapping. (default=off).  */
+  const char *analytic_help; /**< @brief Compute the standard deviations and p-values without bootstrapping. help description.  */
   
   unsigned int help_given ;	/**< @brief Whether help was given.  */
   unsigned int detailed_help_given ;	/**< @brief Whether detailed-help was given.  */
@@ -90,16 +129,30 @@ struct ikke_args_info
   unsigned int output_given ;	/**< @brief Whether output was given.  */
   unsigned int kmer_given ;	/**< @brief Whether kmer was given.  */
   unsigned int iterations_given ;	/**< @brief Whether iterations was given.  */
+  unsigned int batch_given ;	/**< @brief Whether batch was given.  */
+  unsigned int batch_gap_given ;	/**< @brief Whether batch-gap was given.  */
   unsigned int threads_given ;	/**< @brief Whether threads was given.  */
+  unsigned int dedup_given ;	/**< @brief Whether dedup was given.  */
+  unsigned int umi_given ;	/**< @brief Whether umi was given.  */
+  unsigned int umi_start_given ;	/**< @brief Whether umi-start was given.  */
+  unsigned int adapter_given ;	/**< @brief Whether adapter was given.  */
+  unsigned int quality_cutoff_given ;	/**< @brief Whether quality-cutoff was given.  */
+  unsigned int mask_quality_given ;	/**< @brief Whether mask-quality was given.  */
+  unsigned int min_length_given ;	/**< @brief Whether min-length was given.  */
   unsigned int delimiter_given ;	/**< @brief Whether delimiter was given.  */
   unsigned int no_log_given ;	/**< @brief Whether no-log was given.  */
   unsigned int enrichments_given ;	/**< @brief Whether enrichments was given.  */
   unsigned int shuffle_given ;	/**< @brief Whether shuffle was given.  */
   unsigned int klet_given ;	/**< @brief Whether klet was given.  */
+  unsigned int expected_shuffle_given ;	/**< @brief Whether expected-shuffle was given.  */
+  unsigned int shuffles_given ;	/**< @brief Whether shuffles was given.  */
   unsigned int independent_probs_given ;	/**< @brief Whether independent-probs was given.  */
+  unsigned int markov_order_given ;	/**< @brief Whether markov-order was given.  */
   unsigned int bootstrap_given ;	/**< @brief Whether bootstrap was given.  */
   unsigned int sample_given ;	/**< @brief Whether sample was given.  */
   unsigned int seed_given ;	/**< @brief Whether seed was given.  */
+  unsigned int tolerance_given ;	/**< @brief Whether tolerance was given.  */
+  unsigned int analytic_given ;	/**< @brief Whether analytic was given.  */
 
 } ;
 
@@ -1,10 +1,14 @@
+#include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 #include "kstruct_cmdl.h"
 
 #include "structure.h"
+#include "enrichments.h"
+#include "hash_functions.h"
 #include "string_utils.h"
 #include "memory_utils.h"
 
@@ -12,13 +16,41 @@ typedef struct Options {
 	char *test_file;   /** Name of test file */
 	char *ctrl_file;   /** Name of control file */
 	char *out_file;    /** Output file to write to */
+	char *out_name;    /** Output file name without its extension */
 
 	int  kmer;         /** Length of k-mer to count */
 	int  threads;      /** Number of threads to use */
+	bool verbose;      /** Report thread utilization */
 	char delimiter;    /** File delimiter for output file */
+	bool fold_cache;   /** Store and reuse the probabilities of each read? */
+	char *cache_dir;   /** Directory of the fold cache files */
+	int  cache_bits;   /** Bits per probability in the fold cache files */
 
 	bool seq_windows;  /** Use the sliding window algorithm? */
 	int  window_size;  /** Length of window to obtain from sequence */
+	bool dedup;        /** Fold identical sequences only once? */
+
+	BppStructureModel structure_model;  /** Model used to fold sequences */
+	int  max_bp_span;  /** Maximum base-pair span for the span model */
+	int  num_samples;  /** Number of sampled structures for the sample model */
+	int  beam_size;    /** States kept per nucleotide for the linear model */
+
+	bool stratify;     /** Count the k-mers by their structural context? */
+	BppStrataWeighting strata_weighting;  /** How each k-mer is split between contexts */
+	double paired_threshold;  /** Mean probability for a k-mer to count as paired */
+	bool   partners;   /** Report which k-mers pair with each other? */
+	double partners_min;  /** Smallest mass of a pair of k-mers to report */
+	int    bootstraps; /** Bootstrap replicates for the standard errors, 0 to skip them */
+
+	bool   adaptive;   /** Stop folding once the top k-mers converge? */
+	double tolerance;  /** Tolerance for the top k-mers to converge */
+	int    batch_size; /** Number of reads per batch in adaptive sampling */
+	int    top_kmers;  /** Number of top k-mers that need to converge */
+	int    seed;       /** Seed for adaptive sampling and the bootstrap replicates */
+
+	char *targets_file;   /** File with the k-mers of interest */
+	int  num_targets;     /** Number of k-mers to read from targets_file, 0 for all */
+	int  target_window;   /** Context window folded around each target, 0 for whole reads */
 } Options;
 
 char 
@@ -27,6 +59,18 @@ delimiter_to_char(char *user_delimiter);
 int
 set_out_file(Options *opt, char *name);
 
+BppStructureModel
+structure_model_from_string(const char *model);
+
+void
+model_comment(char *comment, size_t size, Options *opts);
+
+int
+strata_to_file(BppStrata *test, BppStrata *ctrl, Options *opts);
+
+int
+partners_to_file(BppPartners *partners, Options *opts);
+
 void
 free_options(Options *opt);
 
@@ -36,12 +80,40 @@ init_default_options(Options *opts)
 	opts->test_file = NULL;
 	opts->ctrl_file = NULL;
 	opts->out_file  = NULL;
+	opts->out_name  = NULL;
 
 	opts->kmer      = 5;
 	opts->threads   = 1;
+	opts->verbose   = false;
 	opts->delimiter = ',';
+	opts->fold_cache = false;
+	opts->cache_dir  = NULL;
+	opts->cache_bits = 16;
 
 	opts->seq_windows = 20;
+	opts->dedup = false;
+
+	opts->structure_model = BPP_MODEL_PF;
+	opts->max_bp_span = 100;
+	opts->num_samples = 100;
+	opts->beam_size = 100;
+
+	opts->stratify = false;
+	opts->strata_weighting = BPP_STRATA_THRESHOLD;
+	opts->paired_threshold = 0.5;
+	opts->partners = false;
+	opts->partners_min = 1.;
+	opts->bootstraps = 0;
+
+	opts->adaptive   = false;
+	opts->tolerance  = 0.01;
+	opts->batch_size = 5000;
+	opts->top_kmers  = 10;
+	opts->seed       = -1;
+
+	opts->targets_file  = NULL;
+	opts->num_targets   = 0;
+	opts->target_window = 0;
 }
 
 int
@@ -82,10 +154,38 @@ main(int argc, char *argv[])
 	if(set_out_file(&opts, args_info.output_arg) != 0)
 		goto cleanup_args;
 
+	if(args_info.fold_cache_given && args_info.fold_cache_arg)
+		opts.cache_dir = strdup(args_info.fold_cache_arg);
+
+	if(args_info.targets_given)
+		opts.targets_file = strdup(args_info.targets_arg);
+
 	opts.kmer          = args_info.kmer_arg;
 	opts.threads       = args_info.threads_arg;
+	opts.verbose       = args_info.verbose_flag;
 	opts.seq_windows   = args_info.seq_windows_given;
 	opts.window_size   = args_info.seq_windows_arg;
+	opts.dedup         = args_info.dedup_flag;
+	opts.fold_cache    = args_info.fold_cache_given;
+	opts.cache_bits    = args_info.cache_bits_arg;
+	opts.structure_model = structure_model_from_string(args_info.structure_model_arg);
+	opts.max_bp_span   = args_info.max_bp_span_arg;
+	opts.num_samples   = args_info.samples_arg;
+	opts.beam_size     = args_info.beam_size_arg;
+	opts.stratify      = args_info.stratify_given;
+	opts.strata_weighting = strcmp(args_info.stratify_arg, "expected") == 0 ?
+	                        BPP_STRATA_EXPECTED : BPP_STRATA_THRESHOLD;
+	opts.paired_threshold = args_info.paired_threshold_arg;
+	opts.partners      = args_info.partners_flag;
+	opts.partners_min  = args_info.partners_min_arg;
+	opts.bootstraps    = args_info.bootstrap_given ? args_info.bootstrap_arg : 0;
+	opts.adaptive      = args_info.adaptive_given;
+	opts.tolerance     = args_info.adaptive_arg;
+	opts.batch_size    = args_info.batch_size_arg;
+	opts.top_kmers     = args_info.adaptive_top_arg;
+	opts.seed          = args_info.seed_arg;
+	opts.num_targets   = args_info.num_targets_arg;
+	opts.target_window = args_info.target_window_arg;
 
 	/* Make sure options were set correctly */
 	if(opts.kmer < 1 || 16 < opts.kmer) {
@@ -99,6 +199,74 @@ main(int argc, char *argv[])
 		              "Given: %d", opts.window_size);
 	}
 
+	if(opts.max_bp_span < 1 || opts.num_samples < 1) {
+		error_message("Options 'max-bp-span' and 'samples' must be at least one.");
+		goto cleanup_args;
+	}
+
+	if(opts.beam_size < 0) {
+		error_message("Option 'beam-size' must be positive, or 0 to keep every state. "
+		              "Given: %d", opts.beam_size);
+		goto cleanup_args;
+	}
+
+	if(opts.paired_threshold < 0 || 1 < opts.paired_threshold) {
+		error_message("Option 'paired-threshold' must be a value between 0 and 1. "
+		              "Given: %g", opts.paired_threshold);
+		goto cleanup_args;
+	}
+
+	if(opts.stratify && opts.adaptive) {
+		error_message("Option 'stratify' can not be used with 'adaptive'.");
+		goto cleanup_args;
+	}
+
+	if(opts.partners && (opts.seq_windows || opts.target_window > 0 || opts.adaptive)) {
+		error_message("Option 'partners' can not be used with 'seq-windows', "
+		              "'target-window', or 'adaptive'.");
+		goto cleanup_args;
+	}
+
+	if(opts.bootstraps != 0 && opts.bootstraps < 2) {
+		error_message("Option 'bootstrap' must be at least two replicates. "
+		              "Given: %d", opts.bootstraps);
+		goto cleanup_args;
+	}
+
+	if(opts.bootstraps > 0 && opts.adaptive) {
+		error_message("Option 'bootstrap' can not be used with 'adaptive'.");
+		goto cleanup_args;
+	}
+
+	if(opts.cache_bits != 8 && opts.cache_bits != 16) {
+		error_message("Option 'cache-bits' must be either 8 or 16. "
+		              "Given: %d", opts.cache_bits);
+		goto cleanup_args;
+	}
+
+	if(opts.adaptive && opts.tolerance <= 0) {
+		error_message("Option 'adaptive' must be a tolerance greater than zero. "
+		              "Given: %g", opts.tolerance);
+		goto cleanup_args;
+	}
+
+	if(opts.adaptive && (opts.batch_size < 1 || opts.top_kmers < 1)) {
+		error_message("Options 'batch-size' and 'adaptive-top' must be at least one.");
+		goto cleanup_args;
+	}
+
+	if(opts.num_targets < 0) {
+		error_message("Option 'num-targets' must be non-negative. "
+		              "Given: %d", opts.num_targets);
+		goto cleanup_args;
+	}
+
+	if(opts.target_window != 0 && opts.target_window < opts.kmer) {
+		error_message("Option 'target-window' must be at least the k-mer length. "
+		              "Given: %d", opts.target_window);
+		goto cleanup_args;
+	}
+
 	kstruct_cmdline_parser_free(&args_info);
 
 	/* Setup options for katss_bpp */
@@ -108,18 +276,74 @@ main(int argc, char *argv[])
 	bpp_opts.seq_windows = opts.seq_windows;
 	bpp_opts.window_size = opts.window_size;
 	bpp_opts.threads     = opts.threads;
+	bpp_opts.verbose     = opts.verbose;
+	bpp_opts.dedup       = opts.dedup;
+	bpp_opts.structure_model = opts.structure_model;
+	bpp_opts.max_bp_span = opts.max_bp_span;
+	bpp_opts.num_samples = opts.num_samples;
+	bpp_opts.beam_size = opts.beam_size;
+	bpp_opts.strata_weighting = opts.strata_weighting;
+	bpp_opts.paired_threshold = opts.paired_threshold;
+	bpp_opts.fold_cache  = opts.fold_cache;
+	bpp_opts.cache_dir   = opts.cache_dir;
+	bpp_opts.cache_bits  = opts.cache_bits;
+	bpp_opts.adaptive    = opts.adaptive;
+	bpp_opts.tolerance   = opts.tolerance;
+	bpp_opts.batch_size  = opts.batch_size;
+	bpp_opts.top_kmers   = opts.top_kmers;
+	bpp_opts.seed        = opts.seed == -1 ? (unsigned int)time(NULL) : (unsigned int)opts.seed;
+	bpp_opts.target_window = opts.target_window;
+	bpp_opts.bootstraps  = opts.bootstraps;
+
+	/* Read the k-mers of interest */
+	if(opts.targets_file) {
+		bpp_opts.targets = bpp_targets_load(opts.targets_file, opts.kmer, opts.num_targets);
+		if(bpp_opts.targets == NULL)
+			goto cleanup_opts;
+	}
+
+	if(opts.partners)
+		bpp_opts.partners = bpp_partners_init(opts.kmer);
 
-	/* Calculate structural preference */
+	/* Calculate structural preference, counting the k-mers by context if requested */
+	BppStrata test_strata, ctrl_strata;
 	kmerHashTable *enrichments;
-	enrichments = katss_bpp(opts.test_file, opts.ctrl_file, &bpp_opts);
-	if(enrichments == NULL)
+	enrichments = katss_bpp_stratified(opts.test_file, opts.ctrl_file, &bpp_opts,
+	                                   opts.stratify ? &test_strata : NULL,
+	                                   opts.stratify ? &ctrl_strata : NULL);
+	bpp_targets_free(bpp_opts.targets);
+	if(enrichments == NULL) {
+		bpp_partners_free(bpp_opts.partners);
 		goto cleanup_opts;
+	}
 	
-	/* Output to file */
-	kmerHashTable_to_file(enrichments, opts.out_file, opts.delimiter);
+	/* Output to file, noting a non-default structure model and the error columns */
+	char comment[160];
+	model_comment(comment, sizeof comment, &opts);
+	if(opts.bootstraps > 0) {
+		size_t length = strlen(comment);
+		snprintf(comment + length, sizeof comment - length, " bootstrap=%d", opts.bootstraps);
+	}
+	if(opts.structure_model == BPP_MODEL_PF && opts.bootstraps <= 0)
+		kmerHashTable_to_file(enrichments, opts.out_file, opts.delimiter);
+	else
+		kmerHashTable_to_file_comment(enrichments, opts.out_file, opts.delimiter, comment);
+	katss_free_bpp(enrichments);
+
+	int status = 0;
+	if(opts.stratify) {
+		status |= strata_to_file(&test_strata, &ctrl_strata, &opts);
+		katss_free_strata(&test_strata);
+		katss_free_strata(&ctrl_strata);
+	}
+	if(opts.partners) {
+		status |= partners_to_file(bpp_opts.partners, &opts);
+		bpp_partners_free(bpp_opts.partners);
+	}
+	if(status != 0)
+		goto cleanup_opts;
 
 	/* Cleanup and return */
-	katss_free_bpp(enrichments);
 	free_options(&opts);
 	return 0;
 cleanup_args:
@@ -171,6 +395,7 @@ set_out_file(Options *opt, char *name)
 		name = "rna";
 
 	char *out_filename;
+	opt->out_name = strdup(name);
 	switch(opt->delimiter) {
 		case ',':  out_filename = concat(name, ".csv"); break;
 		case '\t': out_filename = concat(name, ".tsv"); break;
@@ -181,6 +406,102 @@ set_out_file(Options *opt, char *name)
 	return opt->out_file == NULL;
 }
 
+BppStructureModel
+structure_model_from_string(const char *model)
+{
+	/* The parser only accepts values listed in kstruct.ggo */
+	if(strcmp(model, "mfe") == 0)
+		return BPP_MODEL_MFE;
+	if(strcmp(model, "sample") == 0)
+		return BPP_MODEL_SAMPLE;
+	if(strcmp(model, "span") == 0)
+		return BPP_MODEL_SPAN;
+	if(strcmp(model, "linear") == 0)
+		return BPP_MODEL_LINEAR;
+	return BPP_MODEL_PF;
+}
+
+void
+model_comment(char *comment, size_t size, Options *opts)
+{
+	const char *name = katss_bpp_model_name(opts->structure_model);
+	switch(opts->structure_model) {
+		case BPP_MODEL_SPAN:
+			snprintf(comment, size, "structure-model=%s max-bp-span=%d", name, opts->max_bp_span);
+			break;
+		case BPP_MODEL_SAMPLE:
+			snprintf(comment, size, "structure-model=%s samples=%d", name, opts->num_samples);
+			break;
+		case BPP_MODEL_LINEAR:
+			snprintf(comment, size, "structure-model=%s beam-size=%d", name, opts->beam_size);
+			break;
+		default:
+			snprintf(comment, size, "structure-model=%s", name);
+			break;
+	}
+}
+
+/* Name of an extra output file, the output file with suffix added before its extension */
+static char *
+suffixed_out_file(Options *opts, const char *suffix)
+{
+	const char *extension = strrchr(opts->out_file, '.');
+	char *prefix = concat(opts->out_name, suffix);
+	char *filename = concat(prefix, extension);
+	free(prefix);
+	return filename;
+}
+
+/* Write the enrichments of one structural context, in the same format as ikke */
+static int
+context_to_file(KatssCounter *test, KatssCounter *ctrl, const char *context, Options *opts)
+{
+	char *filename = suffixed_out_file(opts, context);
+	FILE *file = fopen(filename, "w");
+	if(file == NULL) {
+		error_message("Could not write to file '%s'", filename);
+		free(filename);
+		return 1;
+	}
+
+	KatssEnrichments *enrichments = katss_compute_enrichments(test, ctrl, true);
+	katss_sort_enrichments(enrichments);
+
+	fprintf(file, "kmer%crval\n", opts->delimiter);
+	char kseq[32];
+	for(uint64_t i = 0; i < enrichments->num_enrichments; i++) {
+		double rval = enrichments->enrichments[i].enrichment;
+		if(isnan(rval))
+			continue;
+		katss_unhash(kseq, enrichments->enrichments[i].key, opts->kmer, false);
+		fprintf(file, "%s%c%f\n", kseq, opts->delimiter, rval);
+	}
+
+	katss_free_enrichments(enrichments);
+	fclose(file);
+	free(filename);
+	return 0;
+}
+
+int
+strata_to_file(BppStrata *test, BppStrata *ctrl, Options *opts)
+{
+	int status = context_to_file(test->paired, ctrl->paired, "_paired", opts);
+	if(status == 0)
+		status = context_to_file(test->unpaired, ctrl->unpaired, "_unpaired", opts);
+	return status;
+}
+
+int
+partners_to_file(BppPartners *partners, Options *opts)
+{
+	bpp_partners_prune(partners, opts->partners_min);
+	char *filename = suffixed_out_file(opts, "_partners");
+	int status = bpp_partners_to_file(partners, filename, opts->delimiter);
+	free(filename);
+	return status;
+}
+
 void
 free_options(Options *opt)
 {
@@ -190,4 +511,10 @@ free_options(Options *opt)
 		free(opt->ctrl_file);
 	if(opt->out_file)
 		free(opt->out_file);
+	if(opt->out_name)
+		free(opt->out_name);
+	if(opt->cache_dir)
+		free(opt->cache_dir);
+	if(opt->targets_file)
+		free(opt->targets_file);
 }
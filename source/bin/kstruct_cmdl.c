@@ -48,12 +48,54 @@ const char *kstruct_args_info_detailed_help[] = {
   "  Specify the length of the k-mers you want to perform the enrichment analysis\n  on.\n",
   "      --threads=INT        Set the number of threads to use in ikke. This\n                             allows to process calculations in parallel using\n                             multiple threads.  (default=`1')",
   "  By default, processing of the test and control files is computed serially.\n  Specifying this options allows for parallelization of the computations.\n  Though, this not only increases memory consumption as each thread requires\n  storing sequences, but it is possible to that it can provide incorrect counts\n  or even fail when the files have long sequences (>16000nt). In other words,\n  if you have long sequences in your file, it is not recommended to turn on\n  threads.\n",
+  "      --verbose            Report how busy each folding thread was.\n                             (default=off)",
+  "  When using multiple threads, reads are folded in batches where the longest\n  sequences are started first and idle threads take work from busy ones. With\n  this flag, the number of sequences folded by each thread and the time it\n  spent folding are printed to stderr, which helps to check whether all cores\n  were kept busy.\n",
   "  -d, --delimiter=char     Set the delimiter used to separate the values in the\n                             output file.  (default=`,')",
   "  The output of ikke is by default in CSV format, meaning the values are\n  comma-delimited. By specifying this option, you can change the delimiter used\n  to separate the values. The available delimiters are: comma (,), tab (t),\n  colon (:), vertical bar (|), and space (\" \"). For example, setting\n  `--delimiter=\" \"` will change the delimiter to be space-delimited. If using\n  the comma delimiter, the file extension will be \".csv\"; if using the tab\n  delimiter, the file extension will be \".tsv\"; otherwise, the extension will\n  be \".dsv\". Support for other delimiters is currently unavailable.\n",
+  "      --fold-cache[=directory]  Store the base-pair probabilities of every read, and\n                             reuse them in later runs.",
+  "  The first run writes the probabilities of each read of the test and control\n  files to a binary file named after the reads file, with a \".kbpp\" extension.\n  The file is placed next to the reads file, or in the given directory. Later\n  runs with the same reads and the same structure options (`--structure-model`,\n  `--max-bp-span`, `--samples`, `--beam-size`, `--seq-windows`, and\n  `--cache-bits`) read those files instead of folding, for any k-mer length.\n  The files are rebuilt whenever the reads file changes. They are not used with\n  `--adaptive`.\n",
+  "      --cache-bits=INT     Number of bits used to store each probability with\n                             --fold-cache (8 or 16).  (default=`16')",
+  "  ",
   "\nAlgorithms:",
   "  Select additional algorithms to determine the calculations.\n\n",
   "  -w, --seq-windows[=INT]  Split the sequence into sliding windows of the\n                             specified size and find the mean probability per\n                             position in the window.  (default=`20')",
   "  If this option is provided, each sequence will be iterated by creating\n  sliding windows of the provided size. For example, if the sequence  is:\n  \tAGCUUCGA\n  Then, the sliding windows of size 5 would be:\n  \tAGCUU\n  \t GCUUC\n  \t  CUUCG\n  \t   UUCGA\n  The pipeline will then find the base pair probability of each window. After\n  which, the mean probability of each aligned nucleotide across the windows\n  will be used as the base pair probability for each nucleotide in the\n  sequence.\n",
+  "      --dedup              Fold each distinct sequence only once.\n                             (default=off)",
+  "  Identical sequences (after cleaning) are collapsed into a single entry along\n  with the number of times they were seen. Every distinct sequence is folded\n  once, and its base-pair probabilities are weighted by its multiplicity, so\n  the output is the same as without this option. Libraries with many PCR\n  duplicates or recurring sequences (such as CLIP or SELEX libraries) skip most\n  of the folding this way, at the cost of holding the distinct sequences of a\n  file in memory.\n",
+  "      --structure-model=STRING  Select the structure model used to get the base-pair\n                             probability of each nucleotide.  (possible\n                             values=\"pf\", \"mfe\", \"sample\", \"span\",\n                             \"linear\" default=`pf')",
+  "  The structure model trades accuracy for speed:\n  \tpf: the base-pair probabilities of the partition function (default)\n  \tmfe: whether the nucleotide is paired (1) or not (0) in the minimum free\n  energy structure\n  \tsample: the fraction of `--samples` stochastically sampled structures in\n  which the nucleotide is paired\n  \tspan: the partition function, restricted to base pairs spanning at most\n  `--max-bp-span` nucleotides\n  \tlinear: the partition function, keeping only the `--beam-size` most likely\n  states at each nucleotide\n  The mfe model is several times faster than the partition function, and the\n  span and linear models scale linearly with the length of long reads rather\n  than cubically. Unlike span, linear does not limit the distance between\n  paired nucleotides. The model used is written to the first line of the output\n  file.\n",
+  "      --max-bp-span=INT    Largest distance between two paired nucleotides with\n                             --structure-model=span.  (default=`100')",
+  "  ",
+  "      --samples=INT        Number of structures sampled per sequence with\n                             --structure-model=sample.  (default=`100')",
+  "  ",
+  "      --beam-size=INT      Number of states kept per nucleotide with\n                             --structure-model=linear, or 0 to keep all of\n                             them.  (default=`100')",
+  "  ",
+  "      --stratify[=STRING]  Also count the k-mers by their structural context,\n                             and report their enrichments in paired and\n                             unpaired contexts.  (possible values=\"threshold\",\n                             \"expected\" default=`threshold')",
+  "  While the reads are folded, every occurrence of a k-mer is also counted as\n  paired or unpaired by the mean base-pair probability of its nucleotides:\n  \tthreshold: paired if the mean reaches `--paired-threshold` (default)\n  \texpected: split between both contexts by the mean\n  The enrichments of the k-mers in each context, computed as in `ikke\n  --enrichments`, are written to two more files named after the output file\n  with \"_paired\" and \"_unpaired\" added. This answers whether a motif is\n  enriched in an unpaired context without reading the files again. Not\n  available with `--adaptive`.\n",
+  "      --paired-threshold=DOUBLE  Smallest mean base-pair probability of a k-mer\n                             counted as paired with --stratify=threshold.\n                             (default=`0.5')",
+  "  ",
+  "      --partners           Also report which k-mers pair with each other in the\n                             test reads.  (default=off)",
+  "  Every base pair (i, j) of the folded test reads adds its probability to the\n  k-mer starting at i and the k-mer ending at j, so a k-mer and the k-mer it\n  forms a helix with add up their whole stem. The pairs are taken from the same\n  folds as the base-pair probabilities, so the reads are not folded again. The\n  pairs of k-mers with a total of at least `--partners-min` are written, from\n  the most to the least likely, to a file named after the output file with\n  \"_partners\" added. With `--targets`, only the pairs involving a target are\n  kept. Base pairs less likely than 0.01 are left out. Not available with\n  `--seq-windows`, `--target-window`, or `--adaptive`.\n",
+  "      --partners-min=DOUBLE  Smallest total base-pair probability of the pairs of\n                             k-mers written with --partners.  (default=`1')",
+  "  ",
+  "      --bootstrap[=INT]    Also report the standard error and p-value of every\n                             enrichment, from the given number of bootstrap\n                             replicates.  (default=`20')",
+  "  While the reads are folded, the running mean and variance of the base-pair\n  probability of every k-mer position are kept, along with the given number of\n  bootstrap replicates in which each read is drawn a Poisson distributed number\n  of times. After the enrichments and their mean, the output file then has the\n  standard error of each of them, followed by their two-sided p-values. The\n  errors of the positions come from their variances, while the error of the\n  mean comes from the spread of the replicates, since the positions of a k-mer\n  are not independent. All of this comes from the same folds, so the reads are\n  only folded once. The replicates are drawn from `--seed`. Not available with\n  `--adaptive`.\n",
+  "  -a, --adaptive[=DOUBLE]  Fold random batches of reads until the top k-mers\n                             converge to the given tolerance.  (default=`0.01')",
+  "  Instead of folding every read, reads from the test and control files are\n  folded in a random order, in batches of `--batch-size` reads. After every\n  batch, the running mean and variance of the base-pair probability of each\n  k-mer position are used to compute the enrichments. Once the `--adaptive-top`\n  k-mers keep their ranking and their mean enrichments change less than the\n  tolerance between two batches, no more reads are folded. The number of reads\n  used and the confidence that each top k-mer is within the tolerance of its\n  value are reported. Note that all sequences of both files are held in memory.\n",
+  "      --batch-size=INT     Number of reads folded from each file per batch with\n                             --adaptive.  (default=`5000')",
+  "  ",
+  "      --adaptive-top=INT   Number of top k-mers that have to converge with\n                             --adaptive.  (default=`10')",
+  "  ",
+  "      --seed=INT           Specify the seed used to pick the order of reads\n                             with --adaptive, and the bootstrap replicates with\n                             --bootstrap  (default=`-1')",
+  "  Seeding the order in which reads are folded, and the bootstrap replicates,\n  ensures deterministic output. To pick a random seed, set `seed=-1`.\n",
+  "\nTargets:",
+  "Only fold the reads that contain k-mers of interest.\n\n",
+  "      --targets=filename   Only fold the reads containing one of the k-mers\n                             listed in the file.",
+  "  The file is either a list of k-mers, one per line, or the output of ikke or\n  kstruct, in which case the k-mer of each row is taken from the first column.\n  Reads of the test and control files are scanned for the listed k-mers before\n  folding, and reads without any of them are skipped. Only the listed k-mers\n  are reported. Since the mean base-pair probability of a k-mer only depends on\n  the reads that contain it, the reported values are the same as without this\n  option, unless `--target-window` is used.\n",
+  "      --num-targets=INT    Only use the first N k-mers of the --targets file,\n                             or all of them if 0.  (default=`0')",
+  "  ",
+  "      --target-window=INT  Fold a window of this many nucleotides around each\n                             target occurrence instead of the whole read.\n                             (default=`0')",
+  "  With a positive window size, every occurrence of a k-mer from `--targets` is\n  folded in its own context window, centered on the k-mer and clipped to the\n  ends of the read, and only that occurrence is counted. Folding short windows\n  is much cheaper than folding long reads, but the probabilities no longer\n  account for base pairs outside of the window. The default of 0 folds whole\n  reads.\n",
     0
 };
 
@@ -72,17 +114,41 @@ init_help_array(void)
   kstruct_args_info_help[9] = kstruct_args_info_detailed_help[13];
   kstruct_args_info_help[10] = kstruct_args_info_detailed_help[15];
   kstruct_args_info_help[11] = kstruct_args_info_detailed_help[17];
-  kstruct_args_info_help[12] = kstruct_args_info_detailed_help[18];
-  kstruct_args_info_help[13] = kstruct_args_info_detailed_help[19];
-  kstruct_args_info_help[14] = 0; 
+  kstruct_args_info_help[12] = kstruct_args_info_detailed_help[19];
+  kstruct_args_info_help[13] = kstruct_args_info_detailed_help[21];
+  kstruct_args_info_help[14] = kstruct_args_info_detailed_help[23];
+  kstruct_args_info_help[15] = kstruct_args_info_detailed_help[24];
+  kstruct_args_info_help[16] = kstruct_args_info_detailed_help[25];
+  kstruct_args_info_help[17] = kstruct_args_info_detailed_help[27];
+  kstruct_args_info_help[18] = kstruct_args_info_detailed_help[29];
+  kstruct_args_info_help[19] = kstruct_args_info_detailed_help[31];
+  kstruct_args_info_help[20] = kstruct_args_info_detailed_help[33];
+  kstruct_args_info_help[21] = kstruct_args_info_detailed_help[35];
+  kstruct_args_info_help[22] = kstruct_args_info_detailed_help[37];
+  kstruct_args_info_help[23] = kstruct_args_info_detailed_help[39];
+  kstruct_args_info_help[24] = kstruct_args_info_detailed_help[41];
+  kstruct_args_info_help[25] = kstruct_args_info_detailed_help[43];
+  kstruct_args_info_help[26] = kstruct_args_info_detailed_help[45];
+  kstruct_args_info_help[27] = kstruct_args_info_detailed_help[47];
+  kstruct_args_info_help[28] = kstruct_args_info_detailed_help[49];
+  kstruct_args_info_help[29] = kstruct_args_info_detailed_help[51];
+  kstruct_args_info_help[30] = kstruct_args_info_detailed_help[53];
+  kstruct_args_info_help[31] = kstruct_args_info_detailed_help[55];
+  kstruct_args_info_help[32] = kstruct_args_info_detailed_help[56];
+  kstruct_args_info_help[33] = kstruct_args_info_detailed_help[57];
+  kstruct_args_info_help[34] = kstruct_args_info_detailed_help[59];
+  kstruct_args_info_help[35] = kstruct_args_info_detailed_help[61];
+  kstruct_args_info_help[36] = 0; 
   
 }
 
-const char *kstruct_args_info_help[15];
+const char *kstruct_args_info_help[37];
 
 typedef enum {ARG_NO
+  , ARG_FLAG
   , ARG_STRING
   , ARG_INT
+  , ARG_DOUBLE
 } kstruct_cmdline_parser_arg_type;
 
 static
@@ -95,6 +161,10 @@ kstruct_cmdline_parser_internal (int argc, char **argv, struct kstruct_args_info
                         struct kstruct_cmdline_parser_params *params, const char *additional_error);
 
 
+const char *kstruct_cmdline_parser_structure_model_values[] = {"pf", "mfe", "sample", "span", "linear", 0}; /*< Possible values for structure-model. */
+
+const char *kstruct_cmdline_parser_stratify_values[] = {"threshold", "expected", 0}; /*< Possible values for stratify. */
+
 static char *
 gengetopt_strdup (const char *s);
 
@@ -109,8 +179,28 @@ void clear_given (struct kstruct_args_info *args_info)
   args_info->output_given = 0 ;
   args_info->kmer_given = 0 ;
   args_info->threads_given = 0 ;
+  args_info->verbose_given = 0 ;
   args_info->delimiter_given = 0 ;
+  args_info->fold_cache_given = 0 ;
+  args_info->cache_bits_given = 0 ;
   args_info->seq_windows_given = 0 ;
+  args_info->dedup_given = 0 ;
+  args_info->structure_model_given = 0 ;
+  args_info->max_bp_span_given = 0 ;
+  args_info->samples_given = 0 ;
+  args_info->beam_size_given = 0 ;
+  args_info->stratify_given = 0 ;
+  args_info->paired_threshold_given = 0 ;
+  args_info->partners_given = 0 ;
+  args_info->partners_min_given = 0 ;
+  args_info->bootstrap_given = 0 ;
+  args_info->adaptive_given = 0 ;
+  args_info->batch_size_given = 0 ;
+  args_info->adaptive_top_given = 0 ;
+  args_info->seed_given = 0 ;
+  args_info->targets_given = 0 ;
+  args_info->num_targets_given = 0 ;
+  args_info->target_window_given = 0 ;
 }
 
 static
@@ -127,10 +217,47 @@ void clear_args (struct kstruct_args_info *args_info)
   args_info->kmer_orig = NULL;
   args_info->threads_arg = 1;
   args_info->threads_orig = NULL;
+  args_info->verbose_flag = 0;
   args_info->delimiter_arg = gengetopt_strdup (",");
   args_info->delimiter_orig = NULL;
+  args_info->fold_cache_arg = NULL;
+  args_info->fold_cache_orig = NULL;
+  args_info->cache_bits_arg = 16;
+  args_info->cache_bits_orig = NULL;
   args_info->seq_windows_arg = 20;
   args_info->seq_windows_orig = NULL;
+  args_info->dedup_flag = 0;
+  args_info->structure_model_arg = gengetopt_strdup ("pf");
+  args_info->structure_model_orig = NULL;
+  args_info->max_bp_span_arg = 100;
+  args_info->max_bp_span_orig = NULL;
+  args_info->samples_arg = 100;
+  args_info->samples_orig = NULL;
+  args_info->beam_size_arg = 100;
+  args_info->beam_size_orig = NULL;
+  args_info->stratify_arg = gengetopt_strdup ("threshold");
+  args_info->stratify_orig = NULL;
+  args_info->paired_threshold_arg = 0.5;
+  args_info->paired_threshold_orig = NULL;
+  args_info->partners_flag = 0;
+  args_info->partners_min_arg = 1;
+  args_info->partners_min_orig = NULL;
+  args_info->bootstrap_arg = 20;
+  args_info->bootstrap_orig = NULL;
+  args_info->adaptive_arg = 0.01;
+  args_info->adaptive_orig = NULL;
+  args_info->batch_size_arg = 5000;
+  args_info->batch_size_orig = NULL;
+  args_info->adaptive_top_arg = 10;
+  args_info->adaptive_top_orig = NULL;
+  args_info->seed_arg = -1;
+  args_info->seed_orig = NULL;
+  args_info->targets_arg = NULL;
+  args_info->targets_orig = NULL;
+  args_info->num_targets_arg = 0;
+  args_info->num_targets_orig = NULL;
+  args_info->target_window_arg = 0;
+  args_info->target_window_orig = NULL;
   
 }
 
@@ -147,8 +274,28 @@ void init_args_info(struct kstruct_args_info *args_info)
   args_info->output_help = kstruct_args_info_detailed_help[9] ;
   args_info->kmer_help = kstruct_args_info_detailed_help[11] ;
   args_info->threads_help = kstruct_args_info_detailed_help[13] ;
-  args_info->delimiter_help = kstruct_args_info_detailed_help[15] ;
-  args_info->seq_windows_help = kstruct_args_info_detailed_help[19] ;
+  args_info->verbose_help = kstruct_args_info_detailed_help[15] ;
+  args_info->delimiter_help = kstruct_args_info_detailed_help[17] ;
+  args_info->fold_cache_help = kstruct_args_info_detailed_help[19] ;
+  args_info->cache_bits_help = kstruct_args_info_detailed_help[21] ;
+  args_info->seq_windows_help = kstruct_args_info_detailed_help[25] ;
+  args_info->dedup_help = kstruct_args_info_detailed_help[27] ;
+  args_info->structure_model_help = kstruct_args_info_detailed_help[29] ;
+  args_info->max_bp_span_help = kstruct_args_info_detailed_help[31] ;
+  args_info->samples_help = kstruct_args_info_detailed_help[33] ;
+  args_info->beam_size_help = kstruct_args_info_detailed_help[35] ;
+  args_info->stratify_help = kstruct_args_info_detailed_help[37] ;
+  args_info->paired_threshold_help = kstruct_args_info_detailed_help[39] ;
+  args_info->partners_help = kstruct_args_info_detailed_help[41] ;
+  args_info->partners_min_help = kstruct_args_info_detailed_help[43] ;
+  args_info->bootstrap_help = kstruct_args_info_detailed_help[45] ;
+  args_info->adaptive_help = kstruct_args_info_detailed_help[47] ;
+  args_info->batch_size_help = kstruct_args_info_detailed_help[49] ;
+  args_info->adaptive_top_help = kstruct_args_info_detailed_help[51] ;
+  args_info->seed_help = kstruct_args_info_detailed_help[53] ;
+  args_info->targets_help = kstruct_args_info_detailed_help[57] ;
+  args_info->num_targets_help = kstruct_args_info_detailed_help[59] ;
+  args_info->target_window_help = kstruct_args_info_detailed_help[61] ;
   
 }
 
@@ -260,7 +407,28 @@ kstruct_cmdline_parser_release (struct kstruct_args_info *args_info)
   free_string_field (&(args_info->threads_orig));
   free_string_field (&(args_info->delimiter_arg));
   free_string_field (&(args_info->delimiter_orig));
+  free_string_field (&(args_info->fold_cache_arg));
+  free_string_field (&(args_info->fold_cache_orig));
+  free_string_field (&(args_info->cache_bits_orig));
   free_string_field (&(args_info->seq_windows_orig));
+  free_string_field (&(args_info->structure_model_arg));
+  free_string_field (&(args_info->structure_model_orig));
+  free_string_field (&(args_info->max_bp_span_orig));
+  free_string_field (&(args_info->samples_orig));
+  free_string_field (&(args_info->beam_size_orig));
+  free_string_field (&(args_info->stratify_arg));
+  free_string_field (&(args_info->stratify_orig));
+  free_string_field (&(args_info->paired_threshold_orig));
+  free_string_field (&(args_info->partners_min_orig));
+  free_string_field (&(args_info->bootstrap_orig));
+  free_string_field (&(args_info->adaptive_orig));
+  free_string_field (&(args_info->batch_size_orig));
+  free_string_field (&(args_info->adaptive_top_orig));
+  free_string_field (&(args_info->seed_orig));
+  free_string_field (&(args_info->targets_arg));
+  free_string_field (&(args_info->targets_orig));
+  free_string_field (&(args_info->num_targets_orig));
+  free_string_field (&(args_info->target_window_orig));
   
   
   for (i = 0; i < args_info->inputs_num; ++i)
@@ -273,12 +441,54 @@ kstruct_cmdline_parser_release (struct kstruct_args_info *args_info)
 }
 
 
+/**
+ * @param val the value to check
+ * @param values the possible values
+ * @return the index of the matched value:
+ * -1 if no value matched,
+ * -2 if more than one value has matched
+ */
+static int
+check_possible_values(const char *val, const char *values[])
+{
+  int i, found, last;
+  size_t len;
+
+  if (!val)   /* otherwise strlen() crashes below */
+    return -1; /* -1 means no argument for the option */
+
+  found = last = 0;
+
+  for (i = 0, len = strlen(val); values[i]; ++i)
+    {
+      if (strncmp(val, values[i], len) == 0)
+        {
+          ++found;
+          last = i;
+          if (strlen(values[i]) == len)
+            return i; /* exact macth no need to check more */
+        }
+    }
+
+  if (found == 1) /* one match: OK */
+    return last;
+
+  return (found ? -2 : -1); /* return many values or none matched */
+}
+
+
 static void
 write_into_file(FILE *outfile, const char *opt, const char *arg, const char *values[])
 {
-  FIX_UNUSED (values);
+  int found = -1;
   if (arg) {
-    fprintf(outfile, "%s=\"%s\"\n", opt, arg);
+    if (values) {
+      found = check_possible_values(arg, values);      
+    }
+    if (found >= 0)
+      fprintf(outfile, "%s=\"%s\" # %s\n", opt, arg, values[found]);
+    else
+      fprintf(outfile, "%s=\"%s\"\n", opt, arg);
   } else {
     fprintf(outfile, "%s\n", opt);
   }
@@ -312,10 +522,50 @@ kstruct_cmdline_parser_dump(FILE *outfile, struct kstruct_args_info *args_info)
     write_into_file(outfile, "kmer", args_info->kmer_orig, 0);
   if (args_info->threads_given)
     write_into_file(outfile, "threads", args_info->threads_orig, 0);
+  if (args_info->verbose_given)
+    write_into_file(outfile, "verbose", 0, 0 );
   if (args_info->delimiter_given)
     write_into_file(outfile, "delimiter", args_info->delimiter_orig, 0);
+  if (args_info->fold_cache_given)
+    write_into_file(outfile, "fold-cache", args_info->fold_cache_orig, 0);
+  if (args_info->cache_bits_given)
+    write_into_file(outfile, "cache-bits", args_info->cache_bits_orig, 0);
   if (args_info->seq_windows_given)
     write_into_file(outfile, "seq-windows", args_info->seq_windows_orig, 0);
+  if (args_info->dedup_given)
+    write_into_file(outfile, "dedup", 0, 0 );
+  if (args_info->structure_model_given)
+    write_into_file(outfile, "structure-model", args_info->structure_model_orig, kstruct_cmdline_parser_structure_model_values);
+  if (args_info->max_bp_span_given)
+    write_into_file(outfile, "max-bp-span", args_info->max_bp_span_orig, 0);
+  if (args_info->samples_given)
+    write_into_file(outfile, "samples", args_info->samples_orig, 0);
+  if (args_info->beam_size_given)
+    write_into_file(outfile, "beam-size", args_info->beam_size_orig, 0);
+  if (args_info->stratify_given)
+    write_into_file(outfile, "stratify", args_info->stratify_orig, kstruct_cmdline_parser_stratify_values);
+  if (args_info->paired_threshold_given)
+    write_into_file(outfile, "paired-threshold", args_info->paired_threshold_orig, 0);
+  if (args_info->partners_given)
+    write_into_file(outfile, "partners", 0, 0 );
+  if (args_info->partners_min_given)
+    write_into_file(outfile, "partners-min", args_info->partners_min_orig, 0);
+  if (args_info->bootstrap_given)
+    write_into_file(outfile, "bootstrap", args_info->bootstrap_orig, 0);
+  if (args_info->adaptive_given)
+    write_into_file(outfile, "adaptive", args_info->adaptive_orig, 0);
+  if (args_info->batch_size_given)
+    write_into_file(outfile, "batch-size", args_info->batch_size_orig, 0);
+  if (args_info->adaptive_top_given)
+    write_into_file(outfile, "adaptive-top", args_info->adaptive_top_orig, 0);
+  if (args_info->seed_given)
+    write_into_file(outfile, "seed", args_info->seed_orig, 0);
+  if (args_info->targets_given)
+    write_into_file(outfile, "targets", args_info->targets_orig, 0);
+  if (args_info->num_targets_given)
+    write_into_file(outfile, "num-targets", args_info->num_targets_orig, 0);
+  if (args_info->target_window_given)
+    write_into_file(outfile, "target-window", args_info->target_window_orig, 0);
   
 
   i = EXIT_SUCCESS;
@@ -1062,7 +1312,18 @@ int update_arg(void *field, char **orig_field,
       return 1; /* failure */
     }
 
-  FIX_UNUSED (default_value);
+  if (possible_values && (found = check_possible_values((value ? value : default_value), possible_values)) < 0)
+    {
+      if (short_opt != '-')
+        fprintf (stderr, "%s: %s argument, \"%s\", for option `--%s' (`-%c')%s\n", 
+          package_name, (found == -2) ? "ambiguous" : "invalid", value, long_opt, short_opt,
+          (additional_error ? additional_error : ""));
+      else
+        fprintf (stderr, "%s: %s argument, \"%s\", for option `--%s'%s\n", 
+          package_name, (found == -2) ? "ambiguous" : "invalid", value, long_opt,
+          (additional_error ? additional_error : ""));
+      return 1; /* failure */
+    }
     
   if (field_given && *field_given && ! override)
     return 0;
@@ -1074,9 +1335,15 @@ int update_arg(void *field, char **orig_field,
     val = possible_values[found];
 
   switch(arg_type) {
+  case ARG_FLAG:
+    *((int *)field) = !*((int *)field);
+    break;
   case ARG_INT:
     if (val) *((int *)field) = strtol (val, &stop_char, 0);
     break;
+  case ARG_DOUBLE:
+    if (val) *((double *)field) = strtod (val, &stop_char);
+    break;
   case ARG_STRING:
     if (val) {
       string_field = (char **)field;
@@ -1092,6 +1359,7 @@ int update_arg(void *field, char **orig_field,
   /* check numeric conversion */
   switch(arg_type) {
   case ARG_INT:
+  case ARG_DOUBLE:
     if (val && !(stop_char && *stop_char == '\0')) {
       fprintf(stderr, "%s: invalid numeric value: %s\n", package_name, val);
       return 1; /* failure */
@@ -1104,6 +1372,7 @@ int update_arg(void *field, char **orig_field,
   /* store the original value */
   switch(arg_type) {
   case ARG_NO:
+  case ARG_FLAG:
     break;
   default:
     if (value && orig_field) {
@@ -1177,8 +1446,28 @@ kstruct_cmdline_parser_internal (
         { "output",	1, NULL, 'o' },
         { "kmer",	1, NULL, 'k' },
         { "threads",	1, NULL, 0 },
+        { "verbose",	0, NULL, 0 },
         { "delimiter",	1, NULL, 'd' },
+        { "fold-cache",	2, NULL, 0 },
+        { "cache-bits",	1, NULL, 0 },
         { "seq-windows",	2, NULL, 'w' },
+        { "dedup",	0, NULL, 0 },
+        { "structure-model",	1, NULL, 0 },
+        { "max-bp-span",	1, NULL, 0 },
+        { "samples",	1, NULL, 0 },
+        { "beam-size",	1, NULL, 0 },
+        { "stratify",	2, NULL, 0 },
+        { "paired-threshold",	1, NULL, 0 },
+        { "partners",	0, NULL, 0 },
+        { "partners-min",	1, NULL, 0 },
+        { "bootstrap",	2, NULL, 0 },
+        { "adaptive",	2, NULL, 'a' },
+        { "batch-size",	1, NULL, 0 },
+        { "adaptive-top",	1, NULL, 0 },
+        { "seed",	1, NULL, 0 },
+        { "targets",	1, NULL, 0 },
+        { "num-targets",	1, NULL, 0 },
+        { "target-window",	1, NULL, 0 },
         { 0,  0, 0, 0 }
       };
 
@@ -1187,7 +1476,7 @@ kstruct_cmdline_parser_internal (
       custom_opterr = opterr;
       custom_optopt = optopt;
 
-      c = custom_getopt_long (argc, argv, "hVt:c:o:k:d:w::", long_options, &option_index);
+      c = custom_getopt_long (argc, argv, "hVt:c:o:k:d:w::a::", long_options, &option_index);
 
       optarg = custom_optarg;
       optind = custom_optind;
@@ -1281,6 +1570,18 @@ kstruct_cmdline_parser_internal (
         
           break;
 
+        case 'a':	/* Fold random batches of reads until the top k-mers converge to the given tolerance..  */
+        
+        
+          if (update_arg( (void *)&(args_info->adaptive_arg), 
+               &(args_info->adaptive_orig), &(args_info->adaptive_given),
+              &(local_args_info.adaptive_given), optarg, 0, "0.01", ARG_DOUBLE,
+              check_ambiguity, override, 0, 0,
+              "adaptive", 'a',
+              additional_error))
+            goto failure;
+        
+          break;
         case 0:	/* Long option with no short option */
           if (strcmp (long_options[option_index].name, "detailed-help") == 0) {
             kstruct_cmdline_parser_print_detailed_help ();
@@ -1301,6 +1602,266 @@ kstruct_cmdline_parser_internal (
                 additional_error))
               goto failure;
           
+          }
+          /* Fold each distinct sequence only once..  */
+          else if (strcmp (long_options[option_index].name, "dedup") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->dedup_flag), 0, &(args_info->dedup_given),
+                &(local_args_info.dedup_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "dedup", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Number of reads folded from each file per batch with --adaptive..  */
+          else if (strcmp (long_options[option_index].name, "batch-size") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->batch_size_arg), 
+                 &(args_info->batch_size_orig), &(args_info->batch_size_given),
+                &(local_args_info.batch_size_given), optarg, 0, "5000", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "batch-size", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Number of top k-mers that have to converge with --adaptive..  */
+          else if (strcmp (long_options[option_index].name, "adaptive-top") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->adaptive_top_arg), 
+                 &(args_info->adaptive_top_orig), &(args_info->adaptive_top_given),
+                &(local_args_info.adaptive_top_given), optarg, 0, "10", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "adaptive-top", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Specify the seed used to pick the order of reads with --adaptive..  */
+          else if (strcmp (long_options[option_index].name, "seed") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->seed_arg), 
+                 &(args_info->seed_orig), &(args_info->seed_given),
+                &(local_args_info.seed_given), optarg, 0, "-1", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "seed", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Report how busy each folding thread was..  */
+          else if (strcmp (long_options[option_index].name, "verbose") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->verbose_flag), 0, &(args_info->verbose_given),
+                &(local_args_info.verbose_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "verbose", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Select the structure model used to get the base-pair probability of each nucleotide..  */
+          else if (strcmp (long_options[option_index].name, "structure-model") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->structure_model_arg), 
+                 &(args_info->structure_model_orig), &(args_info->structure_model_given),
+                &(local_args_info.structure_model_given), optarg, kstruct_cmdline_parser_structure_model_values, "pf", ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "structure-model", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Largest distance between two paired nucleotides with --structure-model=span..  */
+          else if (strcmp (long_options[option_index].name, "max-bp-span") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->max_bp_span_arg), 
+                 &(args_info->max_bp_span_orig), &(args_info->max_bp_span_given),
+                &(local_args_info.max_bp_span_given), optarg, 0, "100", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "max-bp-span", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Number of structures sampled per sequence with --structure-model=sample..  */
+          else if (strcmp (long_options[option_index].name, "samples") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->samples_arg), 
+                 &(args_info->samples_orig), &(args_info->samples_given),
+                &(local_args_info.samples_given), optarg, 0, "100", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "samples", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Store the base-pair probabilities of every read, and reuse them in later runs..  */
+          else if (strcmp (long_options[option_index].name, "fold-cache") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->fold_cache_arg), 
+                 &(args_info->fold_cache_orig), &(args_info->fold_cache_given),
+                &(local_args_info.fold_cache_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "fold-cache", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Number of bits used to store each probability with --fold-cache (8 or 16)..  */
+          else if (strcmp (long_options[option_index].name, "cache-bits") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->cache_bits_arg), 
+                 &(args_info->cache_bits_orig), &(args_info->cache_bits_given),
+                &(local_args_info.cache_bits_given), optarg, 0, "16", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "cache-bits", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Only fold the reads containing one of the k-mers listed in the file..  */
+          else if (strcmp (long_options[option_index].name, "targets") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->targets_arg), 
+                 &(args_info->targets_orig), &(args_info->targets_given),
+                &(local_args_info.targets_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "targets", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Only use the first N k-mers of the --targets file, or all of them if 0..  */
+          else if (strcmp (long_options[option_index].name, "num-targets") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->num_targets_arg), 
+                 &(args_info->num_targets_orig), &(args_info->num_targets_given),
+                &(local_args_info.num_targets_given), optarg, 0, "0", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "num-targets", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Fold a window of this many nucleotides around each target occurrence instead of the whole read..  */
+          else if (strcmp (long_options[option_index].name, "target-window") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->target_window_arg), 
+                 &(args_info->target_window_orig), &(args_info->target_window_given),
+                &(local_args_info.target_window_given), optarg, 0, "0", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "target-window", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Also count the k-mers by their structural context, and report their enrichments in paired and unpaired contexts..  */
+          else if (strcmp (long_options[option_index].name, "stratify") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->stratify_arg), 
+                 &(args_info->stratify_orig), &(args_info->stratify_given),
+                &(local_args_info.stratify_given), optarg, kstruct_cmdline_parser_stratify_values, "threshold", ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "stratify", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Smallest mean base-pair probability of a k-mer counted as paired with --stratify=threshold..  */
+          else if (strcmp (long_options[option_index].name, "paired-threshold") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->paired_threshold_arg), 
+                 &(args_info->paired_threshold_orig), &(args_info->paired_threshold_given),
+                &(local_args_info.paired_threshold_given), optarg, 0, "0.5", ARG_DOUBLE,
+                check_ambiguity, override, 0, 0,
+                "paired-threshold", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Also report which k-mers pair with each other in the test reads..  */
+          else if (strcmp (long_options[option_index].name, "partners") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->partners_flag), 0, &(args_info->partners_given),
+                &(local_args_info.partners_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "partners", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Smallest total base-pair probability of the pairs of k-mers written with --partners..  */
+          else if (strcmp (long_options[option_index].name, "partners-min") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->partners_min_arg), 
+                 &(args_info->partners_min_orig), &(args_info->partners_min_given),
+                &(local_args_info.partners_min_given), optarg, 0, "1", ARG_DOUBLE,
+                check_ambiguity, override, 0, 0,
+                "partners-min", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Number of states kept per nucleotide with --structure-model=linear, or 0 to keep all of them..  */
+          else if (strcmp (long_options[option_index].name, "beam-size") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->beam_size_arg), 
+                 &(args_info->beam_size_orig), &(args_info->beam_size_given),
+                &(local_args_info.beam_size_given), optarg, 0, "100", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "beam-size", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Also report the standard error and p-value of every enrichment, from the given number of bootstrap replicates..  */
+          else if (strcmp (long_options[option_index].name, "bootstrap") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->bootstrap_arg), 
+                 &(args_info->bootstrap_orig), &(args_info->bootstrap_given),
+                &(local_args_info.bootstrap_given), optarg, 0, "20", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "bootstrap", '-',
+                additional_error))
+              goto failure;
+          
           }
           
           break;
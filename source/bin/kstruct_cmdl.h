@@ -55,12 +55,69 @@ struct kstruct_args_info
   int threads_arg;	/**< @brief Set the number of threads to use in ikke. This allows to process calculations in parallel using multiple threads. (default='1').  */
   char * threads_orig;	/**< @brief Set the number of threads to use in ikke. This allows to process calculations in parallel using multiple threads. original value given at command line.  */
   const char *threads_help; /**< @brief Set the number of threads to use in ikke. This allows to process calculations in parallel using multiple threads. help description.  */
+  int verbose_flag;	/**< @brief Report how busy each folding thread was. (default=off).  */
+  const char *verbose_help; /**< @brief Report how busy each folding thread was. help description.  */
   char * delimiter_arg;	/**< @brief Set the delimiter used to separate the values in the output file. (default=',').  */
   char * delimiter_orig;	/**< @brief Set the delimiter used to separate the values in the output file. original value given at command line.  */
   const char *delimiter_help; /**< @brief Set the delimiter used to separate the values in the output file. help description.  */
+  char * fold_cache_arg;	/**< @brief Store the base-pair probabilities of every read, and reuse them in later runs..  */
+  char * fold_cache_orig;	/**< @brief Store the base-pair probabilities of every read, and reuse them in later runs. original value given at command line.  */
+  const char *fold_cache_help; /**< @brief Store the base-pair probabilities of every read, and reuse them in later runs. help description.  */
+  int cache_bits_arg;	/**< @brief Number of bits used to store each probability with --fold-cache (8 or 16). (default='16').  */
+  char * cache_bits_orig;	/**< @brief Number of bits used to store each probability with --fold-cache (8 or 16). original value given at command line.  */
+  const char *cache_bits_help; /**< @brief Number of bits used to store each probability with --fold-cache (8 or 16). help description.  */
   int seq_windows_arg;	/**< @brief Split the sequence into sliding windows of the specified size and find the mean probability per position in the window. (default='20').  */
   char * seq_windows_orig;	/**< @brief Split the sequence into sliding windows of the specified size and find the mean probability per position in the window. original value given at command line.  */
   const char *seq_windows_help; /**< @brief Split the sequence into sliding windows of the specified size and find the mean probability per position in the window. help description.  */
+  int dedup_flag;	/**< @brief Fold each distinct sequence only once. (default=off).  */
+  const char *dedup_help; /**< @brief Fold each distinct sequence only once. help description.  */
+  char * structure_model_arg;	/**< @brief Select the structure model used to get the base-pair probability of each nucleotide. (default='pf').  */
+  char * structure_model_orig;	/**< @brief Select the structure model used to get the base-pair probability of each nucleotide. original value given at command line.  */
+  const char *structure_model_help; /**< @brief Select the structure model used to get the base-pair probability of each nucleotide. help description.  */
+  int max_bp_span_arg;	/**< @brief Largest distance between two paired nucleotides with --structure-model=span. (default='100').  */
+  char * max_bp_span_orig;	/**< @brief Largest distance between two paired nucleotides with --structure-model=span. original value given at command line.  */
+  const char *max_bp_span_help; /**< @brief Largest distance between two paired nucleotides with --structure-model=span. help description.  */
+  int samples_arg;	/**< @brief Number of structures sampled per sequence with --structure-model=sample. (default='100').  */
+  char * samples_orig;	/**< @brief Number of structures sampled per sequence with --structure-model=sample. original value given at command line.  */
+  const char *samples_help; /**< @brief Number of structures sampled per sequence with --structure-model=sample. help description.  */
+  int beam_size_arg;	/**< @brief Number of states kept per nucleotide with --structure-model=linear, or 0 to keep all of them. (default='100').  */
+  char * beam_size_orig;	/**< @brief Number of states kept per nucleotide with --structure-model=linear, or 0 to keep all of them. original value given at command line.  */
+  const char *beam_size_help; /**< @brief Number of states kept per nucleotide with --structure-model=linear, or 0 to keep all of them. help description.  */
+  char * stratify_arg;	/**< @brief Also count the k-mers by their structural context, and report their enrichments in paired and unpaired contexts. (default='threshold').  */
+  char * stratify_orig;	/**< @brief Also count the k-mers by their structural context, and report their enrichments in paired and unpaired contexts. original value given at command line.  */
+  const char *stratify_help; /**< @brief Also count the k-mers by their structural context, and report their enrichments in paired and unpaired contexts. help description.  */
+  double paired_threshold_arg;	/**< @brief Smallest mean base-pair probability of a k-mer counted as paired with --stratify=threshold. (default='0.5').  */
+  char * paired_threshold_orig;	/**< @brief Smallest mean base-pair probability of a k-mer counted as paired with --stratify=threshold. original value given at command line.  */
+  const char *paired_threshold_help; /**< @brief Smallest mean base-pair probability of a k-mer counted as paired with --stratify=threshold. help description.  */
+  int partners_flag;	/**< @brief Also report which k-mers pair with each other in the test reads. (default=off).  */
+  const char *partners_help; /**< @brief Also report which k-mers pair with each other in the test reads. help description.  */
+  double partners_min_arg;	/**< @brief Smallest total base-pair probability of the pairs of k-mers written with --partners. (default='1').  */
+  char * partners_min_orig;	/**< @brief Smallest total base-pair probability of the pairs of k-mers written with --partners. original value given at command line.  */
+  const char *partners_min_help; /**< @brief Smallest total base-pair probability of the pairs of k-mers written with --partners. help description.  */
+  int bootstrap_arg;	/**< @brief Also report the standard error and p-value of every enrichment, from the given number of bootstrap replicates. (default='20').  */
+  char * bootstrap_orig;	/**< @brief Also report the standard error and p-value of every enrichment, from the given number of bootstrap replicates. original value given at command line.  */
+  const char *bootstrap_help; /**< @brief Also report the standard error and p-value of every enrichment, from the given number of bootstrap replicates. help description.  */
+  double adaptive_arg;	/**< @brief Fold random batches of reads until the top k-mers converge to the given tolerance. (default='0.01').  */
+  char * adaptive_orig;	/**< @brief Fold random batches of reads until the top k-mers converge to the given tolerance. original value given at command line.  */
+  const char *adaptive_help; /**< @brief Fold random batches of reads until the top k-mers converge to the given tolerance. help description.  */
+  int batch_size_arg;	/**< @brief Number of reads folded from each file per batch with --adaptive. (default='5000').  */
+  char * batch_size_orig;	/**< @brief Number of reads folded from each file per batch with --adaptive. original value given at command line.  */
+  const char *batch_size_help; /**< @brief Number of reads folded from each file per batch with --adaptive. help description.  */
+  int adaptive_top_arg;	/**< @brief Number of top k-mers that have to converge with --adaptive. (default='10').  */
+  char * adaptive_top_orig;	/**< @brief Number of top k-mers that have to converge with --adaptive. original value given at command line.  */
+  const char *adaptive_top_help; /**< @brief Number of top k-mers that have to converge with --adaptive. help description.  */
+  int seed_arg;	/**< @brief Specify the seed used to pick the order of reads with --adaptive, and the bootstrap replicates with --bootstrap (default='-1').  */
+  char * seed_orig;	/**< @brief Specify the seed used to pick the order of reads with --adaptive, and the bootstrap replicates with --bootstrap original value given at command line.  */
+  const char *seed_help; /**< @brief Specify the seed used to pick the order of reads with --adaptive, and the bootstrap replicates with --bootstrap help description.  */
+  char * targets_arg;	/**< @brief Only fold the reads containing one of the k-mers listed in the file..  */
+  char * targets_orig;	/**< @brief Only fold the reads containing one of the k-mers listed in the file. original value given at command line.  */
+  const char *targets_help; /**< @brief Only fold the reads containing one of the k-mers listed in the file. help description.  */
+  int num_targets_arg;	/**< @brief Only use the first N k-mers of the --targets file, or all of them if 0. (default='0').  */
+  char * num_targets_orig;	/**< @brief Only use the first N k-mers of the --targets file, or all of them if 0. original value given at command line.  */
+  const char *num_targets_help; /**< @brief Only use the first N k-mers of the --targets file, or all of them if 0. help description.  */
+  int target_window_arg;	/**< @brief Fold a window of this many nucleotides around each target occurrence instead of the whole read. (default='0').  */
+  char * target_window_orig;	/**< @brief Fold a window of this many nucleotides around each target occurrence instead of the whole read. original value given at command line.  */
+  const char *target_window_help; /**< @brief Fold a window of this many nucleotides around each target occurrence instead of the whole read. help description.  */
   
   unsigned int help_given ;	/**< @brief Whether help was given.  */
   unsigned int detailed_help_given ;	/**< @brief Whether detailed-help was given.  */
@@ -70,8 +127,28 @@ struct kstruct_args_info
   unsigned int output_given ;	/**< @brief Whether output was given.  */
   unsigned int kmer_given ;	/**< @brief Whether kmer was given.  */
   unsigned int threads_given ;	/**< @brief Whether threads was given.  */
+  unsigned int verbose_given ;	/**< @brief Whether verbose was given.  */
   unsigned int delimiter_given ;	/**< @brief Whether delimiter was given.  */
+  unsigned int fold_cache_given ;	/**< @brief Whether fold-cache was given.  */
+  unsigned int cache_bits_given ;	/**< @brief Whether cache-bits was given.  */
   unsigned int seq_windows_given ;	/**< @brief Whether seq-windows was given.  */
+  unsigned int dedup_given ;	/**< @brief Whether dedup was given.  */
+  unsigned int structure_model_given ;	/**< @brief Whether structure-model was given.  */
+  unsigned int max_bp_span_given ;	/**< @brief Whether max-bp-span was given.  */
+  unsigned int samples_given ;	/**< @brief Whether samples was given.  */
+  unsigned int beam_size_given ;	/**< @brief Whether beam-size was given.  */
+  unsigned int stratify_given ;	/**< @brief Whether stratify was given.  */
+  unsigned int paired_threshold_given ;	/**< @brief Whether paired-threshold was given.  */
+  unsigned int partners_given ;	/**< @brief Whether partners was given.  */
+  unsigned int partners_min_given ;	/**< @brief Whether partners-min was given.  */
+  unsigned int bootstrap_given ;	/**< @brief Whether bootstrap was given.  */
+  unsigned int adaptive_given ;	/**< @brief Whether adaptive was given.  */
+  unsigned int batch_size_given ;	/**< @brief Whether batch-size was given.  */
+  unsigned int adaptive_top_given ;	/**< @brief Whether adaptive-top was given.  */
+  unsigned int seed_given ;	/**< @brief Whether seed was given.  */
+  unsigned int targets_given ;	/**< @brief Whether targets was given.  */
+  unsigned int num_targets_given ;	/**< @brief Whether num-targets was given.  */
+  unsigned int target_window_given ;	/**< @brief Whether target-window was given.  */
 
   char **inputs ; /**< @brief unnamed options (options without names) */
   unsigned inputs_num ; /**< @brief unnamed options number */
@@ -205,6 +282,10 @@ int kstruct_cmdline_parser_required (struct kstruct_args_info *args_info,
   const char *prog_name);
 
 
+extern const char *kstruct_cmdline_parser_structure_model_values[];  /**< @brief Possible values for structure-model. */
+
+extern const char *kstruct_cmdline_parser_stratify_values[];  /**< @brief Possible values for stratify. */
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
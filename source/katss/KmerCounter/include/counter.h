@@ -1,6 +1,7 @@
 #ifndef KATSS_COUNTER_H
 #define KATSS_COUNTER_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -8,6 +9,10 @@ extern "C" {
 #endif 
 
 typedef struct KatssCounter KatssCounter;
+typedef struct KatssReadSet KatssReadSet;
+
+/* Counters of expected counts hold them in units of 1/KATSS_EXPECTED_SCALE */
+#define KATSS_EXPECTED_SCALE 1024
 
 typedef enum KATSS_TYPE {
 	KATSS_INT8,
@@ -33,6 +38,17 @@ KatssCounter *
 katss_init_counter(unsigned int kmer);
 
 
+/**
+ * @brief Get the number of bytes a counter of k-mers of the given length takes up, to check
+ * that the counters of a computation fit in memory before they are initialized.
+ * 
+ * @param kmer The size of k-mer value to count.
+ * @return size_t Size of the counter in bytes, or 0 if the k-mer size is not supported.
+ */
+size_t
+katss_counter_size(unsigned int kmer);
+
+
 /**
  * @brief Increments the count of the hashed k-mer by one. Use the hash provided by `KmerHasher`
  * struct in `hash_function.h`
@@ -55,6 +71,18 @@ katss_increment(KatssCounter *counter, uint32_t hash);
 void
 katss_increments(KatssCounter *counter, uint32_t *hash_values, size_t num_values);
 
+
+/**
+ * @brief Increments the count of the hashed k-mer by the given amount. Unlike
+ * `katss_increment`, this function is thread-safe.
+ * 
+ * @param counter Pointer to KatssCounter struct
+ * @param hash    Hash value of a k-mer sequence
+ * @param amount  Amount to add to the count
+ */
+void
+katss_increment_by(KatssCounter *counter, uint32_t hash, uint64_t amount);
+
 /**
  * @brief Decrements the count of the hashed k-mer by one. Use the hash provided by `KmerHasher`
  * struct in `hash_function.h`
@@ -118,16 +146,38 @@ katss_free_counter(KatssCounter *counter);
 
 
 /**
- * @brief Predict the kmer frequency
+ * @brief Predict the kmer frequency from a Markov model of order m
+ * 
+ * The model is estimated from the (m+1)-mer counts `words` and the m-mer counts
+ * `context`, with m one less than the length of `words`. The mono- and
+ * di-nucleotide counts make the model of order 1.
  * 
  * @param hash Numerical representation of a kmer (0 = A, 1=C, 2=G, 3=T) to predict
  * @param kmer Length of kmer to predict
- * @param mono Mono-nucleotide counts
- * @param dint Di-nucleotide counts
- * @return double Predicted kmer frequency
+ * @param context m-mer counts, NULL if m is 0
+ * @param words (m+1)-mer counts
+ * @return double Predicted kmer frequency, NAN if the model is longer than the kmer
  */
 double
-katss_predict_kmer_freq(uint32_t hash, int kmer, KatssCounter *mono, KatssCounter *dint);
+katss_predict_kmer_freq(uint32_t hash, int kmer, KatssCounter *context, KatssCounter *words);
+
+
+/**
+ * @brief Predict the frequency of every kmer from a Markov model of order m, as
+ * `katss_predict_kmer_freq()` does for one.
+ * 
+ * The frequencies are built one nucleotide at a time, from the (m+1)-mers up, so
+ * the whole table takes O(4^kmer) steps.
+ * 
+ * @param freqs Array of 4^kmer frequencies to fill, indexed by hash
+ * @param kmer Length of kmers to predict
+ * @param context m-mer counts, NULL if m is 0
+ * @param words (m+1)-mer counts
+ * @return int 0 on success, 1 if the model is longer than the kmers or the
+ * counts don't make one
+ */
+int
+katss_predict_kmer_freqs(double *freqs, int kmer, KatssCounter *context, KatssCounter *words);
 
 
 /**
@@ -135,12 +185,12 @@ katss_predict_kmer_freq(uint32_t hash, int kmer, KatssCounter *mono, KatssCounte
  * 
  * @param hash Numerical representation of a kmer (0 = A, 1=C, 2=G, 3=T) to predict
  * @param kmer Length of kmer to predict
- * @param mono Mono-nucleotide counts
- * @param dint Di-nucleotide counts
+ * @param context m-mer counts, NULL if m is 0
+ * @param words (m+1)-mer counts
  * @return uint64_t Predicted kmer count
  */
 uint64_t
-katss_predict_kmer(uint32_t hash, int kmer, KatssCounter *mono, KatssCounter *dint);
+katss_predict_kmer(uint32_t hash, int kmer, KatssCounter *context, KatssCounter *words);
 
 
 /**
@@ -220,13 +270,58 @@ katss_count_kmers_ushuffle(const char *filename, unsigned int kmer, int klet);
  * @param filename Name of the file to count on
  * @param kmer     Length of the k-mer to count
  * @param klet     Length of k-let to preserve in sequence
+ * @param shuffles Number of shuffles of every sequence to count, all drawn from the
+ * graph of its k-lets built once. The counts (and total) are those of all of them
  * @param sample   Percent to sample (should be between 1-100000, each number
  * representing 0.001%. E.g., 12345 -> 12.345%)
- * @param seed     Seed to use for random sample. NULL to use a random seed
+ * @param seed     Seed to use for random sample. NULL to use a random seed. The
+ * sequences are shuffled with numbers drawn from it instead of `rand()`, so calls
+ * with their own seeds can run at the same time
  * @return KatssCounter* struct containing the sub-sampled shuffled counts
  */
 KatssCounter *
 katss_count_kmers_ushuffle_bootstrap(
+	const char *filename,
+	unsigned int kmer,
+	int klet,
+	int shuffles,
+	int sample,
+	unsigned int *seed);
+
+
+/**
+ * @brief Add up the number of times every k-mer is expected to be in the sequences of a file
+ * once they are shuffled, preserving the klet nucleotide frequency, instead of shuffling them.
+ * 
+ * The expectations are exact for the uniform shuffles katss_count_kmers_ushuffle draws from,
+ * so they are what the average of infinitely many shuffles would count. Every run of
+ * nucleotides between other characters is shuffled on its own. The counter holds the
+ * expected counts in units of 1/KATSS_EXPECTED_SCALE, and so does its total. The time taken
+ * by every read grows with the number of k-mers made from its k-lets, so it suits short k-mers.
+ * 
+ * @param filename Name of the file to count the shuffled k-mers in
+ * @param kmer     Length of the k-mer to count, at most 12
+ * @param klet     Length of k-let to preserve in sequence, at most 8 if shorter than kmer
+ * @return KatssCounter* struct containing the expected shuffled counts
+ */
+KatssCounter *
+katss_count_kmers_ushuffle_expected(const char *filename, unsigned int kmer, int klet);
+
+
+/**
+ * @brief Add up the expected shuffled counts of a sub-sampled file, like
+ * katss_count_kmers_ushuffle_expected.
+ * 
+ * @param filename Name of the file to count on
+ * @param kmer     Length of the k-mer to count
+ * @param klet     Length of k-let to preserve in sequence
+ * @param sample   Percent to sample (should be between 1-100000, each number
+ * representing 0.001%. E.g., 12345 -> 12.345%)
+ * @param seed     Seed to use for random sample. NULL to use a random seed
+ * @return KatssCounter* struct containing the sub-sampled expected shuffled counts
+ */
+KatssCounter *
+katss_count_kmers_ushuffle_expected_bootstrap(
 	const char *filename,
 	unsigned int kmer,
 	int klet,
@@ -265,6 +360,16 @@ int katss_recount_kmer_mt(
 	int threads);
 
 
+/**
+ * @brief Add a k-mer to the ones the recounts of a KatssCounter exclude, without recounting it.
+ * Several k-mers can then be removed in a single recount, given remove=NULL.
+ * 
+ * @param counter   KatssCounter to remove the k-mer from
+ * @param remove    K-mer to not include in the next counts
+ */
+void katss_remove_kmer(KatssCounter *counter, const char *remove);
+
+
 /**
  * @brief Recount all shuffled k-mers in a KatssCounter
  * 
@@ -307,6 +412,380 @@ int katss_uncount_kmer(KatssCounter *counter, const char *filename, const char *
  */
 int katss_uncount_kmer_mt(KatssCounter *counter, const char *filename, const char *kmer, int threads);
 
+/**
+ * @brief Read the sequences of a file into a set of distinct reads, each stored once (2-bit
+ * packed) along with the number of times it appears in the file.
+ * 
+ * The katss_*_reads functions then count, recount, sub-sample and shuffle every distinct read
+ * once, weighted by its multiplicity, which gives the same counts as the katss_*_kmers
+ * functions on the file while skipping the repeated work of duplicated reads.
+ * 
+ * @param filename   Name of the file containing the reads
+ * @param max_memory Most bytes the distinct reads can take up
+ * @param threads    Number of threads to use
+ * @return KatssReadSet* Set of distinct reads, or NULL if the file could not be read or its
+ * distinct reads did not fit in max_memory
+ */
+KatssReadSet *katss_dedup_reads(const char *filename, size_t max_memory, int threads);
+
+
+/**
+ * @brief Like katss_dedup_reads, but first collapses PCR duplicates: of the reads that share
+ * a UMI and their first start nucleotides, only the first one in the file is kept.
+ * 
+ * The pattern tells where the UMI of a read is:
+ *  - "header" or "header:SEP": after the last SEP ('_' by default) in the first word of the
+ *    header, as in "@read1_ACGTACGT".
+ *  - "prefix:N": the first N nucleotides of the read, which are then left out of the read.
+ * 
+ * Reads without a UMI are kept. Half of max_memory goes to the (UMI, start) keys; as the
+ * duplicates can't be left out when reading the file, NULL is returned if the reads don't fit.
+ * 
+ * @param filename   Name of the file containing the reads
+ * @param pattern    Where to find the UMIs, see above
+ * @param start      Number of nucleotides after the UMI that also have to match
+ * @param max_memory Most bytes the reads and keys can take up
+ * @param threads    Number of threads to use
+ * @return KatssReadSet* Set of distinct reads, or NULL on error
+ */
+KatssReadSet *katss_collapse_umi_reads(const char *filename, const char *pattern, int start,
+                                       size_t max_memory, int threads);
+
+
+/**
+ * @brief How katss_preprocess_reads trims, filters and collapses the reads of a file.
+ */
+typedef struct KatssReadFilter {
+	const char *adapter;    /** 3' adapter to trim, in the letters of the reads. NULL to not trim */
+	double adapter_error;   /** Mismatches allowed per nucleotide of the adapter matched */
+	int adapter_overlap;    /** Fewest nucleotides of the adapter matched at the 3' end of a read */
+	int quality_cutoff;     /** Trim the 3' end of reads down to this quality, 0 to not trim */
+	int mask_quality;       /** Mask nucleotides of lower quality with 'N', 0 to not mask */
+	int min_length;         /** Leave out reads shorter than this after trimming */
+	const char *umi;        /** Where to find UMIs, see katss_collapse_umi_reads, or NULL */
+	int umi_start;          /** Nucleotides after the UMI that duplicates share */
+} KatssReadFilter;
+
+
+/**
+ * @brief Set a filter that keeps reads as they are: an adapter error of 0.1, an overlap of 3
+ * nucleotides and a UMI start of 16, with every step turned off.
+ */
+void katss_init_read_filter(KatssReadFilter *filter);
+
+
+/**
+ * @brief Like katss_dedup_reads, but preprocesses every read as it is read, before it goes
+ * into the set: the UMI prefix is taken off, the low quality 3' end is trimmed (as in BWA),
+ * then the 3' adapter (with mismatches, no indels, as in cutadapt), low quality nucleotides are
+ * masked and short reads left out. Remaining reads are collapsed by UMI and start as in
+ * katss_collapse_umi_reads. Quality scores are phred+33; the quality steps skip reads without
+ * them (such as those of fasta files).
+ * 
+ * NULL is returned if the reads don't fit. Without UMIs, the file can then be counted with
+ * katss_count_kmers_trimmed_mt instead, which trims the reads as they are read; with them, the
+ * duplicates can only be collapsed in memory.
+ * 
+ * @param filename   Name of the file containing the reads
+ * @param filter     How to preprocess the reads
+ * @param max_memory Most bytes the reads (and UMI keys) can take up
+ * @param threads    Number of threads to use
+ * @return KatssReadSet* Set of distinct preprocessed reads, or NULL on error
+ */
+KatssReadSet *katss_preprocess_reads(const char *filename, const KatssReadFilter *filter,
+                                     size_t max_memory, int threads);
+
+
+/**
+ * @brief Count all forward-strand k-mers of a file, trimming every read as it is read like
+ * katss_preprocess_reads does, for files whose trimmed reads do not fit in memory. The filter's
+ * UMI is not used, since duplicates can only be collapsed in memory.
+ * 
+ * @param filename Name of the file containing the reads
+ * @param filter   How to trim the reads
+ * @param kmer     Length of k-mer to count
+ * @param threads  Number of threads to use
+ * @return KatssCounter* Counts of the trimmed reads, or NULL on error
+ */
+KatssCounter *katss_count_kmers_trimmed_mt(const char *filename, const KatssReadFilter *filter,
+                                           unsigned int kmer, int threads);
+
+
+/**
+ * @brief Like katss_recount_kmer_mt, trimming the reads of the file as in
+ * katss_count_kmers_trimmed_mt.
+ */
+int katss_recount_kmer_trimmed_mt(KatssCounter *counter, const char *filename,
+                                  const KatssReadFilter *filter, const char *remove, int threads);
+
+
+/**
+ * @brief Like katss_count_kmers_ushuffle, shuffling the reads of the file once trimmed as in
+ * katss_count_kmers_trimmed_mt.
+ */
+KatssCounter *katss_count_kmers_ushuffle_trimmed(const char *filename,
+                                                 const KatssReadFilter *filter, unsigned int kmer,
+                                                 int klet);
+
+
+/**
+ * @brief Like katss_recount_kmer_shuffle, shuffling the reads of the file once trimmed as in
+ * katss_count_kmers_trimmed_mt.
+ */
+int katss_recount_kmer_shuffle_trimmed(KatssCounter *counter, const char *file,
+                                       const KatssReadFilter *filter, int klet,
+                                       const char *remove);
+
+
+/**
+ * @brief Number of reads in the file the set was read from.
+ */
+uint64_t katss_reads_total(const KatssReadSet *reads);
+
+
+/**
+ * @brief Number of reads left out as UMI duplicates by katss_collapse_umi_reads.
+ */
+uint64_t katss_reads_collapsed(const KatssReadSet *reads);
+
+
+/**
+ * @brief Number of reads katss_collapse_umi_reads kept since no UMI was found in them.
+ */
+uint64_t katss_reads_missing_umi(const KatssReadSet *reads);
+
+
+/**
+ * @brief Number of reads katss_preprocess_reads found the adapter in.
+ */
+uint64_t katss_reads_adapter_trimmed(const KatssReadSet *reads);
+
+
+/**
+ * @brief Number of reads katss_preprocess_reads left out for being too short after trimming.
+ */
+uint64_t katss_reads_too_short(const KatssReadSet *reads);
+
+
+/**
+ * @brief Number of bytes taken up by the distinct reads, as a measure of the work it takes to
+ * count them.
+ */
+size_t katss_reads_size(const KatssReadSet *reads);
+
+
+/**
+ * @brief Free a set of distinct reads.
+ */
+void katss_free_reads(KatssReadSet *reads);
+
+
+/**
+ * @brief Count all forward-strand k-mers of a set of distinct reads, weighted by the number of
+ * times each read was seen.
+ * 
+ * @param reads    Distinct reads, from katss_dedup_reads
+ * @param kmer     Size of k-mers to count
+ * @param threads  Number of threads to use
+ * @return KatssCounter* struct containing the counts
+ */
+KatssCounter *katss_count_reads_mt(const KatssReadSet *reads, unsigned int kmer, int threads);
+
+
+/**
+ * @brief Count the k-mers of a sub-sample of a set of distinct reads. Every copy of a read is
+ * sampled on its own, as in katss_count_kmers_bootstrap_mt, with draws that only depend on the
+ * seed and the read, so the same seed keeps the same copies for any number of threads.
+ * 
+ * @param reads    Distinct reads, from katss_dedup_reads
+ * @param kmer     Length of the k-mer to count
+ * @param sample   Percent to sample (should be between 1-100000, each number
+ * representing 0.001%. E.g., 12345 -> 12.345%)
+ * @param seed     Seed to use for random sample, NULL to use a random seed
+ * @param threads  Number of threads to use
+ * @return KatssCounter* struct containing the sub-sampled counts
+ */
+KatssCounter *
+katss_count_reads_bootstrap_mt(
+	const KatssReadSet *reads,
+	unsigned int kmer,
+	int sample,
+	unsigned int *seed,
+	int threads);
+
+
+/**
+ * @brief Shuffle every copy of the distinct reads, preserving the klet nucleotide frequency,
+ * and count the shuffled k-mers.
+ * 
+ * @param reads    Distinct reads, from katss_dedup_reads
+ * @param kmer     Length of the k-mer to count
+ * @param klet     Length of k-let to preserve in sequence
+ * @return KatssCounter* struct containing the shuffled counts
+ */
+KatssCounter *
+katss_count_reads_ushuffle(const KatssReadSet *reads, unsigned int kmer, int klet);
+
+
+/**
+ * @brief Count the shuffled reads of a sub-sample of a set of distinct reads.
+ * 
+ * @param reads    Distinct reads, from katss_dedup_reads
+ * @param kmer     Length of the k-mer to count
+ * @param klet     Length of k-let to preserve in sequence
+ * @param shuffles Number of shuffles of every sequence to count, all drawn from the
+ * graph of its k-lets built once. The counts (and total) are those of all of them
+ * @param sample   Percent to sample (should be between 1-100000, each number
+ * representing 0.001%. E.g., 12345 -> 12.345%)
+ * @param seed     Seed to use for random sample. NULL to use a random seed. The
+ * sequences are shuffled with numbers drawn from it instead of `rand()`, so calls
+ * with their own seeds can run at the same time
+ * @return KatssCounter* struct containing the sub-sampled shuffled counts
+ */
+KatssCounter *
+katss_count_reads_ushuffle_bootstrap(
+	const KatssReadSet *reads,
+	unsigned int kmer,
+	int klet,
+	int shuffles,
+	int sample,
+	unsigned int *seed);
+
+
+/**
+ * @brief Add up the expected shuffled counts of every copy of the distinct reads, like
+ * katss_count_kmers_ushuffle_expected.
+ * 
+ * @param reads    Distinct reads, from katss_dedup_reads
+ * @param kmer     Length of the k-mer to count
+ * @param klet     Length of k-let to preserve in sequence
+ * @return KatssCounter* struct containing the expected shuffled counts
+ */
+KatssCounter *
+katss_count_reads_ushuffle_expected(const KatssReadSet *reads, unsigned int kmer, int klet);
+
+
+/**
+ * @brief Add up the expected shuffled counts of a sub-sample of a set of distinct reads.
+ * 
+ * @param reads    Distinct reads, from katss_dedup_reads
+ * @param kmer     Length of the k-mer to count
+ * @param klet     Length of k-let to preserve in sequence
+ * @param sample   Percent to sample (should be between 1-100000, each number
+ * representing 0.001%. E.g., 12345 -> 12.345%)
+ * @param seed     Seed to use for random sample. NULL to use a random seed
+ * @return KatssCounter* struct containing the sub-sampled expected shuffled counts
+ */
+KatssCounter *
+katss_count_reads_ushuffle_expected_bootstrap(
+	const KatssReadSet *reads,
+	unsigned int kmer,
+	int klet,
+	int sample,
+	unsigned int *seed);
+
+
+/**
+ * @brief Recount all k-mers of a set of distinct reads, excluding the k-mer remove and the
+ * k-mers removed before, like katss_recount_kmer_mt.
+ * 
+ * @param counter   KatssCounter to recount k-mers
+ * @param reads     Distinct reads, from katss_dedup_reads
+ * @param remove    K-mer to not include in counts
+ * @param threads   Number of threads to use
+ * @return int 0 if succeded, otherwise if error was encountered
+ */
+int katss_recount_reads_mt(
+	KatssCounter *counter,
+	const KatssReadSet *reads,
+	const char *remove,
+	int threads);
+
+
+/**
+ * @brief Recount all shuffled k-mers of a set of distinct reads, excluding the k-mer remove and
+ * the k-mers removed before, like katss_recount_kmer_shuffle.
+ * 
+ * @param counter KatssCounter to recount shuffled k-mers
+ * @param reads   Distinct reads, from katss_dedup_reads
+ * @param klet    Length of k-let to preserve in sequence
+ * @param remove  K-mer to not include in the counts
+ * @return int 0 if succeded, otherwise if error was encountered
+ */
+int
+katss_recount_reads_shuffle(KatssCounter *counter, const KatssReadSet *reads, int klet,
+                            const char *remove);
+
+
+/**
+ * @brief Recount the k-mers of many bootstrap replicates of a set of distinct reads at once,
+ * each excluding the k-mers removed from it, for a bootstrap of IKKE.
+ * 
+ * Replicate 0 counts every read; every other replicate r counts each copy of a read with a
+ * chance of sample in 100000, drawn from seed, r and the read alone, so it counts the same
+ * copies every time, whatever the number of threads. For the shuffles of katss_shuffle_reads,
+ * the draws are those of the read they were drawn from, so with the same seed a replicate
+ * counts the shuffles of the very copies it counts in the reads. Each read is unpacked once
+ * for all the replicates, which are spread over the threads. All the counters of a replicate,
+ * which may count k-mers of different lengths, are cleared and have remove[r] added to their
+ * removed k-mers, and the reads are crossed out with the removed k-mers of its first counter.
+ * 
+ * @param counters      per_replicate counters of every replicate, one after the other
+ * @param per_replicate Number of counters of a replicate
+ * @param replicates    Number of replicates, including the full replicate 0
+ * @param remove        K-mer to remove from every replicate, or NULL to remove none
+ * @param reads         Distinct reads, from katss_dedup_reads, or their shuffles
+ * @param sample        Copies sampled per 100000 by replicates past 0, between 1-100000
+ * @param seed          Seed of the bootstrap
+ * @param threads       Number of threads to use
+ * @return int 0 if succeded, otherwise if error was encountered
+ */
+int
+katss_recount_reads_bootstrap_mt(KatssCounter **counters, int per_replicate, int replicates,
+                                 const char **remove, const KatssReadSet *reads, int sample,
+                                 unsigned int seed, int threads);
+
+/**
+ * @brief Shuffle every read of a file once, preserving its k-let counts, into a set of reads.
+ * 
+ * The shuffles are kept 2-bit packed like the reads of katss_dedup_reads, so the shuffled
+ * background of every IKKE iteration can be recounted from them with katss_recount_reads_mt,
+ * crossing the removed k-mers out of the shuffled reads, instead of shuffling the file again.
+ * The reads are shuffled in the order of the file with numbers drawn from seed, so the same
+ * seed gives the same shuffles. Without a seed, the reads get the same shuffles as in
+ * katss_count_kmers_ushuffle.
+ * 
+ * @param filename   Name of the file containing the reads
+ * @param klet       Length of k-let to preserve in the reads
+ * @param seed       Seed of the shuffles, or NULL to shuffle with `rand()` from `srand(1)`
+ * @param max_memory Most bytes the shuffled reads can take up
+ * @return KatssReadSet* Set of shuffled reads, or NULL if the file could not be read or the
+ * shuffled reads did not fit in max_memory
+ */
+KatssReadSet *katss_shuffle_file(const char *filename, int klet, const unsigned int *seed,
+                                 size_t max_memory);
+
+
+/**
+ * @brief Shuffle every copy of a set of distinct reads once into a set of reads, like
+ * katss_shuffle_file. The reads are shuffled in the same order whatever the number of threads
+ * that deduplicated them, and without a seed they get the same shuffles as in
+ * katss_count_reads_ushuffle.
+ * 
+ * The shuffles of every copy of a read are kept together, under the hash of the read, so a
+ * sub-sample of them drawn with katss_recount_reads_bootstrap_mt holds the shuffles of the
+ * same sub-sample of the reads. Identical shuffles are not merged, and the set can only be
+ * counted, not shuffled again.
+ * 
+ * @param reads      Distinct reads, from katss_dedup_reads
+ * @param klet       Length of k-let to preserve in the reads
+ * @param seed       Seed of the shuffles, or NULL to shuffle with `rand()` from `srand(1)`
+ * @param max_memory Most bytes the shuffled reads can take up
+ * @return KatssReadSet* Set of shuffled reads, or NULL if they did not fit in max_memory
+ */
+KatssReadSet *katss_shuffle_reads(const KatssReadSet *reads, int klet, const unsigned int *seed,
+                                  size_t max_memory);
+
 #ifdef __cplusplus
 }
 #endif
@@ -22,21 +22,44 @@ typedef struct KatssEnrichments {
 /* Enrichments functions */
 KatssEnrichments *katss_compute_enrichments(KatssCounter *test, KatssCounter *control, bool normalize);
 KatssEnrichments *katss_enrichments(const char *test_file, const char *control_file, unsigned int kmer, bool normalize);
-KatssEnrichments *katss_compute_prob_enrichments(KatssCounter *test, KatssCounter *mono, 
-                                                 KatssCounter *dint, bool normalize);
+KatssEnrichments *katss_compute_prob_enrichments(KatssCounter *test, KatssCounter *context, 
+                                                 KatssCounter *words, bool normalize);
 KatssEnrichments *katss_prob_enrichments(const char *test_file, unsigned int kmer, bool normalize);
 
 /* IKKE Functions */
 KatssEnrichments *katss_ikke_mt(const char *test_file, const char *control_file, unsigned int kmer, 
-                                uint64_t iterations, bool normalize, int threads);
+                                uint64_t iterations, bool normalize, int batch, double gap, int threads);
 KatssEnrichments *katss_ikke_(const char *test_file, const char *control_file, unsigned int kmer, uint64_t iterations, bool normalize);
-KatssEnrichments *katss_prob_ikke_mt(const char *test_file, unsigned int kmer, uint64_t iterations, bool normalize, int threads);
+KatssEnrichments *katss_prob_ikke_mt(const char *test_file, unsigned int kmer, int order, uint64_t iterations,
+                                     bool normalize, int batch, double gap, int threads);
 KatssEnrichments *katss_prob_ikke(const char *test_file, unsigned int kmer, uint64_t iterations, bool normalize);
 KatssEnrichments *katss_ikke_shuffle(const char *test, int kmer, int klet, uint64_t iterations, bool normalize);
 KatssEnrichments *katss_ikke_shuffle_mt(const char *test, const char *ctrl, int kmer, int klet, uint64_t iterations, bool normalize, int threads);
 
+/* IKKE Functions on files whose reads are trimmed as they are read, see katss_count_kmers_trimmed_mt */
+KatssEnrichments *katss_ikke_trimmed_mt(const char *test_file, const char *control_file,
+                                        const KatssReadFilter *filter, unsigned int kmer,
+                                        uint64_t iterations, bool normalize, int batch, double gap,
+                                        int threads);
+KatssEnrichments *katss_prob_ikke_trimmed_mt(const char *test_file, const KatssReadFilter *filter,
+                                             unsigned int kmer, int order, uint64_t iterations,
+                                             bool normalize, int batch, double gap, int threads);
+KatssEnrichments *katss_ikke_shuffle_trimmed(const char *test, const KatssReadFilter *filter, int kmer,
+                                             int klet, uint64_t iterations, bool normalize);
+
+/* IKKE Functions on distinct reads, from katss_dedup_reads, or shuffled reads, from katss_shuffle_file */
+KatssEnrichments *katss_ikke_reads_mt(const KatssReadSet *test, const KatssReadSet *control, unsigned int kmer,
+                                      uint64_t iterations, bool normalize, int batch, double gap, int threads);
+KatssEnrichments *katss_prob_ikke_reads_mt(const KatssReadSet *test, unsigned int kmer, int order,
+                                           uint64_t iterations, bool normalize, int batch, double gap,
+                                           int threads);
+KatssEnrichments *katss_ikke_shuffle_reads(const KatssReadSet *test, int kmer, int klet, uint64_t iterations, bool normalize);
+KatssEnrichments *katss_ikke_shuffled_mt(const char *test_file, const KatssReadSet *shuffled, unsigned int kmer,
+                                         uint64_t iterations, bool normalize, int batch, double gap,
+                                         int threads);
+
 KatssEnrichment katss_top_enrichment(KatssCounter *test, KatssCounter *control, bool normalize);
-KatssEnrichment katss_top_prediction(KatssCounter *test, KatssCounter *mono, KatssCounter *dint, bool normalize);
+KatssEnrichment katss_top_prediction(KatssCounter *test, KatssCounter *context, KatssCounter *words, bool normalize);
 void katss_free_enrichments(KatssEnrichments *enrichments);
 void katss_sort_enrichments(KatssEnrichments *enrichments);
 
@@ -39,6 +39,19 @@ KatssHasher *katss_init_hasher(unsigned int kmer, char filetype);
 void katss_set_seq(KatssHasher *hasher, char *sequence, char filetype);
 
 
+/**
+ * @brief Replace the previous sequence in the k-mer hasher struct with a read of its own. Unlike
+ * katss_set_seq, the previous sequence is not used as context, so no k-mer spans the end of the
+ * previous read and the start of this one.
+ * 
+ * @param hasher   Pointer to the KmerHasher struct you want to 'feed'
+ * @param sequence Read to replace the current sequence in the provided KmerHasher
+ * @param filetype The type of file the read was obtained from. `a` for fasta files. `q`
+ * for fastq files. `r` for raw sequences.
+ */
+void katss_set_read(KatssHasher *hasher, char *sequence, char filetype);
+
+
 /**
  * @brief Get the next 32-bit forward-strand hash value contained in the sequence. If the hasher
  * has hashed all k-mers in the sequence, then it will return false. Works with fastq, fasta, and
@@ -19,6 +19,7 @@ struct KatssDataEntry {
 	};
 	double pval;
 	float stdev;
+	float stability;  /** Fraction of the bootstrap replicates of IKKE whose top k-mer it was */
 };
 typedef struct KatssDataEntry KatssDataEntry;
 
@@ -28,6 +29,7 @@ typedef struct KatssDataEntry KatssDataEntry;
 struct KatssData {	
 	KatssDataEntry *kmers;
 	uint64_t num_kmers;
+	int bootstrap_iters;   /** Number of bootstrap replicates used, 0 if not bootstrapped */
 };
 typedef struct KatssData KatssData;
 
@@ -47,6 +49,11 @@ typedef enum {
 struct KatssOptions {
 	int kmer;              /** Set length of k-mers */
 	int iters;             /** Set the number of iterations for ikke */
+	int batch;             /** Most k-mers an iteration of ikke removes at once. 1 to
+	                           remove one k-mer per iteration */
+	double batch_gap;      /** Factor (minus 1) by which every k-mer of a batch after the
+	                           first must be more enriched than the k-mers overlapping
+	                           the ones picked before it */
 	int threads;           /** Set the number of threads to use */
 	int normalize;         /** Get the log2 of the enrichments */
 	bool sort_enrichments; /** Sort the enrichment based on rval. This will
@@ -59,12 +66,46 @@ struct KatssOptions {
 	int bootstrap_sample;  /** Percent to sample. Should be a number between 
 	                           1-100000. Every number represents 0.001%, e.g.,
 	                           250000 -> 25.000%, 12345 -> 12.345% */
+	double bootstrap_tolerance; /** Stop before bootstrap_iters once the relative change
+	                                in the stdev of the top k-mers stays below this. 0 to
+	                                run every iteration. Ignored by katss_ikke */
+	bool analytic;         /** Compute the stdev and pval of the enrichments from the counts,
+	                           without bootstrapping. Only for enrichments against control
+	                           files or the probabilistic method */
 	
 	/* Probabilistic Options */
 	KatssProbsAlgo probs_algo;   /* Specify which probabilistic method to use */
 	int            probs_ntprec; /* Precision in kmer prediction. Set it as -1 for recommended value */
+	bool           shuffle_expected; /* Add up the exact expected counts of the shuffled sequences
+	                                    instead of shuffling them once. Only for enrichments of
+	                                    k-mers of at most 12 */
+	int            shuffles;     /* Number of shuffles of every sequence in the background, all
+	                                drawn from the same graph of its k-lets. Only for enrichments */
+	int            probs_order;  /* Markov order of the background of the probabilistic method,
+	                                estimated from the (order+1)-mer and order-mer counts. Set it
+	                                as -1 for recommended value (1, or 0 for 1-mers) */
 	int            seed;         /* Seed to use for which random sequences to sample */
 
+	/* Deduplication options */
+	bool dedup;                  /* Count every distinct read once, weighted by the number of
+	                                times it was seen. Counts are the same as without it */
+	int  dedup_memory;           /* Most MiB the distinct reads of a file can take up. Files
+	                                whose distinct reads don't fit are counted as they are.
+	                                Also bounds the reads IKKE shuffles once for KATSS_PROBS_USHUFFLE,
+	                                and the counters of the bootstrap replicates counted at once
+	                                (all replicates for katss_ikke) */
+	const char *umi;             /* Collapse PCR duplicates sharing a UMI and start, with the
+	                                UMI found by "header", "header:SEP" or "prefix:N". NULL
+	                                to not collapse. Implies dedup */
+	int  umi_start;              /* Nucleotides after the UMI that duplicates share */
+
+	/* Read preprocessing options, done while reading the distinct reads. Setting any implies
+	   dedup */
+	const char *adapter;         /* 3' adapter to trim off the reads, NULL to not trim */
+	int  quality_cutoff;         /* Trim the 3' end of reads down to this quality, 0 to not trim */
+	int  mask_quality;           /* Mask nucleotides of lower quality with 'N', 0 to not mask */
+	int  min_length;             /* Leave out reads shorter than this after trimming */
+
 	/* Function information */
 	bool enable_warnings;        /* Display warnings regarding options */
 	bool verbose_output;         /* Display verbose output of calculations */
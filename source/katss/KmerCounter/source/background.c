@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "katss_core.h"
+#include "counter.h"
+#include "memory_utils.h"
+
+/* Frequency of the `context->kmer`-mer `hash`, 1 for a model of order 0 */
+static double
+context_freq(KatssCounter *context, uint32_t hash)
+{
+	if(context == NULL)
+		return 1.0;
+	double count = 0;
+	katss_get_from_hash(context, KATSS_DOUBLE, &count, hash);
+	return count / context->total;
+}
+
+/* Order of the model estimated from `context` and `words`, -1 if they don't make one */
+static int
+background_order(KatssCounter *context, KatssCounter *words)
+{
+	int order = (int)words->kmer - 1;
+	if(order > 0 && (context == NULL || context->kmer != (unsigned int)order))
+		return -1;
+	return order;
+}
+
+double
+katss_predict_kmer_freq(uint32_t hash, int kmer, KatssCounter *context, KatssCounter *words)
+{
+	int order = background_order(context, words);
+	if(order < 0 || order >= kmer)
+		return NAN;
+	uint32_t word_mask = (uint32_t)((1ULL << 2*(order+1)) - 1);
+
+	/* Frequency of the first (m+1)-mer */
+	double count;
+	katss_get_from_hash(words, KATSS_DOUBLE, &count, hash >> 2*(kmer-order-1));
+	double freq = count / words->total;
+
+	/* Times the probability of every following nucleotide given the m before it */
+	for(int i=order+1; i<kmer; i++) {
+		uint32_t word = (hash >> 2*(kmer-1-i)) & word_mask;
+		double ctx_freq = context_freq(context, word >> 2);
+		if(ctx_freq == 0)
+			return 0;
+		katss_get_from_hash(words, KATSS_DOUBLE, &count, word);
+		freq *= (count / words->total) / ctx_freq;
+	}
+	return freq;
+}
+
+int
+katss_predict_kmer_freqs(double *freqs, int kmer, KatssCounter *context, KatssCounter *words)
+{
+	int order = background_order(context, words);
+	if(order < 0 || order >= kmer)
+		return 1;
+	uint64_t num_words = 1ULL << 2*(order+1);
+	uint64_t ctx_mask = (1ULL << 2*order) - 1;
+
+	/* Probability of each nucleotide following the m before it, indexed by the (m+1)-mer.
+	   The (m+1)-mer frequencies start the k-mers off */
+	double *trans = s_malloc(num_words * sizeof *trans);
+	for(uint64_t w=0; w<num_words; w++) {
+		double count = 0;
+		katss_get_from_hash(words, KATSS_DOUBLE, &count, (uint32_t)w);
+		double ctx_freq = context_freq(context, (uint32_t)(w >> 2));
+		freqs[w] = count / words->total;
+		trans[w] = ctx_freq == 0 ? 0 : freqs[w] / ctx_freq;
+	}
+
+	/* Extend every prefix by one nucleotide until it is k long. Going from the last prefix
+	   down, the extensions only overwrite prefixes that were extended already */
+	for(int len=order+1; len<kmer; len++) {
+		for(uint64_t h=1ULL << 2*len; h-- > 0;) {
+			double prefix = freqs[h];
+			const double *next = trans + ((h & ctx_mask) << 2);
+			double *out = freqs + (h << 2);
+			out[0] = prefix * next[0];
+			out[1] = prefix * next[1];
+			out[2] = prefix * next[2];
+			out[3] = prefix * next[3];
+		}
+	}
+
+	free(trans);
+	return 0;
+}
+
+
+uint64_t
+katss_predict_kmer(uint32_t hash, int kmer, KatssCounter *context, KatssCounter *words)
+{
+	double freq_pred = katss_predict_kmer_freq(hash, kmer, context, words);
+
+	uint64_t numseqs = 10000; // pick an arbitrary number of sequences
+	uint64_t total = context ? context->total : words->total;
+	return (uint64_t)(freq_pred * (total - (numseqs * (kmer-1))));
+}
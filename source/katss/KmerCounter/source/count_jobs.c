@@ -0,0 +1,71 @@
+#include <stddef.h>
+
+#include "count_jobs.h"
+
+void
+count_job_init(katss_job *job, count_job *count, katss_job_fn run, const char *filename,
+               unsigned int kmer)
+{
+	count->filename = filename;
+	count->reads = NULL;
+	count->filter = NULL;
+	count->kmer = kmer;
+	count->sample = 0;
+	count->seed = NULL;
+	count->remove = NULL;
+	count->counts = NULL;
+	katss_job_init(job, run, count, katss_file_weight(filename));
+}
+
+
+void
+count_job_init_reads(katss_job *job, count_job *count, katss_job_fn run,
+                     const KatssReadSet *reads, unsigned int kmer)
+{
+	count_job_init(job, count, run, NULL, kmer);
+	count->reads = reads;
+	if(katss_reads_size(reads) > 0)
+		job->weight = (double)katss_reads_size(reads);
+}
+
+
+int
+count_job_count(void *arg, int threads)
+{
+	count_job *count = (count_job *)arg;
+	if(count->reads != NULL)
+		count->counts = katss_count_reads_mt(count->reads, count->kmer, threads);
+	else if(count->filter != NULL)
+		count->counts = katss_count_kmers_trimmed_mt(count->filename, count->filter,
+		                                             count->kmer, threads);
+	else
+		count->counts = katss_count_kmers_mt(count->filename, count->kmer, threads);
+	return count->counts == NULL;
+}
+
+
+int
+count_job_bootstrap(void *arg, int threads)
+{
+	count_job *count = (count_job *)arg;
+	if(count->reads != NULL)
+		count->counts = katss_count_reads_bootstrap_mt(count->reads, count->kmer, count->sample,
+		                                               count->seed, threads);
+	else
+		count->counts = katss_count_kmers_bootstrap_mt(count->filename, count->kmer,
+		                                               count->sample, count->seed, threads);
+	return count->counts == NULL;
+}
+
+
+int
+count_job_recount(void *arg, int threads)
+{
+	count_job *count = (count_job *)arg;
+	if(count->reads != NULL)
+		return katss_recount_reads_mt(count->counts, count->reads, count->remove, threads);
+	if(count->filter != NULL)
+		return katss_recount_kmer_trimmed_mt(count->counts, count->filename, count->filter,
+		                                     count->remove, threads);
+	return katss_recount_kmer_mt(count->counts, count->filename, count->remove, threads);
+}
@@ -0,0 +1,66 @@
+#ifndef KATSS_COUNT_JOBS_H
+#define KATSS_COUNT_JOBS_H
+
+#include "counter.h"
+#include "katss_jobs.h"
+
+/* Arguments of a job that counts (or recounts) the k-mers of one file */
+struct count_job {
+	const char *filename;   /** File to count k-mers in */
+	const KatssReadSet *reads; /** Distinct reads of the file, counted instead if not NULL */
+	const KatssReadFilter *filter; /** Trimming of the reads of the file, NULL to not trim */
+	unsigned int kmer;      /** Length of k-mer to count */
+	int sample;             /** Percent to sample, for bootstrap jobs */
+	unsigned int *seed;     /** Seed of the sample, for bootstrap jobs */
+	const char *remove;     /** K-mer to remove, for recount jobs */
+	KatssCounter *counts;   /** Counts produced by the job, or the counts to recount */
+};
+typedef struct count_job count_job;
+
+
+/**
+ * @brief Set up a job that counts the k-mers of a file, weighted by the size of the file.
+ *
+ * @param job       Job to initialize
+ * @param count     Arguments of the job, zeroed except for filename and kmer
+ * @param run       One of count_job_count, count_job_bootstrap, or count_job_recount
+ * @param filename  File to count k-mers in
+ * @param kmer      Length of k-mer to count
+ */
+void count_job_init(katss_job *job, count_job *count, katss_job_fn run, const char *filename,
+                    unsigned int kmer);
+
+
+/**
+ * @brief Set up a job that counts the k-mers of a set of distinct reads, weighted by the size
+ * of the reads.
+ *
+ * @param job       Job to initialize
+ * @param count     Arguments of the job, zeroed except for reads and kmer
+ * @param run       One of count_job_count, count_job_bootstrap, or count_job_recount
+ * @param reads     Distinct reads to count k-mers in
+ * @param kmer      Length of k-mer to count
+ */
+void count_job_init_reads(katss_job *job, count_job *count, katss_job_fn run,
+                          const KatssReadSet *reads, unsigned int kmer);
+
+
+/**
+ * @brief Count all k-mers of the file into count->counts.
+ */
+int count_job_count(void *count, int threads);
+
+
+/**
+ * @brief Count the k-mers of a sub-sample of the file into count->counts. The reads of the
+ * file are not trimmed, use a set of preprocessed reads instead.
+ */
+int count_job_bootstrap(void *count, int threads);
+
+
+/**
+ * @brief Recount count->counts without the k-mer count->remove.
+ */
+int count_job_recount(void *count, int threads);
+
+#endif // KATSS_COUNT_JOBS_H
@@ -18,16 +18,19 @@
 #include "hash_functions.h"
 #include "memory_utils.h"
 #include "ushuffle.h"
+#include "expected_shuffle.h"
 #include "seqfile.h"
 #include "thread_safe_rand.h"
+#include "trim.h"
 #define BUFFER_SIZE 65536U
 
 struct threadinfo {
 	SeqFile seqfile;
 	KatssCounter *counter;
 	unsigned int kmer;
-	int sample;
-	unsigned int *seed;
+	rand_sampler *sampler;
+	mtx_t *lock;              /* Locks the sampler along with the file */
+	bool *done;
 	char filetype;
 };
 typedef struct threadinfo threadinfo;
@@ -38,6 +41,10 @@ count_file(const char *filename, unsigned int kmer, const char filetype);
 static int
 count_file_mt(void *arg);
 
+static KatssCounter *
+count_ushuffle(const char *filename, const KatssReadFilter *filter, unsigned int kmer, int klet,
+               int shuffles);
+
 /*============= Helper Function Declarations =============*/
 static char
 determine_filetype(const char *filename);
@@ -121,6 +128,23 @@ katss_count_kmers_mt(const char *filename, unsigned int kmer, int threads)
 }
 
 
+KatssCounter *
+katss_count_kmers_trimmed_mt(const char *filename, const KatssReadFilter *filter,
+                             unsigned int kmer, int threads)
+{
+	KatssCounter *counter = katss_init_counter(kmer);
+	if(counter == NULL)
+		return NULL;
+
+	/* Counting is recounting without any k-mer removed */
+	if(katss_recount_kmer_trimmed_mt(counter, filename, filter, NULL, threads) != 0) {
+		katss_free_counter(counter);
+		return NULL;
+	}
+	return counter;
+}
+
+
 KatssCounter *
 katss_count_kmers_bootstrap(const char *filename, unsigned int kmer,
                             int sample, unsigned int *seed)
@@ -159,14 +183,23 @@ katss_count_kmers_bootstrap(const char *filename, unsigned int kmer,
 		seed = &local_seed;
 	}
 
-	while(seqfgets_unlocked(read_file, buffer, BUFFER_SIZE)) {
-		if(rand_r(seed) % 100000 >= sample)
-			continue;
-		katss_set_seq(hasher, buffer, filetype);
+	/* Skip the records left out instead of reading them */
+	rand_sampler sampler;
+	rand_sampler_init(&sampler, sample, seed);
+	for(;;) {
+		uint64_t gap = rand_sampler_gap(&sampler);
+		uint64_t skipped = seqfskip_unlocked(read_file, gap);
+		rand_sampler_take(&sampler, skipped);
+		if(skipped < gap || !seqfgets_unlocked(read_file, buffer, BUFFER_SIZE))
+			break;
+		rand_sampler_take(&sampler, 1);
+
+		katss_set_read(hasher, buffer, filetype);
 		while(katss_get_fh(hasher, &hash_value, filetype)) {
 			katss_increment(counter, hash_value);
 		}
 	}
+	rand_sampler_end(&sampler);
 
 	if(seqferrno) {
 		error_message("katss: sample: %s\n", seqfstrerror_r(seqferrno, buffer, BUFFER_SIZE));
@@ -189,7 +222,6 @@ count_file_bootstrap_mt(void *arg)
 {
 	threadinfo *args = (threadinfo *)arg;
 	char *buffer = s_malloc(BUFFER_SIZE * sizeof *buffer);
-	thread_safe_rand_t *tsr = thread_safe_rand_init();
 
 	KatssHasher *hasher = katss_init_hasher(args->kmer, '\0');
 	if(hasher == NULL)
@@ -200,11 +232,27 @@ count_file_bootstrap_mt(void *arg)
 	uint32_t *hash_values = s_malloc(num_counts * sizeof *hash_values);
 	size_t cur_hash = 0;
 
-	/* Begin counting */
-	while(seqfgets(args->seqfile, buffer, BUFFER_SIZE)) {
-		if(thread_safe_rand_r(tsr, args->seed) % 100000 >= args->sample)
-			continue;
-		katss_set_seq(hasher, buffer, args->filetype);
+	/* Begin counting, the records are sampled in the order they are in the file
+	   whatever thread reads them */
+	for(;;) {
+		mtx_lock(args->lock);
+		if(*args->done) {
+			mtx_unlock(args->lock);
+			break;
+		}
+		uint64_t gap = rand_sampler_gap(args->sampler);
+		uint64_t skipped = seqfskip_unlocked(args->seqfile, gap);
+		rand_sampler_take(args->sampler, skipped);
+		if(skipped < gap || !seqfgets_unlocked(args->seqfile, buffer, BUFFER_SIZE)) {
+			rand_sampler_end(args->sampler);
+			*args->done = true;
+			mtx_unlock(args->lock);
+			break;
+		}
+		rand_sampler_take(args->sampler, 1);
+		mtx_unlock(args->lock);
+
+		katss_set_read(hasher, buffer, args->filetype);
 		while(katss_get_fh(hasher, &hash_values[cur_hash], args->filetype)) {
 			if(++cur_hash == num_counts) { // begin flushing
 				katss_increments(args->counter, hash_values, cur_hash);
@@ -217,7 +265,6 @@ count_file_bootstrap_mt(void *arg)
 	katss_increments(args->counter, hash_values, cur_hash);
 
 	/* Free resources */
-	thread_safe_rand_free(tsr);
 	free(hasher);
 	free(buffer);
 	free(hash_values);
@@ -262,6 +309,19 @@ katss_count_kmers_bootstrap_mt(const char *filename, unsigned int kmer,
 		return NULL;
 	}
 
+	unsigned int local_seed;
+	if(seed == NULL) {
+		local_seed = time(NULL);
+		seed = &local_seed;
+	}
+
+	/* The threads share one sampler, drawing from the same seed */
+	rand_sampler sampler;
+	rand_sampler_init(&sampler, sample, seed);
+	mtx_t lock;
+	mtx_init(&lock, mtx_plain);
+	bool done = false;
+
 	threadinfo *jobarg = s_malloc(threads * sizeof *jobarg);
 	thrd_t *jobs = s_malloc(threads * sizeof *jobs);
 	for(int i=0; i<threads; i++) {
@@ -269,8 +329,9 @@ katss_count_kmers_bootstrap_mt(const char *filename, unsigned int kmer,
 		jobarg[i].counter = counter;
 		jobarg[i].kmer = kmer;
 		jobarg[i].filetype = filetype;
-		jobarg[i].sample = sample;
-		jobarg[i].seed = seed;
+		jobarg[i].sampler = &sampler;
+		jobarg[i].lock = &lock;
+		jobarg[i].done = &done;
 
 		/* Start threads */
 		thrd_create(&jobs[i], count_file_bootstrap_mt, &jobarg[i]);
@@ -281,6 +342,7 @@ katss_count_kmers_bootstrap_mt(const char *filename, unsigned int kmer,
 	}
 
 	/* Free resources */
+	mtx_destroy(&lock);
 	seqfclose(file);
 	free(jobs);
 	free(jobarg);
@@ -380,6 +442,20 @@ count_file_mt(void *arg)
 ==============================================================================*/
 KatssCounter *
 katss_count_kmers_ushuffle(const char *filename, unsigned int kmer, int klet)
+{
+	return count_ushuffle(filename, NULL, kmer, klet, 1);
+}
+
+KatssCounter *
+katss_count_kmers_ushuffle_trimmed(const char *filename, const KatssReadFilter *filter,
+                                   unsigned int kmer, int klet)
+{
+	return count_ushuffle(filename, filter, kmer, klet, 1);
+}
+
+static KatssCounter *
+count_ushuffle(const char *filename, const KatssReadFilter *filter, unsigned int kmer, int klet,
+               int shuffles)
 {
 	/* Determine file type, or return NULL on error */
 	char filetype = determine_filetype(filename);
@@ -394,6 +470,7 @@ katss_count_kmers_ushuffle(const char *filename, unsigned int kmer, int klet)
 	/* Open file and prepare counter & hasher */
 	char *buffer = s_calloc(BUFFER_SIZE, sizeof *buffer);
 	char *shuf   = s_calloc(BUFFER_SIZE, sizeof *shuf);
+	char *quality = filter != NULL ? s_malloc(BUFFER_SIZE) : NULL;
 	uint32_t hash_value;
 
 	/* Open file */
@@ -412,13 +489,17 @@ katss_count_kmers_ushuffle(const char *filename, unsigned int kmer, int klet)
 		goto cleanup_hasher;
 
 	srand(1); // reset rand seed for shuffle
-	while(seqfgets_unlocked(read_file, buffer, BUFFER_SIZE)) {
+	while(trim_next_read(read_file, filter, buffer, quality, BUFFER_SIZE, false)) {
+		/* The graph of the read is built once for all its shuffles */
 		int seqlen = strlen(buffer);
-		shuffle(buffer, shuf, seqlen, klet);
-		shuf[seqlen] = '\0';
-		katss_set_seq(hasher, shuf, 'r');
-		while(katss_get_fh(hasher, &hash_value, 'r')) {
-			katss_increment(counter, hash_value);
+		shuffle1(buffer, seqlen, klet);
+		for(int s = 0; s < shuffles; s++) {
+			shuffle2(shuf);
+			shuf[seqlen] = '\0';
+			katss_set_read(hasher, shuf, 'r');
+			while(katss_get_fh(hasher, &hash_value, 'r')) {
+				katss_increment(counter, hash_value);
+			}
 		}
 	}
 
@@ -436,20 +517,22 @@ cleanup_file:
 exit:
 	free(buffer);
 	free(shuf);
+	free(quality);
 	return counter;
 }
 
 KatssCounter *
 katss_count_kmers_ushuffle_bootstrap(const char *filename, unsigned int kmer,
-                                     int klet, int sample, unsigned int *seed)
+                                     int klet, int shuffles, int sample, unsigned int *seed)
 {
 	/* sample should be between 1-100000 */
 	sample = MAX2(sample, 1);
 	sample = MIN2(sample, 100000);
+	shuffles = MAX2(shuffles, 1);
 
 	/* If not subsampling, just do regular ushuffle */
-	if(sample == 100000)
-		return katss_count_kmers_ushuffle(filename, kmer, klet);
+	if(sample == 100000 && seed == NULL)
+		return count_ushuffle(filename, NULL, kmer, klet, shuffles);
 
 	/* Check klet */
 	if(klet < 1)
@@ -487,20 +570,33 @@ katss_count_kmers_ushuffle_bootstrap(const char *filename, unsigned int kmer,
 		seed = &local_seed;
 	}
 
-	srand(1); // reset rand seed for shuffle
-	while(seqfgets_unlocked(read_file, buffer, BUFFER_SIZE)) {
-		/* Pick random sequences */
-		if(rand_r(seed) % 100000 >= sample)
-			continue;
-		/* Shuffle sequences */
+	/* Shuffle with a generator of our own, so bootstraps can run at the same time */
+	ushuffle_state *shuffler = ushuffle_create(*seed);
+	rand_sampler sampler;
+	rand_sampler_init(&sampler, sample, seed);
+	for(;;) {
+		/* Pick random sequences, skipping the rest */
+		uint64_t gap = rand_sampler_gap(&sampler);
+		uint64_t skipped = seqfskip_unlocked(read_file, gap);
+		rand_sampler_take(&sampler, skipped);
+		if(skipped < gap || !seqfgets_unlocked(read_file, buffer, BUFFER_SIZE))
+			break;
+		rand_sampler_take(&sampler, 1);
+
+		/* Shuffle sequences, building the graph of each once */
 		int seqlen = strlen(buffer);
-		shuffle(buffer, shuf, strlen(buffer), klet);
-		shuf[seqlen] = '\0'; // add null terminator since shuffle uses strncpy
-		katss_set_seq(hasher, shuf, 'r');
-		while(katss_get_fh(hasher, &hash_value, 'r')) {
-			katss_increment(counter, hash_value);
+		shuffle1_r(shuffler, buffer, seqlen, klet);
+		for(int s = 0; s < shuffles; s++) {
+			shuffle2_r(shuffler, shuf);
+			shuf[seqlen] = '\0'; // add null terminator since shuffle uses strncpy
+			katss_set_read(hasher, shuf, 'r');
+			while(katss_get_fh(hasher, &hash_value, 'r')) {
+				katss_increment(counter, hash_value);
+			}
 		}
 	}
+	rand_sampler_end(&sampler);
+	ushuffle_free(shuffler);
 
 	if(seqferrno) {
 		error_message("katss: sample: %s\n", seqfstrerror_r(seqferrno, buffer, BUFFER_SIZE));
@@ -518,6 +614,76 @@ exit:
 	return counter;
 }
 
+KatssCounter *
+katss_count_kmers_ushuffle_expected(const char *filename, unsigned int kmer, int klet)
+{
+	return katss_count_kmers_ushuffle_expected_bootstrap(filename, kmer, klet, 100000, NULL);
+}
+
+KatssCounter *
+katss_count_kmers_ushuffle_expected_bootstrap(const char *filename, unsigned int kmer,
+                                              int klet, int sample, unsigned int *seed)
+{
+	/* sample should be between 1-100000 */
+	sample = MAX2(sample, 1);
+	sample = MIN2(sample, 100000);
+
+	char filetype = determine_filetype(filename);
+	if(filetype == 'e' || filetype == 'N')
+		return NULL;
+
+	expected_shuffle *expected = expected_shuffle_init(kmer, klet);
+	if(expected == NULL)
+		return NULL;
+
+	KatssCounter *counter = NULL;
+	char *buffer = s_calloc(BUFFER_SIZE, sizeof *buffer);
+
+	/* Open file */
+	buffer[0] = filetype == 'r' ? 's' : filetype;
+	SeqFile read_file = seqfopen(filename, buffer);
+	if(read_file == NULL)
+		goto exit;
+
+	counter = katss_init_counter(kmer);
+	if(counter == NULL)
+		goto cleanup_file;
+
+	unsigned int local_seed;
+	if(seed == NULL) {
+		local_seed = time(NULL);
+		seed = &local_seed;
+	}
+
+	/* Only the sub-sample is random, the expectations of every read are not */
+	rand_sampler sampler;
+	rand_sampler_init(&sampler, sample, seed);
+	for(;;) {
+		uint64_t gap = rand_sampler_gap(&sampler);
+		uint64_t skipped = seqfskip_unlocked(read_file, gap);
+		rand_sampler_take(&sampler, skipped);
+		if(skipped < gap || !seqfgets_unlocked(read_file, buffer, BUFFER_SIZE))
+			break;
+		rand_sampler_take(&sampler, 1);
+		expected_shuffle_add(expected, buffer, strlen(buffer), 1.0);
+	}
+	rand_sampler_end(&sampler);
+	expected_shuffle_flush(expected, counter);
+
+	if(seqferrno) {
+		error_message("katss: %d: %s", seqferrno, seqfstrerror(seqferrno));
+		katss_free_counter(counter);
+		counter = NULL;
+	}
+
+cleanup_file:
+	seqfclose(read_file);
+exit:
+	expected_shuffle_free(expected);
+	free(buffer);
+	return counter;
+}
+
 /*==============================================================
 |  Helper Functions                                            |
 ==============================================================*/
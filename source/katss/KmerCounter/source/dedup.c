@@ -0,0 +1,1671 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
+#  include <threads.h>
+#else
+#  include <tinycthread.h>
+#endif
+
+#include "katss_core.h"
+#include "counter.h"
+#include "memory_utils.h"
+#include "seqfile.h"
+#include "thread_safe_rand.h"
+#include "trim.h"
+#include "ushuffle.h"
+#include "expected_shuffle.h"
+
+#define BUFFER_SIZE 65536U
+#define NUM_SHARDS 64          /* Must be a power of two */
+#define INITIAL_CAPACITY 256
+#define INITIAL_ARENA 4096
+#define RAW_READ 0x80000000U   /* Set in the length of reads stored one byte per character */
+#define NUM_WEIGHTS 65536      /* Counts buffered by each thread before flushing them */
+#define HEADER_SIZE 1024       /* Longest header kept when reading UMIs from headers */
+#define MAX_UMI_PREFIX 64
+
+/* A slot is free while its count is zero */
+struct read_entry {
+	uint64_t hash;
+	uint64_t offset;        /* Position of the read in the arena of its shard */
+	uint32_t length;        /* Number of nucleotides, or'd with RAW_READ */
+	uint32_t padding;
+	uint64_t count;         /* Number of times the read was seen */
+};
+typedef struct read_entry read_entry;
+
+/* Reads are spread over the shards by hash, each shard with its own lock */
+struct read_shard {
+	read_entry    *entries;
+	size_t        num_entries;
+	size_t        capacity;
+	unsigned char *arena;   /* Reads, 2-bit packed four nucleotides per byte */
+	size_t        arena_used;
+	size_t        arena_size;
+	mtx_t         lock;
+};
+typedef struct read_shard read_shard;
+
+struct KatssReadSet {
+	read_shard shards[NUM_SHARDS];
+	size_t     shard_limit; /* Bytes each shard may use */
+	bool       full;        /* Set once a shard went over its limit */
+	int        error;       /* seqferrno of the threads that failed to read */
+	uint64_t   num_reads;   /* Reads in the file */
+	uint64_t   collapsed;   /* Reads left out as UMI duplicates */
+	uint64_t   missing_umi; /* Reads kept since they had no UMI */
+	uint64_t   adapters;    /* Reads the adapter was trimmed off */
+	uint64_t   too_short;   /* Reads left out for being too short after trimming */
+	bool       shuffles;    /* Entries hold count shuffles of a read, see katss_shuffle_reads */
+	mtx_t      lock;
+};
+
+/* Where to find the UMI of a read, see katss_collapse_umi_reads */
+struct umi_pattern {
+	bool in_header;         /* At the end of the header's first word, else a sequence prefix */
+	char separator;         /* Character before the UMI in the header */
+	int  length;            /* Length of the UMI prefix */
+	int  start;             /* Nucleotides of the read that go into the key with the UMI */
+};
+typedef struct umi_pattern umi_pattern;
+
+struct build_info {
+	SeqFile seqfile;
+	KatssReadSet *reads;
+	KatssReadSet *keys;     /* (UMI, start) of the reads kept, only set when collapsing */
+	const umi_pattern *umi;
+	const KatssReadFilter *filter; /* Only set when trimming */
+	mtx_t lock;             /* Numbers the records as they are read when collapsing */
+	uint64_t records;
+};
+typedef struct build_info build_info;
+
+/* The read kept for a key follows the key in the arena of the keys, see keep_read */
+struct kept_read {
+	uint64_t record;        /* Position of the read in the file */
+	uint32_t length;        /* Number of nucleotides, or'd with RAW_READ */
+};
+typedef struct kept_read kept_read;
+
+struct replicate_info {
+	const KatssReadSet *reads;
+	KatssCounter **counters;    /* per_replicate counters of every replicate, one after the other */
+	int per_replicate;
+	int replicates;
+	int sample;
+	unsigned int seed;
+	int thread;
+	int threads;
+};
+typedef struct replicate_info replicate_info;
+
+struct count_info {
+	const KatssReadSet *reads;
+	KatssCounter *counter;
+	int thread;
+	int threads;
+	int sample;                 /* Per 100000 reads, for bootstrap counts */
+	unsigned int seed;          /* Seed of the copies sampled */
+};
+typedef struct count_info count_info;
+
+/* A read of a set, see sorted_reads */
+struct read_ref {
+	const read_shard *shard;
+	const read_entry *entry;
+};
+typedef struct read_ref read_ref;
+
+/* A..T (and U) to 0..3 in either case, 4 for every other character */
+static const unsigned char code[256] = {
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  //0..15
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  //16..31
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  //32..47
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  //48..63
+	4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,  //64..79
+	4, 4, 4, 4, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  //80..95
+	4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,  //96..111
+	4, 4, 4, 4, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  //112..127
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  //128..143
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  //144..159
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  //160..175
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  //176..191
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  //192..207
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  //208..223
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  //224..239
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,  //240..255
+};
+
+static char determine_filetype(const char *filename);
+static bool is_nucleotide(char character);
+
+/*==================================================================================================
+|                                       Building the read set                                      |
+==================================================================================================*/
+static uint64_t
+hash_read(const unsigned char *packed, size_t num_bytes, uint32_t length)
+{
+	/* 64-bit FNV-1a, then mixed since the shard is taken from the top bits */
+	uint64_t hash = 14695981039346656037ULL ^ length;
+	for(size_t i = 0; i < num_bytes; i++) {
+		hash ^= packed[i];
+		hash *= 1099511628211ULL;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+
+/* Pack a read two bits per nucleotide, or copy it as it is if it has other characters */
+static size_t
+pack_read(const char *sequence, unsigned char *packed, uint32_t *length)
+{
+	uint32_t len = 0;
+	for(const char *s = sequence; *s; s++) {
+		unsigned char nt = code[(unsigned char)*s];
+		if(nt == 4) {
+			*length = (uint32_t)strlen(sequence) | RAW_READ;
+			memcpy(packed, sequence, strlen(sequence));
+			return strlen(sequence);
+		}
+		if(len % 4 == 0)
+			packed[len / 4] = 0;
+		packed[len / 4] |= nt << (2 * (len % 4));
+		len++;
+	}
+	*length = len;
+	return (len + 3) / 4;
+}
+
+
+/* Bytes taken by a packed read of the given length, as returned by pack_read */
+static size_t
+packed_size(uint32_t length)
+{
+	uint32_t nucleotides = length & ~RAW_READ;
+	return length & RAW_READ ? nucleotides : (nucleotides + 3) / 4;
+}
+
+
+static int
+shard_grow(KatssReadSet *reads, read_shard *shard, size_t num_bytes)
+{
+	/* Grow the arena or the table, as long as the shard stays under its limit */
+	size_t arena_size = shard->arena_size;
+	while(shard->arena_used + num_bytes > arena_size)
+		arena_size *= 2;
+	size_t capacity = shard->capacity;
+	if(10 * (shard->num_entries + 1) > 7 * capacity)
+		capacity *= 2;
+	if(arena_size + capacity * sizeof(read_entry) > reads->shard_limit)
+		return 1;
+
+	if(arena_size != shard->arena_size) {
+		shard->arena = s_realloc(shard->arena, arena_size);
+		shard->arena_size = arena_size;
+	}
+	if(capacity != shard->capacity) {
+		read_entry *entries = s_calloc(capacity, sizeof *entries);
+		size_t mask = capacity - 1;
+		for(size_t i = 0; i < shard->capacity; i++) {
+			if(shard->entries[i].count == 0)
+				continue;
+			size_t slot = shard->entries[i].hash & mask;
+			while(entries[slot].count != 0)
+				slot = (slot + 1) & mask;
+			entries[slot] = shard->entries[i];
+		}
+		free(shard->entries);
+		shard->entries = entries;
+		shard->capacity = capacity;
+	}
+	return 0;
+}
+
+
+/* Returns 0 if the read is new, 1 if it was already in the set, -1 if it does not fit */
+static int
+insert_read(KatssReadSet *reads, const unsigned char *packed, size_t num_bytes, uint32_t length)
+{
+	uint64_t hash = hash_read(packed, num_bytes, length);
+	read_shard *shard = &reads->shards[hash >> 58];
+	int ret = 0;
+
+	mtx_lock(&shard->lock);
+	size_t mask = shard->capacity - 1;
+	size_t slot = hash & mask;
+	while(shard->entries[slot].count != 0) {
+		read_entry *entry = &shard->entries[slot];
+		if(entry->hash == hash && entry->length == length &&
+		   memcmp(shard->arena + entry->offset, packed, num_bytes) == 0) {
+			entry->count++;
+			ret = 1;
+			goto unlock;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	/* New read, make room for it first */
+	if(shard->arena_used + num_bytes > shard->arena_size ||
+	   10 * (shard->num_entries + 1) > 7 * shard->capacity) {
+		if(shard_grow(reads, shard, num_bytes) != 0) {
+			ret = -1;
+			goto unlock;
+		}
+		mask = shard->capacity - 1;
+		slot = hash & mask;
+		while(shard->entries[slot].count != 0)
+			slot = (slot + 1) & mask;
+	}
+
+	memcpy(shard->arena + shard->arena_used, packed, num_bytes);
+	shard->entries[slot].hash = hash;
+	shard->entries[slot].offset = shard->arena_used;
+	shard->entries[slot].length = length;
+	shard->entries[slot].count = 1;
+	shard->arena_used += num_bytes;
+	shard->num_entries++;
+
+unlock:
+	mtx_unlock(&shard->lock);
+	return ret;
+}
+
+
+/* Add an entry for count copies of a read of num_bytes each, without looking for the read in
+   the set. Returns where the copies go in the arena of its shard, which no other thread may
+   grow until they are written, or NULL if they do not fit */
+static unsigned char *
+append_entry(KatssReadSet *reads, uint64_t hash, uint32_t length, uint64_t count,
+             size_t num_bytes)
+{
+	read_shard *shard = &reads->shards[hash >> 58];
+	size_t total = num_bytes * count;
+	unsigned char *copies = NULL;
+
+	mtx_lock(&shard->lock);
+	if(shard->arena_used + total > shard->arena_size ||
+	   10 * (shard->num_entries + 1) > 7 * shard->capacity) {
+		if(shard_grow(reads, shard, total) != 0)
+			goto unlock;
+	}
+
+	size_t mask = shard->capacity - 1;
+	size_t slot = hash & mask;
+	while(shard->entries[slot].count != 0)
+		slot = (slot + 1) & mask;
+	shard->entries[slot].hash = hash;
+	shard->entries[slot].offset = shard->arena_used;
+	shard->entries[slot].length = length;
+	shard->entries[slot].count = count;
+	copies = shard->arena + shard->arena_used;
+	shard->arena_used += total;
+	shard->num_entries++;
+
+unlock:
+	mtx_unlock(&shard->lock);
+	return copies;
+}
+
+
+/* The UMI is whatever follows the last separator in the first word of the header */
+static const char *
+header_umi(const char *header, char separator, size_t *length)
+{
+	size_t word = strcspn(header, " \t\r");
+	const char *umi = NULL;
+	for(size_t i = 0; i < word; i++)
+		if(header[i] == separator)
+			umi = header + i + 1;
+	if(umi == NULL || umi == header + word)
+		return NULL;
+	*length = (size_t)(header + word - umi);
+	return umi;
+}
+
+
+/* Find the read's UMI, skipping past (the quality scores of) a UMI prefix. Returns NULL if the
+   read has no UMI. */
+static const char *
+read_umi(const umi_pattern *umi, const char *header, char **sequence, const char **quality,
+         size_t *length)
+{
+	if(umi->in_header)
+		return header_umi(header, umi->separator, length);
+	if(strnlen(*sequence, umi->length) < (size_t)umi->length)
+		return NULL;
+
+	const char *tag = *sequence;
+	*length = umi->length;
+	*sequence += umi->length;
+	if(strnlen(*quality, umi->length) == (size_t)umi->length)
+		*quality += umi->length;
+	return tag;
+}
+
+
+static read_entry *
+find_key(read_shard *shard, uint64_t hash, const char *key, size_t key_length)
+{
+	size_t mask = shard->capacity - 1;
+	for(size_t slot = hash & mask; shard->entries[slot].count != 0; slot = (slot + 1) & mask) {
+		read_entry *entry = &shard->entries[slot];
+		if(entry->hash == hash && entry->length == ((uint32_t)key_length | RAW_READ) &&
+		   memcmp(shard->arena + entry->offset, key, key_length) == 0)
+			return entry;
+	}
+	return NULL;
+}
+
+
+/* Keep the read of the earliest record with the key, whichever thread reads it first. Returns
+   1 if another record had the same key, -1 if the keys ran out of memory, 0 otherwise. */
+static int
+keep_read(KatssReadSet *keys, const char *key, size_t key_length, uint64_t record,
+          const unsigned char *packed, size_t num_bytes, uint32_t length)
+{
+	uint64_t hash = hash_read((const unsigned char *)key, key_length,
+	                          (uint32_t)key_length | RAW_READ);
+	read_shard *shard = &keys->shards[hash >> 58];
+	kept_read kept = { .record = record, .length = length };
+	size_t total = key_length + sizeof kept + num_bytes;
+	int ret = 0;
+
+	mtx_lock(&shard->lock);
+	read_entry *entry = find_key(shard, hash, key, key_length);
+	if(entry != NULL) {
+		kept_read earlier;
+		unsigned char *read = shard->arena + entry->offset + key_length;
+		memcpy(&earlier, read, sizeof earlier);
+		ret = 1;
+		entry->count++;
+		if(earlier.record < record)
+			goto unlock;
+
+		/* Replace the later read in place if this one fits */
+		if(num_bytes <= packed_size(earlier.length)) {
+			memcpy(read, &kept, sizeof kept);
+			memcpy(read + sizeof kept, packed, num_bytes);
+			goto unlock;
+		}
+	}
+
+	/* Otherwise the key moves to the end of the arena with its new read */
+	if(shard->arena_used + total > shard->arena_size ||
+	   10 * (shard->num_entries + 1) > 7 * shard->capacity) {
+		if(shard_grow(keys, shard, total) != 0) {
+			ret = -1;
+			goto unlock;
+		}
+		if(entry != NULL)
+			entry = find_key(shard, hash, key, key_length);
+	}
+	if(entry == NULL) {
+		size_t mask = shard->capacity - 1;
+		size_t slot = hash & mask;
+		while(shard->entries[slot].count != 0)
+			slot = (slot + 1) & mask;
+		entry = &shard->entries[slot];
+		entry->hash = hash;
+		entry->length = (uint32_t)key_length | RAW_READ;
+		entry->count = 1;
+		shard->num_entries++;
+	}
+
+	unsigned char *copy = shard->arena + shard->arena_used;
+	memcpy(copy, key, key_length);
+	memcpy(copy + key_length, &kept, sizeof kept);
+	memcpy(copy + key_length + sizeof kept, packed, num_bytes);
+	entry->offset = shard->arena_used;
+	shard->arena_used += total;
+
+unlock:
+	mtx_unlock(&shard->lock);
+	return ret;
+}
+
+
+/* Look up the read's UMI and first nucleotides in the keys, see keep_read */
+static int
+collapse_read(build_info *args, const char *tag, size_t tag_length, const char *sequence,
+              uint64_t record, const unsigned char *packed, size_t num_bytes, uint32_t length,
+              char *key)
+{
+	size_t start = strnlen(sequence, args->umi->start);
+	memcpy(key, tag, tag_length);
+	key[tag_length] = '\n';
+	memcpy(key + tag_length + 1, sequence, start);
+	return keep_read(args->keys, key, tag_length + 1 + start, record, packed, num_bytes, length);
+}
+
+
+/* Add the reads kept for the keys to the set. Returns 1 if they do not fit. */
+static int
+add_kept_reads(KatssReadSet *reads, const KatssReadSet *keys)
+{
+	for(int i = 0; i < NUM_SHARDS; i++) {
+		const read_shard *shard = &keys->shards[i];
+		for(size_t j = 0; j < shard->capacity; j++) {
+			const read_entry *entry = &shard->entries[j];
+			if(entry->count == 0)
+				continue;
+			const unsigned char *read = shard->arena + entry->offset + packed_size(entry->length);
+			kept_read kept;
+			memcpy(&kept, read, sizeof kept);
+			if(insert_read(reads, read + sizeof kept, packed_size(kept.length), kept.length) < 0)
+				return 1;
+		}
+	}
+	return 0;
+}
+
+
+static int
+build_mt(void *arg)
+{
+	build_info *args = (build_info *)arg;
+	KatssReadSet *reads = args->reads;
+	const umi_pattern *umi = args->umi;
+	const KatssReadFilter *filter = args->filter;
+	char *buffer = s_malloc(BUFFER_SIZE);
+	unsigned char *packed = s_malloc(BUFFER_SIZE);
+	char *header = NULL, *key = NULL, *quality = NULL;
+	uint64_t num_reads = 0, collapsed = 0, missing = 0, adapters = 0, too_short = 0;
+	int ret = 0;
+
+	/* Only ask for the header when the UMI is in there, and for quality scores when trimming */
+	if(umi != NULL && umi->in_header)
+		header = s_malloc(HEADER_SIZE);
+	if(umi != NULL)
+		key = s_malloc(HEADER_SIZE + MAX_UMI_PREFIX + umi->start + 1);
+	if(filter != NULL && trim_uses_quality(filter))
+		quality = s_malloc(BUFFER_SIZE);
+
+	for(;; num_reads++) {
+		/* Number the records when collapsing, their order decides which duplicate is kept */
+		uint64_t record = 0;
+		if(umi != NULL)
+			mtx_lock(&args->lock);
+		bool more = seqfgetq(args->seqfile, header, HEADER_SIZE, buffer, BUFFER_SIZE, quality,
+		                     BUFFER_SIZE);
+		if(umi != NULL) {
+			record = args->records++;
+			mtx_unlock(&args->lock);
+		}
+		if(!more)
+			break;
+
+		/* Stop once any thread ran out of memory */
+		if(num_reads % 1024 == 0) {
+			mtx_lock(&reads->lock);
+			bool full = reads->full;
+			mtx_unlock(&reads->lock);
+			if(full)
+				break;
+		}
+
+		/* The UMI is taken before trimming, which may cut into a UMI prefix */
+		char *sequence = buffer;
+		const char *qual = quality != NULL ? quality : "";
+		const char *tag = NULL;
+		size_t tag_length = 0;
+		if(umi != NULL)
+			tag = read_umi(umi, header, &sequence, &qual, &tag_length);
+
+		/* Trim in place, the trimmed read goes straight into the set */
+		if(filter != NULL) {
+			bool adapter;
+			size_t length = trim_read(filter, sequence, qual, &adapter);
+			adapters += adapter;
+			if(length < (size_t)MAX2(filter->min_length, 0)) {
+				too_short++;
+				continue;
+			}
+		}
+
+		/* Reads with a UMI wait with their key until the threads are done. Reads without one
+		   can't be told apart from their duplicates, keep all of them. */
+		uint32_t length;
+		size_t num_bytes = pack_read(sequence, packed, &length);
+		int found;
+		if(tag != NULL) {
+			found = collapse_read(args, tag, tag_length, sequence, record, packed, num_bytes,
+			                      length, key);
+			collapsed += found == 1;
+		} else {
+			missing += umi != NULL;
+			found = insert_read(reads, packed, num_bytes, length);
+		}
+		if(found < 0) {
+			mtx_lock(&reads->lock);
+			reads->full = true;
+			mtx_unlock(&reads->lock);
+			ret = 1;
+			break;
+		}
+	}
+
+	mtx_lock(&reads->lock);
+	if(seqferrno)
+		reads->error = seqferrno;
+	reads->num_reads += num_reads;
+	reads->collapsed += collapsed;
+	reads->missing_umi += missing;
+	reads->adapters += adapters;
+	reads->too_short += too_short;
+	mtx_unlock(&reads->lock);
+
+	free(buffer);
+	free(packed);
+	free(header);
+	free(key);
+	free(quality);
+	return ret;
+}
+
+
+static KatssReadSet *
+init_reads(size_t max_memory)
+{
+	KatssReadSet *reads = s_malloc(sizeof *reads);
+	reads->shard_limit = max_memory / NUM_SHARDS;
+	reads->full = false;
+	reads->error = 0;
+	reads->num_reads = 0;
+	reads->collapsed = 0;
+	reads->missing_umi = 0;
+	reads->adapters = 0;
+	reads->too_short = 0;
+	reads->shuffles = false;
+	mtx_init(&reads->lock, mtx_plain);
+	for(int i = 0; i < NUM_SHARDS; i++) {
+		read_shard *shard = &reads->shards[i];
+		shard->entries = s_calloc(INITIAL_CAPACITY, sizeof *shard->entries);
+		shard->num_entries = 0;
+		shard->capacity = INITIAL_CAPACITY;
+		shard->arena = s_malloc(INITIAL_ARENA);
+		shard->arena_used = 0;
+		shard->arena_size = INITIAL_ARENA;
+		mtx_init(&shard->lock, mtx_plain);
+	}
+	return reads;
+}
+
+
+/* Read the file into a set of distinct reads, trimming them if filter is not NULL and
+   collapsing UMI duplicates if umi is not NULL. The caller checks reads->full. */
+static KatssReadSet *
+build_reads(const char *filename, size_t max_memory, int threads, const KatssReadFilter *filter,
+            const umi_pattern *umi)
+{
+	threads = MAX2(threads, 1);
+	threads = MIN2(threads, 128);
+
+	char filetype = determine_filetype(filename);
+	if(filetype == 'e' || filetype == 'N')
+		return NULL;
+
+	/* Open SeqFile for reading */
+	char mode[2] = { 0 };
+	mode[0] = filetype == 'r' ? 's' : filetype;
+	SeqFile file = seqfopen(filename, mode);
+	if(file == NULL) {
+		error_message("katss: seqfopen: %s\n", seqfstrerror(seqferrno));
+		return NULL;
+	}
+
+	/* The keys, with the read kept for each, take up half of the memory when collapsing */
+	KatssReadSet *reads = init_reads(umi != NULL ? max_memory / 2 : max_memory);
+	KatssReadSet *keys = umi != NULL ? init_reads(max_memory / 2) : NULL;
+
+	/* Every thread reads records from the file and inserts them */
+	build_info arg = { .seqfile = file, .reads = reads, .keys = keys, .umi = umi,
+	                   .filter = filter, .records = 0 };
+	mtx_init(&arg.lock, mtx_plain);
+	thrd_t *jobs = s_malloc(threads * sizeof *jobs);
+	for(int i = 0; i < threads; i++)
+		thrd_create(&jobs[i], build_mt, &arg);
+	for(int i = 0; i < threads; i++)
+		thrd_join(jobs[i], NULL);
+	free(jobs);
+	mtx_destroy(&arg.lock);
+	if(keys != NULL && !reads->full && add_kept_reads(reads, keys) != 0)
+		reads->full = true;
+	katss_free_reads(keys);
+	seqfclose(file);
+
+	if(reads->error) {
+		error_message("katss: %d: %s", reads->error, seqfstrerror(reads->error));
+		katss_free_reads(reads);
+		return NULL;
+	}
+	return reads;
+}
+
+
+KatssReadSet *
+katss_dedup_reads(const char *filename, size_t max_memory, int threads)
+{
+	KatssReadSet *reads = build_reads(filename, max_memory, threads, NULL, NULL);
+	if(reads != NULL && reads->full) {
+		warning_message("katss: distinct reads of '%s' do not fit in %zu MiB, reading the file "
+		                "instead", filename, max_memory >> 20);
+		katss_free_reads(reads);
+		reads = NULL;
+	}
+	return reads;
+}
+
+
+static int
+parse_umi(const char *pattern, int start, umi_pattern *umi)
+{
+	umi->in_header = false;
+	umi->separator = '_';
+	umi->length = 0;
+	umi->start = start;
+	if(start < 0)
+		goto error;
+
+	if(strcmp(pattern, "header") == 0) {
+		umi->in_header = true;
+		return 0;
+	}
+	if(strncmp(pattern, "header:", 7) == 0 && pattern[7] != '\0' && pattern[8] == '\0') {
+		umi->in_header = true;
+		umi->separator = pattern[7];
+		return 0;
+	}
+	if(strncmp(pattern, "prefix:", 7) == 0) {
+		char *end;
+		long length = strtol(pattern + 7, &end, 10);
+		if(end != pattern + 7 && *end == '\0' && length >= 1 && length <= MAX_UMI_PREFIX) {
+			umi->length = (int)length;
+			return 0;
+		}
+	}
+
+error:
+	error_message("katss: UMI pattern '%s' is not 'header', 'header:SEP' or 'prefix:N' "
+	              "(N up to %d)", pattern, MAX_UMI_PREFIX);
+	return 1;
+}
+
+
+void
+katss_init_read_filter(KatssReadFilter *filter)
+{
+	filter->adapter = NULL;
+	filter->adapter_error = 0.1;
+	filter->adapter_overlap = 3;
+	filter->quality_cutoff = 0;
+	filter->mask_quality = 0;
+	filter->min_length = 0;
+	filter->umi = NULL;
+	filter->umi_start = 16;
+}
+
+
+KatssReadSet *
+katss_preprocess_reads(const char *filename, const KatssReadFilter *filter, size_t max_memory,
+                       int threads)
+{
+	umi_pattern umi;
+	if(filter->umi != NULL && parse_umi(filter->umi, filter->umi_start, &umi) != 0)
+		return NULL;
+
+	/* Without UMIs, the file can be trimmed as it is read instead. With them, that would count
+	   the duplicates left out */
+	KatssReadSet *reads = build_reads(filename, max_memory, threads,
+	                                  trim_enabled(filter) ? filter : NULL,
+	                                  filter->umi != NULL ? &umi : NULL);
+	if(reads != NULL && reads->full && filter->umi != NULL)
+		error_message("katss: preprocessed reads of '%s' do not fit in %zu MiB", filename,
+		              max_memory >> 20);
+	else if(reads != NULL && reads->full)
+		warning_message("katss: trimmed reads of '%s' do not fit in %zu MiB, trimming them as "
+		                "the file is read instead", filename, max_memory >> 20);
+	if(reads != NULL && reads->full) {
+		katss_free_reads(reads);
+		reads = NULL;
+	}
+	return reads;
+}
+
+
+KatssReadSet *
+katss_collapse_umi_reads(const char *filename, const char *pattern, int start, size_t max_memory,
+                         int threads)
+{
+	if(pattern == NULL)
+		return NULL;
+
+	KatssReadFilter filter;
+	katss_init_read_filter(&filter);
+	filter.umi = pattern;
+	filter.umi_start = start;
+	return katss_preprocess_reads(filename, &filter, max_memory, threads);
+}
+
+
+uint64_t
+katss_reads_total(const KatssReadSet *reads)
+{
+	return reads->num_reads;
+}
+
+
+uint64_t
+katss_reads_collapsed(const KatssReadSet *reads)
+{
+	return reads->collapsed;
+}
+
+
+uint64_t
+katss_reads_missing_umi(const KatssReadSet *reads)
+{
+	return reads->missing_umi;
+}
+
+
+uint64_t
+katss_reads_adapter_trimmed(const KatssReadSet *reads)
+{
+	return reads->adapters;
+}
+
+
+uint64_t
+katss_reads_too_short(const KatssReadSet *reads)
+{
+	return reads->too_short;
+}
+
+
+size_t
+katss_reads_size(const KatssReadSet *reads)
+{
+	size_t size = 0;
+	for(int i = 0; i < NUM_SHARDS; i++)
+		size += reads->shards[i].arena_used;
+	return size;
+}
+
+
+void
+katss_free_reads(KatssReadSet *reads)
+{
+	if(reads == NULL)
+		return;
+	for(int i = 0; i < NUM_SHARDS; i++) {
+		mtx_destroy(&reads->shards[i].lock);
+		free(reads->shards[i].entries);
+		free(reads->shards[i].arena);
+	}
+	mtx_destroy(&reads->lock);
+	free(reads);
+}
+
+/*==================================================================================================
+|                                        Counting the reads                                        |
+==================================================================================================*/
+/* Bytes a read takes up in the arena, or each of its copies in a set of shuffles */
+static size_t
+read_bytes(const read_entry *entry)
+{
+	return packed_size(entry->length);
+}
+
+
+/* Unpack a read, or its given copy in a set of shuffles, into one code (0-3, or 4 for other
+   characters) per nucleotide */
+static uint32_t
+unpack_read(const read_shard *shard, const read_entry *entry, uint64_t copy, unsigned char *codes)
+{
+	const unsigned char *read = shard->arena + entry->offset + copy * read_bytes(entry);
+	uint32_t length = entry->length & ~RAW_READ;
+	if(entry->length & RAW_READ) {
+		for(uint32_t i = 0; i < length; i++)
+			codes[i] = code[read[i]];
+	} else {
+		for(uint32_t i = 0; i < length; i++)
+			codes[i] = (read[i / 4] >> (2 * (i % 4))) & 3;
+	}
+	return length;
+}
+
+
+/* Cross out the leftmost non-overlapping occurrences of every removed k-mer, like cross_out */
+static void
+cross_out_codes(unsigned char *codes, uint32_t length, const katss_str_node_t *removed)
+{
+	for(; removed != NULL; removed = removed->next) {
+		uint32_t len = 0, pattern = 0;
+		for(const char *s = removed->str; *s; s++, len++)
+			pattern = (pattern << 2) | (code[(unsigned char)*s] & 3);
+		if(len == 0 || len > 16)
+			continue;
+
+		uint32_t mask = (uint32_t)((1ULL << 2*len) - 1);
+		uint32_t hash = 0, valid = 0;
+		for(uint32_t i = 0; i < length; i++) {
+			if(codes[i] > 3) {
+				valid = 0;
+				continue;
+			}
+			hash = ((hash << 2) | codes[i]) & mask;
+			if(++valid >= len && hash == pattern) {
+				memset(codes + i + 1 - len, 4, len);
+				valid = 0;
+			}
+		}
+	}
+}
+
+
+static void
+flush_weights(KatssCounter *counter, uint32_t *hash_values, uint64_t *weights, size_t num_values)
+{
+	mtx_lock(&counter->lock);
+	for(size_t i = 0; i < num_values; i++) {
+		if(counter->kmer <= 12)
+			counter->table.small[hash_values[i]] += weights[i];
+		else
+			counter->table.medium[hash_values[i]] += (uint32_t)weights[i];
+		counter->total += weights[i];
+	}
+	mtx_unlock(&counter->lock);
+}
+
+
+/* Thread-local buffer of weighted k-mers */
+struct weights {
+	uint32_t *hash_values;
+	uint64_t *weights;
+	size_t num_values;
+};
+
+
+static void
+count_codes(KatssCounter *counter, struct weights *buf, const unsigned char *codes,
+            uint32_t length, uint64_t weight)
+{
+	unsigned int kmer = counter->kmer;
+	uint32_t mask = (uint32_t)((1ULL << 2*kmer) - 1);
+	uint32_t hash = 0, valid = 0;
+	for(uint32_t i = 0; i < length; i++) {
+		if(codes[i] > 3) {
+			valid = 0;
+			continue;
+		}
+		hash = ((hash << 2) | codes[i]) & mask;
+		if(++valid < kmer)
+			continue;
+		buf->hash_values[buf->num_values] = hash;
+		buf->weights[buf->num_values] = weight;
+		if(++buf->num_values == NUM_WEIGHTS) {
+			flush_weights(counter, buf->hash_values, buf->weights, buf->num_values);
+			buf->num_values = 0;
+		}
+	}
+}
+
+
+/* Number of the count copies of a read a sub-sample keeps, each with a chance of sample in 100000.
+   The draws only depend on the seed and the read, not on the order the reads are counted in */
+static uint64_t
+replicate_weight(uint64_t count, int sample, unsigned int seed, uint64_t hash)
+{
+	if(sample >= 100000)
+		return count;
+
+	/* Jump over the copies left out, whose number before each kept copy is geometric */
+	uint64_t state = hash ^ ((uint64_t)seed << 32);
+	double log_miss = log1p(-sample / 100000.0);
+	uint64_t weight = 0;
+	for(;;) {
+		double u = (double)(splitmix64(&state) >> 11) * 0x1.0p-53;
+		double gap = floor(log1p(-u) / log_miss);
+		if(gap >= (double)count)
+			break;
+		count -= (uint64_t)gap + 1;
+		weight++;
+	}
+	return weight;
+}
+
+
+static int
+count_reads_mt(void *arg)
+{
+	count_info *args = (count_info *)arg;
+	KatssCounter *counter = args->counter;
+	unsigned char *codes = s_malloc(BUFFER_SIZE);
+	struct weights buf = {
+		.hash_values = s_malloc(NUM_WEIGHTS * sizeof *buf.hash_values),
+		.weights = s_malloc(NUM_WEIGHTS * sizeof *buf.weights),
+		.num_values = 0,
+	};
+
+	/* Threads take every threads-th shard */
+	for(int s = args->thread; s < NUM_SHARDS; s += args->threads) {
+		const read_shard *shard = &args->reads->shards[s];
+		for(size_t i = 0; i < shard->capacity; i++) {
+			const read_entry *entry = &shard->entries[i];
+			if(entry->count == 0)
+				continue;
+			uint64_t weight = replicate_weight(entry->count, args->sample, args->seed,
+			                                   entry->hash);
+			if(weight == 0)
+				continue;
+
+			/* Sets of shuffles hold every copy of the read, the first ones kept are counted */
+			uint64_t copies = 1;
+			if(args->reads->shuffles) {
+				copies = weight;
+				weight = 1;
+			}
+			for(uint64_t c = 0; c < copies; c++) {
+				uint32_t length = unpack_read(shard, entry, c, codes);
+				cross_out_codes(codes, length, counter->removed);
+				count_codes(counter, &buf, codes, length, weight);
+			}
+		}
+	}
+	flush_weights(counter, buf.hash_values, buf.weights, buf.num_values);
+
+	free(codes);
+	free(buf.hash_values);
+	free(buf.weights);
+	return 0;
+}
+
+
+static void
+run_count(const KatssReadSet *reads, KatssCounter *counter, int sample, unsigned int *seed,
+          int threads)
+{
+	threads = MAX2(threads, 1);
+	threads = MIN2(threads, NUM_SHARDS);
+
+	unsigned int local_seed;
+	if(seed == NULL) {
+		local_seed = time(NULL);
+		seed = &local_seed;
+	}
+
+	/* The copies kept only depend on the seed and the read, not on the thread counting it */
+	count_info *jobarg = s_malloc(threads * sizeof *jobarg);
+	for(int i = 0; i < threads; i++) {
+		jobarg[i].reads = reads;
+		jobarg[i].counter = counter;
+		jobarg[i].thread = i;
+		jobarg[i].threads = threads;
+		jobarg[i].sample = sample;
+		jobarg[i].seed = *seed;
+	}
+
+	if(threads == 1) {
+		count_reads_mt(&jobarg[0]);
+	} else {
+		thrd_t *jobs = s_malloc(threads * sizeof *jobs);
+		for(int i = 0; i < threads; i++)
+			thrd_create(&jobs[i], count_reads_mt, &jobarg[i]);
+		for(int i = 0; i < threads; i++)
+			thrd_join(jobs[i], NULL);
+		free(jobs);
+	}
+
+	free(jobarg);
+}
+
+
+static void
+clear_counter(KatssCounter *counter)
+{
+	uint64_t total = ((uint64_t)counter->capacity) + 1;
+	if(counter->kmer <= 12)
+		memset(counter->table.small,  0x00, total * sizeof(uint64_t));
+	else
+		memset(counter->table.medium, 0x00, total * sizeof(uint32_t));
+	counter->total = 0;
+}
+
+
+static void
+push_removed(KatssCounter *counter, const char *str)
+{
+	if(str == NULL)
+		return;
+
+	katss_str_node_t **tail = &counter->removed;
+	while(*tail != NULL)
+		tail = &(*tail)->next;
+	*tail = s_malloc(sizeof(katss_str_node_t));
+	(*tail)->str = strdup(str);
+	(*tail)->next = NULL;
+}
+
+
+KatssCounter *
+katss_count_reads_mt(const KatssReadSet *reads, unsigned int kmer, int threads)
+{
+	KatssCounter *counter = katss_init_counter(kmer);
+	if(counter == NULL)
+		return NULL;
+	run_count(reads, counter, 100000, NULL, threads);
+	return counter;
+}
+
+
+KatssCounter *
+katss_count_reads_bootstrap_mt(const KatssReadSet *reads, unsigned int kmer, int sample,
+                               unsigned int *seed, int threads)
+{
+	/* sample should be between 1-100000 */
+	sample = MAX2(sample, 1);
+	sample = MIN2(sample, 100000);
+
+	KatssCounter *counter = katss_init_counter(kmer);
+	if(counter == NULL)
+		return NULL;
+	run_count(reads, counter, sample, seed, threads);
+	return counter;
+}
+
+
+int
+katss_recount_reads_mt(KatssCounter *counter, const KatssReadSet *reads, const char *remove,
+                       int threads)
+{
+	clear_counter(counter);
+	push_removed(counter, remove);
+	run_count(reads, counter, 100000, NULL, threads);
+	return 0;
+}
+
+/*==================================================================================================
+|                                       Shuffling the reads                                        |
+==================================================================================================*/
+/* Reads are sorted by hash, then by length and content, which only ties for the same read */
+static int
+compare_reads(const void *a, const void *b)
+{
+	const read_ref *ref_a = a, *ref_b = b;
+	const read_entry *entry_a = ref_a->entry, *entry_b = ref_b->entry;
+	if(entry_a->hash != entry_b->hash)
+		return entry_a->hash < entry_b->hash ? -1 : 1;
+	if(entry_a->length != entry_b->length)
+		return entry_a->length < entry_b->length ? -1 : 1;
+
+	return memcmp(ref_a->shard->arena + entry_a->offset, ref_b->shard->arena + entry_b->offset,
+	              read_bytes(entry_a));
+}
+
+
+/* The reads of the set in an order that does not depend on the order they were inserted in,
+   which changes with the number of threads that built the set. Reads that take their numbers
+   from one generator go through them in this order, so the numbers each read gets only depend
+   on the seed */
+static read_ref *
+sorted_reads(const KatssReadSet *reads, size_t *num_reads)
+{
+	size_t total = 0;
+	for(int s = 0; s < NUM_SHARDS; s++)
+		total += reads->shards[s].num_entries;
+
+	read_ref *refs = s_malloc(MAX2(total, 1) * sizeof *refs);
+	*num_reads = 0;
+	for(int s = 0; s < NUM_SHARDS; s++) {
+		const read_shard *shard = &reads->shards[s];
+		for(size_t i = 0; i < shard->capacity; i++) {
+			if(shard->entries[i].count == 0)
+				continue;
+			refs[*num_reads].shard = shard;
+			refs[*num_reads].entry = &shard->entries[i];
+			(*num_reads)++;
+		}
+	}
+	qsort(refs, *num_reads, sizeof *refs, compare_reads);
+	return refs;
+}
+
+
+static void
+shuffle_reads(const KatssReadSet *reads, KatssCounter *counter, int klet, int shuffles,
+              int sample, unsigned int seed, ushuffle_state *shuffler, expected_shuffle *expected)
+{
+	static const char nucleotides[] = "ACGT";
+	unsigned char *codes = s_malloc(BUFFER_SIZE);
+	char *buffer = s_malloc(BUFFER_SIZE + 1);
+	char *shuf   = s_malloc(BUFFER_SIZE + 1);
+	struct weights buf = {
+		.hash_values = s_malloc(NUM_WEIGHTS * sizeof *buf.hash_values),
+		.weights = s_malloc(NUM_WEIGHTS * sizeof *buf.weights),
+		.num_values = 0,
+	};
+
+	/* Every copy of a read is shuffled on its own, as if it was read from the file, from a
+	   graph built once per distinct read. Their expected counts are the same, so those are
+	   added once, weighted by the copies */
+	size_t num_reads;
+	read_ref *refs = sorted_reads(reads, &num_reads);
+	if(shuffler == NULL && expected == NULL)
+		srand(1); // reset rand seed for shuffle
+	for(size_t r = 0; r < num_reads; r++) {
+		const read_shard *shard = refs[r].shard;
+		const read_entry *entry = refs[r].entry;
+		uint64_t copies = replicate_weight(entry->count, sample, seed, entry->hash);
+		if(copies == 0)
+			continue;
+
+		uint32_t length = entry->length & ~RAW_READ;
+		if(entry->length & RAW_READ) {
+			memcpy(buffer, shard->arena + entry->offset, length);
+		} else {
+			unpack_read(shard, entry, 0, codes);
+			for(uint32_t j = 0; j < length; j++)
+				buffer[j] = nucleotides[codes[j]];
+		}
+		buffer[length] = '\0';
+
+		if(expected != NULL) {
+			expected_shuffle_add(expected, buffer, length, (double)copies);
+			continue;
+		}
+		if(shuffler != NULL)
+			shuffle1_r(shuffler, buffer, (int)length, klet);
+		else
+			shuffle1(buffer, (int)length, klet);
+		for(uint64_t c = 0; c < copies * shuffles; c++) {
+			if(shuffler != NULL)
+				shuffle2_r(shuffler, shuf);
+			else
+				shuffle2(shuf);
+			for(uint32_t j = 0; j < length; j++)
+				codes[j] = code[(unsigned char)shuf[j]];
+			cross_out_codes(codes, length, counter->removed);
+			count_codes(counter, &buf, codes, length, 1);
+		}
+	}
+	free(refs);
+	flush_weights(counter, buf.hash_values, buf.weights, buf.num_values);
+	if(expected != NULL)
+		expected_shuffle_flush(expected, counter);
+
+	free(codes);
+	free(buffer);
+	free(shuf);
+	free(buf.hash_values);
+	free(buf.weights);
+}
+
+
+KatssCounter *
+katss_count_reads_ushuffle(const KatssReadSet *reads, unsigned int kmer, int klet)
+{
+	return katss_count_reads_ushuffle_bootstrap(reads, kmer, klet, 1, 100000, NULL);
+}
+
+
+KatssCounter *
+katss_count_reads_ushuffle_bootstrap(const KatssReadSet *reads, unsigned int kmer, int klet,
+                                     int shuffles, int sample, unsigned int *seed)
+{
+	if(klet < 1)
+		return NULL;
+
+	/* sample should be between 1-100000 */
+	sample = MAX2(sample, 1);
+	sample = MIN2(sample, 100000);
+	shuffles = MAX2(shuffles, 1);
+
+	/* Bootstraps shuffle with a generator of their own, so they can run at the same time */
+	bool bootstrap = sample < 100000 || seed != NULL;
+
+	unsigned int local_seed;
+	if(seed == NULL) {
+		local_seed = time(NULL);
+		seed = &local_seed;
+	}
+
+	KatssCounter *counter = katss_init_counter(kmer);
+	if(counter == NULL)
+		return NULL;
+	ushuffle_state *shuffler = bootstrap ? ushuffle_create(*seed) : NULL;
+	shuffle_reads(reads, counter, klet, shuffles, sample, *seed, shuffler, NULL);
+	ushuffle_free(shuffler);
+	return counter;
+}
+
+
+KatssCounter *
+katss_count_reads_ushuffle_expected(const KatssReadSet *reads, unsigned int kmer, int klet)
+{
+	return katss_count_reads_ushuffle_expected_bootstrap(reads, kmer, klet, 100000, NULL);
+}
+
+
+KatssCounter *
+katss_count_reads_ushuffle_expected_bootstrap(const KatssReadSet *reads, unsigned int kmer,
+                                              int klet, int sample, unsigned int *seed)
+{
+	/* sample should be between 1-100000 */
+	sample = MAX2(sample, 1);
+	sample = MIN2(sample, 100000);
+
+	unsigned int local_seed;
+	if(seed == NULL) {
+		local_seed = time(NULL);
+		seed = &local_seed;
+	}
+
+	expected_shuffle *expected = expected_shuffle_init(kmer, klet);
+	if(expected == NULL)
+		return NULL;
+	KatssCounter *counter = katss_init_counter(kmer);
+	if(counter != NULL)
+		shuffle_reads(reads, counter, klet, 1, sample, *seed, NULL, expected);
+	expected_shuffle_free(expected);
+	return counter;
+}
+
+
+int
+katss_recount_reads_shuffle(KatssCounter *counter, const KatssReadSet *reads, int klet,
+                            const char *remove)
+{
+	if(klet < 1)
+		return 1;
+
+	clear_counter(counter);
+	push_removed(counter, remove);
+	shuffle_reads(reads, counter, klet, 1, 100000, 0, NULL, NULL);
+	return 0;
+}
+
+/*==================================================================================================
+|                                     Bootstrapping the reads                                      |
+==================================================================================================*/
+/* Count the k-mers of a read straight into a counter no other thread counts into */
+static void
+add_codes(KatssCounter *counter, const unsigned char *codes, uint32_t length, uint64_t weight)
+{
+	unsigned int kmer = counter->kmer;
+	uint32_t mask = (uint32_t)((1ULL << 2*kmer) - 1);
+	uint32_t hash = 0, valid = 0;
+	for(uint32_t i = 0; i < length; i++) {
+		if(codes[i] > 3) {
+			valid = 0;
+			continue;
+		}
+		hash = ((hash << 2) | codes[i]) & mask;
+		if(++valid < kmer)
+			continue;
+		if(kmer <= 12)
+			counter->table.small[hash] += weight;
+		else
+			counter->table.medium[hash] += (uint32_t)weight;
+		counter->total += weight;
+	}
+}
+
+
+static int
+count_replicates_mt(void *arg)
+{
+	replicate_info *args = (replicate_info *)arg;
+	unsigned char *codes = s_malloc(BUFFER_SIZE);
+	unsigned char *crossed = s_malloc(BUFFER_SIZE);
+	unsigned int *seeds = s_malloc(args->replicates * sizeof *seeds);
+	uint64_t *weights = s_malloc(args->replicates * sizeof *weights);
+	for(int r = args->thread; r < args->replicates; r += args->threads)
+		seeds[r] = rand_replicate_seed(args->seed, r);
+
+	/* Every read is unpacked once for all the replicates of the thread, which each take their
+	   own copies of it and cross their own k-mers out. Sets of shuffles hold every copy of the
+	   read, so each copy is unpacked once for the replicates that keep that many */
+	for(int s = 0; s < NUM_SHARDS; s++) {
+		const read_shard *shard = &args->reads->shards[s];
+		for(size_t i = 0; i < shard->capacity; i++) {
+			const read_entry *entry = &shard->entries[i];
+			if(entry->count == 0)
+				continue;
+
+			uint64_t copies = 0;
+			for(int r = args->thread; r < args->replicates; r += args->threads) {
+				int sample = r == 0 ? 100000 : args->sample;
+				weights[r] = replicate_weight(entry->count, sample, seeds[r], entry->hash);
+				copies = MAX2(copies, weights[r]);
+			}
+			if(!args->reads->shuffles)
+				copies = MIN2(copies, 1);
+
+			for(uint64_t copy = 0; copy < copies; copy++) {
+				uint32_t length = unpack_read(shard, entry, copy, codes);
+				for(int r = args->thread; r < args->replicates; r += args->threads) {
+					uint64_t weight = args->reads->shuffles ? weights[r] > copy : weights[r];
+					if(weight == 0)
+						continue;
+
+					KatssCounter **counters = args->counters + (size_t)r * args->per_replicate;
+					const unsigned char *read = codes;
+					if(counters[0]->removed != NULL) {
+						memcpy(crossed, codes, length);
+						cross_out_codes(crossed, length, counters[0]->removed);
+						read = crossed;
+					}
+					for(int c = 0; c < args->per_replicate; c++)
+						add_codes(counters[c], read, length, weight);
+				}
+			}
+		}
+	}
+
+	free(codes);
+	free(crossed);
+	free(seeds);
+	free(weights);
+	return 0;
+}
+
+
+int
+katss_recount_reads_bootstrap_mt(KatssCounter **counters, int per_replicate, int replicates,
+                                 const char **remove, const KatssReadSet *reads, int sample,
+                                 unsigned int seed, int threads)
+{
+	/* sample should be between 1-100000 */
+	sample = MAX2(sample, 1);
+	sample = MIN2(sample, 100000);
+	if(per_replicate < 1 || replicates < 1)
+		return 1;
+
+	for(int r = 0; r < replicates; r++) {
+		for(int c = 0; c < per_replicate; c++) {
+			KatssCounter *counter = counters[(size_t)r * per_replicate + c];
+			clear_counter(counter);
+			if(remove != NULL)
+				push_removed(counter, remove[r]);
+		}
+	}
+
+	/* Every replicate is counted by one thread, so its counters need no locks */
+	threads = MAX2(threads, 1);
+	threads = MIN2(threads, replicates);
+	replicate_info *jobarg = s_malloc(threads * sizeof *jobarg);
+	for(int i = 0; i < threads; i++) {
+		jobarg[i].reads = reads;
+		jobarg[i].counters = counters;
+		jobarg[i].per_replicate = per_replicate;
+		jobarg[i].replicates = replicates;
+		jobarg[i].sample = sample;
+		jobarg[i].seed = seed;
+		jobarg[i].thread = i;
+		jobarg[i].threads = threads;
+	}
+
+	if(threads == 1) {
+		count_replicates_mt(&jobarg[0]);
+	} else {
+		thrd_t *jobs = s_malloc(threads * sizeof *jobs);
+		for(int i = 0; i < threads; i++)
+			thrd_create(&jobs[i], count_replicates_mt, &jobarg[i]);
+		for(int i = 0; i < threads; i++)
+			thrd_join(jobs[i], NULL);
+		free(jobs);
+	}
+	free(jobarg);
+	return 0;
+}
+
+/*==================================================================================================
+|                                    Storing the shuffled reads                                    |
+==================================================================================================*/
+/* Draw the next shuffle of the read in the shuffler, or in ushuffle's own state if shuffler is
+   NULL */
+static void
+next_shuffle(ushuffle_state *shuffler, char *shuf, int length)
+{
+	if(shuffler != NULL)
+		shuffle2_r(shuffler, shuf);
+	else
+		shuffle2(shuf);
+	shuf[length] = '\0'; // null terminate shuf since shuffle uses strncpy
+}
+
+
+/* Insert the next shuffle of the read into the store, or mark it as full */
+static int
+store_shuffle(KatssReadSet *store, ushuffle_state *shuffler, char *shuf, int length,
+              unsigned char *packed)
+{
+	uint32_t packed_length;
+	next_shuffle(shuffler, shuf, length);
+	size_t num_bytes = pack_read(shuf, packed, &packed_length);
+	if(insert_read(store, packed, num_bytes, packed_length) >= 0)
+		return 0;
+	store->full = true;
+	return 1;
+}
+
+
+/* Hand the store over, or free it if it could not be filled. filename is NULL for read sets */
+static KatssReadSet *
+finish_store(KatssReadSet *store, const char *filename, size_t max_memory)
+{
+	if(store->error) {
+		error_message("katss: %d: %s", store->error, seqfstrerror(store->error));
+		katss_free_reads(store);
+		return NULL;
+	}
+	if(store->full && filename != NULL)
+		warning_message("katss: shuffled reads of '%s' do not fit in %zu MiB, shuffling them "
+		                "every iteration instead", filename, max_memory >> 20);
+	else if(store->full)
+		warning_message("katss: shuffled distinct reads do not fit in %zu MiB, shuffling them "
+		                "every iteration instead", max_memory >> 20);
+	if(store->full) {
+		katss_free_reads(store);
+		return NULL;
+	}
+	return store;
+}
+
+
+KatssReadSet *
+katss_shuffle_file(const char *filename, int klet, const unsigned int *seed, size_t max_memory)
+{
+	if(klet < 1)
+		return NULL;
+
+	char filetype = determine_filetype(filename);
+	if(filetype == 'e' || filetype == 'N')
+		return NULL;
+
+	/* Open SeqFile for reading */
+	char mode[2] = { 0 };
+	mode[0] = filetype == 'r' ? 's' : filetype;
+	SeqFile file = seqfopen(filename, mode);
+	if(file == NULL) {
+		error_message("katss: seqfopen: %s\n", seqfstrerror(seqferrno));
+		return NULL;
+	}
+
+	/* Reads are shuffled in the order of the file, so the store only depends on the seed.
+	   Without one, they are shuffled like katss_count_kmers_ushuffle shuffles them */
+	KatssReadSet *store = init_reads(max_memory);
+	ushuffle_state *shuffler = seed != NULL ? ushuffle_create(*seed) : NULL;
+	char *buffer = s_malloc(BUFFER_SIZE);
+	char *shuf = s_malloc(BUFFER_SIZE + 1);
+	unsigned char *packed = s_malloc(BUFFER_SIZE);
+	if(shuffler == NULL)
+		srand(1); // reset rand seed for shuffle
+	while(seqfgets_unlocked(file, buffer, BUFFER_SIZE)) {
+		int length = (int)strlen(buffer);
+		store->num_reads++;
+		if(shuffler != NULL)
+			shuffle1_r(shuffler, buffer, length, klet);
+		else
+			shuffle1(buffer, length, klet);
+		if(store_shuffle(store, shuffler, shuf, length, packed) != 0)
+			break;
+	}
+	if(seqferrno)
+		store->error = seqferrno;
+
+	ushuffle_free(shuffler);
+	free(buffer);
+	free(shuf);
+	free(packed);
+	seqfclose(file);
+	return finish_store(store, filename, max_memory);
+}
+
+
+KatssReadSet *
+katss_shuffle_reads(const KatssReadSet *reads, int klet, const unsigned int *seed,
+                    size_t max_memory)
+{
+	static const char nucleotides[] = "ACGT";
+	if(klet < 1)
+		return NULL;
+
+	KatssReadSet *store = init_reads(max_memory);
+	store->num_reads = reads->num_reads;
+	store->shuffles = true;
+	ushuffle_state *shuffler = seed != NULL ? ushuffle_create(*seed) : NULL;
+	unsigned char *codes = s_malloc(BUFFER_SIZE);
+	char *buffer = s_malloc(BUFFER_SIZE + 1);
+	char *shuf = s_malloc(BUFFER_SIZE + 1);
+	unsigned char *packed = s_malloc(BUFFER_SIZE);
+
+	/* Every copy of a read is shuffled on its own, from a graph built once per distinct read,
+	   and the shuffles are kept together under the read's hash. The reads are sorted, so the
+	   store only depends on the seed, and without one they are shuffled like
+	   katss_count_reads_ushuffle shuffles them */
+	size_t num_reads;
+	read_ref *refs = sorted_reads(reads, &num_reads);
+	if(shuffler == NULL)
+		srand(1); // reset rand seed for shuffle
+	for(size_t r = 0; r < num_reads && !store->full; r++) {
+		const read_shard *shard = refs[r].shard;
+		const read_entry *entry = refs[r].entry;
+		uint32_t length = entry->length & ~RAW_READ;
+		if(entry->length & RAW_READ) {
+			memcpy(buffer, shard->arena + entry->offset, length);
+		} else {
+			unpack_read(shard, entry, 0, codes);
+			for(uint32_t j = 0; j < length; j++)
+				buffer[j] = nucleotides[codes[j]];
+		}
+		buffer[length] = '\0';
+
+		if(shuffler != NULL)
+			shuffle1_r(shuffler, buffer, (int)length, klet);
+		else
+			shuffle1(buffer, (int)length, klet);
+
+		/* Shuffles have the characters of the read, so they all pack to the same length */
+		uint32_t packed_length;
+		next_shuffle(shuffler, shuf, (int)length);
+		size_t num_bytes = pack_read(shuf, packed, &packed_length);
+		unsigned char *copies = append_entry(store, entry->hash, packed_length, entry->count,
+		                                     num_bytes);
+		if(copies == NULL) {
+			store->full = true;
+			break;
+		}
+		memcpy(copies, packed, num_bytes);
+		for(uint64_t c = 1; c < entry->count; c++) {
+			next_shuffle(shuffler, shuf, (int)length);
+			pack_read(shuf, copies + c * num_bytes, &packed_length);
+		}
+	}
+
+	ushuffle_free(shuffler);
+	free(refs);
+	free(codes);
+	free(buffer);
+	free(shuf);
+	free(packed);
+	return finish_store(store, NULL, max_memory);
+}
+
+/*==================================================================================================
+|                                         Helper Functions                                         |
+==================================================================================================*/
+static bool
+is_nucleotide(char character)
+{
+	return code[(unsigned char)character] != 4;
+}
+
+static char
+determine_filetype(const char *file)
+{
+	/* Open the SeqFile, return 'e' upon error */
+	SeqFile reads_file = seqfopen(file, "b");
+	if(reads_file == NULL) {
+		error_message("katss: %s: %s", file, strerror(errno));
+		seqfclose(reads_file);
+		return 'N';
+	}
+
+	char buffer[BUFFER_SIZE];
+	int lines_read = 0;
+	int fastq_score_lines = 0;
+	int fasta_score_lines = 0;
+	int sequence_lines = 0;
+
+	while (seqfgets(reads_file, buffer, BUFFER_SIZE) != NULL && lines_read < 10) {
+		lines_read++;
+		char first_char = buffer[0];
+
+		/* Check if the first line starts with '@' for FASTQ */
+		if (first_char == '@' && lines_read % 4 == 1) {
+			fastq_score_lines++;
+
+		/* Check if the third line starts with '+' for FASTQ */
+		} else if (first_char == '+' && lines_read % 4 == 3) {
+			fastq_score_lines++;
+
+		/* Check if the line starts with '>' or ';' for FASTA */
+		} else if (first_char == '>' || first_char == ';') {
+			fasta_score_lines++;
+		} else {
+			// Check for nucleotide characters
+			int num_total = 0, num = 0;
+			for(int i = 0; buffer[i] != '\0'; i++) {
+				if(is_nucleotide(buffer[i])) {
+					num++;
+				}
+				num_total++;
+			}
+			if((double)num/num_total > 0.9) {
+				sequence_lines++;
+			}
+		}
+	}
+	seqfclose(reads_file);
+
+	if (fastq_score_lines >= 2) {
+		return 'q'; // fastq file
+	} else if (fasta_score_lines > 0) {
+		return 'a';
+	} else if (sequence_lines == 10) {
+		return 'r'; // raw sequences file
+	} else {
+		error_message("Unable to read sequence from file.\nCurrent supported file types are:"
+		              " FASTA, FASTQ, and file containing sequences per line.");
+		return 'e'; // unsupported file type
+	}
+}
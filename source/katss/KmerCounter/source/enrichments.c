@@ -7,12 +7,12 @@
 #include "katss_core.h"
 #include "enrichments.h"
 #include "counter.h"
+#include "count_jobs.h"
 #include "hash_functions.h"
 #include "memory_utils.h"
 
-static double predict_kmer(char *kseq, KatssCounter *monomer_counts, KatssCounter *dimer_counts);
 KatssEnrichment katss_top_enrichment(KatssCounter *test, KatssCounter *control, bool normalize);
-KatssEnrichment katss_top_prediction(KatssCounter *test, KatssCounter *mono, KatssCounter *dint, bool normalize);
+KatssEnrichment katss_top_prediction(KatssCounter *test, KatssCounter *context, KatssCounter *words, bool normalize);
 
 KatssEnrichments *
 katss_compute_enrichments(KatssCounter *test, KatssCounter *control, bool normalize)
@@ -77,30 +77,30 @@ katss_enrichments(const char *test_file, const char *control_file, unsigned int
 
 
 KatssEnrichments *
-katss_compute_prob_enrichments(KatssCounter *test, KatssCounter *mono, 
-                               KatssCounter *dint, bool normalize)
+katss_compute_prob_enrichments(KatssCounter *test, KatssCounter *context, 
+                               KatssCounter *words, bool normalize)
 {
-	/* Mono and dinucleotides must be of correct length */
-	if(mono->kmer != 1 || dint->kmer != 2)
+	/* Predict the frequencies of all k-mers, if the counts make a model */
+	uint64_t num_enrichments = ((uint64_t)test->capacity)+1;
+	double *freqs = s_malloc(num_enrichments * sizeof *freqs);
+	if(katss_predict_kmer_freqs(freqs, test->kmer, context, words) != 0) {
+		free(freqs);
 		return NULL;
+	}
 
 	/* Allocate enrichments struct */
-	uint64_t num_enrichments = ((uint64_t)test->capacity)+1;
 	KatssEnrichments *enrichments = s_malloc(sizeof *enrichments);
 	enrichments->enrichments = s_malloc(num_enrichments * sizeof(KatssEnrichment));
 	enrichments->num_enrichments = num_enrichments;
 
 	/* Compute enrichments */
 	for(uint32_t i=0; i<=test->capacity; i++) {
-		char kseq[17] = { 0 };
-		katss_unhash(kseq, i, test->kmer, true);
-
 		/* Get frequencies */
 		double test_count, test_frq, ctrl_frq;
 		katss_get_from_hash(test, KATSS_DOUBLE, &test_count, i);
 
 		test_frq = test_count / test->total;
-		ctrl_frq = predict_kmer(kseq, mono, dint);
+		ctrl_frq = freqs[i];
 
 		enrichments->enrichments[i].key = i; // Set key
 		if(test_frq == 0.0 || ctrl_frq == 0.0) { // Determine if enrichment is valid
@@ -120,6 +120,7 @@ katss_compute_prob_enrichments(KatssCounter *test, KatssCounter *mono,
 
 		enrichments->enrichments[i].enrichment = r_val;
 	}
+	free(freqs);
 	return enrichments;
 }
 
@@ -198,21 +199,169 @@ exit:
 }
 
 
-KatssEnrichments *
-katss_ikke_mt(const char *test_file, const char *control_file, unsigned int kmer, 
-              uint64_t iterations, bool normalize, int threads)
+/**
+ * @brief Whether occurrences of two k-mers can share nucleotides, so that crossing one of them
+ * out changes the counts of the other: they are the same, or a suffix of either is a prefix of
+ * the other.
+ */
+static bool
+kmers_overlap(uint32_t a, uint32_t b, unsigned int kmer)
 {
-	/* Get the counts for the test_file */
-	KatssCounter *test_counts = katss_count_kmers_mt(test_file, kmer, threads);
-	if(test_counts == NULL)
-		return NULL;
+	if(a == b)
+		return true;
+	for(unsigned int len=1; len<kmer; len++) {
+		uint32_t mask = (1U << 2*len) - 1;
+		if((a & mask) == (b >> 2*(kmer-len)) || (b & mask) == (a >> 2*(kmer-len)))
+			return true;
+	}
+	return false;
+}
 
-	/* Get the counts for the control file */
-	KatssCounter *control_counts = katss_count_kmers_mt(control_file, kmer, threads);
-	if(control_counts == NULL) {
-		katss_free_counter(test_counts);
+
+/* Frequency of every k-mer in the test reads over its frequency in the control reads, NAN if
+   it is missing from either, as in katss_top_enrichment */
+static void
+enrichment_ratios(double *ratios, KatssCounter *test, KatssCounter *control)
+{
+	for(uint32_t i=0; i<=test->capacity; i++) {
+		double test_frq = 0, control_frq = 0;
+		katss_get_from_hash(test, KATSS_DOUBLE, &test_frq, i);
+		katss_get_from_hash(control, KATSS_DOUBLE, &control_frq, i);
+		if(test_frq == 0 || control_frq == 0 || !test->total || !control->total) {
+			ratios[i] = NAN;
+			continue;
+		}
+		ratios[i] = (test_frq/test->total)/(control_frq/control->total);
+	}
+}
+
+
+/* Frequency of every k-mer in the test reads over the one the Markov model predicts, NAN if
+   it has no prediction, as in katss_top_prediction */
+static int
+prediction_ratios(double *ratios, KatssCounter *test, KatssCounter *context, KatssCounter *words)
+{
+	if(katss_predict_kmer_freqs(ratios, test->kmer, context, words) != 0)
+		return 1;
+	for(uint32_t i=0; i<=test->capacity; i++) {
+		double kmer_frq;
+		katss_get_from_hash(test, KATSS_DOUBLE, &kmer_frq, i);
+		ratios[i] = ratios[i] > 0 ? (kmer_frq/test->total)/ratios[i] : NAN;
+	}
+	return 0;
+}
+
+
+/* Raise threat to the most enriched k-mer that overlaps kmer, other than itself */
+static void
+overlap_threat(double *threat, uint32_t kmer, const double *ratios, KatssCounter *test)
+{
+	for(uint32_t i=0; i<=test->capacity; i++) {
+		if(i == kmer || isnan(ratios[i]) || ratios[i] <= *threat)
+			continue;
+		if(kmers_overlap(kmer, i, test->kmer))
+			*threat = ratios[i];
+	}
+}
+
+
+/**
+ * @brief Pick the k-mers an iteration of IKKE removes at once, in the order sequential IKKE
+ * would remove them. The most enriched k-mer is always picked, and then each next most enriched
+ * k-mer while it overlaps none of the k-mers picked before it, so that removing those leaves its
+ * counts as they are. Removing them scales the frequencies of the k-mers that don't overlap them
+ * alike, but changes the counts of the k-mers that do, so each k-mer picked must also be more
+ * enriched than all of those by a factor of at least 1 + gap.
+ * 
+ * @param batch     Enrichments of the k-mers picked, most enriched first
+ * @param max       Most k-mers to pick
+ * @param ratios    Enrichment of every k-mer, not normalized, NAN if it has none
+ * @param test      Counts of the k-mers in the test reads
+ * @param gap       Relative enrichment gap between every k-mer picked after the first and the
+ *                  k-mers overlapping the ones picked before it
+ * @param normalize Get the log2 of the enrichments picked
+ * @return uint32_t Number of k-mers picked, at least 1
+ */
+static uint32_t
+top_batch(KatssEnrichment *batch, uint32_t max, const double *ratios, KatssCounter *test,
+          double gap, bool normalize)
+{
+	/* Rank the max most enriched k-mers, the first of equally enriched ones first */
+	uint32_t ranked = 0;
+	KatssEnrichment *top = s_malloc(max * sizeof *top);
+	for(uint32_t i=0; i<=test->capacity; i++) {
+		double ratio = ratios[i];
+		if(isnan(ratio) || (ranked == max && ratio <= top[max-1].enrichment))
+			continue;
+		uint32_t j = ranked < max ? ranked++ : max - 1;
+		for(; j > 0 && top[j-1].enrichment < ratio; j--)
+			top[j] = top[j-1];
+		top[j].key = i;
+		top[j].enrichment = ratio;
+	}
+	if(ranked == 0) {
+		batch[0] = (KatssEnrichment){.enrichment = -DBL_MAX};
+		free(top);
+		return 1;
+	}
+
+	uint32_t picked = 1;
+	double threat = -DBL_MAX;
+	overlap_threat(&threat, top[0].key, ratios, test);
+	while(picked < ranked) {
+		bool independent = true;
+		for(uint32_t j=0; j<picked && independent; j++)
+			independent = !kmers_overlap(top[j].key, top[picked].key, test->kmer);
+		if(!independent || top[picked].enrichment < (1 + gap) * threat)
+			break;
+		overlap_threat(&threat, top[picked].key, ratios, test);
+		picked++;
+	}
+
+	/* Fill in the k-mers picked, checking their counts as katss_top_enrichment does */
+	for(uint32_t j=0; j<picked; j++) {
+		batch[j].key = top[j].key;
+		batch[j].enrichment = normalize ? log2(top[j].enrichment) : top[j].enrichment;
+
+		uint64_t count = 0;
+		katss_get_from_hash(test, KATSS_UINT64, &count, top[j].key);
+		if(count < 20) {
+			char kmer_str[20];
+			katss_unhash(kmer_str, top[j].key, test->kmer, false);
+			warning_message("count for `%s' is less than 20.", kmer_str);
+		}
+	}
+	free(top);
+	return picked;
+}
+
+
+/* Remove the k-mers of the last batch from every counter, to be recounted without them at once */
+static void
+remove_batch(KatssCounter **counters, int num_counters, const KatssEnrichment *batch,
+             uint32_t size, unsigned int kmer)
+{
+	char kseq[17];
+	for(uint32_t j=0; j<size; j++) {
+		katss_unhash(kseq, batch[j].key, kmer, true);
+		for(int c=0; c<num_counters; c++)
+			katss_remove_kmer(counters[c], kseq);
+	}
+}
+
+
+static KatssEnrichments *
+ikke_jobs(katss_job jobs[2], count_job *test, count_job *ctrl, uint64_t iterations,
+          bool normalize, int batch, double gap, int threads)
+{
+	/* Count the test and control files at the same time */
+	if(katss_run_jobs(jobs, 2, threads) != 0) {
+		katss_free_counter(test->counts);
+		katss_free_counter(ctrl->counts);
 		return NULL;
 	}
+	KatssCounter *test_counts = test->counts;
+	KatssCounter *control_counts = ctrl->counts;
 
 	KatssEnrichments *enrichments = s_malloc(sizeof *enrichments);
 	if(iterations > test_counts->capacity)
@@ -220,17 +369,28 @@ katss_ikke_mt(const char *test_file, const char *control_file, unsigned int kmer
 	enrichments->enrichments = s_malloc(iterations * sizeof *enrichments->enrichments);
 	enrichments->num_enrichments = iterations;
 
-	/* Get the first top kmer */
-	enrichments->enrichments[0] = katss_top_enrichment(test_counts, control_counts, normalize);
-
-	/* Subsequent iterations begin uncounting */
-	for(uint32_t i=1; i<iterations; i++) {
-		char kseq[17];
-		katss_unhash(kseq, enrichments->enrichments[i-1].key, test_counts->kmer, true);
-		katss_recount_kmer_mt(test_counts, test_file, kseq, threads);
-		katss_recount_kmer_mt(control_counts, control_file, kseq, threads);
-		enrichments->enrichments[i] = katss_top_enrichment(test_counts, control_counts, normalize);
+	/* Get the top kmer (or batch of them), then begin uncounting, recounting both files at the
+	   same time without every k-mer of the batch */
+	KatssCounter *counters[2] = {test_counts, control_counts};
+	double *ratios = batch > 1 ? s_malloc((((size_t)test_counts->capacity)+1) * sizeof *ratios) : NULL;
+	jobs[0].run = jobs[1].run = count_job_recount;
+	test->remove = ctrl->remove = NULL;
+	for(uint64_t i=0; ; ) {
+		KatssEnrichment *top = &enrichments->enrichments[i];
+		uint32_t found = 1;
+		if(batch > 1) {
+			enrichment_ratios(ratios, test_counts, control_counts);
+			found = top_batch(top, (uint32_t)MIN2((uint64_t)batch, iterations - i), ratios,
+			                  test_counts, gap, normalize);
+		} else {
+			*top = katss_top_enrichment(test_counts, control_counts, normalize);
+		}
+		if((i += found) >= iterations)
+			break;
+		remove_batch(counters, 2, top, found, test_counts->kmer);
+		katss_run_jobs(jobs, 2, threads);
 	}
+	free(ratios);
 
 	/* Cleanup and return */
 	katss_free_counter(test_counts);
@@ -240,6 +400,54 @@ katss_ikke_mt(const char *test_file, const char *control_file, unsigned int kmer
 }
 
 
+KatssEnrichments *
+katss_ikke_mt(const char *test_file, const char *control_file, unsigned int kmer, 
+              uint64_t iterations, bool normalize, int batch, double gap, int threads)
+{
+	return katss_ikke_trimmed_mt(test_file, control_file, NULL, kmer, iterations, normalize,
+	                             batch, gap, threads);
+}
+
+
+KatssEnrichments *
+katss_ikke_trimmed_mt(const char *test_file, const char *control_file,
+                      const KatssReadFilter *filter, unsigned int kmer, uint64_t iterations,
+                      bool normalize, int batch, double gap, int threads)
+{
+	katss_job jobs[2];
+	count_job test, ctrl;
+	count_job_init(&jobs[0], &test, count_job_count, test_file, kmer);
+	count_job_init(&jobs[1], &ctrl, count_job_count, control_file, kmer);
+	test.filter = ctrl.filter = filter;
+	return ikke_jobs(jobs, &test, &ctrl, iterations, normalize, batch, gap, threads);
+}
+
+
+KatssEnrichments *
+katss_ikke_reads_mt(const KatssReadSet *test_reads, const KatssReadSet *control_reads,
+                    unsigned int kmer, uint64_t iterations, bool normalize, int batch, double gap,
+                    int threads)
+{
+	katss_job jobs[2];
+	count_job test, ctrl;
+	count_job_init_reads(&jobs[0], &test, count_job_count, test_reads, kmer);
+	count_job_init_reads(&jobs[1], &ctrl, count_job_count, control_reads, kmer);
+	return ikke_jobs(jobs, &test, &ctrl, iterations, normalize, batch, gap, threads);
+}
+
+
+KatssEnrichments *
+katss_ikke_shuffled_mt(const char *test_file, const KatssReadSet *shuffled, unsigned int kmer,
+                       uint64_t iterations, bool normalize, int batch, double gap, int threads)
+{
+	katss_job jobs[2];
+	count_job test, ctrl;
+	count_job_init(&jobs[0], &test, count_job_count, test_file, kmer);
+	count_job_init_reads(&jobs[1], &ctrl, count_job_count, shuffled, kmer);
+	return ikke_jobs(jobs, &test, &ctrl, iterations, normalize, batch, gap, threads);
+}
+
+
 KatssEnrichments *
 katss_prob_ikke(const char *test_file, unsigned int kmer, uint64_t iterations, bool normalize)
 {
@@ -289,66 +497,161 @@ katss_prob_ikke(const char *test_file, unsigned int kmer, uint64_t iterations, b
 }
 
 
+static KatssEnrichments *
+prob_ikke_jobs(katss_job jobs[3], count_job *test, count_job *words, count_job *context,
+               uint64_t iterations, bool normalize, int batch, double gap, int threads)
+{
+	KatssEnrichments *enrichments = NULL;
+
+	/* Count the k-mers, (m+1)-mers and m-mers of the test file at the same time. A model of
+	   order 0 has no m-mers to count */
+	int num_jobs = context->kmer > 0 ? 3 : 2;
+	if(katss_run_jobs(jobs, num_jobs, threads) != 0)
+		goto exit;
+	KatssCounter *test_counts = test->counts;
+	KatssCounter *word_counts = words->counts;
+	KatssCounter *ctx_counts  = context->counts;
+	unsigned int kmer = test_counts->kmer;
+
+	/* Create enrichments struct */
+	enrichments = s_malloc(sizeof(KatssEnrichments));
+	if(iterations > test_counts->capacity)
+		iterations = ((uint64_t)test_counts->capacity) + 1;
+	enrichments->enrichments = s_malloc(iterations * sizeof *enrichments->enrichments);
+	enrichments->num_enrichments = iterations;
+
+	/* Get the top k-mer (or batch of them), then begin uncounting */
+	KatssCounter *counters[3] = {test_counts, word_counts, ctx_counts};
+	double *ratios = batch > 1 ? s_malloc((((size_t)test_counts->capacity)+1) * sizeof *ratios) : NULL;
+	jobs[0].run = jobs[1].run = jobs[2].run = count_job_recount;
+	test->remove = words->remove = context->remove = NULL;
+	for(uint64_t i=0; ; ) {
+		KatssEnrichment *top = &enrichments->enrichments[i];
+		uint32_t found = 1;
+		if(batch > 1 && prediction_ratios(ratios, test_counts, ctx_counts, word_counts) == 0) {
+			found = top_batch(top, (uint32_t)MIN2((uint64_t)batch, iterations - i), ratios,
+			                  test_counts, gap, normalize);
+		} else {
+			*top = katss_top_prediction(test_counts, ctx_counts, word_counts, normalize);
+		}
+		if((i += found) >= iterations)
+			break;
+		remove_batch(counters, num_jobs, top, found, kmer);
+		katss_run_jobs(jobs, num_jobs, threads);
+	}
+	free(ratios);
+
+	/* Cleanup and return */
+exit:
+	katss_free_counter(context->counts);
+	katss_free_counter(words->counts);
+	katss_free_counter(test->counts);
+	return enrichments;
+}
+
+
 KatssEnrichments *
-katss_prob_ikke_mt(const char *test_file, unsigned int kmer, uint64_t iterations, bool normalize, int threads)
+katss_prob_ikke_mt(const char *test_file, unsigned int kmer, int order, uint64_t iterations,
+                   bool normalize, int batch, double gap, int threads)
+{
+	return katss_prob_ikke_trimmed_mt(test_file, NULL, kmer, order, iterations, normalize, batch,
+	                                  gap, threads);
+}
+
+
+KatssEnrichments *
+katss_prob_ikke_trimmed_mt(const char *test_file, const KatssReadFilter *filter,
+                           unsigned int kmer, int order, uint64_t iterations, bool normalize,
+                           int batch, double gap, int threads)
+{
+	katss_job jobs[3];
+	count_job test, words, context;
+	count_job_init(&jobs[0], &test, count_job_count, test_file, kmer);
+	count_job_init(&jobs[1], &words, count_job_count, test_file, order + 1);
+	count_job_init(&jobs[2], &context, count_job_count, test_file, order);
+	test.filter = words.filter = context.filter = filter;
+	return prob_ikke_jobs(jobs, &test, &words, &context, iterations, normalize, batch, gap,
+	                      threads);
+}
+
+
+KatssEnrichments *
+katss_prob_ikke_reads_mt(const KatssReadSet *test_reads, unsigned int kmer, int order,
+                         uint64_t iterations, bool normalize, int batch, double gap, int threads)
+{
+	katss_job jobs[3];
+	count_job test, words, context;
+	count_job_init_reads(&jobs[0], &test, count_job_count, test_reads, kmer);
+	count_job_init_reads(&jobs[1], &words, count_job_count, test_reads, order + 1);
+	count_job_init_reads(&jobs[2], &context, count_job_count, test_reads, order);
+	return prob_ikke_jobs(jobs, &test, &words, &context, iterations, normalize, batch, gap,
+	                      threads);
+}
+
+KatssEnrichments *
+katss_ikke_shuffle(const char *test, int kmer, int klet, uint64_t iterations, bool normalize)
+{
+	return katss_ikke_shuffle_trimmed(test, NULL, kmer, klet, iterations, normalize);
+}
+
+KatssEnrichments *
+katss_ikke_shuffle_trimmed(const char *test, const KatssReadFilter *filter, int kmer, int klet,
+                           uint64_t iterations, bool normalize)
 {
 	KatssEnrichments *enrichments = NULL;
 
-	/* Get counts for test file */
-	KatssCounter *test_counts = katss_count_kmers(test_file, kmer);
+	/* Get the counts for the test_file */
+	KatssCounter *test_counts = filter != NULL ? katss_count_kmers_trimmed_mt(test, filter, kmer, 1)
+	                                           : katss_count_kmers(test, kmer);
 	if(test_counts == NULL)
 		goto exit;
 
-	/* Get mono and di-nucleotide counts */
-	KatssCounter *mono_counts = katss_count_kmers(test_file, 1);
-	if(mono_counts == NULL)
-		goto cleanup_mono;
-	KatssCounter *dint_counts = katss_count_kmers(test_file, 2);
-	if(dint_counts == NULL)
-		goto cleanup_dint;
+	/* Get the counts for the control file */
+	KatssCounter *ctrl_counts = katss_count_kmers_ushuffle_trimmed(test, filter, kmer, klet);
+	if(ctrl_counts == NULL)
+		goto cleanup_ctrl;
 
 	/* Create enrichments struct */
-	enrichments = s_malloc(sizeof(KatssEnrichments));
+	enrichments = s_malloc(sizeof *enrichments);
 	if(iterations > test_counts->capacity)
 		iterations = ((uint64_t)test_counts->capacity) + 1;
 	enrichments->enrichments = s_malloc(iterations * sizeof *enrichments->enrichments);
 	enrichments->num_enrichments = iterations;
 
-	/* Get the first top k-mer */
-	enrichments->enrichments[0] = katss_top_prediction(test_counts, mono_counts, dint_counts, normalize);
+	/* Get the first top kmer */
+	enrichments->enrichments[0] = katss_top_enrichment(test_counts, ctrl_counts, normalize);
 
 	/* Subsequent iterations begin uncounting */
-	char kseq[17];
-	for(uint64_t i=1; i<enrichments->num_enrichments; i++) {
-		katss_unhash(kseq, enrichments->enrichments[i-1].key, kmer, true);
-		katss_recount_kmer_mt(test_counts, test_file, kseq, threads);
-		katss_recount_kmer_mt(mono_counts, test_file, kseq, threads);
-		katss_recount_kmer_mt(dint_counts, test_file, kseq, threads);
-		enrichments->enrichments[i] = katss_top_prediction(test_counts, mono_counts, dint_counts, normalize);
+	for(uint64_t i=1; i<iterations; i++) {
+		char kseq[17];
+		katss_unhash(kseq, enrichments->enrichments[i-1].key, test_counts->kmer, true);
+		if(filter != NULL)
+			katss_recount_kmer_trimmed_mt(test_counts, test, filter, kseq, 1);
+		else
+			katss_recount_kmer(test_counts, test, kseq);
+		katss_recount_kmer_shuffle_trimmed(ctrl_counts, test, filter, klet, kseq);
+		enrichments->enrichments[i] = katss_top_enrichment(test_counts, ctrl_counts, normalize);
 	}
 
-	/* Cleanup and return */
-	katss_free_counter(dint_counts);
-cleanup_dint:
-	katss_free_counter(mono_counts);
-cleanup_mono:
+	katss_free_counter(ctrl_counts);
+cleanup_ctrl:
 	katss_free_counter(test_counts);
 exit:
 	return enrichments;
 }
 
 KatssEnrichments *
-katss_ikke_shuffle(const char *test, int kmer, int klet, uint64_t iterations, bool normalize)
+katss_ikke_shuffle_reads(const KatssReadSet *test, int kmer, int klet, uint64_t iterations, bool normalize)
 {
 	KatssEnrichments *enrichments = NULL;
 
-	/* Get the counts for the test_file */
-	KatssCounter *test_counts = katss_count_kmers(test, kmer);
+	/* Get the counts for the test reads */
+	KatssCounter *test_counts = katss_count_reads_mt(test, kmer, 1);
 	if(test_counts == NULL)
 		goto exit;
 
-	/* Get the counts for the control file */
-	KatssCounter *ctrl_counts = katss_count_kmers_ushuffle(test, kmer, klet);
+	/* Get the counts for the shuffled reads */
+	KatssCounter *ctrl_counts = katss_count_reads_ushuffle(test, kmer, klet);
 	if(ctrl_counts == NULL)
 		goto cleanup_ctrl;
 
@@ -366,8 +669,8 @@ katss_ikke_shuffle(const char *test, int kmer, int klet, uint64_t iterations, bo
 	for(uint64_t i=1; i<iterations; i++) {
 		char kseq[17];
 		katss_unhash(kseq, enrichments->enrichments[i-1].key, test_counts->kmer, true);
-		katss_recount_kmer(test_counts, test, kseq);
-		katss_recount_kmer_shuffle(ctrl_counts, test, klet, kseq);
+		katss_recount_reads_mt(test_counts, test, kseq, 1);
+		katss_recount_reads_shuffle(ctrl_counts, test, klet, kseq);
 		enrichments->enrichments[i] = katss_top_enrichment(test_counts, ctrl_counts, normalize);
 	}
 
@@ -393,41 +696,6 @@ katss_ikke_shuffle_mt(const char *test, const char *ctrl, int kmer, int klet, ui
 	return NULL;
 }
 
-/*==================================================================================================
-|                                         Helper Functions                                         |
-==================================================================================================*/
-static double
-predict_kmer(char *kseq, KatssCounter *monomer_counts, KatssCounter *dimer_counts)
-{
-	char monoseq[2] = { 0 };
-	char diseq[3]   = { 0 };
-
-	double monoprob = 1;
-	double diprob = 1;
-
-	int kmer = strlen(kseq);
-
-	/* Get the cumulative probabilities for overlapping monomers */
-	for(int i=1; i<kmer-1; i++) {
-		monoseq[0] = kseq[i];
-		double count;
-		katss_get(monomer_counts, KATSS_DOUBLE, &count, monoseq);
-		monoprob *= count/monomer_counts->total;
-	}
-
-	/* Get probabilities for all di-mers in k-mer */
-	for(int i=0; i<kmer-1; i++) {
-		diseq[0] = kseq[i]; diseq[1] = kseq[i+1];
-		double count;
-		katss_get(dimer_counts, KATSS_DOUBLE, &count, diseq);
-		diprob *= count/dimer_counts->total;
-	}
-
-	/* Predicted k-mer probability is dinucleotides / overlapping monomers */
-	return diprob/monoprob;
-}
-
-
 KatssEnrichment
 katss_top_enrichment(KatssCounter *test, KatssCounter *control, bool normalize)
 {
@@ -440,7 +708,7 @@ katss_top_enrichment(KatssCounter *test, KatssCounter *control, bool normalize)
 		return top_kmer;
 	}
 
-	for(uint32_t i=0; i<control->capacity; i++) {
+	for(uint32_t i=0; i<=control->capacity; i++) {
 		/* Get frequencies of input and bound */
 		double test_frq, control_frq;
 		katss_get_from_hash(test, KATSS_DOUBLE, &test_frq, i);
@@ -489,20 +757,24 @@ katss_top_enrichment(KatssCounter *test, KatssCounter *control, bool normalize)
 
 
 KatssEnrichment
-katss_top_prediction(KatssCounter *test, KatssCounter *mono, KatssCounter *dint, bool normalize)
+katss_top_prediction(KatssCounter *test, KatssCounter *context, KatssCounter *words, bool normalize)
 {
 	KatssEnrichment top_kmer = {.enrichment = DBL_MIN};
 	double top_enrichment = DBL_MIN;
-	char kseq[17];
 
-	for(uint32_t i=0; i<=test->capacity; i++) {
-		katss_unhash(kseq, i, test->kmer, true);
+	/* Predict the frequencies of all k-mers at once */
+	double *freqs = s_malloc((((size_t)test->capacity)+1) * sizeof *freqs);
+	if(katss_predict_kmer_freqs(freqs, test->kmer, context, words) != 0) {
+		free(freqs);
+		return top_kmer;
+	}
 
+	for(uint32_t i=0; i<=test->capacity; i++) {
 		/* Get actual and predicted frequencies */
 		double kmer_frq, pred_frq;
 		katss_get_from_hash(test, KATSS_DOUBLE, &kmer_frq, i);
 		kmer_frq = kmer_frq / test->total;
-		pred_frq = predict_kmer(kseq, mono, dint);
+		pred_frq = freqs[i];
 
 		/* if input_frq is 0, then div by 0 error would occur so skip */
 		if(pred_frq == 0) {
@@ -520,6 +792,7 @@ katss_top_prediction(KatssCounter *test, KatssCounter *mono, KatssCounter *dint,
 			top_kmer.key = i;
 		}
 	}
+	free(freqs);
 
 	/* No top kmer was found (probs because something terrible happened) return empty struct */
 	if(top_enrichment == top_kmer.enrichment) {
@@ -0,0 +1,446 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "katss_core.h"
+#include "counter.h"
+#include "memory_utils.h"
+#include "expected_shuffle.h"
+
+/* Longest k-mer, and so most vertices a walk of k-lets visits */
+#define MAX_KMER 16
+#define LOCAL (MAX_KMER + 1)
+
+struct expected_shuffle {
+	unsigned int kmer;
+	int klet;
+	uint64_t num_kmers;
+	double *expected;        /* Expected count of every k-mer */
+
+	/* Graph of the run of nucleotides being added, cleared after it */
+	uint32_t vertex_mask;
+	uint32_t *edges;         /* Copies of every k-let not walked yet */
+	uint32_t *out;           /* Out-degree of every vertex not walked yet */
+	int *rows;               /* Row of every vertex in the reduced Laplacian, -1 if none */
+	uint32_t *vertices;      /* Vertex of every row */
+	double *laplacian;       /* Laplacian without the row and column of the last vertex */
+	double *inverse;         /* Its inverse */
+	int capacity;            /* Most rows the matrices fit */
+	int num_rows;
+	uint32_t end;            /* Last vertex of the run */
+
+	/* Walk of the k-mer being enumerated, and the rows of the Laplacian it changes */
+	int steps;               /* Number of k-lets in a k-mer */
+	uint32_t path[LOCAL];
+	double weight;
+	int *local_ids;          /* Index of every vertex among the rows of the walk, -1 if none */
+	uint32_t local[LOCAL];   /* Vertex of every row of the walk */
+	int num_local;
+	double change[LOCAL * LOCAL];        /* Change of every row of the walk */
+	double local_inverse[LOCAL * LOCAL]; /* Inverse restricted to the rows of the walk */
+
+	unsigned char *codes;
+	size_t codes_size;
+};
+
+static int
+nucleotide_code(char character)
+{
+	switch(character) {
+		case 'A': case 'a': return 0;
+		case 'C': case 'c': return 1;
+		case 'G': case 'g': return 2;
+		case 'T': case 't':
+		case 'U': case 'u': return 3;
+		default: return 4;
+	}
+}
+
+expected_shuffle *
+expected_shuffle_init(unsigned int kmer, int klet)
+{
+	if(kmer < 1 || kmer > KATSS_EXPECTED_MAX_KMER || klet < 1) {
+		error_message("katss: Expected shuffled counts need k-mers of 1-%d, not %u",
+		              KATSS_EXPECTED_MAX_KMER, kmer);
+		return NULL;
+	}
+	if(klet < (int)kmer && klet > KATSS_EXPECTED_MAX_KLET)
+		return NULL;
+
+	expected_shuffle *es = s_calloc(1, sizeof *es);
+	es->kmer = kmer;
+	es->klet = klet;
+	es->num_kmers = 1ULL << 2*kmer;
+	es->expected = s_calloc(es->num_kmers, sizeof *es->expected);
+
+	/* The k-mers of reads shuffled by longer k-lets are counted as they are */
+	if(klet < (int)kmer) {
+		uint64_t num_vertices = 1ULL << 2*(klet-1);
+		es->vertex_mask = (uint32_t)(num_vertices - 1);
+		es->steps = (int)kmer - klet + 1;
+		es->edges = s_calloc(num_vertices * 4, sizeof *es->edges);
+		es->out = s_calloc(num_vertices, sizeof *es->out);
+		es->rows = s_malloc(num_vertices * sizeof *es->rows);
+		es->local_ids = s_malloc(num_vertices * sizeof *es->local_ids);
+		for(uint64_t v = 0; v < num_vertices; v++)
+			es->rows[v] = es->local_ids[v] = -1;
+		es->vertices = s_malloc(num_vertices * sizeof *es->vertices);
+	}
+	return es;
+}
+
+void
+expected_shuffle_free(expected_shuffle *es)
+{
+	if(es == NULL)
+		return;
+	free(es->expected);
+	free(es->edges);
+	free(es->out);
+	free(es->rows);
+	free(es->local_ids);
+	free(es->vertices);
+	free(es->laplacian);
+	free(es->inverse);
+	free(es->codes);
+	free(es);
+}
+
+/*==================================================================================================
+|                                          Linear algebra                                          |
+==================================================================================================*/
+/* Determinant of the n by n matrix a, which is overwritten */
+static double
+determinant(double *a, int n)
+{
+	double det = 1.0;
+	for(int c = 0; c < n; c++) {
+		int pivot = c;
+		for(int r = c + 1; r < n; r++)
+			if(fabs(a[r*n + c]) > fabs(a[pivot*n + c]))
+				pivot = r;
+		if(a[pivot*n + c] == 0)
+			return 0;
+		if(pivot != c) {
+			for(int j = c; j < n; j++) {
+				double tmp = a[c*n + j];
+				a[c*n + j] = a[pivot*n + j];
+				a[pivot*n + j] = tmp;
+			}
+			det = -det;
+		}
+		det *= a[c*n + c];
+		for(int r = c + 1; r < n; r++) {
+			double f = a[r*n + c] / a[c*n + c];
+			for(int j = c + 1; j < n; j++)
+				a[r*n + j] -= f * a[c*n + j];
+		}
+	}
+	return det;
+}
+
+/* Invert the n by n matrix a into inv by Gauss-Jordan elimination. a is overwritten */
+static void
+invert(double *a, double *inv, int n)
+{
+	for(int i = 0; i < n; i++)
+		for(int j = 0; j < n; j++)
+			inv[i*n + j] = i == j;
+
+	for(int c = 0; c < n; c++) {
+		int pivot = c;
+		for(int r = c + 1; r < n; r++)
+			if(fabs(a[r*n + c]) > fabs(a[pivot*n + c]))
+				pivot = r;
+		if(pivot != c) {
+			for(int j = 0; j < n; j++) {
+				double tmp = a[c*n + j];
+				a[c*n + j] = a[pivot*n + j];
+				a[pivot*n + j] = tmp;
+				tmp = inv[c*n + j];
+				inv[c*n + j] = inv[pivot*n + j];
+				inv[pivot*n + j] = tmp;
+			}
+		}
+		double scale = 1.0 / a[c*n + c];
+		for(int j = 0; j < n; j++) {
+			a[c*n + j] *= scale;
+			inv[c*n + j] *= scale;
+		}
+		for(int r = 0; r < n; r++) {
+			double f = a[r*n + c];
+			if(r == c || f == 0)
+				continue;
+			for(int j = 0; j < n; j++) {
+				a[r*n + j] -= f * a[c*n + j];
+				inv[r*n + j] -= f * inv[c*n + j];
+			}
+		}
+	}
+}
+
+/*==================================================================================================
+|                                     Counting Eulerian trails                                     |
+==================================================================================================*/
+/**
+ * By the BEST theorem, the number of trails of the graph from its first vertex s to its last t,
+ * as sequences, is
+ *
+ *   tau_t * out(t)! * prod_{v != t} (out(v) - 1)! / prod_e copies(e)!
+ *
+ * where tau_t is the number of spanning trees directed towards t, the determinant of the
+ * Laplacian without the row and column of t (and of the vertices without edges). A k-mer is
+ * a walk of k-lets; replacing the walk by one new edge gives a graph whose trails are the
+ * shuffles with that k-mer at a marked position. Their ratio, the expected count, is built up
+ * while the walk is enumerated: every k-let walked multiplies it by its copies left over the
+ * factorial ratio of its vertex's out-degree, and the new edge by the factorial ratio back.
+ */
+
+/* Add a vertex of the walk to the rows it changes, with its entries of the inverse */
+static bool
+push_vertex(expected_shuffle *es, uint32_t vertex)
+{
+	if(vertex == es->end || es->local_ids[vertex] >= 0)
+		return false;
+	int id = es->num_local++;
+	es->local_ids[vertex] = id;
+	es->local[id] = vertex;
+
+	int size = es->num_rows, row = es->rows[vertex];
+	for(int q = 0; q <= id; q++) {
+		int other = es->rows[es->local[q]];
+		es->local_inverse[id*LOCAL + q] = es->inverse[row*size + other];
+		es->local_inverse[q*LOCAL + id] = es->inverse[other*size + row];
+	}
+	return true;
+}
+
+static void
+pop_vertex(expected_shuffle *es)
+{
+	es->local_ids[es->local[--es->num_local]] = -1;
+}
+
+/* Change the row of u of the Laplacian by removing `copies` edges from u to v */
+static void
+remove_edge(expected_shuffle *es, uint32_t u, uint32_t v, double copies)
+{
+	if(u == es->end || u == v)
+		return;
+	int row = es->local_ids[u];
+	es->change[row*LOCAL + row] -= copies;
+	if(v != es->end)
+		es->change[row*LOCAL + es->local_ids[v]] += copies;
+}
+
+/**
+ * The ratio of tau_t once the walk is replaced by its edge. The Laplacian only changes in the
+ * rows of the vertices the walk leaves, so the determinant lemma gives the ratio as the
+ * determinant of a matrix of those rows, from the inverse of the read's Laplacian.
+ */
+static double
+trees_ratio(expected_shuffle *es)
+{
+	double lemma[LOCAL * LOCAL];
+	int active[LOCAL];
+	int n = es->num_local;
+	uint32_t first = es->path[0];
+
+	/* The walk's edge joins the first row, and rows without edges are left out */
+	remove_edge(es, first, es->path[es->steps], -1);
+	for(int i = 0; i < n; i++)
+		if(es->out[es->local[i]] == 0 && es->local[i] != first)
+			es->change[i*LOCAL + i] += 1;
+
+	/* det(I + change * inverse), over the rows that change */
+	int r = 0;
+	for(int i = 0; i < n; i++) {
+		for(int q = 0; q < n; q++) {
+			if(es->change[i*LOCAL + q] != 0) {
+				active[r++] = i;
+				break;
+			}
+		}
+	}
+	for(int a = 0; a < r; a++) {
+		const double *change = es->change + active[a]*LOCAL;
+		for(int b = 0; b < r; b++) {
+			double sum = a == b;
+			for(int q = 0; q < n; q++)
+				sum += change[q] * es->local_inverse[q*LOCAL + active[b]];
+			lemma[a*r + b] = sum;
+		}
+	}
+	double ratio = determinant(lemma, r);
+
+	remove_edge(es, first, es->path[es->steps], 1);
+	for(int i = 0; i < n; i++)
+		if(es->out[es->local[i]] == 0 && es->local[i] != first)
+			es->change[i*LOCAL + i] -= 1;
+	return MAX2(ratio, 0.0);
+}
+
+static void
+walk(expected_shuffle *es, int step, uint32_t hash, double ratio)
+{
+	uint32_t vertex = es->path[step];
+	if(step == es->steps) {
+		/* The walk's edge leaves from its first vertex */
+		uint32_t first = es->path[0];
+		uint32_t left = es->out[first];
+		ratio *= first == es->end ? left + 1 : MAX2(left, 1);
+		es->expected[hash] += es->weight * ratio * trees_ratio(es);
+		return;
+	}
+
+	uint32_t left = es->out[vertex];
+	if(left == 0)
+		return;
+	double degree = vertex == es->end ? left : MAX2(left - 1, 1);
+	for(uint32_t nt = 0; nt < 4; nt++) {
+		uint32_t edge = (vertex << 2) | nt;
+		uint32_t copies = es->edges[edge];
+		if(copies == 0)
+			continue;
+		uint32_t next = edge & es->vertex_mask;
+		es->edges[edge]--;
+		es->out[vertex]--;
+		es->path[step + 1] = next;
+		bool pushed = push_vertex(es, next);
+		remove_edge(es, vertex, next, 1);
+		walk(es, step + 1, (hash << 2) | nt, ratio * copies / degree);
+		remove_edge(es, vertex, next, -1);
+		if(pushed)
+			pop_vertex(es);
+		es->edges[edge]++;
+		es->out[vertex]++;
+	}
+}
+
+/* Add the expected counts of the shuffles of a run of nucleotide codes */
+static void
+add_run(expected_shuffle *es, const unsigned char *codes, size_t length)
+{
+	int klet = es->klet;
+	if(length < es->kmer)
+		return;
+
+	/* Shuffles keep the k-mers no longer than their k-lets, and reads no longer than them */
+	if(klet >= (int)es->kmer || length <= (size_t)klet) {
+		uint32_t mask = (uint32_t)(es->num_kmers - 1);
+		uint32_t hash = 0;
+		for(size_t i = 0; i < length; i++) {
+			hash = ((hash << 2) | codes[i]) & mask;
+			if(i + 1 >= es->kmer)
+				es->expected[hash] += es->weight;
+		}
+		return;
+	}
+
+	/* Graph of the run */
+	uint32_t edge_mask = (es->vertex_mask << 2) | 3;
+	uint32_t edge = 0;
+	for(int i = 0; i < klet - 1; i++)
+		edge = (edge << 2) | codes[i];
+	for(size_t i = klet - 1; i < length; i++) {
+		edge = ((edge << 2) | codes[i]) & edge_mask;
+		es->edges[edge]++;
+		es->out[edge >> 2]++;
+	}
+	es->end = edge & es->vertex_mask;
+
+	/* Rows of the reduced Laplacian: every vertex with edges but the last one */
+	int n = 0;
+	for(size_t i = 0; i + klet <= length; i++) {
+		uint32_t vertex = 0;
+		for(int j = 0; j < klet - 1; j++)
+			vertex = (vertex << 2) | codes[i + j];
+		if(vertex != es->end && es->rows[vertex] < 0) {
+			es->rows[vertex] = n;
+			es->vertices[n++] = vertex;
+		}
+	}
+	if(n > es->capacity) {
+		es->capacity = n;
+		free(es->laplacian);
+		free(es->inverse);
+		es->laplacian = s_malloc((size_t)n * n * sizeof *es->laplacian);
+		es->inverse = s_malloc((size_t)n * n * sizeof *es->inverse);
+	}
+	es->num_rows = n;
+	if(n > 0)
+		memset(es->laplacian, 0, (size_t)n * n * sizeof *es->laplacian);
+	for(int r = 0; r < n; r++) {
+		uint32_t v = es->vertices[r];
+		for(uint32_t nt = 0; nt < 4; nt++) {
+			uint32_t next = ((v << 2) | nt) & es->vertex_mask;
+			double copies = es->edges[(v << 2) | nt];
+			if(copies == 0 || next == v)
+				continue;
+			es->laplacian[r*n + r] += copies;
+			if(next != es->end)
+				es->laplacian[r*n + es->rows[next]] -= copies;
+		}
+	}
+	if(n > 0)
+		invert(es->laplacian, es->inverse, n);
+
+	/* Walk every k-mer from every vertex */
+	for(int r = 0; r <= n; r++) {
+		uint32_t vertex = r < n ? es->vertices[r] : es->end;
+		es->path[0] = vertex;
+		bool pushed = push_vertex(es, vertex);
+		walk(es, 0, vertex, 1.0);
+		if(pushed)
+			pop_vertex(es);
+	}
+
+	/* Clear the graph */
+	for(int r = 0; r < n; r++)
+		es->rows[es->vertices[r]] = -1;
+	for(size_t i = klet - 1; i < length; i++) {
+		edge = 0;
+		for(int j = klet - 1; j >= 0; j--)
+			edge = (edge << 2) | codes[i - j];
+		es->edges[edge] = 0;
+		es->out[edge >> 2] = 0;
+	}
+}
+
+void
+expected_shuffle_add(expected_shuffle *es, const char *seq, size_t length, double weight)
+{
+	if(length > es->codes_size) {
+		free(es->codes);
+		es->codes_size = length;
+		es->codes = s_malloc(length);
+	}
+	es->weight = weight;
+
+	size_t run = 0;
+	for(size_t i = 0; i <= length; i++) {
+		int code = i < length ? nucleotide_code(seq[i]) : 4;
+		if(code < 4) {
+			es->codes[run++] = (unsigned char)code;
+			continue;
+		}
+		add_run(es, es->codes, run);
+		run = 0;
+	}
+}
+
+void
+expected_shuffle_flush(expected_shuffle *es, KatssCounter *counter)
+{
+	for(uint64_t h = 0; h < es->num_kmers; h++) {
+		uint64_t count = (uint64_t)llround(es->expected[h] * KATSS_EXPECTED_SCALE);
+		es->expected[h] = 0;
+		if(counter->kmer <= 12)
+			counter->table.small[h] += count;
+		else
+			counter->table.medium[h] += (uint32_t)count;
+		counter->total += count;
+	}
+}
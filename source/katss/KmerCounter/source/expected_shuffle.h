@@ -0,0 +1,58 @@
+#ifndef KATSS_EXPECTED_SHUFFLE_H
+#define KATSS_EXPECTED_SHUFFLE_H
+
+#include <stddef.h>
+
+#include "counter.h"
+
+/* Longest k-let whose shuffles have their expected counts computed, as the graph of a read has
+   4^(klet-1) vertices */
+#define KATSS_EXPECTED_MAX_KLET 8
+
+/* Longest k-mer whose expected shuffled counts are added up, as the 32-bit counters of longer
+   k-mers would overflow with counts in units of 1/KATSS_EXPECTED_SCALE */
+#define KATSS_EXPECTED_MAX_KMER 12
+
+typedef struct expected_shuffle expected_shuffle;
+
+/**
+ * @brief Start adding up the expected k-mer counts of shuffled reads.
+ *
+ * @param kmer Length of the k-mers to count, at most KATSS_EXPECTED_MAX_KMER
+ * @param klet Length of the k-lets the shuffles preserve, at most KATSS_EXPECTED_MAX_KLET when
+ * it is shorter than kmer
+ * @return expected_shuffle* Empty expectations, NULL if kmer or klet is out of range
+ */
+expected_shuffle *expected_shuffle_init(unsigned int kmer, int klet);
+
+
+/**
+ * @brief Free the expectations.
+ */
+void expected_shuffle_free(expected_shuffle *es);
+
+
+/**
+ * @brief Add the number of times every k-mer is expected to be in a uniformly random shuffle of
+ * a read preserving its k-let counts, as uShuffle draws them.
+ *
+ * The shuffles of a read are the Eulerian trails of its graph of (klet-1)-mers, whose edges are
+ * its k-lets, from its first (klet-1)-mer to its last. The expected count of a k-mer is the
+ * number of trails of the graph in which its k-lets are replaced by a single edge, over the
+ * number of trails of the read's graph, both counted with the BEST theorem. Every run of
+ * nucleotides between other characters is shuffled on its own.
+ *
+ * @param es     Expectations to add to
+ * @param seq    Read to shuffle
+ * @param length Length of the read
+ * @param weight Number of copies of the read
+ */
+void expected_shuffle_add(expected_shuffle *es, const char *seq, size_t length, double weight);
+
+
+/**
+ * @brief Add the expectations to a counter, in units of 1/KATSS_EXPECTED_SCALE, and clear them.
+ */
+void expected_shuffle_flush(expected_shuffle *es, KatssCounter *counter);
+
+#endif // KATSS_EXPECTED_SHUFFLE_H
@@ -80,6 +80,16 @@ katss_set_seq(KatssHasher *hasher, char *sequence, char filetype)
 }
 
 
+void
+katss_set_read(KatssHasher *hasher, char *sequence, char filetype)
+{
+	hasher->has_previous = false;
+	hasher->previous_hash = 0;
+	hasher->pos = 0;
+	katss_set_seq(hasher, sequence, filetype);
+}
+
+
 void
 katss_unhash(char *key, uint32_t hash_value, unsigned int kmer, bool use_t) 
 {
@@ -7,6 +7,8 @@
 #include "memory_utils.h"
 
 #include "counter.h"
+#include "katss_jobs.h"
+#include "thread_safe_rand.h"
 #include "ushuffle.h"
 
 static int
@@ -97,94 +99,115 @@ ushuffle(const char *path, KatssOptions *opts)
 	return counts;
 }
 
+/* Counts of one bootstrap replicate, counted from a seed of its own */
+struct replicate {
+	const char *path;
+	const KatssOptions *opts;
+	bool shuffle;
+	unsigned int seed;
+	KatssCounter *counts;
+};
+
+/* Replicates of a bootstrap, and the mean of the counts of those added so far */
+struct bootstrap_run {
+	const char *path;
+	const KatssOptions *opts;
+	bool shuffle;
+	struct replicate *reps;   /* Replicate counted in every slot */
+	KatssData *counts;
+	bool failed;
+};
+
+static int
+count_replicate(void *arg, int index, int slot, int threads)
+{
+	struct bootstrap_run *run = (struct bootstrap_run *)arg;
+	struct replicate *rep = &run->reps[slot];
+	*rep = (struct replicate){.path = run->path, .opts = run->opts, .shuffle = run->shuffle};
+	rep->seed = rand_replicate_seed(run->opts->seed, index);
+
+	unsigned int kmer = rep->opts->kmer;
+	int sample        = rep->opts->bootstrap_sample;
+	if(rep->shuffle)
+		rep->counts = katss_count_kmers_ushuffle_bootstrap(rep->path, kmer,
+		                                                   rep->opts->probs_ntprec, 1, sample,
+		                                                   &rep->seed);
+	else
+		rep->counts = katss_count_kmers_bootstrap_mt(rep->path, kmer, sample, &rep->seed,
+		                                             threads);
+	return rep->counts == NULL;
+}
+
+/* Move the counts of a replicate to the mean, unless a replicate before it failed */
+static int
+add_replicate(void *arg, int index, int slot, int status)
+{
+	struct bootstrap_run *run = (struct bootstrap_run *)arg;
+	struct replicate *rep = &run->reps[slot];
+	KatssData *counts = run->counts;
+
+	if(status != 0) {
+		error_message("katss_count: Failed to get counts on iteration=(%d)", index + 1);
+		run->failed = true;
+	}
+	float count;
+	for(uint64_t i=0; !run->failed && i<counts->num_kmers; i++) {
+		counts->kmers[i].kmer = (uint32_t)i;
+		katss_get_from_hash(rep->counts, KATSS_FLOAT, &count, (uint32_t)i);
+		running_stdev(count, &counts->kmers[i].rval, &counts->kmers[i].stdev, index + 1);
+	}
+	katss_free_counter(rep->counts);
+	rep->counts = NULL;
+	return run->failed;
+}
+
+/**
+ * @brief Count the bootstrap replicates, each from a seed of its own. Up to
+ * `opts->threads` replicates are counted at a time, fewer if their counters
+ * don't fit in `dedup_memory` together, sharing the threads. The counts are
+ * added to the mean in the order of the replicates, so they are the same for
+ * any number of threads.
+ */
 static KatssData *
-bootstrap_regular(const char *path, KatssOptions *opts)
+bootstrap(const char *path, KatssOptions *opts, bool shuffle)
 {
 	KatssData *counts = katss_init_kdata(opts->kmer);
 	if(counts == NULL)
 		return NULL;
-	KatssCounter *ctr = NULL;
-	unsigned int seed = opts->seed;
-	unsigned int kmer = opts->kmer;
-	int sample        = opts->bootstrap_sample;
-	int threads       = opts->threads;
-
-	/* Process n number of iterations */
-	for(int i=1; i<=opts->bootstrap_iters; i++) {
-		/* Compute counts */
-		ctr = katss_count_kmers_bootstrap_mt(path, kmer, sample, &seed, threads);
-		if(ctr == NULL) {
-			error_message("katss_count: Failed to get counts on iteration=(%d)", i);
-			katss_free_kdata(counts);
-			return NULL;
-		}
-
-		/* Move counts to KatssData */
-		float count;
-		for(uint64_t n=0; n<counts->num_kmers; n++) {
-			counts->kmers[n].kmer = (uint32_t)n;
-			if(katss_get_from_hash(ctr, KATSS_FLOAT, &count, (uint32_t)n) != 0)
-				goto error;
-			running_stdev(count, &counts->kmers[n].rval, &counts->kmers[n].stdev, i);
-		}
-
-		/* Free data */
-		katss_free_counter(ctr);
+	int iters = opts->bootstrap_iters;
+	int slots = MIN2(MAX2(opts->threads, 1), MAX2(iters, 1));
+	size_t memory = ((size_t)MAX2(opts->dedup_memory, 1) << 20) / katss_counter_size(opts->kmer);
+	slots = (int)MAX2(MIN2((size_t)slots, memory), 1);
+
+	struct bootstrap_run run = {.path = path, .opts = opts, .shuffle = shuffle, .counts = counts};
+	run.reps = s_malloc(slots * sizeof *run.reps);
+	katss_run_ordered(iters, slots, opts->threads, count_replicate, add_replicate, &run);
+	free(run.reps);
+	if(run.failed) {
+		katss_free_kdata(counts);
+		return NULL;
 	}
 
+	counts->bootstrap_iters = iters;
+
 	/* Finish computing stdev */
-	if(opts->bootstrap_iters > 1)
+	if(iters > 1)
 		for(uint64_t i=0; i<counts->num_kmers; i++)
-			counts->kmers[i].stdev = sqrt(counts->kmers[i].stdev / (opts->bootstrap_iters - 1));
+			counts->kmers[i].stdev = sqrt(counts->kmers[i].stdev / (iters - 1));
 
 	return counts;
+}
 
-error:
-	katss_free_counter(ctr);
-	katss_free_kdata(counts);
-	return NULL;
+static KatssData *
+bootstrap_regular(const char *path, KatssOptions *opts)
+{
+	return bootstrap(path, opts, false);
 }
 
 static KatssData *
 bootstrap_ushuffle(const char *path, KatssOptions *opts)
 {
-	KatssData *counts = katss_init_kdata(opts->kmer);
-	if(counts == NULL)
-		return NULL;
-	KatssCounter *ctr;
-	unsigned int seed = opts->seed;
-	unsigned int kmer = opts->kmer;
-	int klet          = opts->probs_ntprec;
-	int sample        = opts->bootstrap_sample;
-
-	/* Process n number of iterations */
-	for(int i=1; i<=opts->bootstrap_iters; i++) {
-		/* Compute counts */
-		ctr = katss_count_kmers_ushuffle_bootstrap(path, kmer, klet, sample, &seed);
-		if(ctr == NULL) {
-			error_message("katss_count: Failed to get counts on iteration=(%d)", i);
-			katss_free_kdata(counts);
-			return NULL;
-		}
-		
-		/* Move counts to KatssData */
-		float count;
-		for(uint64_t n=0; n<counts->num_kmers; n++) {
-			counts->kmers[n].kmer = (uint32_t)n;
-			katss_get_from_hash(ctr, KATSS_FLOAT, &count, (uint32_t)n);
-			running_stdev(count, &counts->kmers[n].rval, &counts->kmers[n].stdev, i);
-		}
-
-		/* Free data */
-		katss_free_counter(ctr);
-	}
-
-	/* Finish computing stdev */
-	for(uint64_t n=0; n<counts->num_kmers; n++) {
-		counts->kmers[n].stdev = sqrt(counts->kmers[n].stdev / (opts->bootstrap_iters - 1));
-	}
-
-	return counts;
+	return bootstrap(path, opts, true);
 }
 
 KatssData *
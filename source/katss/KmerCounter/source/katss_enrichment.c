@@ -1,5 +1,8 @@
 #include <stddef.h>
 #include <stdlib.h>
+#ifdef _WIN32
+#define _USE_MATH_DEFINES
+#endif
 #include <math.h>
 
 #include "katss.h"
@@ -8,7 +11,10 @@
 #include "memory_utils.h"
 
 #include "enrichments.h"
+#include "count_jobs.h"
 #include "t_test.h"
+#include "binom_test.h"
+#include "thread_safe_rand.h"
 
 static int
 compare(const void *a, const void *b)
@@ -33,6 +39,52 @@ compare(const void *a, const void *b)
 	}
 }
 
+/* Set up a job counting the distinct reads of a file if it was deduplicated, or the file,
+   trimmed as it is read if filter is not NULL */
+static void
+init_count_job(katss_job *job, count_job *count, katss_job_fn run, const char *file,
+               const KatssReadSet *reads, const KatssReadFilter *filter, unsigned int kmer)
+{
+	if(reads != NULL) {
+		count_job_init_reads(job, count, run, reads, kmer);
+	} else {
+		count_job_init(job, count, run, file, kmer);
+		count->filter = filter;
+	}
+}
+
+static KatssCounter *
+count_kmers(const char *file, const KatssReadSet *reads, unsigned int kmer, int threads)
+{
+	if(reads != NULL)
+		return katss_count_reads_mt(reads, kmer, threads);
+	return katss_count_kmers_mt(file, kmer, threads);
+}
+
+static KatssCounter *
+count_bootstrap(const char *file, const KatssReadSet *reads, unsigned int kmer, int sample,
+                unsigned int *seed, int threads)
+{
+	if(reads != NULL)
+		return katss_count_reads_bootstrap_mt(reads, kmer, sample, seed, threads);
+	return katss_count_kmers_bootstrap_mt(file, kmer, sample, seed, threads);
+}
+
+static KatssCounter *
+count_ushuffle(const char *file, const KatssReadSet *reads, unsigned int kmer,
+               const KatssOptions *opts, int sample, unsigned int *seed)
+{
+	int klet = opts->probs_ntprec;
+	if(opts->shuffle_expected && reads != NULL)
+		return katss_count_reads_ushuffle_expected_bootstrap(reads, kmer, klet, sample, seed);
+	if(opts->shuffle_expected)
+		return katss_count_kmers_ushuffle_expected_bootstrap(file, kmer, klet, sample, seed);
+	if(reads != NULL)
+		return katss_count_reads_ushuffle_bootstrap(reads, kmer, klet, opts->shuffles, sample,
+		                                            seed);
+	return katss_count_kmers_ushuffle_bootstrap(file, kmer, klet, opts->shuffles, sample, seed);
+}
+
 static void
 running_stdev(double value, double *mean, double *stdev, int run)
 {
@@ -41,6 +93,114 @@ running_stdev(double value, double *mean, double *stdev, int run)
 	*stdev += (value - tmp_mean) * (value - *mean);
 }
 
+/**
+ * @brief Fill the pval of every k-mer from a binomial test of its `x` counts out
+ * of `n` trials of probability `p`, with the dispersion of the whole table.
+ * 
+ * @return double Dispersion factor, to scale the variance of the enrichments
+ */
+static double
+analytic_pvals(KatssData *data, const double *x, const double *n, const double *p, int threads)
+{
+	double phi = binom_test_dispersion(x, n, p, data->num_kmers);
+	double *pval = s_malloc(data->num_kmers * sizeof *pval);
+	binom_test_batch(x, n, p, phi, pval, data->num_kmers, threads);
+	for(uint64_t i=0; i<data->num_kmers; i++)
+		data->kmers[i].pval = pval[i];
+	free(pval);
+	return phi;
+}
+
+/**
+ * @brief Standard deviation of an enrichment from the relative variance of its
+ * ratio, by the delta method.
+ */
+static float
+analytic_stdev(double ratio, double rel_var, double phi, bool normalize)
+{
+	double rel_stdev = sqrt(phi * rel_var);
+	return (float)(normalize ? rel_stdev / M_LN2 : ratio * rel_stdev);
+}
+
+/**
+ * @brief Compute the stdev and pval of test vs control enrichments from the
+ * counts. Given the sum of both counts of a k-mer, its test count is binomial
+ * with the share of the test k-mers as probability.
+ */
+static void
+analytic_regular(KatssData *data, KatssCounter *test, KatssCounter *ctrl, const KatssOptions *opts)
+{
+	uint64_t size = data->num_kmers;
+	double *x = s_malloc(size * sizeof *x);
+	double *n = s_malloc(size * sizeof *n);
+	double *p = s_malloc(size * sizeof *p);
+	double test_total = katss_get_total(test);
+	double ctrl_total = katss_get_total(ctrl);
+	double test_share = test_total / (test_total + ctrl_total);
+	for(uint64_t i=0; i<size; i++) {
+		double test_val, ctrl_val;
+		katss_get_from_hash(test, KATSS_DOUBLE, &test_val, data->kmers[i].kmer);
+		katss_get_from_hash(ctrl, KATSS_DOUBLE, &ctrl_val, data->kmers[i].kmer);
+		x[i] = test_val;
+		n[i] = test_val + ctrl_val;
+		p[i] = test_share;
+	}
+
+	double phi = analytic_pvals(data, x, n, p, opts->threads);
+	for(uint64_t i=0; i<size; i++) {
+		double ctrl_val = n[i] - x[i];
+		double ratio = (x[i] / test_total) / (ctrl_val / ctrl_total);
+		data->kmers[i].stdev = (x[i] == 0 || ctrl_val == 0) ? NAN :
+		    analytic_stdev(ratio, 1 / x[i] + 1 / ctrl_val, phi, opts->normalize);
+	}
+	free(x);
+	free(n);
+	free(p);
+}
+
+/**
+ * @brief Compute the stdev and pval of probabilistic enrichments from the
+ * counts. Every k-mer of the test file is the given k-mer with the probability
+ * the Markov model of the background predicts for it.
+ * 
+ * @return int 0 on success, 1 if the counts don't make a model
+ */
+static int
+analytic_probs(KatssData *data, KatssCounter *test, KatssCounter *context, KatssCounter *words,
+               const KatssOptions *opts)
+{
+	uint64_t size = data->num_kmers;
+	double *freqs = s_malloc(size * sizeof *freqs);
+	if(katss_predict_kmer_freqs(freqs, opts->kmer, context, words) != 0) {
+		error_message("katss_enrichment: Could not predict the k-mer frequencies of the background");
+		free(freqs);
+		return 1;
+	}
+
+	double *x = s_malloc(size * sizeof *x);
+	double *n = s_malloc(size * sizeof *n);
+	double *p = s_malloc(size * sizeof *p);
+	double test_total = katss_get_total(test);
+	for(uint64_t i=0; i<size; i++) {
+		katss_get_from_hash(test, KATSS_DOUBLE, &x[i], data->kmers[i].kmer);
+		n[i] = test_total;
+		p[i] = freqs[data->kmers[i].kmer];
+	}
+	free(freqs);
+
+	/* The variance of the counts comes from the model, not from the observed counts */
+	double phi = analytic_pvals(data, x, n, p, opts->threads);
+	for(uint64_t i=0; i<size; i++) {
+		double ratio = (x[i] / test_total) / p[i];
+		data->kmers[i].stdev = (x[i] == 0 || p[i] == 0) ? NAN :
+		    analytic_stdev(ratio, (1 - p[i]) / (test_total * p[i]), phi, opts->normalize);
+	}
+	free(x);
+	free(n);
+	free(p);
+	return 0;
+}
+
 /**
  * @brief Compute the enrichments of all kmers
  * 
@@ -50,15 +210,26 @@ running_stdev(double value, double *mean, double *stdev, int run)
  * @return KatssData* Data containing rval's
  */
 static KatssData *
-regular(const char *test, const char *ctrl, KatssOptions *opts)
+regular(const char *test, const char *ctrl, const KatssReadSet *test_reads,
+        const KatssReadSet *ctrl_reads, KatssOptions *opts)
 {
-	KatssEnrichments *enr;
+	KatssEnrichments *enr = NULL;
 	KatssData *enrichments;
 
-	/* Compute enrichments */
-	enr = katss_enrichments(test, ctrl, opts->kmer, opts->normalize);
-	if(enr == NULL)
+	/* Count the test and control files at the same time */
+	katss_job jobs[2];
+	count_job test_job, ctrl_job;
+	KatssReadFilter filter;
+	const KatssReadFilter *trim = katss_trim_filter(opts, &filter);
+	init_count_job(&jobs[0], &test_job, count_job_count, test, test_reads, trim, opts->kmer);
+	init_count_job(&jobs[1], &ctrl_job, count_job_count, ctrl, ctrl_reads, trim, opts->kmer);
+	if(katss_run_jobs(jobs, 2, opts->threads) == 0)
+		enr = katss_compute_enrichments(test_job.counts, ctrl_job.counts, opts->normalize);
+	if(enr == NULL) {
+		katss_free_counter(test_job.counts);
+		katss_free_counter(ctrl_job.counts);
 		return NULL;
+	}
 
 	/* Move enrichments to KatssData */
 	enrichments = katss_init_kdata(opts->kmer);
@@ -66,8 +237,12 @@ regular(const char *test, const char *ctrl, KatssOptions *opts)
 		enrichments->kmers[i].kmer = enr->enrichments[i].key;
 		enrichments->kmers[i].rval = (float)enr->enrichments[i].enrichment;
 	}
+	if(opts->analytic)
+		analytic_regular(enrichments, test_job.counts, ctrl_job.counts, opts);
 
 	/* Free data */
+	katss_free_counter(test_job.counts);
+	katss_free_counter(ctrl_job.counts);
 	katss_free_enrichments(enr);
 
 	return enrichments;
@@ -81,17 +256,28 @@ regular(const char *test, const char *ctrl, KatssOptions *opts)
  * @return KatssData* Data containing rval's
  */
 static KatssData *
-probs(const char *test, KatssOptions *opts)
+probs(const char *test, const KatssReadSet *reads, KatssOptions *opts)
 {
 	KatssEnrichments *enr = NULL;
 
-	/* Compute probabilistic enrichments */
-	enr = katss_prob_enrichments(test, opts->kmer, opts->normalize);
+	/* Count the k-mers, and the (m+1)-mers and m-mers of the background at the same time */
+	int order = opts->probs_order;
+	katss_job jobs[3];
+	count_job test_job, word_job, ctx_job;
+	KatssReadFilter filter;
+	const KatssReadFilter *trim = katss_trim_filter(opts, &filter);
+	init_count_job(&jobs[0], &test_job, count_job_count, test, reads, trim, opts->kmer);
+	init_count_job(&jobs[1], &word_job, count_job_count, test, reads, trim, order + 1);
+	init_count_job(&jobs[2], &ctx_job,  count_job_count, test, reads, trim, order);
+	if(katss_run_jobs(jobs, order > 0 ? 3 : 2, opts->threads) == 0)
+		enr = katss_compute_prob_enrichments(test_job.counts, ctx_job.counts, word_job.counts,
+		                                     opts->normalize);
+	KatssData *data = NULL;
 	if(enr == NULL)
-		return NULL;
+		goto exit;
 
 	/* Initialize kdata */
-	KatssData *data = katss_init_kdata(opts->kmer);
+	data = katss_init_kdata(opts->kmer);
 	if(data == NULL)
 		goto exit;
 	
@@ -100,8 +286,16 @@ probs(const char *test, KatssOptions *opts)
 		data->kmers[i].kmer = enr->enrichments[i].key;
 		data->kmers[i].rval = (float)enr->enrichments[i].enrichment;
 	}
+	if(opts->analytic && analytic_probs(data, test_job.counts, ctx_job.counts, word_job.counts,
+	                                    opts) != 0) {
+		katss_free_kdata(data);
+		data = NULL;
+	}
 
 exit:
+	katss_free_counter(test_job.counts);
+	katss_free_counter(word_job.counts);
+	katss_free_counter(ctx_job.counts);
 	katss_free_enrichments(enr);
 	return data;
 }
@@ -114,19 +308,18 @@ exit:
  * @return KatssData* Data containing rval's
  */
 static KatssData *
-ushuffle(const char *test, KatssOptions *opts)
+ushuffle(const char *test, const KatssReadSet *reads, KatssOptions *opts)
 {
 	KatssData *data = NULL;
 	KatssEnrichments *enr = NULL;
 	unsigned int kmer = opts->kmer;
-	int klet          = opts->probs_ntprec;
 	bool normalize    = opts->normalize;
 
 	/* Compute the counts */
-	KatssCounter *test_counts = katss_count_kmers(test, kmer);
+	KatssCounter *test_counts = count_kmers(test, reads, kmer, 1);
 	if(test_counts == NULL)
 		goto exit_error;
-	KatssCounter *shuf_counts = katss_count_kmers_ushuffle(test, kmer, klet);
+	KatssCounter *shuf_counts = count_ushuffle(test, reads, kmer, opts, 100000, NULL);
 	if(shuf_counts == NULL)
 		goto exit_error;
 
@@ -172,33 +365,41 @@ exit_error:
  * @return KatssData* Data containing rval's
  */
 static KatssData *
-both(const char *test, KatssOptions *opts)
+both(const char *test, const KatssReadSet *reads, KatssOptions *opts)
 {
 	KatssData *data = NULL;
 	KatssEnrichments *shuf = NULL;
 	KatssEnrichments *prob = NULL;
 	unsigned int kmer = opts->kmer;
-	int klet          = opts->probs_ntprec;
-
-	/* Compute the counts */	
-	KatssCounter *test_counts = katss_count_kmers_ushuffle(test, kmer, klet);
-	KatssCounter *mono_counts = katss_count_kmers_ushuffle(test, 1, klet);
-	KatssCounter *dint_counts = katss_count_kmers_ushuffle(test, 2, klet);
-	if(test_counts == NULL || mono_counts == NULL || dint_counts == NULL)
+	int order         = opts->probs_order;
+
+	/* Compute the counts, with no m-mers for a background of order 0 */	
+	KatssCounter *test_counts = count_ushuffle(test, reads, kmer, opts, 100000, NULL);
+	KatssCounter *word_counts = count_ushuffle(test, reads, order + 1, opts, 100000, NULL);
+	KatssCounter *ctx_counts  = order > 0 ? count_ushuffle(test, reads, order, opts, 100000, NULL)
+	                                      : NULL;
+	if(test_counts == NULL || word_counts == NULL || (order > 0 && ctx_counts == NULL))
 		goto exit_error;
 
 	/* Compute the enrichments */
-	shuf = katss_compute_prob_enrichments(test_counts, mono_counts, dint_counts, false);
+	shuf = katss_compute_prob_enrichments(test_counts, ctx_counts, word_counts, false);
 	if(shuf == NULL)
 		goto exit_error;
 
 	/* Free counters */
 	katss_free_counter(test_counts);
-	katss_free_counter(mono_counts);
-	katss_free_counter(dint_counts);
+	katss_free_counter(word_counts);
+	katss_free_counter(ctx_counts);
 
 	/* Compute the probabilistic enrichments */
-	prob = katss_prob_enrichments(test, kmer, false);
+	test_counts = count_kmers(test, reads, kmer, 1);
+	word_counts = count_kmers(test, reads, order + 1, 1);
+	ctx_counts  = order > 0 ? count_kmers(test, reads, order, 1) : NULL;
+	if(test_counts && word_counts && (order == 0 || ctx_counts))
+		prob = katss_compute_prob_enrichments(test_counts, ctx_counts, word_counts, false);
+	katss_free_counter(test_counts);
+	katss_free_counter(word_counts);
+	katss_free_counter(ctx_counts);
 	if(prob == NULL)
 		goto exit;
 
@@ -217,11 +418,384 @@ exit:
 
 exit_error:
 	katss_free_counter(test_counts);
-	katss_free_counter(mono_counts);
-	katss_free_counter(dint_counts);
+	katss_free_counter(word_counts);
+	katss_free_counter(ctx_counts);
 	return NULL;
 }
 
+/* Number of k-mers whose values are gathered before updating their statistics */
+#define BOOTSTRAP_BLOCK 4096
+
+/**
+ * @brief Statistics of every k-mer over the bootstrap iterations: the T-test of
+ * the test values against the control values, and the running mean and M2 of the
+ * enrichments. Each iteration fills the values of a block of k-mers at a time.
+ */
+struct bootstrap_stats {
+	uint64_t total;
+	t_test2_batch *ttest2;
+	double *rval_mean;
+	double *rval_M2;
+	double test[BOOTSTRAP_BLOCK];
+	double ctrl[BOOTSTRAP_BLOCK];
+	double rval[BOOTSTRAP_BLOCK];
+};
+
+static struct bootstrap_stats *
+bootstrap_stats_create(unsigned int kmer)
+{
+	struct bootstrap_stats *stats = s_malloc(sizeof *stats);
+	stats->total     = 1ULL << (2*kmer);
+	stats->ttest2    = t_test2_batch_create(stats->total);
+	stats->rval_mean = s_calloc(stats->total, sizeof *stats->rval_mean);
+	stats->rval_M2   = s_calloc(stats->total, sizeof *stats->rval_M2);
+	return stats;
+}
+
+static void
+bootstrap_stats_destroy(struct bootstrap_stats *stats)
+{
+	t_test2_batch_destroy(stats->ttest2);
+	free(stats->rval_mean);
+	free(stats->rval_M2);
+	free(stats);
+}
+
+/**
+ * @brief Add the values in the blocks of `stats` to the k-mers `start` to
+ * `start + n - 1`. NAN test or control values are left out of the T-test, and
+ * NAN enrichments of the mean if `skip_nan` is set.
+ */
+static void
+bootstrap_stats_update(struct bootstrap_stats *stats, uint64_t start, uint64_t n, int run,
+                       bool skip_nan)
+{
+	t_test2_batch_update(stats->ttest2, start, n, stats->test, stats->ctrl);
+
+	double *mean = stats->rval_mean + start;
+	double *M2   = stats->rval_M2 + start;
+	for(uint64_t k=0; k<n; k++) {
+		if(skip_nan && isnan(stats->rval[k]))
+			continue;
+		running_stdev(stats->rval[k], &mean[k], &M2[k], run);
+	}
+}
+
+/**
+ * @brief Move the mean enrichments, their standard deviation, and the p-values
+ * of the T-tests of `iters` replicates to KatssData, and destroy `stats`.
+ */
+static KatssData *
+bootstrap_stats_finalize(struct bootstrap_stats *stats, const KatssOptions *opts, int iters)
+{
+	KatssData *enrichments = katss_init_kdata(opts->kmer);
+	if(enrichments == NULL)
+		goto exit;
+	enrichments->bootstrap_iters = iters;
+
+	double *pval = s_malloc(stats->total * sizeof *pval);
+	t_test2_batch_finalize(stats->ttest2, pval, opts->threads);
+	for(uint64_t i=0; i<enrichments->num_kmers; i++) {
+		double rval = stats->rval_mean[i];
+		enrichments->kmers[i].kmer  = i;
+		enrichments->kmers[i].stdev = sqrt(stats->rval_M2[i] / (iters - 1));
+		enrichments->kmers[i].rval  = opts->normalize ? log2(rval) : rval;
+		enrichments->kmers[i].pval  = pval[i];
+	}
+	free(pval);
+
+exit:
+	bootstrap_stats_destroy(stats);
+	return enrichments;
+}
+
+/* Most enriched k-mers whose standard deviations have to converge */
+#define CONVERGE_TOP_KMERS 10
+
+/* Replicates in a row their standard deviations have to stay within the tolerance */
+#define CONVERGE_REPLICATES 3
+
+/**
+ * @brief Standard deviations of the most enriched k-mers after the last
+ * replicate, to stop the bootstrap once they stop changing.
+ */
+struct convergence {
+	double tolerance;                   /* Largest relative change of a converged stdev */
+	int stable;                         /* Replicates in a row within the tolerance */
+	int num_top;
+	uint64_t top[CONVERGE_TOP_KMERS];
+	double stdev[CONVERGE_TOP_KMERS];
+};
+
+/**
+ * @brief Check if the standard deviations of the most enriched k-mers after
+ * `run` replicates changed by less than the tolerance, relative to the last
+ * replicate, for CONVERGE_REPLICATES replicates in a row. The k-mers have to be
+ * the most enriched after both replicates.
+ */
+static bool
+bootstrap_converged(struct convergence *conv, const struct bootstrap_stats *stats, int run)
+{
+	/* Find the most enriched k-mers */
+	const double *mean = stats->rval_mean;
+	uint64_t top[CONVERGE_TOP_KMERS];
+	int num_top = 0;
+	for(uint64_t i=0; i<stats->total; i++) {
+		if(isnan(mean[i]))
+			continue;
+		if(num_top == CONVERGE_TOP_KMERS && mean[i] <= mean[top[num_top-1]])
+			continue;
+		int j = num_top < CONVERGE_TOP_KMERS ? num_top++ : num_top - 1;
+		for(; j > 0 && mean[top[j-1]] < mean[i]; j--)
+			top[j] = top[j-1];
+		top[j] = i;
+	}
+
+	/* Compare their standard deviations to the last ones */
+	bool within = run > 2 && num_top > 0 && num_top == conv->num_top;
+	double stdev[CONVERGE_TOP_KMERS];
+	for(int j=0; j<num_top; j++) {
+		stdev[j] = sqrt(stats->rval_M2[top[j]] / (run - 1));
+		int last = 0;
+		while(last < conv->num_top && conv->top[last] != top[j])
+			last++;
+		if(last == conv->num_top ||
+		   !(fabs(stdev[j] - conv->stdev[last]) <= conv->tolerance * conv->stdev[last]))
+			within = false;
+	}
+
+	conv->stable = within ? conv->stable + 1 : 0;
+	conv->num_top = num_top;
+	for(int j=0; j<num_top; j++) {
+		conv->top[j] = top[j];
+		conv->stdev[j] = stdev[j];
+	}
+	return conv->stable >= CONVERGE_REPLICATES;
+}
+
+/**
+ * @brief Input and counts of one bootstrap replicate.
+ * 
+ * Every replicate is counted by a job of its own, from a seed of its own. As
+ * many replicates as there are threads, and as fit in `dedup_memory`, are counted
+ * at the same time, sharing the threads, and their values are added to the
+ * statistics in the order of the replicates, so the results are the same for any
+ * number of threads.
+ */
+struct replicate {
+	const char *test;
+	const char *ctrl;
+	const KatssReadSet *test_reads;
+	const KatssReadSet *ctrl_reads;
+	const KatssOptions *opts;
+	unsigned int seed;
+	KatssCounter *counts[3];
+	double *freqs;
+	KatssEnrichments *prob;
+	KatssEnrichments *shuf;
+};
+
+/* Fill the values of the k-mers `start` to `start + n - 1` from a replicate */
+typedef void (*replicate_fill_fn)(struct bootstrap_stats *stats, const struct replicate *rep,
+                                  uint64_t start, uint64_t n);
+
+static void
+free_replicate(struct replicate *rep)
+{
+	for(int i=0; i<3; i++) {
+		katss_free_counter(rep->counts[i]);
+		rep->counts[i] = NULL;
+	}
+	free(rep->freqs);
+	rep->freqs = NULL;
+	katss_free_enrichments(rep->prob);
+	katss_free_enrichments(rep->shuf);
+	rep->prob = rep->shuf = NULL;
+}
+
+/* Most bytes of the counters of the bootstrap replicates counted at the same time */
+static size_t
+bootstrap_memory(const KatssOptions *opts)
+{
+	return (size_t)MAX2(opts->dedup_memory, 1) << 20;
+}
+
+/* Bytes of a counter of a replicate, with the expected counts of its shuffles */
+static size_t
+counter_memory(const KatssOptions *opts, unsigned int kmer, bool shuffled)
+{
+	size_t size = katss_counter_size(kmer);
+	if(shuffled && opts->shuffle_expected && kmer > 0)
+		size += ((size_t)1 << 2*kmer) * sizeof(double);
+	return size;
+}
+
+/* Replicates of a bootstrap, and the statistics of those added so far */
+struct bootstrap_run {
+	const struct replicate *base;
+	katss_job_fn count;
+	replicate_fill_fn fill;
+	bool skip_nan;
+	struct replicate *reps;        /* Replicate counted in every slot */
+	struct bootstrap_stats *stats;
+	struct convergence conv;
+	bool converged;
+	bool failed;
+	int used;                      /* Replicates added to the statistics */
+};
+
+static int
+start_replicate(void *arg, int index, int slot, int threads)
+{
+	struct bootstrap_run *run = (struct bootstrap_run *)arg;
+	struct replicate *rep = &run->reps[slot];
+	*rep = *run->base;
+	rep->seed = rand_replicate_seed(rep->opts->seed, index);
+	return run->count(rep, threads);
+}
+
+/* Add a replicate to the statistics, unless the bootstrap converged or failed before it */
+static int
+add_replicate(void *arg, int index, int slot, int status)
+{
+	struct bootstrap_run *run = (struct bootstrap_run *)arg;
+	struct bootstrap_stats *stats = run->stats;
+	struct replicate *rep = &run->reps[slot];
+	(void)index;
+
+	if(status != 0)
+		run->failed = true;
+	if(!run->failed && !run->converged) {
+		run->used++;
+		for(uint64_t start=0; start<stats->total; start+=BOOTSTRAP_BLOCK) {
+			uint64_t size = MIN2(BOOTSTRAP_BLOCK, stats->total - start);
+			run->fill(stats, rep, start, size);
+			bootstrap_stats_update(stats, start, size, run->used, run->skip_nan);
+		}
+		if(run->conv.tolerance > 0)
+			run->converged = bootstrap_converged(&run->conv, stats, run->used);
+	}
+	free_replicate(rep);
+	return run->failed || run->converged;
+}
+
+/**
+ * @brief Run the bootstrap replicates and compute the enrichments from their
+ * statistics.
+ * 
+ * Up to `opts->threads` replicates are counted at a time, fewer if their
+ * counters don't fit in `dedup_memory` together, and the threads are split
+ * between them. A replicate starts as soon as another one is added, without
+ * waiting for the rest.
+ * 
+ * With a tolerance, the bootstrap stops once the top k-mers converged. This is
+ * checked after every replicate, in order, so it stops at the same replicate
+ * for any number of threads.
+ * 
+ * @param base     Input shared by all replicates
+ * @param count    Job counting a replicate, with the threads it is given
+ * @param fill     Fills the values of a block of k-mers from a replicate
+ * @param skip_nan Leave NAN enrichments out of their mean
+ * @param memory   Bytes taken up by the counts of a replicate
+ * @return KatssData* Data containing rval's, stdev, and pvalue
+ */
+static KatssData *
+bootstrap(const struct replicate *base, katss_job_fn count, replicate_fill_fn fill,
+          bool skip_nan, size_t memory)
+{
+	const KatssOptions *opts = base->opts;
+	int iters = opts->bootstrap_iters;
+	int slots = MIN2(MAX2(opts->threads, 1), MAX2(iters, 1));
+	if(memory > 0)
+		slots = (int)MAX2(MIN2((size_t)slots, bootstrap_memory(opts) / memory), 1);
+
+	struct bootstrap_run run = {
+		.base = base, .count = count, .fill = fill, .skip_nan = skip_nan,
+		.conv = {.tolerance = opts->bootstrap_tolerance},
+	};
+	run.reps = s_malloc(slots * sizeof *run.reps);
+	run.stats = bootstrap_stats_create(opts->kmer);
+	katss_run_ordered(iters, slots, opts->threads, start_replicate, add_replicate, &run);
+	free(run.reps);
+
+	if(run.failed) {
+		bootstrap_stats_destroy(run.stats);
+		return NULL;
+	}
+	return bootstrap_stats_finalize(run.stats, opts, run.used);
+}
+
+/* One counter of a replicate, sampled from the seed of the replicate, so that every counter
+   of a replicate samples the same reads */
+struct replicate_counter {
+	const char *file;
+	const KatssReadSet *reads;
+	const KatssOptions *opts;
+	unsigned int kmer;
+	bool shuffled;          /* Count the shuffled reads instead */
+	unsigned int seed;
+	KatssCounter *counts;
+};
+
+static int
+count_replicate_counter(void *arg, int threads)
+{
+	struct replicate_counter *counter = (struct replicate_counter *)arg;
+	const KatssOptions *opts = counter->opts;
+	if(counter->shuffled)
+		counter->counts = count_ushuffle(counter->file, counter->reads, counter->kmer, opts,
+		                                 opts->bootstrap_sample, &counter->seed);
+	else
+		counter->counts = count_bootstrap(counter->file, counter->reads, counter->kmer,
+		                                  opts->bootstrap_sample, &counter->seed, threads);
+	return counter->counts == NULL;
+}
+
+/**
+ * @brief Count the counters of a replicate at the same time, on the threads of the
+ * replicate, and move them to `counts`. Shuffled counters are counted on one thread.
+ * 
+ * @return int 0 if every counter was counted
+ */
+static int
+count_replicate_counters(struct replicate_counter *counters, int n, KatssCounter **counts,
+                         int threads)
+{
+	katss_job jobs[3];
+	for(int i=0; i<n; i++)
+		katss_job_init(&jobs[i], count_replicate_counter, &counters[i], 1);
+	int status = katss_run_jobs(jobs, n, threads);
+	for(int i=0; i<n; i++)
+		counts[i] = counters[i].counts;
+	return status;
+}
+
+static int
+count_replicate_regular(void *arg, int threads)
+{
+	struct replicate *rep = (struct replicate *)arg;
+	const KatssOptions *opts = rep->opts;
+	struct replicate_counter counters[2] = {
+		{rep->test, rep->test_reads, opts, opts->kmer, false, rep->seed, NULL},
+		{rep->ctrl, rep->ctrl_reads, opts, opts->kmer, false, rep->seed, NULL},
+	};
+	return count_replicate_counters(counters, 2, rep->counts, threads);
+}
+
+static void
+fill_regular(struct bootstrap_stats *stats, const struct replicate *rep, uint64_t start,
+             uint64_t n)
+{
+	for(uint64_t k=0; k<n; k++) {
+		double test_val = 0, ctrl_val = 0;
+		katss_get_from_hash(rep->counts[0], KATSS_DOUBLE, &test_val, (uint32_t)(start + k));
+		katss_get_from_hash(rep->counts[1], KATSS_DOUBLE, &ctrl_val, (uint32_t)(start + k));
+		stats->test[k] = test_val == 0 ? NAN : test_val;
+		stats->ctrl[k] = ctrl_val == 0 ? NAN : ctrl_val;
+		stats->rval[k] = stats->test[k] / stats->ctrl[k];
+	}
+}
+
 /**
  * @brief Compute the bootstrap enrichments of a dataset.
  * 
@@ -231,72 +805,53 @@ exit_error:
  * @return KatssData* Data containing rval's, stdev, and pvalue
  */
 static KatssData *
-bootstrap_regular(const char *test, const char *ctrl, KatssOptions *opts)
-{
-	KatssCounter *test_counts = NULL;
-	KatssCounter *ctrl_counts = NULL;
-	KatssData *enrichments    = NULL;
-	unsigned int seed         = opts->seed;
-	unsigned int kmer         = opts->kmer;
-	int sample                = opts->bootstrap_sample;
-	int threads               = opts->threads;
-
-	/* Create T-test aggregates */
-	uint64_t total = 1ULL << (2*opts->kmer);
-	t_test2_aggregate **ttest2 = s_malloc(sizeof *ttest2 * total);
-	for(uint64_t i=0; i<total; i++)
-		ttest2[i] = t_test2_create();
-
-	/* Compute bootstrap values */
-	double test_val, ctrl_val;
-	for(int i=0; i<opts->bootstrap_iters; i++) {
-		test_counts = katss_count_kmers_bootstrap_mt(test, kmer, sample, &seed, threads);
-		ctrl_counts = katss_count_kmers_bootstrap_mt(ctrl, kmer, sample, &seed, threads);
-		if(test_counts == NULL || ctrl_counts == NULL)
-			goto exit_error;
-
-		for(uint64_t k=0; k<total; k++) {
-			katss_get_from_hash(test_counts, KATSS_DOUBLE, &test_val, (uint32_t)k);
-			katss_get_from_hash(ctrl_counts, KATSS_DOUBLE, &ctrl_val, (uint32_t)k);
-			test_val = test_val == 0 ? NAN : test_val;
-			ctrl_val = ctrl_val == 0 ? NAN : ctrl_val;
-
-			/* Update the t-test aggregate */
-			t_test2_update(ttest2[k], test_val, ctrl_val);
-
-			/* Use unused df and pval to be able to store rval stdev */
-			if(!isnan(test_val) && !isnan(ctrl_val))
-				running_stdev(test_val/ctrl_val, &ttest2[k]->df, &ttest2[k]->pval, i+1);
-		}
-
-		/* Free the counters */
-		katss_free_counter(test_counts);
-		katss_free_counter(ctrl_counts);
-	}
+bootstrap_regular(const char *test, const char *ctrl, const KatssReadSet *test_reads,
+                  const KatssReadSet *ctrl_reads, KatssOptions *opts)
+{
+	struct replicate base = {
+		.test = test, .ctrl = ctrl, .test_reads = test_reads, .ctrl_reads = ctrl_reads,
+		.opts = opts,
+	};
+	size_t memory = 2 * counter_memory(opts, opts->kmer, false);
+	return bootstrap(&base, count_replicate_regular, fill_regular, true, memory);
+}
 
-	/* Finalize the bootstrap */
-	enrichments = katss_init_kdata(opts->kmer);
-	for(uint64_t i=0; i<enrichments->num_kmers; i++) {
-		enrichments->kmers[i].kmer = i;
-		enrichments->kmers[i].stdev = sqrt(ttest2[i]->pval / (opts->bootstrap_iters - 1));
-		enrichments->kmers[i].rval = opts->normalize ? log2(ttest2[i]->df) : ttest2[i]->df;
+static int
+count_replicate_probs(void *arg, int threads)
+{
+	struct replicate *rep = (struct replicate *)arg;
+	const KatssOptions *opts = rep->opts;
+	unsigned int kmer = opts->kmer;
 
-		t_test2_finalize(ttest2[i]);
-		enrichments->kmers[i].pval = ttest2[i]->pval;
-		t_test2_destroy(ttest2[i]);
-	}
+	/* Sub-sample the same reads for the k-mers, (m+1)-mers and m-mers */
+	int order = opts->probs_order;
+	struct replicate_counter counters[3] = {
+		{rep->test, rep->test_reads, opts, kmer,      false, rep->seed, NULL},
+		{rep->test, rep->test_reads, opts, order + 1, false, rep->seed, NULL},
+		{rep->test, rep->test_reads, opts, order,     false, rep->seed, NULL},
+	};
+	if(count_replicate_counters(counters, order > 0 ? 3 : 2, rep->counts, threads) != 0)
+		return 1;
 
-	/* Clean up and return */
-	free(ttest2);
-	return enrichments;
+	/* Predict the background of the replicate */
+	rep->freqs = s_malloc((1ULL << 2*kmer) * sizeof *rep->freqs);
+	return katss_predict_kmer_freqs(rep->freqs, kmer, rep->counts[2], rep->counts[1]);
+}
 
-exit_error:
-	katss_free_counter(test_counts);
-	katss_free_counter(ctrl_counts);
-	for(uint64_t i=0; i<total; i++)
-		t_test2_destroy(ttest2[i]);
-	free(ttest2);
-	return NULL;
+static void
+fill_probs(struct bootstrap_stats *stats, const struct replicate *rep, uint64_t start,
+           uint64_t n)
+{
+	double test_total = katss_get_total(rep->counts[0]);
+	for(uint64_t k=0; k<n; k++) {
+		uint32_t key = (uint32_t)(start + k);
+		double test_val = 0;
+		katss_get_from_hash(rep->counts[0], KATSS_DOUBLE, &test_val, key);
+		double freq = rep->freqs[key];
+		stats->test[k] = test_val;
+		stats->ctrl[k] = freq * test_total;
+		stats->rval[k] = (test_val / test_total) / freq;
+	}
 }
 
 /**
@@ -307,81 +862,42 @@ exit_error:
  * @return KatssData* Data containing rval's, stdev, and pvalue
  */
 static KatssData *
-bootstrap_probs(const char *test, KatssOptions *opts)
-{
-	KatssCounter *test_counts = NULL;
-	KatssCounter *mono_counts = NULL;
-	KatssCounter *dint_counts = NULL;
-	KatssData *enrichments    = NULL;
-	unsigned int kmer         = opts->kmer;
-	int sample                = opts->bootstrap_sample;
-	int threads               = opts->threads;
-	unsigned int seed1,seed2,seed3;
-	seed1 = seed2 = seed3 = opts->seed;
-
-	/* Create T-test aggregates */
-	uint64_t total = 1ULL << (2*opts->kmer);
-	t_test2_aggregate **ttest2 = s_malloc(sizeof *ttest2 * total);
-	for(uint64_t i=0; i<total; i++)
-		ttest2[i] = t_test2_create();
-
-	/* Compute bootstrap values */
-	double test_val;
-	for(int i=0; i<opts->bootstrap_iters; i++) {
-		test_counts = katss_count_kmers_bootstrap_mt(test, kmer, sample, &seed1, threads);
-		mono_counts = katss_count_kmers_bootstrap_mt(test, 1,    sample, &seed2, threads);
-		dint_counts = katss_count_kmers_bootstrap_mt(test, 2,    sample, &seed3, threads);
-		if(test_counts == NULL || mono_counts == NULL || dint_counts == NULL)
-			goto exit_error;
-
-		for(uint64_t k=0; k<total; k++) {
-			katss_get_from_hash(test_counts, KATSS_DOUBLE, &test_val, (uint32_t)k);
-			double ctrl_val = katss_predict_kmer_freq((uint32_t)k, kmer, mono_counts, dint_counts);
-			ctrl_val *= katss_get_total(test_counts);
-
-			/* Update the t-test aggregate */
-			t_test2_update(ttest2[k], test_val, ctrl_val);
-
-			/* Use unused df and pval to be able to store rval stdev */
-			test_val /= katss_get_total(test_counts); // normalize the test_val
-			ctrl_val = katss_predict_kmer_freq((uint32_t)k, kmer, mono_counts, dint_counts);
-			running_stdev(test_val/ctrl_val, &ttest2[k]->df, &ttest2[k]->pval, i+1);
-		}
-
-		/* Free the counters */
-		katss_free_counter(test_counts);
-		katss_free_counter(mono_counts);
-		katss_free_counter(dint_counts);
-	}
+bootstrap_probs(const char *test, const KatssReadSet *reads, KatssOptions *opts)
+{
+	struct replicate base = {.test = test, .test_reads = reads, .opts = opts};
+	int order = opts->probs_order;
+	size_t memory = counter_memory(opts, opts->kmer, false) +
+	                counter_memory(opts, order + 1, false) + counter_memory(opts, order, false) +
+	                ((size_t)1 << 2*opts->kmer) * sizeof(double);
+	return bootstrap(&base, count_replicate_probs, fill_probs, false, memory);
+}
 
-	/* Finalize the bootstrap */
-	enrichments = katss_init_kdata(opts->kmer);
-	for(uint64_t i=0; i<enrichments->num_kmers; i++) {
-		enrichments->kmers[i].kmer = i;
-		enrichments->kmers[i].stdev = sqrt(ttest2[i]->pval / (opts->bootstrap_iters - 1));
-		if(opts->normalize) {
-			enrichments->kmers[i].rval = log2(ttest2[i]->df); // df holds rval
-		} else {
-			enrichments->kmers[i].rval = ttest2[i]->df; // df holds rval
-		}
+static int
+count_replicate_ushuffle(void *arg, int threads)
+{
+	struct replicate *rep = (struct replicate *)arg;
+	const KatssOptions *opts = rep->opts;
+	struct replicate_counter counters[2] = {
+		{rep->test, rep->test_reads, opts, opts->kmer, false, rep->seed, NULL},
+		{rep->test, rep->test_reads, opts, opts->kmer, true,  rep->seed, NULL},
+	};
+	return count_replicate_counters(counters, 2, rep->counts, threads);
+}
 
-		t_test2_finalize(ttest2[i]);
-		enrichments->kmers[i].pval = ttest2[i]->pval;
-		t_test2_destroy(ttest2[i]);
+static void
+fill_ushuffle(struct bootstrap_stats *stats, const struct replicate *rep, uint64_t start,
+              uint64_t n)
+{
+	double test_total = katss_get_total(rep->counts[0]);
+	double shuf_total = katss_get_total(rep->counts[1]);
+	double shuf_unit  = rep->opts->shuffle_expected ? KATSS_EXPECTED_SCALE : rep->opts->shuffles;
+	for(uint64_t k=0; k<n; k++) {
+		/* Obtain the shuffled and actual counts for kmer k */
+		katss_get_from_hash(rep->counts[0], KATSS_DOUBLE, &stats->test[k], (uint32_t)(start + k));
+		katss_get_from_hash(rep->counts[1], KATSS_DOUBLE, &stats->ctrl[k], (uint32_t)(start + k));
+		stats->rval[k] = (stats->test[k] / test_total) / (stats->ctrl[k] / shuf_total);
+		stats->ctrl[k] /= shuf_unit;
 	}
-
-	/* Clean up and return */
-	free(ttest2);
-	return enrichments;
-
-exit_error:
-	katss_free_counter(test_counts);
-	katss_free_counter(mono_counts);
-	katss_free_counter(dint_counts);
-	for(uint64_t i=0; i<total; i++)
-		t_test2_destroy(ttest2[i]);
-	free(ttest2);
-	return NULL;
 }
 
 /**
@@ -392,82 +908,64 @@ exit_error:
  * @return KatssData* Data containing rval's, stdev, and pvalue
  */
 static KatssData *
-bootstrap_ushuffle(const char *test, KatssOptions *opts)
-{
-	KatssCounter *test_counts = NULL;
-	KatssCounter *shuf_counts = NULL;
-	KatssData *enrichments    = NULL;
-	unsigned int kmer         = opts->kmer;
-	int klet                  = opts->probs_ntprec;
-	int sample                = opts->bootstrap_sample;
-	bool normalize            = opts->normalize;
-	unsigned int seed1,seed2,seed3;
-	seed1 = seed2 = seed3 = opts->seed;
-
-	/* Create T-test aggregates */
-	uint64_t total = 1ULL << (2*opts->kmer);
-	t_test2_aggregate **ttest2 = s_malloc(sizeof *ttest2 * total);
-	for(uint64_t i=0; i<total; i++)
-		ttest2[i] = t_test2_create();
-
-	/* Compute bootstrap values */
-	for(int i=1; i<=opts->bootstrap_iters; i++) {
-		test_counts = katss_count_kmers_bootstrap(test, kmer, sample, &seed1);
-		if(test_counts == NULL)
-			goto exit_error;
-		shuf_counts = katss_count_kmers_ushuffle_bootstrap(test, kmer, klet, sample, &seed2);
-		if(shuf_counts == NULL)
-			goto exit_error;
-
-		/* Update the statistics for all kmers in this iteration */
-		for(uint64_t k=0; k<total; k++) {
-			/* Obtain the predicted and actual counts for kmer k */
-			double test_count, ctrl_count;
-			katss_get_from_hash(test_counts, KATSS_DOUBLE, &test_count, (uint32_t)k);
-			katss_get_from_hash(shuf_counts, KATSS_DOUBLE, &ctrl_count, (uint32_t)k);
-
-			/* Update the t-test aggregate */
-			t_test2_update(ttest2[k], test_count, ctrl_count);
-
-			/* Use unused df and pval to be able to store rval stdev */
-			test_count /= katss_get_total(test_counts);
-			ctrl_count /= katss_get_total(shuf_counts);
-			running_stdev(test_count/ctrl_count, &ttest2[k]->df, &ttest2[k]->pval, i);
-		}
+bootstrap_ushuffle(const char *test, const KatssReadSet *reads, KatssOptions *opts)
+{
+	struct replicate base = {.test = test, .test_reads = reads, .opts = opts};
+	size_t memory = counter_memory(opts, opts->kmer, false) + counter_memory(opts, opts->kmer, true);
+	return bootstrap(&base, count_replicate_ushuffle, fill_ushuffle, false, memory);
+}
 
-		/* Free the counters */
-		katss_free_counter(test_counts);
-		katss_free_counter(shuf_counts);
+static int
+count_replicate_both(void *arg, int threads)
+{
+	struct replicate *rep = (struct replicate *)arg;
+	const KatssOptions *opts = rep->opts;
+	KatssCounter **counts = rep->counts;
+	unsigned int kmer     = opts->kmer;
+	int order             = opts->probs_order;
+	struct replicate_counter shuffled[3] = {
+		{rep->test, rep->test_reads, opts, kmer,      true, rep->seed, NULL},
+		{rep->test, rep->test_reads, opts, order + 1, true, rep->seed, NULL},
+		{rep->test, rep->test_reads, opts, order,     true, rep->seed, NULL},
+	};
+	struct replicate_counter sampled[3] = {
+		{rep->test, rep->test_reads, opts, kmer,      false, rep->seed, NULL},
+		{rep->test, rep->test_reads, opts, order + 1, false, rep->seed, NULL},
+		{rep->test, rep->test_reads, opts, order,     false, rep->seed, NULL},
+	};
+
+	/* Compute probabilistic enrichments of shuffled counts */
+	if(count_replicate_counters(shuffled, order > 0 ? 3 : 2, counts, threads) != 0)
+		return 1;
+	rep->shuf = katss_compute_prob_enrichments(counts[0], counts[2], counts[1], false);
+	for(int i=0; i<3; i++) {
+		katss_free_counter(counts[i]);
+		counts[i] = NULL;
 	}
+	if(rep->shuf == NULL)
+		return 1;
 
-	/* Finalize the bootstrap */
-	enrichments = katss_init_kdata(opts->kmer);
-	for(uint64_t i=0; i<enrichments->num_kmers; i++) {
-		/* df currently holds the rval (due to running_stdev) */
-		double rval = ttest2[i]->df;
-		enrichments->kmers[i].rval = normalize ? log2(rval) : rval;
-		enrichments->kmers[i].kmer = i;
-		enrichments->kmers[i].stdev = sqrt(ttest2[i]->pval / (opts->bootstrap_iters - 1));
-
-		/* Finalize the t-test to get pvalue */
-		t_test2_finalize(ttest2[i]);
-		enrichments->kmers[i].pval = ttest2[i]->pval;
-		t_test2_destroy(ttest2[i]);
+	/* Compute probabilistic enrichment of dataset */
+	if(count_replicate_counters(sampled, order > 0 ? 3 : 2, counts, threads) != 0)
+		return 1;
+	rep->prob = katss_compute_prob_enrichments(counts[0], counts[2], counts[1], false);
+	for(int i=0; i<3; i++) {
+		katss_free_counter(counts[i]);
+		counts[i] = NULL;
 	}
-
-	/* Clean up and return */
-	free(ttest2);
-	return enrichments;
-
-exit_error:
-	katss_free_counter(test_counts);
-	katss_free_counter(shuf_counts);
-	for(uint64_t i=0; i<total; i++)
-		t_test2_destroy(ttest2[i]);
-	free(ttest2);
-	return NULL;
+	return rep->prob == NULL;
 }
 
+static void
+fill_both(struct bootstrap_stats *stats, const struct replicate *rep, uint64_t start,
+          uint64_t n)
+{
+	for(uint64_t k=0; k<n; k++) {
+		stats->test[k] = rep->prob->enrichments[start + k].enrichment;
+		stats->ctrl[k] = rep->shuf->enrichments[start + k].enrichment;
+		stats->rval[k] = stats->test[k] / stats->ctrl[k];
+	}
+}
 
 /**
  * @brief Compute the bootstraped enrichments using both shuffled and
@@ -486,104 +984,14 @@ exit_error:
  * @return KatssData* Data containing rval's, stdev, and pvalue
  */
 static KatssData *
-bootstrap_both(const char *test, KatssOptions *opts)
-{
-	KatssCounter *test_counts = NULL;
-	KatssCounter *mono_counts = NULL;
-	KatssCounter *dint_counts = NULL;
-	KatssEnrichments *shuf    = NULL;
-	KatssEnrichments *prob    = NULL;
-	KatssData *enrichments    = NULL;
-	unsigned int kmer         = opts->kmer;
-	int klet                  = opts->probs_ntprec;
-	int sample                = opts->bootstrap_sample;
-	int threads               = opts->threads;
-	unsigned int seed1,seed2,seed3,seed4,seed5,seed6;
-	seed1 = seed2 = seed3 = seed4 = seed5 = seed6 = opts->seed;
-
-	/* Create T-test aggregates */
-	uint64_t total = 1ULL << (2*opts->kmer);
-	t_test2_aggregate **ttest2 = s_malloc(sizeof *ttest2 * total);
-	for(uint64_t i=0; i<total; i++)
-		ttest2[i] = t_test2_create();
-
-	/* Compute bootstrap values */
-	for(int i=1; i<=opts->bootstrap_iters; i++) {
-		/* Get the shuffled counts */
-		test_counts = katss_count_kmers_ushuffle_bootstrap(test, kmer, klet, sample, &seed1);
-		mono_counts = katss_count_kmers_ushuffle_bootstrap(test, 1,    klet, sample, &seed2);
-		dint_counts = katss_count_kmers_ushuffle_bootstrap(test, 2,    klet, sample, &seed3);
-		if(test_counts == NULL || mono_counts == NULL || dint_counts == NULL)
-			goto exit_error;
-
-		/* Compute probabilistic enrichmenst of shuffled counts */
-		shuf = katss_compute_prob_enrichments(test_counts, mono_counts, dint_counts, false);
-		if(shuf == NULL)
-			goto exit_error;
-
-		katss_free_counter(test_counts);
-		katss_free_counter(mono_counts);
-		katss_free_counter(dint_counts);
-
-		/* Compute probabilistic enrichment of dataset */
-		test_counts = katss_count_kmers_bootstrap_mt(test, kmer, sample, &seed4, threads);
-		mono_counts = katss_count_kmers_bootstrap_mt(test, 1,    sample, &seed5, threads);
-		dint_counts = katss_count_kmers_bootstrap_mt(test, 2,    sample, &seed6, threads);
-		if(test_counts == NULL || mono_counts == NULL || dint_counts == NULL)
-			goto exit_error_probs;
-		prob = katss_compute_prob_enrichments(test_counts, mono_counts, dint_counts, false);
-		if(prob == NULL)
-			goto exit_error_probs;
-		katss_free_counter(test_counts);
-		katss_free_counter(mono_counts);
-		katss_free_counter(dint_counts);
-
-		/* Update the statistics for all kmers in this iteration */
-		for(uint64_t k=0; k<total; k++) {
-			/* Update the t-test aggregate */
-			double test_rval = prob->enrichments[k].enrichment;
-			double ctrl_rval = shuf->enrichments[k].enrichment;
-			t_test2_update(ttest2[k], test_rval, ctrl_rval);
-
-			/* Store the standard deviation for R value */
-			running_stdev(test_rval/ctrl_rval, &ttest2[k]->df, &ttest2[k]->pval, i);
-		}
-
-		/* Free the enrichments */
-		katss_free_enrichments(prob);
-		katss_free_enrichments(shuf);
-	}
-
-	/* Finalize the bootstrap */
-	enrichments = katss_init_kdata(opts->kmer);
-	for(uint64_t i=0; i<enrichments->num_kmers; i++) {
-		enrichments->kmers[i].kmer = i;
-		enrichments->kmers[i].stdev = sqrt(ttest2[i]->pval / (opts->bootstrap_iters - 1));
-		if(opts->normalize) {
-			enrichments->kmers[i].rval = log2(ttest2[i]->df);
-		} else {
-			enrichments->kmers[i].rval = ttest2[i]->df; // df holds rval currently
-		} 
-
-		t_test2_finalize(ttest2[i]);
-		enrichments->kmers[i].pval = ttest2[i]->pval;
-		t_test2_destroy(ttest2[i]);
-	}
-
-	/* Clean up and return */
-	free(ttest2);
-	return enrichments;
-
-exit_error_probs:
-	katss_free_enrichments(shuf);
-exit_error:
-	katss_free_counter(test_counts);
-	katss_free_counter(mono_counts);
-	katss_free_counter(dint_counts);
-	for(uint64_t i=0; i<total; i++)
-		t_test2_destroy(ttest2[i]);
-	free(ttest2);
-	return NULL;
+bootstrap_both(const char *test, const KatssReadSet *reads, KatssOptions *opts)
+{
+	struct replicate base = {.test = test, .test_reads = reads, .opts = opts};
+	int order = opts->probs_order;
+	size_t memory = counter_memory(opts, opts->kmer, true) + counter_memory(opts, order + 1, true) +
+	                counter_memory(opts, order, true) +
+	                2 * ((size_t)1 << 2*opts->kmer) * sizeof(KatssEnrichment);
+	return bootstrap(&base, count_replicate_both, fill_both, false, memory);
 }
 
 KatssData *
@@ -606,27 +1014,61 @@ katss_enrichment(const char *test, const char *ctrl, KatssOptions *opts)
 	if(ctrl && opts->probs_algo != KATSS_PROBS_NONE && opts->enable_warnings)
 		warning_message("katss_enrichment: Ignoring `ctrl=(%s)'",ctrl);
 
+	/* Read the distinct reads, counting the files as they are if they don't fit */
+	KatssReadSet *test_reads = katss_dedup_file(test, opts);
+	KatssReadSet *ctrl_reads = NULL;
+	if(test_reads && opts->probs_algo == KATSS_PROBS_NONE) {
+		ctrl_reads = katss_dedup_file(ctrl, opts);
+		if(ctrl_reads == NULL) {
+			katss_free_reads(test_reads);
+			test_reads = NULL;
+		}
+	}
+
+	/* UMI duplicates can only be left out of the read sets, and only the counts of the files
+	   are trimmed as they are read, not their samples or shuffles */
+	bool trim_file = katss_preprocessing(opts) && opts->umi == NULL &&
+	                 opts->bootstrap_iters == 0 && (opts->probs_algo == KATSS_PROBS_NONE ||
+	                                                opts->probs_algo == KATSS_PROBS_REGULAR);
+	if(katss_preprocessing(opts) && !trim_file && test_reads == NULL && opts->umi == NULL &&
+	   opts->enable_warnings)
+		error_message("katss_enrichment: The trimmed reads of `%s' have to fit in "
+		              "dedup_memory=(%d) MiB to be bootstrapped or shuffled", test,
+		              opts->dedup_memory);
+	if(katss_preprocessing(opts) && !trim_file && test_reads == NULL)
+		return NULL;
+
+	/* Statistics are only derived analytically for control files and the Markov model */
+	if(opts->analytic && opts->bootstrap_iters == 0 && opts->enable_warnings &&
+	   (opts->probs_algo == KATSS_PROBS_USHUFFLE || opts->probs_algo == KATSS_PROBS_BOTH))
+		warning_message("katss_enrichment: Ignoring `analytic'. Shuffled sequences need"
+		                " bootstrap_iters to get a stdev and pval");
+
 	/* BEGIN COMPUTATION: No bootstrap */
 	KatssData *data = NULL;
 	if(opts->bootstrap_iters == 0) {
 		switch(opts->probs_algo) {
-		case KATSS_PROBS_NONE:     data = regular(test, ctrl, opts); break;
-		case KATSS_PROBS_REGULAR:  data = probs(test, opts);         break;
-		case KATSS_PROBS_USHUFFLE: data = ushuffle(test, opts);      break;
-		case KATSS_PROBS_BOTH:     data = both(test, opts);          break;
-		default: return NULL; // silence compiler warnings
+		case KATSS_PROBS_NONE:     data = regular(test, ctrl, test_reads, ctrl_reads, opts); break;
+		case KATSS_PROBS_REGULAR:  data = probs(test, test_reads, opts);         break;
+		case KATSS_PROBS_USHUFFLE: data = ushuffle(test, test_reads, opts);      break;
+		case KATSS_PROBS_BOTH:     data = both(test, test_reads, opts);          break;
+		default: break;
 		}
 
 	/* BEGIN COMPUTATION: bootstrap */
 	} else {
 		switch(opts->probs_algo) {
-		case KATSS_PROBS_NONE:     data = bootstrap_regular(test, ctrl, opts); break;
-		case KATSS_PROBS_REGULAR:  data = bootstrap_probs(test, opts);         break;
-		case KATSS_PROBS_USHUFFLE: data = bootstrap_ushuffle(test, opts);      break;
-		case KATSS_PROBS_BOTH:     data = bootstrap_both(test, opts);          break;
-		default: return NULL; // silence compiler warnings
+		case KATSS_PROBS_NONE:
+			data = bootstrap_regular(test, ctrl, test_reads, ctrl_reads, opts);
+			break;
+		case KATSS_PROBS_REGULAR:  data = bootstrap_probs(test, test_reads, opts);    break;
+		case KATSS_PROBS_USHUFFLE: data = bootstrap_ushuffle(test, test_reads, opts); break;
+		case KATSS_PROBS_BOTH:     data = bootstrap_both(test, test_reads, opts);     break;
+		default: break;
 		}
 	}
+	katss_free_reads(test_reads);
+	katss_free_reads(ctrl_reads);
 
 	/* If data is NULL, return NULL */
 	if(data == NULL)
@@ -5,23 +5,43 @@
 
 #include "memory_utils.h"
 #include "katss.h"
+#include "katss_helpers.h"
+#include "expected_shuffle.h"
+#include "trim.h"
 
 void
 katss_init_options(KatssOptions *opts)
 {
 	opts->kmer = 0;
 	opts->iters = 1;
+	opts->batch = 1;
+	opts->batch_gap = 0.05;
 	opts->threads = 1;
 	opts->normalize = false;
 	opts->sort_enrichments = true;
 
 	opts->bootstrap_iters = 0;
 	opts->bootstrap_sample = 25000;
+	opts->bootstrap_tolerance = 0;
+	opts->analytic = false;
 
 	opts->probs_algo = KATSS_PROBS_NONE;
 	opts->probs_ntprec = -1;
+	opts->shuffle_expected = false;
+	opts->shuffles = 1;
+	opts->probs_order = -1;
 	opts->seed = -1;
 
+	opts->dedup = false;
+	opts->dedup_memory = 4096;
+	opts->umi = NULL;
+	opts->umi_start = 16;
+
+	opts->adapter = NULL;
+	opts->quality_cutoff = 0;
+	opts->mask_quality = 0;
+	opts->min_length = 0;
+
 	opts->enable_warnings = true;
 	opts->verbose_output = false;
 }
@@ -65,10 +85,82 @@ katss_parse_options(KatssOptions *opts)
 		error_message("KatssOptions: bootstrap_sample=(%d) must be in range of 1-100000", opts->bootstrap_sample);
 	if(opts->bootstrap_sample < 1 || opts->bootstrap_sample > 100000)
 		return 1;
+
+	/* Convergence tolerance of the bootstrap can't be negative */
+	if(!(opts->bootstrap_tolerance >= 0) && opts->enable_warnings)
+		error_message("KatssOptions: bootstrap_tolerance=(%g) must be non-negative", opts->bootstrap_tolerance);
+	if(!(opts->bootstrap_tolerance >= 0))
+		return 1;
 	
+	/* Deduplicated reads need some memory to be stored in */
+	if(opts->dedup && opts->dedup_memory < 1 && opts->enable_warnings)
+		error_message("KatssOptions: dedup_memory=(%d) must be greater than 0", opts->dedup_memory);
+	if(opts->dedup && opts->dedup_memory < 1)
+		return 1;
+	if(katss_preprocessing(opts) && opts->dedup_memory < 1 && opts->enable_warnings)
+		error_message("KatssOptions: dedup_memory=(%d) must be greater than 0", opts->dedup_memory);
+	if(katss_preprocessing(opts) && opts->dedup_memory < 1)
+		return 1;
+
+	/* UMI duplicates have to share a non-negative number of nucleotides */
+	if(opts->umi && opts->umi_start < 0 && opts->enable_warnings)
+		error_message("KatssOptions: umi_start=(%d) must be non-negative", opts->umi_start);
+	if(opts->umi && opts->umi_start < 0)
+		return 1;
+
+	/* Quality scores and lengths can't be negative */
+	if((opts->quality_cutoff < 0 || opts->mask_quality < 0 || opts->min_length < 0) &&
+	   opts->enable_warnings)
+		error_message("KatssOptions: quality_cutoff=(%d), mask_quality=(%d) and min_length=(%d) "
+		              "must be non-negative", opts->quality_cutoff, opts->mask_quality,
+		              opts->min_length);
+	if(opts->quality_cutoff < 0 || opts->mask_quality < 0 || opts->min_length < 0)
+		return 1;
+	
+	/* The background can't be longer than the k-mers it predicts */
+	if((opts->probs_order < -1 || opts->probs_order >= opts->kmer) && opts->enable_warnings)
+		error_message("KatssOptions: probs_order=(%d) must be in range of 0-%d, or -1",
+		              opts->probs_order, opts->kmer - 1);
+	if(opts->probs_order < -1 || opts->probs_order >= opts->kmer)
+		return 1;
+	
+	/* The expected shuffled counts are held by 64-bit counters */
+	if(opts->shuffle_expected && opts->kmer > KATSS_EXPECTED_MAX_KMER && opts->enable_warnings)
+		error_message("KatssOptions: kmer=(%d) must be at most %d for shuffle_expected",
+		              opts->kmer, KATSS_EXPECTED_MAX_KMER);
+	if(opts->shuffle_expected && opts->kmer > KATSS_EXPECTED_MAX_KMER)
+		return 1;
+
+	/* The expected shuffled counts are only computed for k-lets with few (k-1)-mers */
+	if(opts->shuffle_expected && opts->probs_ntprec > KATSS_EXPECTED_MAX_KLET &&
+	   opts->probs_ntprec < opts->kmer && opts->enable_warnings)
+		error_message("KatssOptions: probs_ntprec=(%d) must be at most %d for shuffle_expected",
+		              opts->probs_ntprec, KATSS_EXPECTED_MAX_KLET);
+	if(opts->shuffle_expected && opts->probs_ntprec > KATSS_EXPECTED_MAX_KLET &&
+	   opts->probs_ntprec < opts->kmer)
+		return 1;
+
+	/* Every iteration removes at least one k-mer */
+	if(opts->batch < 1 && opts->enable_warnings)
+		error_message("KatssOptions: batch=(%d) must be greater than 0", opts->batch);
+	if(opts->batch < 1)
+		return 1;
+	if(opts->batch_gap < 0 && opts->enable_warnings)
+		error_message("KatssOptions: batch_gap=(%g) can't be negative", opts->batch_gap);
+	if(opts->batch_gap < 0)
+		return 1;
+
+	/* Every sequence has to be shuffled at least once */
+	if(opts->shuffles < 1 && opts->enable_warnings)
+		error_message("KatssOptions: shuffles=(%d) must be greater than 0", opts->shuffles);
+	if(opts->shuffles < 1)
+		return 1;
+
 	/*================= Update values =================*/
 	if(opts->probs_ntprec == -1)
 		opts->probs_ntprec = (int)round(sqrt((double)opts->kmer));
+	if(opts->probs_order == -1)
+		opts->probs_order = opts->kmer > 1 ? 1 : 0;
 	if(opts->seed < 0)
 		opts->seed = time(NULL);
 	
@@ -83,6 +175,7 @@ katss_init_kdata(int kmer)
 	KatssData *kdata = s_malloc(sizeof *kdata);
 	kdata->num_kmers = total;
 	kdata->kmers = s_calloc(total, sizeof *kdata->kmers);
+	kdata->bootstrap_iters = 0;
 
 	return kdata;
 }
@@ -93,3 +186,65 @@ katss_free_kdata(KatssData *data)
 	free(data->kmers);
 	free(data);
 }
+
+bool
+katss_preprocessing(const KatssOptions *opts)
+{
+	return opts->umi != NULL || opts->adapter != NULL || opts->quality_cutoff > 0 ||
+	       opts->mask_quality > 0 || opts->min_length > 0;
+}
+
+/* Trimming of the reads asked for in opts, without the UMIs */
+static void
+read_filter(const KatssOptions *opts, KatssReadFilter *filter)
+{
+	katss_init_read_filter(filter);
+	filter->adapter = opts->adapter;
+	filter->quality_cutoff = opts->quality_cutoff;
+	filter->mask_quality = opts->mask_quality;
+	filter->min_length = opts->min_length;
+}
+
+KatssReadSet *
+katss_dedup_file(const char *file, KatssOptions *opts)
+{
+	if(file == NULL)
+		return NULL;
+	if(!katss_preprocessing(opts)) {
+		if(!opts->dedup)
+			return NULL;
+		return katss_dedup_reads(file, (size_t)opts->dedup_memory << 20, opts->threads);
+	}
+
+	KatssReadFilter filter;
+	read_filter(opts, &filter);
+	filter.umi = opts->umi;
+	filter.umi_start = opts->umi_start;
+
+	KatssReadSet *reads = katss_preprocess_reads(file, &filter, (size_t)opts->dedup_memory << 20,
+	                                             opts->threads);
+	if(reads == NULL)
+		return NULL;
+
+	unsigned long long total = katss_reads_total(reads);
+	if(opts->adapter != NULL)
+		info_message("katss: %s: trimmed the adapter off %llu of %llu reads", file,
+		             (unsigned long long)katss_reads_adapter_trimmed(reads), total);
+	if(opts->min_length > 0)
+		info_message("katss: %s: left out %llu of %llu reads shorter than %d nt", file,
+		             (unsigned long long)katss_reads_too_short(reads), total, opts->min_length);
+	if(opts->umi != NULL)
+		info_message("katss: %s: collapsed %llu of %llu reads as UMI duplicates", file,
+		             (unsigned long long)katss_reads_collapsed(reads), total);
+	if(opts->umi != NULL && katss_reads_missing_umi(reads) > 0 && opts->enable_warnings)
+		warning_message("katss: %s: kept %llu reads without a UMI", file,
+		                (unsigned long long)katss_reads_missing_umi(reads));
+	return reads;
+}
+
+const KatssReadFilter *
+katss_trim_filter(const KatssOptions *opts, KatssReadFilter *filter)
+{
+	read_filter(opts, filter);
+	return trim_enabled(filter) ? filter : NULL;
+}
@@ -2,6 +2,7 @@
 #define KATSS_HELPERS_H
 
 #include "katss.h"
+#include "counter.h"
 
 /**
  * @brief Parse the KatssOptions options to ensure they are correct.
@@ -22,4 +23,41 @@ katss_parse_options(KatssOptions *opts);
 KatssData *
 katss_init_kdata(int kmer);
 
+
+/**
+ * @brief Whether the reads are preprocessed (trimmed, filtered or collapsed by UMI) while
+ * reading the distinct reads, which then can't fall back to counting the file.
+ * 
+ * @param opts Pointer to KatssOptions struct
+ * @return bool
+ */
+bool
+katss_preprocessing(const KatssOptions *opts);
+
+
+/**
+ * @brief Read the distinct reads of a file, if opts->dedup is set, preprocessing them if
+ * katss_preprocessing(opts).
+ * 
+ * @param file File containing the reads, or NULL
+ * @param opts Pointer to KatssOptions struct
+ * @return KatssReadSet* Distinct reads, or NULL if not deduplicating or if the reads did not
+ * fit in memory, in which case the file should be counted instead, trimmed as it is read with
+ * katss_trim_filter(opts). When collapsing UMI duplicates, NULL is an error
+ */
+KatssReadSet *
+katss_dedup_file(const char *file, KatssOptions *opts);
+
+
+/**
+ * @brief Set filter to the trimming of opts, to count the files whose trimmed reads do not fit
+ * in memory with the trimmed counters, see katss_count_kmers_trimmed_mt.
+ * 
+ * @param opts   Pointer to KatssOptions struct
+ * @param filter Filter to set
+ * @return const KatssReadFilter* filter, or NULL if the reads are not trimmed
+ */
+const KatssReadFilter *
+katss_trim_filter(const KatssOptions *opts, KatssReadFilter *filter);
+
 #endif
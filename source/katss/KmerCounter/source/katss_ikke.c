@@ -1,18 +1,38 @@
 #include <stddef.h>
 #include <stdlib.h>
+#include <math.h>
 
 #include "katss.h"
+#include "katss_core.h"
 #include "katss_helpers.h"
 #include "memory_utils.h"
 
 #include "enrichments.h"
+#include "hash_functions.h"
+#include "t_test.h"
 
 static KatssData *
 regular(const char *test, const char *ctrl, KatssOptions *opts)
 {
-	/* Compute iterative kmer knockout enrichments */
+	/* Compute iterative kmer knockout enrichments, over the distinct reads if possible. UMI
+	   duplicates can only be left out of them, trimmed reads can be trimmed from the files */
 	KatssEnrichments *enr;
-	enr = katss_ikke_mt(test, ctrl, opts->kmer, opts->iters, opts->normalize, opts->threads);
+	KatssReadFilter filter;
+	KatssReadSet *test_reads = katss_dedup_file(test, opts);
+	KatssReadSet *ctrl_reads = test_reads ? katss_dedup_file(ctrl, opts) : NULL;
+	if(opts->umi != NULL && (test_reads == NULL || ctrl_reads == NULL)) {
+		katss_free_reads(test_reads);
+		return NULL;
+	}
+	if(test_reads && ctrl_reads)
+		enr = katss_ikke_reads_mt(test_reads, ctrl_reads, opts->kmer, opts->iters,
+		                          opts->normalize, opts->batch, opts->batch_gap, opts->threads);
+	else
+		enr = katss_ikke_trimmed_mt(test, ctrl, katss_trim_filter(opts, &filter), opts->kmer,
+		                            opts->iters, opts->normalize, opts->batch, opts->batch_gap,
+		                            opts->threads);
+	katss_free_reads(test_reads);
+	katss_free_reads(ctrl_reads);
 	if(enr == NULL)
 		return NULL;
 
@@ -35,7 +55,18 @@ static KatssData *
 probs(const char *test, KatssOptions *opts)
 {
 	KatssEnrichments *enr;
-	enr = katss_prob_ikke_mt(test, opts->kmer, opts->iters, opts->normalize, opts->threads);
+	KatssReadFilter filter;
+	KatssReadSet *reads = katss_dedup_file(test, opts);
+	if(opts->umi != NULL && reads == NULL)
+		return NULL;
+	if(reads)
+		enr = katss_prob_ikke_reads_mt(reads, opts->kmer, opts->probs_order, opts->iters,
+		                               opts->normalize, opts->batch, opts->batch_gap, opts->threads);
+	else
+		enr = katss_prob_ikke_trimmed_mt(test, katss_trim_filter(opts, &filter), opts->kmer,
+		                                 opts->probs_order, opts->iters, opts->normalize,
+		                                 opts->batch, opts->batch_gap, opts->threads);
+	katss_free_reads(reads);
 	if(enr == NULL)
 		return NULL;
 	
@@ -54,10 +85,42 @@ exit:
 }
 
 static KatssData *
-ushuffle(const char *test, KatssOptions *opts)
+ushuffle(const char *test, KatssOptions *opts, bool seeded)
 {
 	KatssEnrichments *enr;
-	enr = katss_ikke_shuffle(test, opts->kmer, opts->probs_ntprec, opts->iters, opts->normalize);
+	KatssReadFilter filter;
+	KatssReadSet *reads = katss_dedup_file(test, opts);
+	if(opts->umi != NULL && reads == NULL)
+		return NULL;
+
+	/* Shuffle the reads once, and recount the shuffles left after every iteration. Without a
+	   seed, the shuffles are those of the enrichments, which the first iteration then matches.
+	   Trimmed reads that do not fit are shuffled again every iteration */
+	size_t memory = (size_t)opts->dedup_memory << 20;
+	unsigned int seed = (unsigned int)opts->seed;
+	const unsigned int *shuffle_seed = seeded ? &seed : NULL;
+	const KatssReadFilter *trim = katss_trim_filter(opts, &filter);
+	KatssReadSet *shuffled = NULL;
+	if(reads)
+		shuffled = katss_shuffle_reads(reads, opts->probs_ntprec, shuffle_seed, memory);
+	else if(trim == NULL)
+		shuffled = katss_shuffle_file(test, opts->probs_ntprec, shuffle_seed, memory);
+	if(reads && shuffled)
+		enr = katss_ikke_reads_mt(reads, shuffled, opts->kmer, opts->iters, opts->normalize,
+		                          opts->batch, opts->batch_gap, opts->threads);
+	else if(shuffled)
+		enr = katss_ikke_shuffled_mt(test, shuffled, opts->kmer, opts->iters, opts->normalize,
+		                             opts->batch, opts->batch_gap, opts->threads);
+	else if(reads)
+		enr = katss_ikke_shuffle_reads(reads, opts->kmer, opts->probs_ntprec, opts->iters,
+		                               opts->normalize);
+	else
+		enr = katss_ikke_shuffle_trimmed(test, trim, opts->kmer, opts->probs_ntprec, opts->iters,
+		                                 opts->normalize);
+	if(shuffled == NULL && opts->batch > 1 && opts->enable_warnings)
+		warning_message("katss_ikke: Ignoring `batch'. The shuffled reads don't fit in memory");
+	katss_free_reads(shuffled);
+	katss_free_reads(reads);
 	if(enr == NULL)
 		return NULL;
 	
@@ -75,34 +138,321 @@ exit:
 	return data;
 }
 
-static KatssData *
-both(const char *test, KatssOptions *opts)
+/* Most counters a run of IKKE counts in a set of reads: its k-mers, (m+1)-mers and m-mers */
+#define RUN_COUNTERS 3
+
+/**
+ * @brief Runs of IKKE counted together, over the same reads: the run of all the reads, 0,
+ * and the bootstrap replicates. Every run counts the test reads and, unless its background is
+ * only predicted from them, the control or shuffled reads, and removes its own top k-mers.
+ */
+struct ikke_runs {
+	KatssProbsAlgo algo;
+	int runs;
+	int num_test;           /* Counters of every run in the test reads */
+	int num_ctrl;           /* Counters of every run in the control or shuffled reads */
+	KatssCounter **test;    /* num_test counters of every run, one run after the other */
+	KatssCounter **ctrl;
+	double *freqs;          /* Background frequency of every k-mer of the last run looked at */
+	double *pred;           /* Predicted frequencies of the shuffled k-mers, for BOTH */
+};
+
+/**
+ * @brief Lengths of the counters of a run in a set of reads, k-mers first. Backgrounds
+ * predicted from a Markov model also count the (m+1)-mers and m-mers, if m is not 0.
+ */
+static int
+run_counters(int *lengths, bool predicted, int kmer, int order)
 {
-	return NULL;
+	lengths[0] = kmer;
+	if(!predicted)
+		return 1;
+	lengths[1] = order + 1;
+	lengths[2] = order;
+	return order > 0 ? 3 : 2;
 }
 
-static KatssData *
-bootstrap_regular(const char *test, const char *ctrl, KatssOptions *opts)
+static void
+ikke_runs_free(struct ikke_runs *ikke)
 {
-	return NULL;
+	for(int i = 0; i < ikke->runs * ikke->num_test; i++)
+		katss_free_counter(ikke->test[i]);
+	for(int i = 0; i < ikke->runs * ikke->num_ctrl; i++)
+		katss_free_counter(ikke->ctrl[i]);
+	free(ikke->test);
+	free(ikke->ctrl);
+	free(ikke->freqs);
+	free(ikke->pred);
 }
 
-static KatssData *
-bootstrap_probs(const char *test, KatssOptions *opts)
+/* Bytes taken up by the counters of the runs and the background frequencies */
+static size_t
+ikke_runs_size(const KatssOptions *opts, int runs)
 {
-	return NULL;
+	int test_lengths[RUN_COUNTERS], ctrl_lengths[RUN_COUNTERS];
+	KatssProbsAlgo algo = opts->probs_algo;
+	bool predicted = algo == KATSS_PROBS_REGULAR || algo == KATSS_PROBS_BOTH;
+	int num_test = run_counters(test_lengths, predicted, opts->kmer, opts->probs_order);
+	int num_ctrl = algo == KATSS_PROBS_REGULAR ? 0 :
+	               run_counters(ctrl_lengths, predicted, opts->kmer, opts->probs_order);
+
+	size_t run_size = 0;
+	for(int c = 0; c < num_test; c++)
+		run_size += katss_counter_size(test_lengths[c]);
+	for(int c = 0; c < num_ctrl; c++)
+		run_size += katss_counter_size(ctrl_lengths[c]);
+	size_t freqs_size = ((size_t)1 << 2*opts->kmer) * sizeof(double);
+	return runs * run_size + (algo == KATSS_PROBS_BOTH ? 2 : 1) * freqs_size;
 }
 
-static KatssData *
-bootstrap_ushuffle(const char *test, KatssOptions *opts)
+static int
+ikke_runs_init(struct ikke_runs *ikke, const KatssOptions *opts, int runs)
+{
+	int test_lengths[RUN_COUNTERS], ctrl_lengths[RUN_COUNTERS];
+	KatssProbsAlgo algo = opts->probs_algo;
+	bool predicted = algo == KATSS_PROBS_REGULAR || algo == KATSS_PROBS_BOTH;
+	ikke->algo = algo;
+	ikke->runs = runs;
+	ikke->num_test = run_counters(test_lengths, predicted, opts->kmer, opts->probs_order);
+	ikke->num_ctrl = algo == KATSS_PROBS_REGULAR ? 0 :
+	                 run_counters(ctrl_lengths, predicted, opts->kmer, opts->probs_order);
+	ikke->test = s_calloc((size_t)runs * ikke->num_test, sizeof *ikke->test);
+	ikke->ctrl = s_calloc((size_t)runs * RUN_COUNTERS, sizeof *ikke->ctrl);
+	ikke->freqs = s_malloc(((size_t)1 << 2*opts->kmer) * sizeof *ikke->freqs);
+	ikke->pred = algo == KATSS_PROBS_BOTH ?
+	             s_malloc(((size_t)1 << 2*opts->kmer) * sizeof *ikke->pred) : NULL;
+
+	int ret = 0;
+	for(int r = 0; r < runs; r++) {
+		for(int c = 0; c < ikke->num_test; c++)
+			ret |= (ikke->test[r * ikke->num_test + c] = katss_init_counter(test_lengths[c])) == NULL;
+		for(int c = 0; c < ikke->num_ctrl; c++)
+			ret |= (ikke->ctrl[r * ikke->num_ctrl + c] = katss_init_counter(ctrl_lengths[c])) == NULL;
+	}
+	return ret;
+}
+
+/**
+ * @brief Fill in the background frequency of every k-mer of run r, 0 for the k-mers without
+ * one: their frequency in the control or shuffled reads, the one a Markov model of the test
+ * reads predicts, or for BOTH, the predicted frequency times the enrichment of the shuffled
+ * reads over their own prediction.
+ */
+static int
+run_background(struct ikke_runs *ikke, int r)
+{
+	KatssCounter **test = ikke->test + (size_t)r * ikke->num_test;
+	KatssCounter **ctrl = ikke->ctrl + (size_t)r * ikke->num_ctrl;
+	uint64_t total = ((uint64_t)test[0]->capacity) + 1;
+
+	if(ikke->algo == KATSS_PROBS_NONE || ikke->algo == KATSS_PROBS_USHUFFLE) {
+		if(ctrl[0]->total == 0)
+			return 1;
+		for(uint64_t i = 0; i < total; i++) {
+			katss_get_from_hash(ctrl[0], KATSS_DOUBLE, &ikke->freqs[i], (uint32_t)i);
+			ikke->freqs[i] /= ctrl[0]->total;
+		}
+		return 0;
+	}
+
+	KatssCounter *context = ikke->num_test == 3 ? test[2] : NULL;
+	if(katss_predict_kmer_freqs(ikke->freqs, test[0]->kmer, context, test[1]) != 0)
+		return 1;
+	if(ikke->algo == KATSS_PROBS_REGULAR)
+		return 0;
+
+	context = ikke->num_ctrl == 3 ? ctrl[2] : NULL;
+	if(ctrl[0]->total == 0 ||
+	   katss_predict_kmer_freqs(ikke->pred, ctrl[0]->kmer, context, ctrl[1]) != 0)
+		return 1;
+	for(uint64_t i = 0; i < total; i++) {
+		double shuf_frq = 0;
+		katss_get_from_hash(ctrl[0], KATSS_DOUBLE, &shuf_frq, (uint32_t)i);
+		shuf_frq /= ctrl[0]->total;
+		ikke->freqs[i] = ikke->pred[i] > 0 ? ikke->freqs[i] * shuf_frq / ikke->pred[i] : 0;
+	}
+	return 0;
+}
+
+/**
+ * @brief Frequency of a k-mer in the test reads of run r, over its background frequency from
+ * the last call to run_background. NAN if either is 0.
+ */
+static void
+run_freqs(const struct ikke_runs *ikke, int r, uint32_t kmer, double *test_frq, double *bg_frq)
+{
+	KatssCounter *test = ikke->test[(size_t)r * ikke->num_test];
+	*test_frq = 0;
+	katss_get_from_hash(test, KATSS_DOUBLE, test_frq, kmer);
+	*test_frq = test->total > 0 && *test_frq > 0 ? *test_frq / test->total : NAN;
+	*bg_frq = ikke->freqs[kmer] > 0 ? ikke->freqs[kmer] : NAN;
+}
+
+/**
+ * @brief Most enriched k-mer of run r over its background, -1 if there is none. As in
+ * katss_top_enrichment, the first of the most enriched k-mers is picked.
+ */
+static int64_t
+run_top_kmer(struct ikke_runs *ikke, int r)
+{
+	if(run_background(ikke, r) != 0)
+		return -1;
+
+	KatssCounter *test = ikke->test[(size_t)r * ikke->num_test];
+	int64_t top = -1;
+	double top_rval = -INFINITY;
+	for(uint32_t i = 0; i <= test->capacity; i++) {
+		if(ikke->freqs[i] == 0)
+			continue;
+		double count = 0;
+		katss_get_from_hash(test, KATSS_DOUBLE, &count, i);
+		double rval = count / test->total / ikke->freqs[i];
+		if(rval > top_rval) {
+			top_rval = rval;
+			top = i;
+		}
+	}
+	return top;
+}
+
+/**
+ * @brief Reads of a file in memory, for the runs of IKKE to be counted from. The reads are
+ * preprocessed and deduplicated as asked, and deduplicated anyway otherwise.
+ */
+static KatssReadSet *
+reads_in_memory(const char *file, KatssOptions *opts)
 {
-	return NULL;
+	KatssReadSet *reads = katss_dedup_file(file, opts);
+	if(reads == NULL && !opts->dedup && !katss_preprocessing(opts))
+		reads = katss_dedup_reads(file, (size_t)opts->dedup_memory << 20, opts->threads);
+	if(reads == NULL && opts->enable_warnings)
+		error_message("katss_ikke: The reads of `%s' have to fit in dedup_memory=(%d) MiB to be "
+		              "bootstrapped", file, opts->dedup_memory);
+	return reads;
 }
 
+/**
+ * @brief Compute IKKE over the reads of all runs at once: the run of all reads, which gives
+ * the k-mers and their enrichments, and opts->bootstrap_iters replicates of a sub-sample of the
+ * reads, each removing its own top k-mers. Every iteration recounts all runs in one pass over
+ * the test reads (and one over the control or shuffled reads).
+ * 
+ * The k-mer of every iteration has the standard deviation of its enrichments in the replicates,
+ * after their own iterations so far, the p-value of the T-test of its test and background
+ * frequencies in them, and its stability: the fraction of replicates it was the top k-mer of.
+ * 
+ * @param test   Testfile to be used for computation
+ * @param ctrl   Control file, for KATSS_PROBS_NONE
+ * @param opts   Options to modify output
+ * @param seeded Whether opts->seed was given, else the reads are shuffled as in ushuffle
+ * @return KatssData* Data containing the k-mers in the order they were removed
+ */
 static KatssData *
-bootstrap_both(const char *test, KatssOptions *opts)
+ikke_runs(const char *test, const char *ctrl, KatssOptions *opts, bool seeded)
 {
-	return NULL;
+	KatssData *data = NULL;
+	KatssReadSet *ctrl_reads = NULL;
+	int replicates = opts->bootstrap_iters;
+	int runs = replicates + 1;
+	unsigned int seed = (unsigned int)opts->seed;
+
+	/* Every run has counters of all k-mers of its own, which have to fit like the reads */
+	size_t size = ikke_runs_size(opts, runs);
+	if(size > (size_t)opts->dedup_memory << 20) {
+		if(opts->enable_warnings)
+			error_message("katss_ikke: The counters of the %d runs take up %zu MiB, more than "
+			              "dedup_memory=(%d) MiB. Use fewer bootstrap_iters or shorter k-mers",
+			              runs, (size >> 20) + 1, opts->dedup_memory);
+		return NULL;
+	}
+
+	/* The runs are counted from reads kept in memory, shuffled once for the shuffled methods */
+	KatssReadSet *test_reads = reads_in_memory(test, opts);
+	if(test_reads == NULL)
+		return NULL;
+	if(opts->probs_algo == KATSS_PROBS_NONE)
+		ctrl_reads = reads_in_memory(ctrl, opts);
+	else if(opts->probs_algo != KATSS_PROBS_REGULAR)
+		ctrl_reads = katss_shuffle_reads(test_reads, opts->probs_ntprec, seeded ? &seed : NULL,
+		                                 (size_t)opts->dedup_memory << 20);
+	if(opts->probs_algo != KATSS_PROBS_REGULAR && ctrl_reads == NULL)
+		goto cleanup_reads;
+
+	struct ikke_runs ikke;
+	if(ikke_runs_init(&ikke, opts, runs) != 0)
+		goto cleanup_runs;
+
+	data = katss_init_kdata(opts->kmer);
+	data->bootstrap_iters = replicates;
+	uint64_t iterations = MIN2((uint64_t)opts->iters, data->num_kmers);
+	char (*removed)[17] = s_malloc(runs * sizeof *removed);
+	const char **remove = s_malloc(runs * sizeof *remove);
+	data->num_kmers = 0;
+	for(uint64_t i = 0; i < iterations; i++) {
+		/* Every run is recounted without the k-mer it removed last */
+		const char **rm = i > 0 ? remove : NULL;
+		katss_recount_reads_bootstrap_mt(ikke.test, ikke.num_test, runs, rm, test_reads,
+		                                 opts->bootstrap_sample, seed, opts->threads);
+		if(ikke.num_ctrl > 0)
+			katss_recount_reads_bootstrap_mt(ikke.ctrl, ikke.num_ctrl, runs, rm, ctrl_reads,
+			                                 opts->bootstrap_sample, seed, opts->threads);
+
+		/* The run of all reads picks the k-mer of the iteration */
+		int64_t top = run_top_kmer(&ikke, 0);
+		if(top < 0)
+			break;
+		double test_frq, bg_frq;
+		run_freqs(&ikke, 0, (uint32_t)top, &test_frq, &bg_frq);
+		double rval = test_frq / bg_frq;
+		katss_unhash(removed[0], (uint32_t)top, opts->kmer, true);
+		remove[0] = removed[0];
+
+		uint64_t count = 0;
+		katss_get_from_hash(ikke.test[0], KATSS_UINT64, &count, (uint32_t)top);
+		if(count < 20)
+			warning_message("count for `%s' is less than 20.", removed[0]);
+
+		/* Compare the replicates to it, and go on with their own top k-mers */
+		t_test2_aggregate *ttest = t_test2_create();
+		double mean = 0, M2 = 0;
+		int n = 0, same = 0;
+		for(int r = 1; r < runs; r++) {
+			int64_t rep_top = run_top_kmer(&ikke, r);
+			run_freqs(&ikke, r, (uint32_t)top, &test_frq, &bg_frq);
+			t_test2_update(ttest, test_frq, bg_frq);
+			double rep_rval = test_frq / bg_frq;
+			if(!isnan(rep_rval)) {
+				double delta = rep_rval - mean;
+				mean += delta / ++n;
+				M2 += delta * (rep_rval - mean);
+			}
+
+			same += rep_top == top;
+			remove[r] = NULL;
+			if(rep_top >= 0) {
+				katss_unhash(removed[r], (uint32_t)rep_top, opts->kmer, true);
+				remove[r] = removed[r];
+			}
+		}
+		t_test2_finalize(ttest);
+
+		KatssDataEntry *entry = &data->kmers[data->num_kmers++];
+		entry->kmer = (uint32_t)top;
+		entry->rval = opts->normalize ? log2(rval) : rval;
+		entry->stdev = n > 1 ? sqrt(M2 / (n - 1)) : 0;
+		entry->pval = replicates > 0 ? ttest->pval : 0;
+		entry->stability = replicates > 0 ? (float)same / replicates : 0;
+		t_test2_destroy(ttest);
+	}
+	free(removed);
+	free(remove);
+
+cleanup_runs:
+	ikke_runs_free(&ikke);
+cleanup_reads:
+	katss_free_reads(ctrl_reads);
+	katss_free_reads(test_reads);
+	return data;
 }
 
 KatssData *
@@ -112,7 +462,8 @@ katss_ikke(const char *test, const char *ctrl, KatssOptions *opts)
 	if(test == NULL)
 		return NULL;
 
-	/* Parse the options */
+	/* Parse the options, which draw a seed if none was given */
+	bool seeded = opts->seed >= 0;
 	if(katss_parse_options(opts) != 0)
 		return NULL;
 	
@@ -125,23 +476,40 @@ katss_ikke(const char *test, const char *ctrl, KatssOptions *opts)
 	if(ctrl && opts->probs_algo != KATSS_PROBS_NONE && opts->enable_warnings)
 		warning_message("katss_enrichment: Ignoring `ctrl=(%s)'",ctrl);
 
+	/* Every iteration shuffles the reads left after crossing out the top k-mers, which have no
+	   expected counts to add up */
+	if(opts->shuffle_expected && opts->enable_warnings)
+		warning_message("katss_ikke: Ignoring `shuffle_expected'. Iterations shuffle the reads");
+	if(opts->shuffles > 1 && opts->enable_warnings)
+		warning_message("katss_ikke: Ignoring `shuffles'. Iterations shuffle the reads once");
+
+	/* The runs of IKKE counted together (ikke_runs) remove one k-mer per iteration */
+	if(opts->batch > 1 && (opts->bootstrap_iters > 0 || opts->probs_algo == KATSS_PROBS_BOTH) &&
+	   opts->enable_warnings)
+		warning_message("katss_ikke: Ignoring `batch'. It doesn't apply to bootstrap_iters or "
+		                "KATSS_PROBS_BOTH");
+
+	/* The replicates are recounted together every iteration, so every one of them runs */
+	if(opts->bootstrap_iters > 0 && opts->bootstrap_tolerance > 0 && opts->enable_warnings)
+		warning_message("katss_ikke: Ignoring `bootstrap_tolerance'. Every replicate of IKKE runs");
+
 	/* BEGIN COMPUTATION: No bootstrap */
 	if(opts->bootstrap_iters == 0) {
 		switch(opts->probs_algo) {
 		case KATSS_PROBS_NONE:     return regular(test, ctrl, opts);
 		case KATSS_PROBS_REGULAR:  return probs(test, opts);
-		case KATSS_PROBS_USHUFFLE: return ushuffle(test, opts);
-		case KATSS_PROBS_BOTH:     return both(test, opts);
+		case KATSS_PROBS_USHUFFLE: return ushuffle(test, opts, seeded);
+		case KATSS_PROBS_BOTH:     return ikke_runs(test, NULL, opts, seeded);
 		default: return NULL;
 		}
 
 	/* BEGIN COMPUTATION: bootstrap */
 	} else {
 		switch(opts->probs_algo) {
-		case KATSS_PROBS_NONE:     return bootstrap_regular(test, ctrl, opts);
-		case KATSS_PROBS_REGULAR:  return bootstrap_probs(test, opts);
-		case KATSS_PROBS_USHUFFLE: return bootstrap_ushuffle(test, opts);
-		case KATSS_PROBS_BOTH:     return bootstrap_both(test, opts);
+		case KATSS_PROBS_NONE:
+		case KATSS_PROBS_REGULAR:
+		case KATSS_PROBS_USHUFFLE:
+		case KATSS_PROBS_BOTH:     return ikke_runs(test, ctrl, opts, seeded);
 		default: return NULL;
 		}
 	}
@@ -14,6 +14,7 @@
 #include "memory_utils.h"
 #include "seqfile.h"
 #include "seqseq.h"
+#include "trim.h"
 #include "ushuffle.h"
 
 #define BUFFER_SIZE 65536U
@@ -21,6 +22,7 @@
 struct threadinfo {
 	SeqFile seqfile;
 	KatssCounter *counter;
+	const KatssReadFilter *filter; /* Only set when trimming */
 	char filetype;
 };
 typedef struct threadinfo threadinfo;
@@ -43,6 +45,7 @@ katss_recount_kmer(KatssCounter *counter, const char *filename, const char *remo
 		memset(counter->table.small,  0x00, total * sizeof(uint64_t));
 	else
 		memset(counter->table.medium, 0x00, total * sizeof(uint32_t));
+	counter->total = 0;
 	
 	/* Push kmer to remove to counter */
 	kctr_push(counter, remove);
@@ -100,6 +103,13 @@ katss_recount_kmer(KatssCounter *counter, const char *filename, const char *remo
 
 int
 katss_recount_kmer_shuffle(KatssCounter *counter, const char *file, int klet, const char *remove)
+{
+	return katss_recount_kmer_shuffle_trimmed(counter, file, NULL, klet, remove);
+}
+
+int
+katss_recount_kmer_shuffle_trimmed(KatssCounter *counter, const char *file,
+                                   const KatssReadFilter *filter, int klet, const char *remove)
 {
 	int ret = 0;
 	char filetype = determine_filetype(file);
@@ -112,6 +122,7 @@ katss_recount_kmer_shuffle(KatssCounter *counter, const char *file, int klet, co
 		memset(counter->table.small,  0x00, total * sizeof(uint64_t));
 	else
 		memset(counter->table.medium, 0x00, total * sizeof(uint32_t));
+	counter->total = 0;
 	
 	/* Push kmer to remove to counter */
 	kctr_push(counter, remove);
@@ -134,26 +145,26 @@ katss_recount_kmer_shuffle(KatssCounter *counter, const char *file, int klet, co
 
 	char *buffer = s_malloc(BUFFER_SIZE);
 	char *shuf   = s_malloc(BUFFER_SIZE);
-	size_t still_reading;
+	char *quality = filter != NULL ? s_malloc(BUFFER_SIZE) : NULL;
 	uint32_t hash_value;
 
 	/* Begin recounting */
 	srand(1); // reset seed for ushuffle
-	while(seqfgets_unlocked(read_file, buffer, BUFFER_SIZE)) {
+	while(trim_next_read(read_file, filter, buffer, quality, BUFFER_SIZE, false)) {
 		/* Shuffle the sequence */
 		int seqlen = strlen(buffer);
 		shuffle(buffer, shuf, seqlen, klet);
 		shuf[seqlen] = '\0'; // null terminate shuf since shuffle uses strncpy
 
-		/* Remove sequences in line */
+		/* Remove sequences in the shuffled line */
 		katss_str_node_t *cur = counter->removed;
 		while(cur != NULL) {
-			cross_out(buffer, cur->str, filetype);
+			cross_out(shuf, cur->str, filetype);
 			cur = cur->next;
 		}
 
 		/* Count the kemrs */
-		katss_set_seq(hasher, shuf, filetype);
+		katss_set_read(hasher, shuf, filetype);
 		while(katss_get_fh(hasher, &hash_value, filetype)) {
 			katss_increment(counter, hash_value);
 		}
@@ -169,6 +180,7 @@ katss_recount_kmer_shuffle(KatssCounter *counter, const char *file, int klet, co
 	free(hasher);
 	free(buffer);
 	free(shuf);
+	free(quality);
 	seqfclose(read_file);
 
 	return ret;
@@ -220,8 +232,64 @@ recount_mt(void *arg)
 	return 0;
 }
 
+/* Like recount_mt, but one trimmed read at a time */
+static int
+recount_trimmed_mt(void *arg)
+{
+	threadinfo *args = (threadinfo *)arg;
+	char *buffer = s_malloc(BUFFER_SIZE);
+	char *quality = s_malloc(BUFFER_SIZE);
+
+	/* Hasher to hash k-mers */
+	KatssHasher *hasher = katss_init_hasher(args->counter->kmer, '\0');
+	if(hasher == NULL)
+		return 1;
+
+	/* Megabyte to store counts */
+	size_t num_counts = 250000;
+	uint32_t *hash_values = s_malloc(num_counts * sizeof *hash_values);
+	size_t cur_hash = 0;
+
+	/* Begin re-counting */
+	while(trim_next_read(args->seqfile, args->filter, buffer, quality, BUFFER_SIZE, true)) {
+		/* Remove unwanted k-mers */
+		katss_str_node_t *cur = args->counter->removed;
+		while(cur != NULL) {
+			cross_out(buffer, cur->str, args->filetype);
+			cur = cur->next;
+		}
+
+		/* Count the k-mers of the read alone */
+		katss_set_read(hasher, buffer, args->filetype);
+		while(katss_get_fh(hasher, &hash_values[cur_hash], args->filetype)) {
+			if(++cur_hash == num_counts) { // begin flushing
+				katss_increments(args->counter, hash_values, cur_hash);
+				cur_hash = 0;
+			}
+		}
+	}
+
+	/* Flush values */
+	katss_increments(args->counter, hash_values, cur_hash);
+
+	/* Free resources */
+	free(hasher);
+	free(buffer);
+	free(quality);
+	free(hash_values);
+
+	return 0;
+}
+
 int
 katss_recount_kmer_mt(KatssCounter *counter, const char *filename, const char *remove, int threads)
+{
+	return katss_recount_kmer_trimmed_mt(counter, filename, NULL, remove, threads);
+}
+
+int
+katss_recount_kmer_trimmed_mt(KatssCounter *counter, const char *filename,
+                              const KatssReadFilter *filter, const char *remove, int threads)
 {
 	int ret = 0;
 
@@ -236,6 +304,7 @@ katss_recount_kmer_mt(KatssCounter *counter, const char *filename, const char *r
 		memset(counter->table.small,  0x00, total * sizeof(uint64_t));
 	else
 		memset(counter->table.medium, 0x00, total * sizeof(uint32_t));
+	counter->total = 0;
 	
 	/* Push kmer to remove to counter */
 	kctr_push(counter, remove);
@@ -260,10 +329,11 @@ katss_recount_kmer_mt(KatssCounter *counter, const char *filename, const char *r
 	for(int i=0; i<threads; i++) {
 		jobarg[i].seqfile = read_file;
 		jobarg[i].counter = counter;
+		jobarg[i].filter = filter;
 		jobarg[i].filetype = filetype;
 
 		/* Start threads */
-		thrd_create(&jobs[i], recount_mt, &jobarg[i]);
+		thrd_create(&jobs[i], filter != NULL ? recount_trimmed_mt : recount_mt, &jobarg[i]);
 	}
 
 	for(int i=0; i<threads; i++) {
@@ -375,6 +445,12 @@ cross_out(char *s1, const char *s2, char filetype) {
 	}
 }
 
+void
+katss_remove_kmer(KatssCounter *counter, const char *remove)
+{
+	kctr_push(counter, remove);
+}
+
 static void
 kctr_push(KatssCounter *counter, const char *str)
 {
@@ -69,6 +69,16 @@ katss_free_counter(KatssCounter *counter)
 }
 
 
+size_t
+katss_counter_size(unsigned int kmer)
+{
+	if(kmer == 0 || kmer > 16)
+		return 0;
+	size_t entry = kmer <= 12 ? sizeof(uint64_t) : sizeof(uint32_t);
+	return sizeof(KatssCounter) + ((size_t)1 << 2*kmer) * entry;
+}
+
+
 void
 katss_increments(KatssCounter *counter, uint32_t *hash_values, size_t num_values)
 {
@@ -80,8 +90,21 @@ katss_increments(KatssCounter *counter, uint32_t *hash_values, size_t num_values
 	else
 		for(size_t i=0; i<num_values; i++)
 			counter->table.medium[hash_values[i]]++;
-	counter->total++;
+	counter->total += num_values;
+
+	mtx_unlock(&counter->lock);
+}
+
 
+void
+katss_increment_by(KatssCounter *counter, uint32_t hash, uint64_t amount)
+{
+	mtx_lock(&counter->lock);
+	if(counter->kmer <= 12)
+		counter->table.small[hash] += amount;
+	else
+		counter->table.medium[hash] += (uint32_t)amount;
+	counter->total += amount;
 	mtx_unlock(&counter->lock);
 }
 
@@ -251,48 +274,6 @@ katss_get_total(KatssCounter *counter)
 }
 
 
-double
-katss_predict_kmer_freq(uint32_t hash, int kmer, KatssCounter *mono, KatssCounter *dint)
-{
-	char kseq[32];
-	katss_unhash(kseq, hash, kmer, true);
-	char monoseq[2] = { 0 };
-	char diseq[3]   = { 0 };
-
-	double monoprob = 1;
-	double diprob = 1;
-
-	/* Get the cumulative probabilities for overlapping monomers */
-	for(int i=1; i<kmer-1; i++) {
-		monoseq[0] = kseq[i];
-		double count;
-		katss_get(mono, KATSS_DOUBLE, &count, monoseq);
-		monoprob *= count/mono->total;
-	}
-
-	/* Get probabilities for all di-mers in k-mer */
-	for(int i=0; i<kmer-1; i++) {
-		diseq[0] = kseq[i]; diseq[1] = kseq[i+1];
-		double count;
-		katss_get(dint, KATSS_DOUBLE, &count, diseq);
-		diprob *= count/dint->total;
-	}
-
-	/* Predicted k-mer probability is dinucleotides / overlapping monomers */
-	return diprob/monoprob;
-}
-
-
-uint64_t
-katss_predict_kmer(uint32_t hash, int kmer, KatssCounter *mono, KatssCounter *dint)
-{
-	double freq_pred = katss_predict_kmer_freq(hash, kmer, mono, dint);
-
-	uint64_t numseqs = 10000; // pick an arbitrary number of sequences
-	return (uint64_t)(freq_pred * (mono->total - (numseqs * (kmer-1))));
-}
-
-
 /*===================================
 |  Helper functions                 |
 ===================================*/
@@ -65,3 +65,77 @@ thread_safe_rand_r(thread_safe_rand_t *tsrand, unsigned int *seed)
 	}
 	return -1;
 }
+
+uint64_t
+splitmix64(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+unsigned int
+rand_replicate_seed(unsigned int seed, int replicate)
+{
+	uint64_t state = ((uint64_t)seed << 32) | (uint32_t)replicate;
+	return (unsigned int)(splitmix64(&state) >> 32);
+}
+
+static int
+draw(unsigned int *seed)
+{
+#ifdef _WIN32
+	rand_s(seed);
+	return (int)(*seed);
+#else
+	return rand_r(seed);
+#endif
+}
+
+static void
+draw_gap(rand_sampler *sampler)
+{
+	sampler->start = *sampler->seed;
+	sampler->gap = 0;
+	while(draw(sampler->seed) % 100000 >= sampler->sample)
+		sampler->gap++;
+	sampler->left = sampler->gap;
+}
+
+void
+rand_sampler_init(rand_sampler *sampler, int sample, unsigned int *seed)
+{
+	sampler->seed = seed;
+	sampler->sample = sample;
+	draw_gap(sampler);
+}
+
+uint64_t
+rand_sampler_gap(const rand_sampler *sampler)
+{
+	return sampler->left;
+}
+
+uint64_t
+rand_sampler_take(rand_sampler *sampler, uint64_t count)
+{
+	uint64_t sampled = 0;
+	while(sampler->left < count) {
+		count -= sampler->left + 1;
+		sampled++;
+		draw_gap(sampler);
+	}
+	sampler->left -= count;
+	return sampled;
+}
+
+void
+rand_sampler_end(rand_sampler *sampler)
+{
+	/* Draw again for the records that were there */
+	*sampler->seed = sampler->start;
+	for(uint64_t i = sampler->gap - sampler->left; i > 0; i--)
+		draw(sampler->seed);
+	sampler->gap = sampler->left = 0;
+}
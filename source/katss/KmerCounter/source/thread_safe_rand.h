@@ -1,6 +1,8 @@
 #ifndef THREAD_SAFE_RAND_H
 #define THREAD_SAFE_RAND_H
 
+#include <stdint.h>
+
 #if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
 #  include <threads.h>
 #else
@@ -63,4 +65,85 @@ int thread_safe_rand(thread_safe_rand_t *tsr);
  */
 int thread_safe_rand_r(thread_safe_rand_t *tsr, unsigned int *seed);
 
+
+
+/**
+ * @brief Advance a splitmix64 generator and return its next number.
+ * 
+ * @param state State of the generator, any value to start
+ * @return uint64_t Random number
+ */
+uint64_t splitmix64(uint64_t *state);
+
+
+/**
+ * @brief Seed of a replicate of a bootstrap seeded with `seed`.
+ * 
+ * Every replicate gets its own seed, mixed from `seed` and `replicate`, so the
+ * replicates can be drawn in any order, or at the same time, with the same
+ * result.
+ * 
+ * @param seed      Seed of the bootstrap
+ * @param replicate Index of the replicate
+ * @return unsigned int Seed of the replicate
+ */
+unsigned int rand_replicate_seed(unsigned int seed, int replicate);
+
+
+/* Subsamples a stream of records, keeping the same records as a draw for each of them */
+struct rand_sampler {
+	unsigned int *seed;
+	int sample;
+	unsigned int start;  /* Seed before drawing the current gap */
+	uint64_t gap;        /* Records skipped before the next sampled one */
+	uint64_t left;       /* Records of gap not skipped yet */
+};
+typedef struct rand_sampler rand_sampler;
+
+
+/**
+ * @brief Start subsampling records, each sampled if `rand_r(seed) % 100000 <
+ * sample`.
+ * 
+ * Instead of a draw for every record, the draws are made ahead up to the next
+ * sampled record, so the records before it can be skipped without reading
+ * them. The numbers drawn from seed are the same, and so are the records
+ * sampled.
+ * 
+ * @param sampler Sampler to initialize
+ * @param sample  Records to sample per 100000, between 1 and 100000
+ * @param seed    Seed to draw from, which is not locked
+ */
+void rand_sampler_init(rand_sampler *sampler, int sample, unsigned int *seed);
+
+
+/**
+ * @brief Number of records to skip before the next sampled one.
+ * 
+ * @param sampler Sampler to use
+ * @return uint64_t Number of records to skip
+ */
+uint64_t rand_sampler_gap(const rand_sampler *sampler);
+
+
+/**
+ * @brief Move past the next `count` records.
+ * 
+ * @param sampler Sampler to use
+ * @param count   Number of records to move past
+ * @return uint64_t How many of the records are sampled
+ */
+uint64_t rand_sampler_take(rand_sampler *sampler, uint64_t count);
+
+
+/**
+ * @brief Stop subsampling when there are no records left.
+ * 
+ * Leaves the seed as if a number was drawn for every record, which does not
+ * draw for the records past the end.
+ * 
+ * @param sampler Sampler to stop
+ */
+void rand_sampler_end(rand_sampler *sampler);
+
 #endif // THREAD_SAFE_RAND_H
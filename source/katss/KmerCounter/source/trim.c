@@ -0,0 +1,143 @@
+#include <string.h>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
+#include "memory_utils.h"
+#include "seqfile.h"
+#include "trim.h"
+
+#define PHRED_OFFSET 33
+
+bool
+trim_enabled(const KatssReadFilter *filter)
+{
+	return filter->adapter != NULL || filter->quality_cutoff > 0 || filter->mask_quality > 0 ||
+	       filter->min_length > 0;
+}
+
+
+static size_t
+popcount(unsigned int bits)
+{
+	size_t count = 0;
+	for(; bits; bits &= bits - 1)
+		count++;
+	return count;
+}
+
+
+/* Number of mismatches between the first length characters of read and adapter, stopping early
+   once there are more than max */
+static size_t
+mismatches(const char *read, const char *adapter, size_t length, size_t max)
+{
+	size_t count = 0, i = 0;
+#if defined(__SSE2__)
+	/* Compare 16 nucleotides at once */
+	for(; i + 16 <= length; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(read + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(adapter + i));
+		unsigned int equal = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+		count += popcount(~equal & 0xffffU);
+		if(count > max)
+			return count;
+	}
+#endif
+	for(; i < length && count <= max; i++)
+		count += read[i] != adapter[i];
+	return count;
+}
+
+
+/* Leftmost position the adapter (or, at the 3' end, a prefix of it) starts at, as in cutadapt's
+   3' adapters without indels. Returns length if it wasn't found. */
+static size_t
+find_adapter(const KatssReadFilter *filter, const char *read, size_t length)
+{
+	size_t adapter_length = strlen(filter->adapter);
+	size_t overlap = (size_t)MAX2(filter->adapter_overlap, 1);
+	overlap = MIN2(overlap, adapter_length);
+	for(size_t i = 0; i + overlap <= length; i++) {
+		size_t n = MIN2(adapter_length, length - i);
+		size_t max = (size_t)(n * filter->adapter_error);
+		if(mismatches(read + i, filter->adapter, n, max) <= max)
+			return i;
+	}
+	return length;
+}
+
+
+/* Length left after trimming the 3' end as in BWA: cut where the sum of the cutoff minus the
+   quality, from the 3' end, is largest */
+static size_t
+quality_trim(const char *quality, size_t length, int cutoff)
+{
+	long sum = 0, best = 0;
+	size_t cut = length;
+	for(size_t i = length; i-- > 0;) {
+		sum += cutoff - (quality[i] - PHRED_OFFSET);
+		if(sum < 0)
+			break;
+		if(sum > best) {
+			best = sum;
+			cut = i;
+		}
+	}
+	return cut;
+}
+
+
+size_t
+trim_read(const KatssReadFilter *filter, char *sequence, const char *quality, bool *adapter)
+{
+	size_t length = strlen(sequence);
+	bool has_quality = strnlen(quality, length) == length;
+
+	if(has_quality && filter->quality_cutoff > 0)
+		length = quality_trim(quality, length, filter->quality_cutoff);
+
+	*adapter = false;
+	if(filter->adapter != NULL && filter->adapter[0] != '\0') {
+		size_t start = find_adapter(filter, sequence, length);
+		*adapter = start < length;
+		length = start;
+	}
+
+	if(has_quality && filter->mask_quality > 0)
+		for(size_t i = 0; i < length; i++)
+			if(quality[i] - PHRED_OFFSET < filter->mask_quality)
+				sequence[i] = 'N';
+
+	sequence[length] = '\0';
+	return length;
+}
+
+
+bool
+trim_uses_quality(const KatssReadFilter *filter)
+{
+	return filter->quality_cutoff > 0 || filter->mask_quality > 0;
+}
+
+
+char *
+trim_next_read(SeqFile file, const KatssReadFilter *filter, char *buffer, char *quality,
+               size_t size, bool locked)
+{
+	if(filter == NULL)
+		return locked ? seqfgets(file, buffer, size) : seqfgets_unlocked(file, buffer, size);
+
+	/* Skip the reads left too short */
+	size_t min_length = (size_t)MAX2(filter->min_length, 0);
+	char *qual = trim_uses_quality(filter) ? quality : NULL;
+	size_t qsize = qual != NULL ? size : 0;
+	bool adapter;
+	while(locked ? seqfgetq(file, NULL, 0, buffer, size, qual, qsize) :
+	               seqfgetq_unlocked(file, NULL, 0, buffer, size, qual, qsize)) {
+		if(trim_read(filter, buffer, qual != NULL ? qual : "", &adapter) >= min_length)
+			return buffer;
+	}
+	return NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef KATSS_TRIM_H
+#define KATSS_TRIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "counter.h"
+#include "seqfile.h"
+
+/**
+ * @brief Whether the filter trims, masks or filters reads at all.
+ */
+bool trim_enabled(const KatssReadFilter *filter);
+
+
+/**
+ * @brief Trim a read in place: trim its low quality 3' end, then the 3' adapter, and mask its
+ * low quality nucleotides with 'N'. The quality steps are skipped if the read has no quality
+ * scores (quality is empty or shorter than the read).
+ *
+ * @param filter    Trimming options
+ * @param sequence  Null-terminated read, shortened in place
+ * @param quality   Null-terminated quality scores of the read (phred+33), or an empty string
+ * @param adapter   Set to whether the adapter was found in the read
+ * @return size_t Length of the trimmed read
+ */
+size_t trim_read(const KatssReadFilter *filter, char *sequence, const char *quality,
+                 bool *adapter);
+
+
+/**
+ * @brief Whether the filter needs the quality scores of the reads.
+ */
+bool trim_uses_quality(const KatssReadFilter *filter);
+
+
+/**
+ * @brief Read the next read of a file that is long enough once trimmed, trimmed in place, so
+ * files can be trimmed as they are counted. Reads as seqfgets does if filter is NULL.
+ *
+ * @param file      File to read, with its lock if locked is set
+ * @param filter    Trimming options, or NULL to not trim
+ * @param buffer    Buffer the read is written to
+ * @param quality   Buffer for the quality scores, only used if trim_uses_quality(filter)
+ * @param size      Size of buffer and quality
+ * @param locked    Whether other threads read the same file
+ * @return char* The trimmed read in buffer, or NULL once the file is read
+ */
+char *trim_next_read(SeqFile file, const KatssReadFilter *filter, char *buffer, char *quality,
+                     size_t size, bool locked);
+
+#endif // KATSS_TRIM_H
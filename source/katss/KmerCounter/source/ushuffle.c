@@ -37,6 +37,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "ushuffle.h"
+#include "thread_safe_rand.h"
 
 /* set random function */
 
@@ -50,11 +51,7 @@ void set_randfunc(randfunc_t func) {
 	randfunc = func;
 }
 
-/* global variables for the Euler algorithm */
-
-static const char *s_ = NULL;
-static int l_ = 0;
-static int k_ = 0;
+/* state of the Euler algorithm */
 
 typedef struct vertex {
 	int *indices;
@@ -64,10 +61,39 @@ typedef struct vertex {
 	int i_sequence;
 } vertex;
 
-static vertex *vertices = NULL;
-static int n_vertices;
-static int *indices = NULL;
-static int root;
+typedef struct hentry {
+	struct hentry *next;
+	int i_sequence;
+	int i_vertices;
+} hentry;
+
+struct ushuffle_state {
+	const char *s_;
+	int l_;
+	int k_;
+
+	vertex *vertices;
+	int n_vertices;
+	int *indices;
+	int root;
+
+	hentry *entries;
+	hentry **htable;
+	int htablesize;
+	double hmagic;
+
+	/* allocated sizes, kept from one sequence to the next */
+	int vertices_size;
+	int indices_size;
+	int entries_size;
+	int htable_size;
+
+	int global;	/* draw from rand() instead of rng */
+	uint64_t rng;
+};
+
+/* state used by shuffle(), shuffle1() and shuffle2() */
+static ushuffle_state global_state = { .global = 1 };
 
 /* memory utility */
 
@@ -81,89 +107,87 @@ static void *malloc0(size_t size) {
 	return memset(mem, 0, size);
 }
 
-/* hashtable utility */
+/* random number utility */
 
-typedef struct hentry {
-	struct hentry *next;
-	int i_sequence;
-	int i_vertices;
-} hentry;
+static int urand(ushuffle_state *st) {
+	if (st->global)
+		return rand();
+	return (int) (splitmix64(&st->rng) >> 33);
+}
 
-static hentry *entries = NULL;
-static hentry **htable = NULL;
-static int htablesize = 0;
-static double hmagic;
+/* hashtable utility */
 
-static int hcode(int i_sequence) {
+static int hcode(ushuffle_state *st, int i_sequence) {
 	double f = 0.0;
 	int i;
 
-	for (i = 0; i < k_ - 1; i++) {
-		f += s_[i_sequence + i];
-		f *= hmagic;
+	for (i = 0; i < st->k_ - 1; i++) {
+		f += st->s_[i_sequence + i];
+		f *= st->hmagic;
 	}
 	if (f < 0.0)
 		f = -f;
-	return (int) (htablesize * f) % htablesize;
+	return (int) (st->htablesize * f) % st->htablesize;
 }
 
-static void hinit(int size) {
-	entries = malloc0(size * sizeof(hentry));
-	htable = malloc0(size * sizeof(hentry *));
-	htablesize = size;
-	hmagic = (sqrt(5.0) - 1.0) / 2.0;
+/* grow a zeroed array of n elements of size bytes, reusing it if it is large enough */
+static void *realloc0(void *mem, int *capacity, int n, size_t size) {
+	if (n > *capacity) {
+		free(mem);
+		mem = malloc0(n * size);
+		*capacity = n;
+		return mem;
+	}
+	return memset(mem, 0, n * size);
 }
 
-static void hcleanup() {
-	free(entries);
-	entries = NULL;
-	free(htable);
-	htable = NULL;
-	htablesize = 0;
+static void hinit(ushuffle_state *st, int size) {
+	st->entries = realloc0(st->entries, &st->entries_size, size, sizeof(hentry));
+	st->htable = realloc0(st->htable, &st->htable_size, size, sizeof(hentry *));
+	st->htablesize = size;
+	st->hmagic = (sqrt(5.0) - 1.0) / 2.0;
 }
 
-static void hinsert(int i_sequence) {
-	int code = hcode(i_sequence);
-	hentry *e, *e2 = &entries[i_sequence];
+static void hinsert(ushuffle_state *st, int i_sequence) {
+	int code = hcode(st, i_sequence);
+	hentry *e, *e2 = &st->entries[i_sequence];
 
-	for (e = htable[code]; e; e = e->next)
-		if (strncmp(&s_[e->i_sequence], &s_[i_sequence], k_ - 1) == 0) {
+	for (e = st->htable[code]; e; e = e->next)
+		if (strncmp(&st->s_[e->i_sequence], &st->s_[i_sequence], st->k_ - 1) == 0) {
 			e2->i_sequence = e->i_sequence;
 			e2->i_vertices = e->i_vertices;
 			return;
 		}
 	e2->i_sequence = i_sequence;
-	e2->i_vertices = n_vertices++;
-	e2->next = htable[code];
-	htable[code] = e2;
+	e2->i_vertices = st->n_vertices++;
+	e2->next = st->htable[code];
+	st->htable[code] = e2;
 }
 
 /* the Euler algorithm */
 
-void shuffle1(const char *s, int l, int k) {
+void shuffle1_r(ushuffle_state *st, const char *s, int l, int k) {
 	int i, j, n_lets;
 
-	s_ = s;
-	l_ = l;
-	k_ = k;
-	if (k_ >= l_ || k_ <= 1)	/* two special cases */
+	st->s_ = s;
+	st->l_ = l;
+	st->k_ = k;
+	if (st->k_ >= st->l_ || st->k_ <= 1)	/* two special cases */
 		return;
 
 	/* use hashtable to find distinct vertices */
-	n_lets = l_ - k_ + 2;	/* number of (k-1)-lets */
-	n_vertices = 0;
-	hinit(n_lets);
+	n_lets = st->l_ - st->k_ + 2;	/* number of (k-1)-lets */
+	st->n_vertices = 0;
+	hinit(st, n_lets);
 	for (i = 0; i < n_lets; i++)
-		hinsert(i);
-	root = entries[n_lets - 1].i_vertices;	/* the last let */
-	if (vertices)
-		free(vertices);
-	vertices = malloc0(n_vertices * sizeof(vertex));
+		hinsert(st, i);
+	st->root = st->entries[n_lets - 1].i_vertices;	/* the last let */
+	st->vertices = realloc0(st->vertices, &st->vertices_size, st->n_vertices, sizeof(vertex));
 
 	/* set i_sequence and n_indices for each vertex */
 	for (i = 0; i < n_lets; i++) {	/* for each let */
-		hentry *ev = &entries[i];
-		vertex *v = &vertices[ev->i_vertices];
+		hentry *ev = &st->entries[i];
+		vertex *v = &st->vertices[ev->i_vertices];
 
 		v->i_sequence = ev->i_sequence;
 		if (i < n_lets - 1)	/* not the last let */
@@ -171,109 +195,142 @@ void shuffle1(const char *s, int l, int k) {
 	}
 
 	/* distribute indices for each vertex */
-	if (indices)
-		free(indices);
-	indices = malloc0((n_lets - 1) * sizeof(int));
+	st->indices = realloc0(st->indices, &st->indices_size, n_lets - 1, sizeof(int));
 	j = 0;
-	for (i = 0; i < n_vertices; i++) {	/* for each vertex */
-		vertex *v = &vertices[i];
+	for (i = 0; i < st->n_vertices; i++) {	/* for each vertex */
+		vertex *v = &st->vertices[i];
 
-		v->indices = indices + j;
+		v->indices = st->indices + j;
 		j += v->n_indices;
 	}
 
 	/* populate indices for each vertex */
 	for (i = 0; i < n_lets - 1; i++) {	/* for each edge */
-		hentry *eu = &entries[i];
-		hentry *ev = &entries[i + 1];
-		vertex *u = &vertices[eu->i_vertices];
+		hentry *eu = &st->entries[i];
+		hentry *ev = &st->entries[i + 1];
+		vertex *u = &st->vertices[eu->i_vertices];
 
 		u->indices[u->i_indices++] = ev->i_vertices;
 	}
-	hcleanup();
 }
 
-void permutec(char *t, int l) {
+void shuffle1(const char *s, int l, int k) {
+	shuffle1_r(&global_state, s, l, k);
+}
+
+static void permutec_r(ushuffle_state *st, char *t, int l) {
 	int i, j;
 	char tmp;
 
 	for (i = l - 1; i > 0; i--) {
-		j = rand() % (i + 1);
+		j = urand(st) % (i + 1);
 		tmp = t[i]; t[i] = t[j]; t[j] = tmp;	/* swap */
 	}
 }
 
-static void permutei(int *t, int l) {
+void permutec(char *t, int l) {
+	permutec_r(&global_state, t, l);
+}
+
+static void permutei(ushuffle_state *st, int *t, int l) {
 	int i, j;
 	int tmp;
 
 	for (i = l - 1; i > 0; i--) {
-		j = rand() % (i + 1);
+		j = urand(st) % (i + 1);
 		tmp = t[i]; t[i] = t[j]; t[j] = tmp;	/* swap */
 	}
 }
 
-void shuffle2(char *t) {
+void shuffle2_r(ushuffle_state *st, char *t) {
 	vertex *u, *v;
 	int i, j;
 
 	/* exact copy case */
-	if (k_ >= l_) {
-		strncpy(t, s_, l_);
+	if (st->k_ >= st->l_) {
+		strncpy(t, st->s_, st->l_);
 		return;
 	}
 
 	/* simple permutation case */
-	if (k_ <= 1) {
-		strncpy(t, s_, l_);
-		permutec(t, l_);
+	if (st->k_ <= 1) {
+		strncpy(t, st->s_, st->l_);
+		permutec_r(st, t, st->l_);
 		return;
 	}
 
 	/* the Wilson algorithm for random arborescence */
-	for (i = 0; i < n_vertices; i++)
-		vertices[i].intree = 0;
-	vertices[root].intree = 1;
-	for (i = 0; i < n_vertices; i++) {
-		u = &vertices[i];
+	for (i = 0; i < st->n_vertices; i++)
+		st->vertices[i].intree = 0;
+	st->vertices[st->root].intree = 1;
+	for (i = 0; i < st->n_vertices; i++) {
+		u = &st->vertices[i];
 		while (!u->intree) {
-			u->next = rand() % u->n_indices;
-			u = &vertices[u->indices[u->next]];
+			u->next = urand(st) % u->n_indices;
+			u = &st->vertices[u->indices[u->next]];
 		}
-		u = &vertices[i];
+		u = &st->vertices[i];
 		while (!u->intree) {
 			u->intree = 1;
-			u = &vertices[u->indices[u->next]];
+			u = &st->vertices[u->indices[u->next]];
 		}
 	}
 
 	/* shuffle indices to prepare for walk */
-	for (i = 0; i < n_vertices; i++) {
-		u = &vertices[i];
-		if (i != root) {
+	for (i = 0; i < st->n_vertices; i++) {
+		u = &st->vertices[i];
+		if (i != st->root) {
 			j = u->indices[u->n_indices - 1];	/* swap the last one */
 			u->indices[u->n_indices - 1] = u->indices[u->next];
 			u->indices[u->next] = j;
-			permutei(u->indices, u->n_indices - 1);	/* permute the rest */
+			permutei(st, u->indices, u->n_indices - 1);	/* permute the rest */
 		} else
-			permutei(u->indices, u->n_indices);
+			permutei(st, u->indices, u->n_indices);
 		u->i_indices = 0;	/* reset to zero before walk */
 	}
 
 	/* walk the graph */
-	strncpy(t, s_, k_ - 1);	/* the first let remains the same */
-	u = &vertices[0];
-	i = k_ - 1;
+	strncpy(t, st->s_, st->k_ - 1);	/* the first let remains the same */
+	u = &st->vertices[0];
+	i = st->k_ - 1;
 	while (u->i_indices < u->n_indices) {
-		v = &vertices[u->indices[u->i_indices]];
-		j = v->i_sequence + k_ - 2;
-		t[i++] = s_[j];
+		v = &st->vertices[u->indices[u->i_indices]];
+		j = v->i_sequence + st->k_ - 2;
+		t[i++] = st->s_[j];
 		u->i_indices++;
 		u = v;
 	}
 }
 
+void shuffle2(char *t) {
+	shuffle2_r(&global_state, t);
+}
+
 void shuffle(const char *s, char *t, int l, int k) {
 	shuffle1(s, l, k);
 	shuffle2(t);
 }
+
+/* reentrant interface */
+
+ushuffle_state *ushuffle_create(uint64_t seed) {
+	ushuffle_state *st = malloc0(sizeof(ushuffle_state));
+
+	st->rng = seed;
+	return st;
+}
+
+void ushuffle_free(ushuffle_state *st) {
+	if (st == NULL)
+		return;
+	free(st->vertices);
+	free(st->indices);
+	free(st->entries);
+	free(st->htable);
+	free(st);
+}
+
+void shuffle_r(ushuffle_state *st, const char *s, char *t, int l, int k) {
+	shuffle1_r(st, s, l, k);
+	shuffle2_r(st, t);
+}
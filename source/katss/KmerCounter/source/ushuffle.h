@@ -31,6 +31,8 @@
  *	Mon Apr 23 14:35:21 MDT 2007
  */
 
+#include <stdint.h>
+
 void shuffle(const char *s, char *t, int l, int k);
 void shuffle1(const char *s, int l, int k);
 void shuffle2(char *t);
@@ -44,3 +46,24 @@ typedef long (*randfunc_t)();
 void set_randfunc(randfunc_t randfunc);
 
 void permutec(char *t, int l);	/* for use by test.c */
+
+/*
+ *	Reentrant interface: every state has its own tables and its own random
+ *	numbers, drawn from seed, so states can shuffle in different threads.
+ *	shuffle() and the functions above share a global state drawing from rand().
+ */
+
+typedef struct ushuffle_state ushuffle_state;
+
+ushuffle_state *ushuffle_create(uint64_t seed);
+void ushuffle_free(ushuffle_state *state);
+void shuffle_r(ushuffle_state *state, const char *s, char *t, int l, int k);
+
+/*
+ *	As shuffle1() and shuffle2(): shuffle1_r() builds the graph of s once, and
+ *	every call to shuffle2_r() then draws another shuffle of it. s must not
+ *	change in between. The arrays of a state are reused from one s to the next.
+ */
+
+void shuffle1_r(ushuffle_state *state, const char *s, int l, int k);
+void shuffle2_r(ushuffle_state *state, char *t);
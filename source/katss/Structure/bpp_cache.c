@@ -0,0 +1,421 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory_utils.h"
+
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
+#  include <threads.h>
+#else
+#  include <tinycthread.h>
+#endif
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include "bpp_cache.h"
+
+#define CACHE_VERSION 2
+#define BYTE_ORDER_MARK 0x01020304U
+#define CHUNK_SIZE 65536
+
+struct cache_header {
+	char     magic[4];      /* "KBPP"                                  */
+	uint32_t byte_order;    /* BYTE_ORDER_MARK in the writer's order   */
+	uint32_t version;
+	uint32_t bits;          /* Bits per quantized probability          */
+	uint32_t params_crc;    /* Checksum of the fold parameters         */
+	uint32_t source_crc;    /* Checksum of the source file             */
+	uint64_t source_size;   /* Size of the source file in bytes        */
+	uint64_t num_records;
+};
+
+struct BppCacheWriter {
+	FILE     *file;
+	char     *path;
+	char     *tmp_path;
+	struct cache_header header;
+	unsigned char *buffer;  /* Record being encoded */
+	size_t   capacity;
+	bool     failed;
+	mtx_t    lock;
+};
+
+struct BppCache {
+	unsigned char *data;
+	size_t   size;
+	size_t   offset;        /* Offset of the next record               */
+	uint64_t remaining;     /* Number of records left to read          */
+	int      bits;
+	bool     mapped;
+	char     *sequence;     /* Decoded sequence of the current record  */
+	float    *probabilities;
+	size_t   capacity;
+};
+
+static uint32_t crc_table[256];
+static once_flag crc_table_flag = ONCE_FLAG_INIT;
+
+static void
+init_crc_table(void)
+{
+	for(uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i;
+		for(int j = 0; j < 8; j++)
+			crc = (crc & 1) ? 0xEDB88320U ^ (crc >> 1) : crc >> 1;
+		crc_table[i] = crc;
+	}
+}
+
+
+uint32_t
+bpp_cache_crc32(uint32_t crc, const void *data, size_t length)
+{
+	const unsigned char *bytes = data;
+
+	call_once(&crc_table_flag, init_crc_table);
+	crc = ~crc;
+	for(size_t i = 0; i < length; i++)
+		crc = crc_table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+
+static int
+source_checksum(const char *source_file, uint32_t *crc, uint64_t *size)
+{
+	FILE *file = fopen(source_file, "rb");
+	if(file == NULL)
+		return 1;
+
+	unsigned char *chunk = s_malloc(CHUNK_SIZE);
+	size_t read;
+	*crc = 0;
+	*size = 0;
+	while((read = fread(chunk, 1, CHUNK_SIZE, file)) > 0) {
+		*crc = bpp_cache_crc32(*crc, chunk, read);
+		*size += read;
+	}
+
+	int status = ferror(file);
+	free(chunk);
+	fclose(file);
+	return status;
+}
+
+
+static int
+nucleotide_code(char nucleotide)
+{
+	switch(nucleotide) {
+		case 'A': return 0;
+		case 'C': return 1;
+		case 'G': return 2;
+		case 'U': return 3;
+		default:  return -1;
+	}
+}
+
+
+BppCacheWriter *
+bpp_cache_create(const char *path, const char *source_file, uint32_t params_crc, int bits)
+{
+	BppCacheWriter *writer = s_malloc(sizeof *writer);
+	memset(&writer->header, 0, sizeof writer->header);
+	memcpy(writer->header.magic, "KBPP", 4);
+	writer->header.byte_order = BYTE_ORDER_MARK;
+	writer->header.version = CACHE_VERSION;
+	writer->header.bits = bits == 8 ? 8 : 16;
+	writer->header.params_crc = params_crc;
+	if(source_checksum(source_file, &writer->header.source_crc, &writer->header.source_size)) {
+		error_message("katss: Could not read '%s' to create its fold cache", source_file);
+		free(writer);
+		return NULL;
+	}
+
+	writer->path = strdup(path);
+	writer->tmp_path = s_malloc(strlen(path) + 5);
+	sprintf(writer->tmp_path, "%s.tmp", path);
+	writer->file = fopen(writer->tmp_path, "wb");
+	if(writer->file == NULL) {
+		error_message("katss: Could not write fold cache '%s'", writer->tmp_path);
+		free(writer->path);
+		free(writer->tmp_path);
+		free(writer);
+		return NULL;
+	}
+
+	/* Placeholder, rewritten with the number of records once finished */
+	writer->failed = fwrite(&writer->header, sizeof writer->header, 1, writer->file) != 1;
+	writer->buffer = NULL;
+	writer->capacity = 0;
+	mtx_init(&writer->lock, mtx_plain);
+
+	return writer;
+}
+
+
+void
+bpp_cache_append(BppCacheWriter *writer, const char *sequence, uint64_t id, uint32_t count,
+                 const float *probabilities)
+{
+	uint32_t length = strlen(sequence);
+	uint32_t num_other = 0;
+	size_t   width = writer->header.bits / 8;
+	uint32_t max_value = (1U << writer->header.bits) - 1;
+
+	for(uint32_t i = 0; i < length; i++)
+		if(nucleotide_code(sequence[i]) < 0)
+			num_other++;
+
+	mtx_lock(&writer->lock);
+	size_t record_size = 3 * sizeof(uint32_t) + sizeof(uint64_t) +
+	                     num_other * (sizeof(uint32_t) + 1) + (length + 3) / 4 + length * width;
+	if(record_size > writer->capacity) {
+		writer->capacity = record_size;
+		writer->buffer = s_realloc(writer->buffer, record_size);
+	}
+
+	unsigned char *ptr = writer->buffer;
+	memcpy(ptr, &length, sizeof length);       ptr += sizeof length;
+	memcpy(ptr, &id, sizeof id);               ptr += sizeof id;
+	memcpy(ptr, &count, sizeof count);         ptr += sizeof count;
+	memcpy(ptr, &num_other, sizeof num_other); ptr += sizeof num_other;
+
+	/* Positions and characters that can't be packed in 2 bits */
+	unsigned char *characters = ptr + num_other * sizeof(uint32_t);
+	for(uint32_t i = 0; i < length; i++) {
+		if(nucleotide_code(sequence[i]) < 0) {
+			memcpy(ptr, &i, sizeof i);
+			ptr += sizeof i;
+			*characters++ = (unsigned char)sequence[i];
+		}
+	}
+	ptr = characters;
+
+	/* Pack four nucleotides per byte, first nucleotide in the highest bits */
+	memset(ptr, 0, (length + 3) / 4);
+	for(uint32_t i = 0; i < length; i++) {
+		int code = nucleotide_code(sequence[i]);
+		ptr[i / 4] |= (unsigned char)((code < 0 ? 0 : code) << (6 - 2 * (i % 4)));
+	}
+	ptr += (length + 3) / 4;
+
+	/* Quantize the probabilities */
+	for(uint32_t i = 0; i < length; i++) {
+		float probability = probabilities[i];
+		probability = probability < 0.F ? 0.F : (probability > 1.F ? 1.F : probability);
+		uint32_t value = (uint32_t)(probability * max_value + 0.5F);
+		if(width == 1) {
+			*ptr++ = (unsigned char)value;
+		} else {
+			uint16_t value16 = (uint16_t)value;
+			memcpy(ptr, &value16, sizeof value16);
+			ptr += sizeof value16;
+		}
+	}
+
+	if(!writer->failed && fwrite(writer->buffer, record_size, 1, writer->file) != 1)
+		writer->failed = true;
+	writer->header.num_records++;
+	mtx_unlock(&writer->lock);
+}
+
+
+int
+bpp_cache_finish(BppCacheWriter *writer)
+{
+	int status = writer->failed;
+
+	if(!status) {
+		status = fseek(writer->file, 0, SEEK_SET) != 0 ||
+		         fwrite(&writer->header, sizeof writer->header, 1, writer->file) != 1;
+	}
+	status |= fclose(writer->file) != 0;
+
+	if(!status) {
+		remove(writer->path);
+		status = rename(writer->tmp_path, writer->path) != 0;
+	}
+	if(status) {
+		error_message("katss: Could not write fold cache '%s'", writer->path);
+		remove(writer->tmp_path);
+	}
+
+	mtx_destroy(&writer->lock);
+	free(writer->buffer);
+	free(writer->path);
+	free(writer->tmp_path);
+	free(writer);
+	return status;
+}
+
+
+static unsigned char *
+load_file(const char *path, size_t *size, bool *mapped)
+{
+	*mapped = false;
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return NULL;
+
+	struct stat info;
+	if(fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(struct cache_header)) {
+		close(fd);
+		return NULL;
+	}
+	*size = (size_t)info.st_size;
+
+	void *data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data != MAP_FAILED) {
+		*mapped = true;
+		return data;
+	}
+#endif
+
+	/* Read the whole file where mapping is unavailable */
+	FILE *file = fopen(path, "rb");
+	if(file == NULL)
+		return NULL;
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if(length < (long)sizeof(struct cache_header)) {
+		fclose(file);
+		return NULL;
+	}
+
+	*size = (size_t)length;
+	unsigned char *data_read = s_malloc(*size);
+	if(fread(data_read, 1, *size, file) != *size) {
+		free(data_read);
+		data_read = NULL;
+	}
+	fclose(file);
+	return data_read;
+}
+
+
+BppCache *
+bpp_cache_open(const char *path, const char *source_file, uint32_t params_crc, int bits)
+{
+	struct cache_header header;
+	uint32_t source_crc;
+	uint64_t source_size;
+
+	BppCache *cache = s_malloc(sizeof *cache);
+	cache->data = load_file(path, &cache->size, &cache->mapped);
+	cache->sequence = NULL;
+	cache->probabilities = NULL;
+	cache->capacity = 0;
+	if(cache->data == NULL)
+		goto stale;
+
+	/* Check the cache was folded from the same file with the same parameters */
+	memcpy(&header, cache->data, sizeof header);
+	if(memcmp(header.magic, "KBPP", 4) != 0 || header.byte_order != BYTE_ORDER_MARK ||
+	   header.version != CACHE_VERSION || header.params_crc != params_crc ||
+	   header.bits != (uint32_t)bits)
+		goto stale;
+	if(source_checksum(source_file, &source_crc, &source_size) ||
+	   source_size != header.source_size || source_crc != header.source_crc)
+		goto stale;
+
+	cache->offset = sizeof header;
+	cache->remaining = header.num_records;
+	cache->bits = (int)header.bits;
+	return cache;
+
+stale:
+	bpp_cache_free(cache);
+	return NULL;
+}
+
+
+char *
+bpp_cache_next(BppCache *cache, uint64_t *id, uint32_t *count, float **probabilities)
+{
+	uint32_t length, num_other;
+	size_t   width = cache->bits / 8;
+	float    max_value = (float)((1U << cache->bits) - 1);
+
+	if(cache->remaining == 0 ||
+	   cache->size - cache->offset < 3 * sizeof(uint32_t) + sizeof(uint64_t))
+		return NULL;
+
+	unsigned char *ptr = cache->data + cache->offset;
+	memcpy(&length, ptr, sizeof length);       ptr += sizeof length;
+	memcpy(id, ptr, sizeof *id);               ptr += sizeof *id;
+	memcpy(count, ptr, sizeof *count);         ptr += sizeof *count;
+	memcpy(&num_other, ptr, sizeof num_other); ptr += sizeof num_other;
+
+	size_t record_size = 3 * sizeof(uint32_t) + sizeof(uint64_t) +
+	                     (size_t)num_other * (sizeof(uint32_t) + 1) +
+	                     ((size_t)length + 3) / 4 + (size_t)length * width;
+	if(record_size > cache->size - cache->offset || num_other > length) {
+		error_message("katss: Fold cache is truncated");
+		cache->remaining = 0;
+		return NULL;
+	}
+
+	if(length + 1 > cache->capacity) {
+		cache->capacity = length + 1;
+		cache->sequence = s_realloc(cache->sequence, cache->capacity);
+		cache->probabilities = s_realloc(cache->probabilities,
+		                                 cache->capacity * sizeof *cache->probabilities);
+	}
+
+	/* Unpack the nucleotides, then put back the characters that were not packed */
+	unsigned char *packed = ptr + (size_t)num_other * (sizeof(uint32_t) + 1);
+	for(uint32_t i = 0; i < length; i++)
+		cache->sequence[i] = "ACGU"[(packed[i / 4] >> (6 - 2 * (i % 4))) & 3];
+	cache->sequence[length] = '\0';
+	for(uint32_t i = 0; i < num_other; i++) {
+		uint32_t position;
+		memcpy(&position, ptr + i * sizeof position, sizeof position);
+		if(position < length)
+			cache->sequence[position] = (char)ptr[num_other * sizeof position + i];
+	}
+
+	unsigned char *values = packed + (length + 3) / 4;
+	for(uint32_t i = 0; i < length; i++) {
+		if(width == 1) {
+			cache->probabilities[i] = values[i] / max_value;
+		} else {
+			uint16_t value16;
+			memcpy(&value16, values + 2 * i, sizeof value16);
+			cache->probabilities[i] = value16 / max_value;
+		}
+	}
+
+	cache->offset += record_size;
+	cache->remaining--;
+	*probabilities = cache->probabilities;
+	return cache->sequence;
+}
+
+
+void
+bpp_cache_free(BppCache *cache)
+{
+	if(cache == NULL)
+		return;
+
+#ifndef _WIN32
+	if(cache->mapped)
+		munmap(cache->data, cache->size);
+	else
+		free(cache->data);
+#else
+	free(cache->data);
+#endif
+	free(cache->sequence);
+	free(cache->probabilities);
+	free(cache);
+}
@@ -0,0 +1,117 @@
+#ifndef BPP_CACHE_H
+#define BPP_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ *  @brief Binary sidecar with the positional base-pair probabilities of every read of a file,
+ *  so a file only has to be folded once no matter the k-mer length.
+ *
+ *  The file starts with a fixed header holding the CRC-32 of the source file and of the fold
+ *  parameters, followed by one record per (distinct) read:
+ *
+ *      uint32  length          Number of nucleotides in the read
+ *      uint64  id              Index of the read in its file, 0 for distinct sequences
+ *      uint32  count           Number of reads the record stands for
+ *      uint32  num_other       Number of characters that are not A, C, G, or U
+ *      uint32  position[num_other]
+ *      char    character[num_other]
+ *      uint8   packed[(length + 3) / 4]    Read packed with 2 bits per nucleotide
+ *      uintN_t probability[length]         Quantized probabilities, N = 8 or 16
+ *
+ *  Values are stored in the byte order of the machine that wrote the cache; caches written on a
+ *  machine with a different byte order are treated as stale.
+*/
+typedef struct BppCacheWriter BppCacheWriter;
+typedef struct BppCache BppCache;
+
+
+/**
+ *  @brief Update a CRC-32 checksum with the given bytes.
+ *
+ *  @param crc      Checksum of the preceding bytes, or 0 for the first call.
+ *  @param data     Bytes to add to the checksum.
+ *  @param length   Number of bytes in data.
+ *
+ *  @return Updated checksum
+*/
+uint32_t bpp_cache_crc32(uint32_t crc, const void *data, size_t length);
+
+
+/**
+ *  @brief Start writing a cache for source_file. Records are written to a temporary file, which
+ *  only replaces path once bpp_cache_finish succeeds.
+ *
+ *  @param path         Name of the cache file.
+ *  @param source_file  File the reads come from.
+ *  @param params_crc   Checksum of the parameters used to fold the reads.
+ *  @param bits         Bits used to store each probability, either 8 or 16.
+ *
+ *  @return Pointer to the writer, or NULL if the cache could not be created.
+*/
+BppCacheWriter *bpp_cache_create(const char *path, const char *source_file,
+                                 uint32_t params_crc, int bits);
+
+
+/**
+ *  @brief Append the probabilities of a read to the cache. This function is thread-safe.
+ *
+ *  @param writer           Cache to append to.
+ *  @param sequence         Null-terminated read.
+ *  @param id               Index of the read in its file, 0 for distinct sequences.
+ *  @param count            Number of reads the sequence stands for.
+ *  @param probabilities    One probability per nucleotide of sequence.
+*/
+void bpp_cache_append(BppCacheWriter *writer, const char *sequence, uint64_t id,
+                      uint32_t count, const float *probabilities);
+
+
+/**
+ *  @brief Finish writing the cache and move it into place. The writer is freed.
+ *
+ *  @param writer   Cache to finish.
+ *
+ *  @return 0 on success, non-zero if the cache could not be written.
+*/
+int bpp_cache_finish(BppCacheWriter *writer);
+
+
+/**
+ *  @brief Open a cache if it matches both the source file and the fold parameters. The cache is
+ *  memory-mapped where supported.
+ *
+ *  @param path         Name of the cache file.
+ *  @param source_file  File the reads come from.
+ *  @param params_crc   Checksum of the parameters used to fold the reads.
+ *  @param bits         Bits used to store each probability, either 8 or 16.
+ *
+ *  @return Pointer to the cache, or NULL if it does not exist or is stale.
+*/
+BppCache *bpp_cache_open(const char *path, const char *source_file, uint32_t params_crc,
+                         int bits);
+
+
+/**
+ *  @brief Get the next record in the cache. The returned buffers are owned by the cache and are
+ *  overwritten on the next call.
+ *
+ *  @param cache            Cache to read from.
+ *  @param id               Set to the index of the read in its file.
+ *  @param count            Set to the number of reads the sequence stands for.
+ *  @param probabilities    Set to the probability of each nucleotide.
+ *
+ *  @return The next sequence, or NULL once all records were read.
+*/
+char *bpp_cache_next(BppCache *cache, uint64_t *id, uint32_t *count, float **probabilities);
+
+
+/**
+ *  @brief Unmap and free a cache opened with bpp_cache_open.
+ *
+ *  @param cache    Cache to free.
+*/
+void bpp_cache_free(BppCache *cache);
+
+#endif // BPP_CACHE_H
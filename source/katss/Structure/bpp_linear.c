@@ -0,0 +1,723 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ViennaRNA/model.h>
+#include <ViennaRNA/params/basic.h>
+#include <ViennaRNA/utils/structures.h>
+
+#include "bpp_linear.h"
+#include "memory_utils.h"
+
+/* Largest number of unpaired nucleotides in an interior loop, and before the first branch of a
+   multiloop (ViennaRNA's MAXLOOP) */
+#define MAX_LOOP 30
+
+/* Smallest number of unpaired nucleotides in a hairpin */
+#define MIN_HAIRPIN 3
+
+/* Largest asymmetry penalty of an interior loop (ViennaRNA's MAX_NINIO) */
+#define MAX_NINIO 300
+
+/* Gas constant in cal/(mol K) and 0 degrees Celsius in Kelvin, as used by ViennaRNA */
+#define GAS_CONSTANT 1.98717
+#define ZERO_CELSIUS 273.15
+
+#define MIN_PAIR_PROBABILITY 1e-6
+
+/* Inside (alpha) and outside (beta) log partition functions of the state of nucleotide i */
+struct beam_state {
+	int    i;
+	double alpha;
+	double beta;
+};
+typedef struct beam_state beam_state;
+
+/* States ending at one nucleotide, in the order they were added, and indexed by i in an
+   open-addressed table */
+struct beam_map {
+	beam_state *states;
+	int        num_states;
+	int        max_states;
+	int        *slots;      /* Index of the state plus one, 0 for an empty slot */
+	int        capacity;    /* Number of slots, a power of two */
+};
+typedef struct beam_map beam_map;
+
+struct linear_fold {
+	int          length;
+	char         *sequence;   /* Upper case copy of the sequence, with U instead of T */
+	int          *nucs;       /* ViennaRNA encoding: A 1, C 2, G 3, U 4, anything else 0 */
+	int          *next_pair;  /* First nucleotide after j that pairs with nuc, at [nuc][j] */
+	vrna_param_t *params;
+	double       scale;       /* Converts energies in dcal/mol into log Boltzmann weights */
+	int          beam_size;
+
+	beam_map     *hairpin;    /* H[j]: i and j close a hairpin */
+	beam_map     *pair;       /* P[j]: i and j are paired */
+	beam_map     *multi;      /* M[j]: one or more branches of a multiloop from i to j */
+	beam_map     *multi2;     /* M2[j]: two or more branches of a multiloop from i to j */
+	beam_map     *closing;    /* Multi[j]: i and j could close a multiloop holding an M2 */
+	double       *prefix_alpha;  /* C[j]: log partition function of the first j nucleotides */
+	double       *prefix_beta;
+};
+typedef struct linear_fold linear_fold;
+
+/* Reverse of each pair type */
+static const int reverse_type[8] = {0, 2, 1, 4, 3, 6, 5, 7};
+
+static int
+encode(char nucleotide)
+{
+	switch(nucleotide) {
+		case 'A': case 'a':           return 1;
+		case 'C': case 'c':           return 2;
+		case 'G': case 'g':           return 3;
+		case 'U': case 'u':
+		case 'T': case 't':           return 4;
+		default:                      return 0;
+	}
+}
+
+/* ViennaRNA pair types: CG 1, GC 2, GU 3, UG 4, AU 5, UA 6, 0 if they can't pair */
+static int
+pair_type(int a, int b)
+{
+	static const int types[5][5] = {
+		{0, 0, 0, 0, 0},
+		{0, 0, 0, 0, 5},
+		{0, 0, 0, 1, 0},
+		{0, 0, 2, 0, 3},
+		{0, 6, 0, 4, 0},
+	};
+	return types[a][b];
+}
+
+/* Beyond this difference of two log values, the smaller one is lost to rounding */
+#define LOG_ADD_CUTOFF 37.
+
+static void
+log_add(double *x, double y)
+{
+	double difference = y - *x;
+	if(difference <= -LOG_ADD_CUTOFF || y == -INFINITY)
+		return;
+	if(difference >= LOG_ADD_CUTOFF || *x == -INFINITY)
+		*x = y;
+	else if(difference <= 0.)
+		*x += log1p(exp(difference));
+	else
+		*x = y + log1p(exp(-difference));
+}
+
+static int
+nucleotide(const linear_fold *fold, int position)
+{
+	return position >= 0 && position < fold->length ? fold->nucs[position] : -1;
+}
+
+static int
+next_pair(const linear_fold *fold, int nuc, int j)
+{
+	return fold->next_pair[nuc * fold->length + j];
+}
+
+
+/* ----------------------------------------------------------------------------------------- */
+/* Loop energies, following ViennaRNA's E_Hairpin, E_IntLoop, E_MLstem and E_ExtLoop          */
+/* ----------------------------------------------------------------------------------------- */
+
+static int
+loop_extrapolation(const int *table, int size, double lxc)
+{
+	if(size <= MAX_LOOP)
+		return table[size];
+	return table[MAX_LOOP] + (int)(lxc * log(size / (double)MAX_LOOP));
+}
+
+/* Look up a special hairpin of size + 2 nucleotides starting at i */
+static const char *
+special_hairpin(const linear_fold *fold, int i, int size, const char *loops, int stride)
+{
+	char loop[16];
+	memcpy(loop, fold->sequence + i, size + 2);
+	loop[size + 2] = '\0';
+	const char *found = strstr(loops, loop);
+	return found != NULL && (found - loops) % stride == 0 ? found : NULL;
+}
+
+static int
+hairpin_energy(const linear_fold *fold, int i, int j)
+{
+	vrna_param_t *P = fold->params;
+	int type = pair_type(fold->nucs[i], fold->nucs[j]);
+	int size = j - i - 1;
+	int energy = loop_extrapolation(P->hairpin, size, P->lxc);
+	const char *loop;
+
+	if(P->model_details.special_hp) {
+		if(size == 4 && (loop = special_hairpin(fold, i, size, P->Tetraloops, 7)) != NULL)
+			return P->Tetra_E[(loop - P->Tetraloops) / 7];
+		if(size == 6 && (loop = special_hairpin(fold, i, size, P->Hexaloops, 9)) != NULL)
+			return P->Hexa_E[(loop - P->Hexaloops) / 9];
+		if(size == 3) {
+			if((loop = special_hairpin(fold, i, size, P->Triloops, 6)) != NULL)
+				return P->Triloop_E[(loop - P->Triloops) / 6];
+			return energy + (type > 2 ? P->TerminalAU : 0);
+		}
+	}
+
+	return energy + P->mismatchH[type][fold->nucs[i + 1]][fold->nucs[j - 1]];
+}
+
+/* Interior loop, bulge or stack closed by (i, j) around the pair (p, q) */
+static int
+interior_energy(const linear_fold *fold, int i, int j, int p, int q)
+{
+	vrna_param_t *P = fold->params;
+	const int *nucs = fold->nucs;
+	int type   = pair_type(nucs[i], nucs[j]);
+	int type_2 = reverse_type[pair_type(nucs[p], nucs[q])];
+	int n1 = p - i - 1, n2 = j - q - 1;
+	int nl = MAX2(n1, n2), ns = MIN2(n1, n2);
+	int si1 = nucs[i + 1], sj1 = nucs[j - 1], sp1 = nucs[p - 1], sq1 = nucs[q + 1];
+	int energy;
+
+	if(nl == 0)
+		return P->stack[type][type_2];
+
+	/* Bulge */
+	if(ns == 0) {
+		energy = loop_extrapolation(P->bulge, nl, P->lxc);
+		if(nl == 1) {
+			energy += P->stack[type][type_2];
+		} else {
+			if(type > 2)
+				energy += P->TerminalAU;
+			if(type_2 > 2)
+				energy += P->TerminalAU;
+		}
+		return energy;
+	}
+
+	if(ns == 1) {
+		if(nl == 1)
+			return P->int11[type][type_2][si1][sj1];
+		if(nl == 2) {
+			if(n1 == 1)
+				return P->int21[type][type_2][si1][sq1][sj1];
+			return P->int21[type_2][type][sq1][si1][sp1];
+		}
+		energy = loop_extrapolation(P->internal_loop, nl + 1, P->lxc);
+		energy += MIN2(MAX_NINIO, (nl - ns) * P->ninio[2]);
+		return energy + P->mismatch1nI[type][si1][sj1] + P->mismatch1nI[type_2][sq1][sp1];
+	}
+
+	if(ns == 2) {
+		if(nl == 2)
+			return P->int22[type][type_2][si1][sp1][sq1][sj1];
+		if(nl == 3) {
+			energy = P->internal_loop[5] + P->ninio[2];
+			return energy + P->mismatch23I[type][si1][sj1] + P->mismatch23I[type_2][sq1][sp1];
+		}
+	}
+
+	energy = loop_extrapolation(P->internal_loop, nl + ns, P->lxc);
+	energy += MIN2(MAX_NINIO, (nl - ns) * P->ninio[2]);
+	return energy + P->mismatchI[type][si1][sj1] + P->mismatchI[type_2][sq1][sp1];
+}
+
+/* Dangles of a helix end of the given type, with dangles=2 */
+static int
+dangle_energy(const linear_fold *fold, int mismatch[5][5], int dangle5[5],
+              int dangle3[5], int type, int si1, int sj1)
+{
+	int energy = 0;
+	if(si1 >= 0 && sj1 >= 0)
+		energy = mismatch[si1][sj1];
+	else if(si1 >= 0)
+		energy = dangle5[si1];
+	else if(sj1 >= 0)
+		energy = dangle3[sj1];
+	if(type > 2)
+		energy += fold->params->TerminalAU;
+	return energy;
+}
+
+/* Branch (i, j) of a multiloop */
+static int
+branch_energy(const linear_fold *fold, int i, int j)
+{
+	vrna_param_t *P = fold->params;
+	int type = pair_type(fold->nucs[i], fold->nucs[j]);
+	int si1 = nucleotide(fold, i - 1), sj1 = nucleotide(fold, j + 1);
+	return P->MLintern[type] + dangle_energy(fold, P->mismatchM[type], P->dangle5[type],
+	                                         P->dangle3[type], type, si1, sj1);
+}
+
+/* Pair (i, j) closing a multiloop */
+static int
+closing_energy(const linear_fold *fold, int i, int j)
+{
+	vrna_param_t *P = fold->params;
+	int type = reverse_type[pair_type(fold->nucs[i], fold->nucs[j])];
+	int si1 = fold->nucs[j - 1], sj1 = fold->nucs[i + 1];
+	return P->MLclosing + P->MLintern[type] +
+	       dangle_energy(fold, P->mismatchM[type], P->dangle5[type], P->dangle3[type], type,
+	                     si1, sj1);
+}
+
+/* Pair (i, j) in the exterior loop */
+static int
+exterior_energy(const linear_fold *fold, int i, int j)
+{
+	vrna_param_t *P = fold->params;
+	int type = pair_type(fold->nucs[i], fold->nucs[j]);
+	int si1 = nucleotide(fold, i - 1), sj1 = nucleotide(fold, j + 1);
+	return dangle_energy(fold, P->mismatchExt[type], P->dangle5[type], P->dangle3[type], type,
+	                     si1, sj1);
+}
+
+
+/* ----------------------------------------------------------------------------------------- */
+/* States                                                                                    */
+/* ----------------------------------------------------------------------------------------- */
+
+static void
+map_index(beam_map *map, int capacity)
+{
+	free(map->slots);
+	map->capacity = capacity;
+	map->slots = s_calloc(capacity, sizeof *map->slots);
+	for(int s = 0; s < map->num_states; s++) {
+		int slot = map->states[s].i & (capacity - 1);
+		while(map->slots[slot] != 0)
+			slot = (slot + 1) & (capacity - 1);
+		map->slots[slot] = s + 1;
+	}
+}
+
+static beam_state *
+map_get(const beam_map *map, int i)
+{
+	if(map->capacity == 0)
+		return NULL;
+	int slot = i & (map->capacity - 1);
+	while(map->slots[slot] != 0) {
+		beam_state *state = &map->states[map->slots[slot] - 1];
+		if(state->i == i)
+			return state;
+		slot = (slot + 1) & (map->capacity - 1);
+	}
+	return NULL;
+}
+
+/* Get the state of i, adding it if it is not in the map yet */
+static beam_state *
+map_add(beam_map *map, int i)
+{
+	beam_state *state = map_get(map, i);
+	if(state != NULL)
+		return state;
+
+	if(map->num_states == map->max_states) {
+		map->max_states = map->max_states == 0 ? 8 : 2 * map->max_states;
+		map->states = s_realloc(map->states, map->max_states * sizeof *map->states);
+	}
+	state = &map->states[map->num_states++];
+	state->i = i;
+	state->alpha = -INFINITY;
+	state->beta = -INFINITY;
+
+	/* Keep the load factor under 0.5 */
+	if(2 * map->num_states > map->capacity) {
+		map_index(map, map->capacity == 0 ? 16 : 2 * map->capacity);
+	} else {
+		int slot = i & (map->capacity - 1);
+		while(map->slots[slot] != 0)
+			slot = (slot + 1) & (map->capacity - 1);
+		map->slots[slot] = map->num_states;
+	}
+	return state;
+}
+
+static void
+map_free(beam_map *map)
+{
+	free(map->states);
+	free(map->slots);
+	memset(map, 0, sizeof *map);
+}
+
+/* Value of the k-th smallest element, reordering the array */
+static double
+quickselect(double *values, int num_values, int k)
+{
+	int lo = 0, hi = num_values - 1;
+	while(lo < hi) {
+		double pivot = values[lo + (hi - lo) / 2];
+		int a = lo, b = hi;
+		while(a <= b) {
+			while(values[a] < pivot) a++;
+			while(values[b] > pivot) b--;
+			if(a <= b) {
+				double tmp = values[a];
+				values[a++] = values[b];
+				values[b--] = tmp;
+			}
+		}
+		if(k <= b)
+			hi = b;
+		else if(k >= a)
+			lo = a;
+		else
+			break;
+	}
+	return values[k];
+}
+
+/* Only keep the beam_size states with the largest inside partition function times that of the
+   prefix before them */
+static void
+map_prune(linear_fold *fold, beam_map *map)
+{
+	if(fold->beam_size <= 0 || map->num_states <= fold->beam_size)
+		return;
+
+	double *scores = s_malloc(map->num_states * sizeof *scores);
+	for(int s = 0; s < map->num_states; s++)
+		scores[s] = map->states[s].alpha + fold->prefix_alpha[map->states[s].i];
+	double threshold = quickselect(scores, map->num_states, map->num_states - fold->beam_size);
+
+	int kept = 0;
+	for(int s = 0; s < map->num_states; s++) {
+		beam_state *state = &map->states[s];
+		if(state->alpha + fold->prefix_alpha[state->i] >= threshold)
+			map->states[kept++] = *state;
+	}
+	map->num_states = kept;
+	map_index(map, map->capacity);
+	free(scores);
+}
+
+
+/* ----------------------------------------------------------------------------------------- */
+/* Inside and outside passes                                                                 */
+/* ----------------------------------------------------------------------------------------- */
+
+static void
+inside(linear_fold *fold)
+{
+	const int *nucs = fold->nucs;
+	int    n = fold->length;
+	double scale = fold->scale;
+	double ml_base = -fold->params->MLbase * scale;
+
+	fold->prefix_alpha[0] = 0.;
+	for(int j = 0; j < n; j++) {
+		/* Start a hairpin at j, with its first possible partner */
+		beam_map *hairpin = &fold->hairpin[j];
+		map_prune(fold, hairpin);
+		if(nucs[j] != 0) {
+			int q = next_pair(fold, nucs[j], j);
+			while(q != -1 && q - j - 1 < MIN_HAIRPIN)
+				q = next_pair(fold, nucs[j], q);
+			if(q != -1)
+				log_add(&map_add(&fold->hairpin[q], j)->alpha, -hairpin_energy(fold, j, q) * scale);
+		}
+
+		/* Close the hairpins ending at j, and try the next partner of i */
+		for(int s = 0; s < hairpin->num_states; s++) {
+			beam_state *state = &hairpin->states[s];
+			int i = state->i;
+			int q = next_pair(fold, nucs[i], j);
+			if(q != -1)
+				log_add(&map_add(&fold->hairpin[q], i)->alpha, -hairpin_energy(fold, i, q) * scale);
+			log_add(&map_add(&fold->pair[j], i)->alpha, state->alpha);
+		}
+		/* Hairpins are not needed by the outside pass */
+		map_free(hairpin);
+
+		/* Close the multiloops ending at j, and leave j unpaired for the next partner of i */
+		beam_map *closing = &fold->closing[j];
+		map_prune(fold, closing);
+		for(int s = 0; s < closing->num_states; s++) {
+			beam_state *state = &closing->states[s];
+			int i = state->i;
+			int q = next_pair(fold, nucs[i], j);
+			if(q != -1)
+				log_add(&map_add(&fold->closing[q], i)->alpha, state->alpha + (q - j) * ml_base);
+			log_add(&map_add(&fold->pair[j], i)->alpha,
+			        state->alpha - closing_energy(fold, i, j) * scale);
+		}
+
+		beam_map *pair = &fold->pair[j];
+		map_prune(fold, pair);
+		for(int s = 0; s < pair->num_states; s++) {
+			beam_state *state = &pair->states[s];
+			int i = state->i;
+
+			if(i > 0 && j < n - 1) {
+				/* Stacks, bulges and interior loops around (i, j) */
+				for(int p = i - 1; p >= 0 && i - p - 1 <= MAX_LOOP; p--) {
+					if(nucs[p] == 0)
+						continue;
+					int q = next_pair(fold, nucs[p], j);
+					while(q != -1 && (i - p - 1) + (q - j - 1) <= MAX_LOOP) {
+						log_add(&map_add(&fold->pair[q], p)->alpha,
+						        state->alpha - interior_energy(fold, p, q, i, j) * scale);
+						q = next_pair(fold, nucs[p], q);
+					}
+				}
+
+				/* (i, j) as a branch of a multiloop, alone or after other branches */
+				double branch = state->alpha - branch_energy(fold, i, j) * scale;
+				log_add(&map_add(&fold->multi[j], i)->alpha, branch);
+				beam_map *before = &fold->multi[i - 1];
+				for(int m = 0; m < before->num_states; m++)
+					log_add(&map_add(&fold->multi2[j], before->states[m].i)->alpha,
+					        before->states[m].alpha + branch);
+			}
+
+			/* (i, j) in the exterior loop */
+			log_add(&fold->prefix_alpha[j + 1],
+			        fold->prefix_alpha[i] + state->alpha - exterior_energy(fold, i, j) * scale);
+		}
+
+		/* Enclose two or more branches in a multiloop closed by p and its first partner after j */
+		beam_map *multi2 = &fold->multi2[j];
+		map_prune(fold, multi2);
+		for(int s = 0; s < multi2->num_states; s++) {
+			beam_state *state = &multi2->states[s];
+			int i = state->i;
+			for(int p = i - 1; p >= 0 && i - p - 1 <= MAX_LOOP; p--) {
+				if(nucs[p] == 0)
+					continue;
+				int q = next_pair(fold, nucs[p], j);
+				if(q != -1)
+					log_add(&map_add(&fold->closing[q], p)->alpha,
+					        state->alpha + ((i - p - 1) + (q - j - 1)) * ml_base);
+			}
+			log_add(&map_add(&fold->multi[j], i)->alpha, state->alpha);
+		}
+
+		/* Leave j + 1 unpaired after the branches */
+		beam_map *multi = &fold->multi[j];
+		map_prune(fold, multi);
+		if(j < n - 1)
+			for(int s = 0; s < multi->num_states; s++)
+				log_add(&map_add(&fold->multi[j + 1], multi->states[s].i)->alpha,
+				        multi->states[s].alpha + ml_base);
+
+		/* Leave j unpaired in the exterior loop */
+		log_add(&fold->prefix_alpha[j + 1], fold->prefix_alpha[j]);
+	}
+}
+
+/* Same hyperedges as inside, from the last to the first, passing the outside partition
+   function of each state down to the states it was built from */
+static void
+outside(linear_fold *fold)
+{
+	const int *nucs = fold->nucs;
+	int    n = fold->length;
+	double scale = fold->scale;
+	double ml_base = -fold->params->MLbase * scale;
+	beam_state *target;
+
+	fold->prefix_beta[n] = 0.;
+	for(int j = n - 1; j >= 0; j--) {
+		log_add(&fold->prefix_beta[j], fold->prefix_beta[j + 1]);
+
+		beam_map *multi = &fold->multi[j];
+		if(j < n - 1)
+			for(int s = 0; s < multi->num_states; s++)
+				if((target = map_get(&fold->multi[j + 1], multi->states[s].i)) != NULL)
+					log_add(&multi->states[s].beta, target->beta + ml_base);
+
+		beam_map *multi2 = &fold->multi2[j];
+		for(int s = 0; s < multi2->num_states; s++) {
+			beam_state *state = &multi2->states[s];
+			int i = state->i;
+			for(int p = i - 1; p >= 0 && i - p - 1 <= MAX_LOOP; p--) {
+				if(nucs[p] == 0)
+					continue;
+				int q = next_pair(fold, nucs[p], j);
+				if(q != -1 && (target = map_get(&fold->closing[q], p)) != NULL)
+					log_add(&state->beta, target->beta + ((i - p - 1) + (q - j - 1)) * ml_base);
+			}
+			if((target = map_get(multi, i)) != NULL)
+				log_add(&state->beta, target->beta);
+		}
+
+		beam_map *pair = &fold->pair[j];
+		for(int s = 0; s < pair->num_states; s++) {
+			beam_state *state = &pair->states[s];
+			int i = state->i;
+
+			if(i > 0 && j < n - 1) {
+				for(int p = i - 1; p >= 0 && i - p - 1 <= MAX_LOOP; p--) {
+					if(nucs[p] == 0)
+						continue;
+					int q = next_pair(fold, nucs[p], j);
+					while(q != -1 && (i - p - 1) + (q - j - 1) <= MAX_LOOP) {
+						if((target = map_get(&fold->pair[q], p)) != NULL)
+							log_add(&state->beta,
+							        target->beta - interior_energy(fold, p, q, i, j) * scale);
+						q = next_pair(fold, nucs[p], q);
+					}
+				}
+
+				double branch = -branch_energy(fold, i, j) * scale;
+				if((target = map_get(multi, i)) != NULL)
+					log_add(&state->beta, target->beta + branch);
+				beam_map *before = &fold->multi[i - 1];
+				for(int m = 0; m < before->num_states; m++) {
+					beam_state *left = &before->states[m];
+					if((target = map_get(multi2, left->i)) == NULL)
+						continue;
+					log_add(&state->beta, target->beta + left->alpha + branch);
+					log_add(&left->beta, target->beta + state->alpha + branch);
+				}
+			}
+
+			double exterior = -exterior_energy(fold, i, j) * scale;
+			log_add(&state->beta, fold->prefix_beta[j + 1] + fold->prefix_alpha[i] + exterior);
+			log_add(&fold->prefix_beta[i], fold->prefix_beta[j + 1] + state->alpha + exterior);
+		}
+
+		beam_map *closing = &fold->closing[j];
+		for(int s = 0; s < closing->num_states; s++) {
+			beam_state *state = &closing->states[s];
+			int i = state->i;
+			int q = next_pair(fold, nucs[i], j);
+			if(q != -1 && (target = map_get(&fold->closing[q], i)) != NULL)
+				log_add(&state->beta, target->beta + (q - j) * ml_base);
+			if((target = map_get(pair, i)) != NULL)
+				log_add(&state->beta, target->beta - closing_energy(fold, i, j) * scale);
+		}
+	}
+}
+
+
+/* ----------------------------------------------------------------------------------------- */
+/* Folding                                                                                   */
+/* ----------------------------------------------------------------------------------------- */
+
+static void
+init_fold(linear_fold *fold, const char *sequence, int beam_size)
+{
+	int n = (int)strlen(sequence);
+
+	fold->length = n;
+	fold->beam_size = beam_size;
+	fold->sequence = s_malloc(n + 1);
+	fold->nucs = s_malloc((n + 1) * sizeof *fold->nucs);
+	for(int k = 0; k < n; k++) {
+		fold->nucs[k] = encode(sequence[k]);
+		fold->sequence[k] = "NACGU"[fold->nucs[k]];
+	}
+	fold->sequence[n] = '\0';
+
+	fold->next_pair = s_malloc(5 * (n + 1) * sizeof *fold->next_pair);
+	for(int nuc = 0; nuc < 5; nuc++) {
+		int *next = fold->next_pair + nuc * n;
+		int following = -1;
+		for(int j = n - 1; j >= 0; j--) {
+			next[j] = following;
+			if(nuc != 0 && pair_type(nuc, fold->nucs[j]) != 0)
+				following = j;
+		}
+	}
+
+	vrna_md_t md;
+	vrna_md_set_default(&md);
+	fold->params = vrna_params(&md);
+	fold->scale = 10. / ((md.temperature + ZERO_CELSIUS) * GAS_CONSTANT);
+
+	fold->hairpin = s_calloc(n + 1, sizeof *fold->hairpin);
+	fold->pair    = s_calloc(n + 1, sizeof *fold->pair);
+	fold->multi   = s_calloc(n + 1, sizeof *fold->multi);
+	fold->multi2  = s_calloc(n + 1, sizeof *fold->multi2);
+	fold->closing = s_calloc(n + 1, sizeof *fold->closing);
+	fold->prefix_alpha = s_malloc((n + 1) * sizeof *fold->prefix_alpha);
+	fold->prefix_beta  = s_malloc((n + 1) * sizeof *fold->prefix_beta);
+	for(int j = 0; j <= n; j++) {
+		fold->prefix_alpha[j] = -INFINITY;
+		fold->prefix_beta[j] = -INFINITY;
+	}
+}
+
+static void
+free_fold(linear_fold *fold)
+{
+	for(int j = 0; j <= fold->length; j++) {
+		map_free(&fold->hairpin[j]);
+		map_free(&fold->pair[j]);
+		map_free(&fold->multi[j]);
+		map_free(&fold->multi2[j]);
+		map_free(&fold->closing[j]);
+	}
+	free(fold->hairpin);
+	free(fold->pair);
+	free(fold->multi);
+	free(fold->multi2);
+	free(fold->closing);
+	free(fold->prefix_alpha);
+	free(fold->prefix_beta);
+	free(fold->next_pair);
+	free(fold->nucs);
+	free(fold->sequence);
+	free(fold->params);
+}
+
+float *
+bpp_linear_fold(const char *sequence, int beam_size, vrna_ep_t **pairs)
+{
+	linear_fold fold;
+	init_fold(&fold, sequence, beam_size);
+	int n = fold.length;
+
+	float *positional_probabilities = s_calloc(n + 1, sizeof *positional_probabilities);
+	size_t num_pairs = 0, max_pairs = 16;
+	if(pairs != NULL)
+		*pairs = s_malloc(max_pairs * sizeof **pairs);
+
+	inside(&fold);
+	outside(&fold);
+
+	/* Probability of each surviving pair */
+	double log_partition = fold.prefix_alpha[n];
+	for(int j = 0; j < n && log_partition != -INFINITY; j++) {
+		for(int s = 0; s < fold.pair[j].num_states; s++) {
+			beam_state *state = &fold.pair[j].states[s];
+			double probability = exp(state->alpha + state->beta - log_partition);
+			probability = MIN2(probability, 1.);
+			positional_probabilities[state->i] += (float)probability;
+			positional_probabilities[j] += (float)probability;
+
+			if(pairs == NULL || probability < MIN_PAIR_PROBABILITY)
+				continue;
+			if(num_pairs + 1 == max_pairs) {
+				max_pairs *= 2;
+				*pairs = s_realloc(*pairs, max_pairs * sizeof **pairs);
+			}
+			(*pairs)[num_pairs].i = state->i + 1;
+			(*pairs)[num_pairs].j = j + 1;
+			(*pairs)[num_pairs].p = (float)probability;
+			(*pairs)[num_pairs].type = 0;
+			num_pairs++;
+		}
+	}
+	if(pairs != NULL) {
+		(*pairs)[num_pairs].i = 0;
+		(*pairs)[num_pairs].j = 0;
+	}
+
+	for(int k = 0; k < n; k++)
+		positional_probabilities[k] = MIN2(positional_probabilities[k], 1.0F);
+
+	free_fold(&fold);
+	return positional_probabilities;
+}
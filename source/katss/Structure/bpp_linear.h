@@ -0,0 +1,37 @@
+#ifndef BPP_LINEAR_H
+#define BPP_LINEAR_H
+
+#include <ViennaRNA/utils/structures.h>
+
+/**
+ *  @brief Default number of states kept per nucleotide and state type.
+*/
+#define BPP_LINEAR_DEFAULT_BEAM 100
+
+
+/**
+ *  @brief Get the probability that each nucleotide of a sequence is paired, from a beam-pruned
+ *  partition function that runs in linear time, in the style of LinearPartition.
+ *
+ *  The sequence is scanned from 5' to 3', and at every nucleotide only the beam_size most likely
+ *  states of each type (hairpins, pairs, multiloop segments) are kept, ranked by their inside
+ *  partition function times that of the prefix before them. An outside pass over the same
+ *  states then gives the base-pair probabilities. Time and memory grow linearly with the length
+ *  of the sequence, unlike the cubic time and quadratic memory of the full partition function,
+ *  so transcripts of several kilobases can be folded.
+ *
+ *  The energies are those of ViennaRNA's default model (Turner 2004, dangles=2), so without
+ *  pruning the probabilities only differ from the full partition function in that the
+ *  unpaired nucleotides before the first branch of a multiloop are limited to 30, like those
+ *  of interior loops.
+ *
+ *  @param sequence     Null-terminated sequence, of A, C, G, U or T in any case.
+ *  @param beam_size    Number of states kept per nucleotide and type, 0 to keep all of them.
+ *  @param pairs        If not NULL, set to the base pairs with a probability of at least 1e-6,
+ *                      terminated by a pair with i = 0, to be freed.
+ *
+ *  @return Array with one probability per nucleotide, to be freed.
+*/
+float *bpp_linear_fold(const char *sequence, int beam_size, vrna_ep_t **pairs);
+
+#endif // BPP_LINEAR_H
@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
+#  include <threads.h>
+#else
+#  include <tinycthread.h>
+#endif
+
+#include "bpp_partners.h"
+#include "hash_functions.h"
+#include "memory_utils.h"
+
+#define INITIAL_CAPACITY 1024
+
+/* A slot is free while its mass is zero, since only positive masses are added */
+struct partner_entry {
+	uint64_t key;       /* 5' k-mer in the upper 32 bits, 3' k-mer in the lower ones */
+	double   mass;
+};
+typedef struct partner_entry partner_entry;
+
+struct BppPartners {
+	int           kmer;
+	size_t        num_entries;
+	size_t        capacity;
+	partner_entry *entries;
+	mtx_t         lock;     /* Only taken by bpp_partners_merge */
+};
+
+static size_t
+slot_of(uint64_t key, size_t mask)
+{
+	/* Mix the bits, consecutive k-mers only differ in their lowest bits */
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	return (size_t)key & mask;
+}
+
+static void
+insert(BppPartners *partners, uint64_t key, double mass)
+{
+	size_t mask = partners->capacity - 1;
+	size_t slot = slot_of(key, mask);
+	while(partners->entries[slot].mass > 0.) {
+		if(partners->entries[slot].key == key) {
+			partners->entries[slot].mass += mass;
+			return;
+		}
+		slot = (slot + 1) & mask;
+	}
+	partners->entries[slot].key = key;
+	partners->entries[slot].mass = mass;
+	partners->num_entries++;
+}
+
+static void
+rehash(BppPartners *partners, size_t capacity)
+{
+	partner_entry *entries = partners->entries;
+	size_t old_capacity = partners->capacity;
+
+	partners->entries = s_calloc(capacity, sizeof *partners->entries);
+	partners->capacity = capacity;
+	partners->num_entries = 0;
+	for(size_t i = 0; i < old_capacity; i++)
+		if(entries[i].mass > 0.)
+			insert(partners, entries[i].key, entries[i].mass);
+	free(entries);
+}
+
+
+BppPartners *
+bpp_partners_init(int kmer)
+{
+	if(kmer < 1 || kmer > 16)
+		return NULL;
+
+	BppPartners *partners = s_malloc(sizeof *partners);
+	partners->kmer = kmer;
+	partners->num_entries = 0;
+	partners->capacity = INITIAL_CAPACITY;
+	partners->entries = s_calloc(INITIAL_CAPACITY, sizeof *partners->entries);
+	mtx_init(&partners->lock, mtx_plain);
+	return partners;
+}
+
+
+void
+bpp_partners_add(BppPartners *partners, uint32_t five_prime, uint32_t three_prime, double mass)
+{
+	if(!(mass > 0.))
+		return;
+
+	/* Keep the load factor under 0.5 */
+	if(2 * (partners->num_entries + 1) > partners->capacity)
+		rehash(partners, 2 * partners->capacity);
+	insert(partners, ((uint64_t)five_prime << 32) | three_prime, mass);
+}
+
+
+void
+bpp_partners_merge(BppPartners *into, const BppPartners *from)
+{
+	mtx_lock(&into->lock);
+	for(size_t i = 0; i < from->capacity; i++) {
+		const partner_entry *entry = &from->entries[i];
+		if(entry->mass > 0.)
+			bpp_partners_add(into, (uint32_t)(entry->key >> 32), (uint32_t)entry->key,
+			                 entry->mass);
+	}
+	mtx_unlock(&into->lock);
+}
+
+
+size_t
+bpp_partners_prune(BppPartners *partners, double min_mass)
+{
+	for(size_t i = 0; i < partners->capacity; i++)
+		if(partners->entries[i].mass < min_mass)
+			partners->entries[i].mass = 0.;
+
+	/* Removing entries breaks the probe sequences, so insert the rest again */
+	size_t capacity = INITIAL_CAPACITY;
+	size_t left = 0;
+	for(size_t i = 0; i < partners->capacity; i++)
+		left += partners->entries[i].mass > 0.;
+	while(2 * left > capacity)
+		capacity *= 2;
+	rehash(partners, capacity);
+	return partners->num_entries;
+}
+
+
+size_t
+bpp_partners_count(const BppPartners *partners)
+{
+	return partners->num_entries;
+}
+
+
+static int
+compare_mass(const void *p1, const void *p2)
+{
+	const partner_entry *a = (const partner_entry *)p1;
+	const partner_entry *b = (const partner_entry *)p2;
+	if(a->mass != b->mass)
+		return (a->mass < b->mass) - (a->mass > b->mass);
+	return (a->key > b->key) - (a->key < b->key);
+}
+
+
+int
+bpp_partners_to_file(const BppPartners *partners, const char *filename, char delimiter)
+{
+	FILE *file = fopen(filename, "w");
+	if(file == NULL) {
+		error_message("katss: Could not write to file '%s'", filename);
+		return 1;
+	}
+
+	partner_entry *sorted = s_malloc((partners->num_entries + 1) * sizeof *sorted);
+	size_t num_sorted = 0;
+	for(size_t i = 0; i < partners->capacity; i++)
+		if(partners->entries[i].mass > 0.)
+			sorted[num_sorted++] = partners->entries[i];
+	qsort(sorted, num_sorted, sizeof *sorted, compare_mass);
+
+	char five_prime[32], three_prime[32];
+	fprintf(file, "kmer%cpartner%cmass\n", delimiter, delimiter);
+	for(size_t i = 0; i < num_sorted; i++) {
+		katss_unhash(five_prime, (uint32_t)(sorted[i].key >> 32), partners->kmer, false);
+		katss_unhash(three_prime, (uint32_t)sorted[i].key, partners->kmer, false);
+		fprintf(file, "%s%c%s%c%f\n", five_prime, delimiter, three_prime, delimiter,
+		        sorted[i].mass);
+	}
+
+	free(sorted);
+	fclose(file);
+	return 0;
+}
+
+
+void
+bpp_partners_free(BppPartners *partners)
+{
+	if(partners == NULL)
+		return;
+	mtx_destroy(&partners->lock);
+	free(partners->entries);
+	free(partners);
+}
@@ -0,0 +1,83 @@
+#ifndef BPP_PARTNERS_H
+#define BPP_PARTNERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ *  @brief Sparse k-mer by k-mer matrix of base-pairing mass.
+ *
+ *  For every base pair (i, j), with i < j, of a folded read, its probability is added to the
+ *  entry of the k-mer starting at i (the 5' k-mer) and the k-mer ending at j (the 3' k-mer).
+ *  A k-mer stacked on its partner in a helix thus adds up its whole stem. Entries are kept in an
+ *  open-addressed hash table, so only the pairs of k-mers that were seen use memory. Each
+ *  folding thread fills its own matrix, which are then merged with bpp_partners_merge.
+*/
+typedef struct BppPartners BppPartners;
+
+
+/**
+ *  @brief Initializes an empty matrix.
+ *
+ *  @param kmer Length of the k-mers, at most 16.
+ *
+ *  @return Pointer to the matrix, or NULL if kmer is out of range.
+*/
+BppPartners *bpp_partners_init(int kmer);
+
+
+/**
+ *  @brief Add mass to the entry of two k-mers.
+ *
+ *  @param partners     Matrix to add to.
+ *  @param five_prime   2-bit hash of the k-mer on the 5' side of the base pair.
+ *  @param three_prime  2-bit hash of the k-mer on the 3' side of the base pair.
+ *  @param mass         Probability of the base pair, times the number of reads it stands for.
+*/
+void bpp_partners_add(BppPartners *partners, uint32_t five_prime, uint32_t three_prime,
+                      double mass);
+
+
+/**
+ *  @brief Add every entry of one matrix to another. This function is thread-safe as long as
+ *  the matrix merged from is not modified at the same time.
+ *
+ *  @param into Matrix to add to.
+ *  @param from Matrix to add, of the same k-mer length.
+*/
+void bpp_partners_merge(BppPartners *into, const BppPartners *from);
+
+
+/**
+ *  @brief Remove the entries with less than min_mass.
+ *
+ *  @return Number of entries left.
+*/
+size_t bpp_partners_prune(BppPartners *partners, double min_mass);
+
+
+/**
+ *  @brief Number of entries in the matrix.
+*/
+size_t bpp_partners_count(const BppPartners *partners);
+
+
+/**
+ *  @brief Write the entries to a file, from the largest mass to the smallest, as rows of the
+ *  5' k-mer, the 3' k-mer and their mass.
+ *
+ *  @param partners     Matrix to write.
+ *  @param filename     Name of the file to write to.
+ *  @param delimiter    Column delimiter.
+ *
+ *  @return 0 on success, non-zero if the file could not be written.
+*/
+int bpp_partners_to_file(const BppPartners *partners, const char *filename, char delimiter);
+
+
+/**
+ *  @brief Free the matrix.
+*/
+void bpp_partners_free(BppPartners *partners);
+
+#endif // BPP_PARTNERS_H
@@ -64,6 +64,20 @@ init_bpp_table(unsigned int kmer)
 }
 
 
+kmerHashTable *
+init_bpp_stats_table(unsigned int kmer)
+{
+	return init_kmer_table(kmer, 2*kmer+1);
+}
+
+
+kmerHashTable *
+init_bpp_bootstrap_table(unsigned int kmer, unsigned int replicates)
+{
+	return init_kmer_table(kmer, 2*kmer+1 + replicates*(kmer+1));
+}
+
+
 double *
 kmer_get(kmerHashTable *hash_table, const char *key)
 {
@@ -100,6 +114,91 @@ kmer_add_value(kmerHashTable   *hash_table,
 }
 
 
+void
+kmer_add_sample(kmerHashTable   *hash_table,
+                const char      *key,
+                const float     *values,
+                double          weight)
+{
+	unsigned int kmer = hash_table->kmer;
+	if(hash_table->cols < 2*kmer+1) {
+		error_message("kmer_add_sample requires a table with at least '%d' columns, but "
+		              "table only has '%d'.", 2*kmer+1, hash_table->cols);
+		exit(EXIT_FAILURE);
+	}
+
+	Hash hash_value = hash(key);
+	if(hash_value.errnum == 1 || weight <= 0) {
+		return;
+	}
+
+	mtx_lock(&((kht_statep)hash_table)->lock);
+	if(hash_table->entries[hash_value.hash] == NULL) {
+		Entry *new_item = create_entry(hash_value.hash, hash_table->cols);
+		hash_table->entries[hash_value.hash] = new_item;
+	}
+
+	/* Weighted Welford update of the mean and sum of squared deviations */
+	double *entry_values = hash_table->entries[hash_value.hash]->values;
+	double total_weight = entry_values[kmer] + weight;
+	for(unsigned int i = 0; i < kmer; i++) {
+		double delta = values[i] - entry_values[i];
+		entry_values[i] += delta * weight / total_weight;
+		entry_values[kmer+1+i] += weight * delta * (values[i] - entry_values[i]);
+	}
+	entry_values[kmer] = total_weight;
+	mtx_unlock(&((kht_statep)hash_table)->lock);
+}
+
+
+void
+kmer_add_replicates(kmerHashTable   *hash_table,
+                    const char      *key,
+                    const float     *values,
+                    double          weight,
+                    const double    *replicate_weights,
+                    unsigned int    replicates)
+{
+	unsigned int kmer = hash_table->kmer;
+	if(hash_table->cols < 2*kmer+1 + replicates*(kmer+1)) {
+		error_message("kmer_add_replicates requires a table with at least '%d' columns, but "
+		              "table only has '%d'.", 2*kmer+1 + replicates*(kmer+1), hash_table->cols);
+		exit(EXIT_FAILURE);
+	}
+
+	Hash hash_value = hash(key);
+	if(hash_value.errnum == 1 || weight <= 0) {
+		return;
+	}
+
+	mtx_lock(&((kht_statep)hash_table)->lock);
+	if(hash_table->entries[hash_value.hash] == NULL) {
+		Entry *new_item = create_entry(hash_value.hash, hash_table->cols);
+		hash_table->entries[hash_value.hash] = new_item;
+	}
+
+	double *entry_values = hash_table->entries[hash_value.hash]->values;
+	double total_weight = entry_values[kmer] + weight;
+	for(unsigned int i = 0; i < kmer; i++) {
+		double delta = values[i] - entry_values[i];
+		entry_values[i] += delta * weight / total_weight;
+		entry_values[kmer+1+i] += weight * delta * (values[i] - entry_values[i]);
+	}
+	entry_values[kmer] = total_weight;
+
+	/* Replicates only need sums, their means are taken once all samples are added */
+	for(unsigned int r = 0; r < replicates; r++) {
+		double *replicate = entry_values + 2*kmer+1 + r*(kmer+1);
+		if(replicate_weights[r] == 0.)
+			continue;
+		for(unsigned int i = 0; i < kmer; i++)
+			replicate[i] += replicate_weights[r] * values[i];
+		replicate[kmer] += replicate_weights[r];
+	}
+	mtx_unlock(&((kht_statep)hash_table)->lock);
+}
+
+
 static Entry *
 create_entry(unsigned int key, unsigned int col)
 {
@@ -197,10 +296,22 @@ print_table_to_file(kmerHashTable *table, FILE *table_file, char sep)
 
 void
 kmerHashTable_to_file(kmerHashTable *table, char *name, char file_delimiter)
+{
+	kmerHashTable_to_file_comment(table, name, file_delimiter, NULL);
+}
+
+
+void
+kmerHashTable_to_file_comment(kmerHashTable *table, char *name, char file_delimiter,
+                              const char *comment)
 {
 	FILE *table_file = fopen(name, "w");
-	if (table_file == NULL)
+	if (table_file == NULL) {
 		error_message("Could not write to file '%s'\n", name);
+		return;
+	}
+	if(comment != NULL)
+		fprintf(table_file, "# %s\n", comment);
 	print_table_to_file(table, table_file, file_delimiter);
 	fclose(table_file);
 }
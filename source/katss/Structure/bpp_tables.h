@@ -52,6 +52,35 @@ kmerHashTable *init_kmer_table(unsigned int kmer, unsigned int cols);
 kmerHashTable *init_bpp_table(unsigned int kmer);
 
 
+/**
+ *  @brief Wrapper of init_kmer_table that creates a kmerHashTable of size kmer used to keep
+ *  running statistics of each k-mer position with kmer_add_sample.
+ *
+ *  The first kmer values hold the running mean of each position, the following value holds the
+ *  total weight of the samples, and the last kmer values hold the sum of squared deviations from
+ *  the mean of each position.
+ *
+ *  @return Pointer to the initialized kmerHashTable
+*/
+kmerHashTable *init_bpp_stats_table(unsigned int kmer);
+
+
+/**
+ *  @brief Wrapper of init_kmer_table that creates a kmerHashTable of size kmer used to keep
+ *  running statistics of each k-mer position with kmer_add_replicates.
+ *
+ *  The first 2*kmer+1 values are laid out as in init_bpp_stats_table. They are followed by one
+ *  block of kmer+1 values per bootstrap replicate, holding the weighted sum of each position
+ *  and the total weight of the replicate.
+ *
+ *  @param kmer         Size of k-mer that will be stored
+ *  @param replicates   Number of bootstrap replicates
+ *
+ *  @return Pointer to the initialized kmerHashTable
+*/
+kmerHashTable *init_bpp_bootstrap_table(unsigned int kmer, unsigned int replicates);
+
+
 /**
  *  Free all allocated memory in kmerHashTable.
  * 
@@ -84,6 +113,41 @@ void kmer_add_value(kmerHashTable   *hash_table,
                     unsigned int    value_index);
 
 
+/**
+ *  @brief Add a weighted sample of kmer values to a table created with init_bpp_stats_table,
+ *  updating the running mean and variance of each position with Welford's method.
+ *
+ *  @param hash_table   kmerHashTable to be added to.
+ *  @param key          Key value to add to.
+ *  @param values       Array of kmer values, one for each position of the key.
+ *  @param weight       Number of times the sample was observed.
+*/
+void kmer_add_sample(kmerHashTable   *hash_table,
+                     const char      *key,
+                     const float     *values,
+                     double          weight);
+
+
+/**
+ *  @brief Same as kmer_add_sample, for a table created with init_bpp_bootstrap_table. The
+ *  sample is also added to every bootstrap replicate, weighted by the number of times it was
+ *  drawn in that replicate.
+ *
+ *  @param hash_table           kmerHashTable to be added to.
+ *  @param key                  Key value to add to.
+ *  @param values               Array of kmer values, one for each position of the key.
+ *  @param weight               Number of times the sample was observed.
+ *  @param replicate_weights    Number of times the sample was drawn in each replicate.
+ *  @param replicates           Number of bootstrap replicates of the table.
+*/
+void kmer_add_replicates(kmerHashTable   *hash_table,
+                         const char      *key,
+                         const float     *values,
+                         double          weight,
+                         const double    *replicate_weights,
+                         unsigned int    replicates);
+
+
 /**
  *  @brief  Print contents of kmerHashTable to file.
  * 
@@ -99,6 +163,23 @@ void kmerHashTable_to_file(kmerHashTable *table,
                            char file_delimiter);
 
 
+/**
+ *  @brief  Print contents of kmerHashTable to file, preceded by a comment line.
+ * 
+ *  Same as kmerHashTable_to_file, but the first line of the file will be the comment prefixed
+ *  with '#', which is used to record how the values were computed.
+ * 
+ *  @param  table   kmerHashTable to read contents from.
+ *  @param  name    Name of the file to write to.
+ *  @param  file_delimiter  Delimiter used to separate values in file.
+ *  @param  comment Comment to write on the first line, or NULL to omit it.
+*/
+void kmerHashTable_to_file_comment(kmerHashTable *table,
+                                   char *name,
+                                   char file_delimiter,
+                                   const char *comment);
+
+
 /**
  *  @brief Print contents of kmerHashTable to stdout.
  * 
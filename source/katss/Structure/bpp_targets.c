@@ -0,0 +1,217 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bpp_targets.h"
+#include "memory_utils.h"
+
+/* Largest number of bits in the bitset (2 MiB) */
+#define MAX_BITSET_BITS 24
+
+struct BppTargets {
+	int      kmer;
+	uint32_t mask;          /* Keeps the last k nucleotides of the rolling hash */
+	int      bitset_bits;   /* log2 of the number of bits in the bitset */
+	bool     exact;         /* The bitset holds every k-mer, no need to confirm a hit */
+	uint64_t *bitset;
+	uint32_t *hashes;       /* Sorted hashes of the targets */
+	size_t   num_hashes;
+};
+
+static int
+nucleotide_code(char nucleotide)
+{
+	switch(nucleotide) {
+		case 'A': case 'a':           return 0;
+		case 'C': case 'c':           return 1;
+		case 'G': case 'g':           return 2;
+		case 'U': case 'u':
+		case 'T': case 't':           return 3;
+		default:                      return -1;
+	}
+}
+
+static uint32_t
+bitset_slot(const BppTargets *targets, uint32_t hash)
+{
+	if(targets->exact)
+		return hash;
+	return (hash * 0x9E3779B1U) >> (32 - targets->bitset_bits);
+}
+
+static bool
+has_hash(const BppTargets *targets, uint32_t hash)
+{
+	uint32_t slot = bitset_slot(targets, hash);
+	if(!(targets->bitset[slot >> 6] & (1ULL << (slot & 63))))
+		return false;
+	if(targets->exact)
+		return true;
+
+	/* Confirm the hit, since other k-mers share the same slot */
+	size_t lo = 0, hi = targets->num_hashes;
+	while(lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if(targets->hashes[mid] < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo < targets->num_hashes && targets->hashes[lo] == hash;
+}
+
+static int
+compare_hashes(const void *p1, const void *p2)
+{
+	uint32_t a = *(const uint32_t *)p1;
+	uint32_t b = *(const uint32_t *)p2;
+	return (a > b) - (a < b);
+}
+
+/* Hash the leading k-mer of a line, returning 0 on success, 1 if the first column is not made
+   of nucleotides, and 2 if it has the wrong length */
+static int
+hash_first_column(const char *line, int kmer, uint32_t *hash)
+{
+	int length = 0;
+	*hash = 0;
+	while(isalpha((unsigned char)line[length])) {
+		int code = nucleotide_code(line[length]);
+		if(code < 0)
+			return 1;
+		*hash = (*hash << 2) | (uint32_t)code;
+		length++;
+	}
+
+	if(length == 0)
+		return 1;
+	return length == kmer ? 0 : 2;
+}
+
+BppTargets *
+bpp_targets_load(const char *filename, int kmer, int max_targets)
+{
+	if(kmer < 1 || kmer > 16)
+		return NULL;
+
+	FILE *file = fopen(filename, "r");
+	if(file == NULL) {
+		error_message("katss: Could not open targets file '%s'", filename);
+		return NULL;
+	}
+
+	size_t capacity = 64;
+	size_t num_hashes = 0;
+	size_t wrong_length = 0;
+	uint32_t *hashes = s_malloc(capacity * sizeof *hashes);
+
+	char line[4096];
+	while(fgets(line, sizeof line, file) != NULL) {
+		if(max_targets > 0 && num_hashes == (size_t)max_targets)
+			break;
+
+		/* Skip over the rest of lines that did not fit in the buffer */
+		size_t length = strlen(line);
+		bool truncated = length > 0 && line[length - 1] != '\n' && !feof(file);
+
+		uint32_t hash;
+		int status = line[0] == '#' ? 1 : hash_first_column(line, kmer, &hash);
+		if(status == 0) {
+			if(num_hashes == capacity) {
+				capacity *= 2;
+				hashes = s_realloc(hashes, capacity * sizeof *hashes);
+			}
+			hashes[num_hashes++] = hash;
+		} else if(status == 2) {
+			wrong_length++;
+		}
+
+		while(truncated && fgets(line, sizeof line, file) != NULL)
+			truncated = line[strlen(line) - 1] != '\n';
+	}
+	fclose(file);
+
+	if(wrong_length > 0)
+		warning_message("katss: Skipped %zu k-mers of '%s' that are not of length %d",
+		                wrong_length, filename, kmer);
+	if(num_hashes == 0) {
+		error_message("katss: No %d-mers found in targets file '%s'", kmer, filename);
+		free(hashes);
+		return NULL;
+	}
+
+	/* Remove duplicates */
+	qsort(hashes, num_hashes, sizeof *hashes, compare_hashes);
+	size_t num_unique = 1;
+	for(size_t i = 1; i < num_hashes; i++)
+		if(hashes[i] != hashes[num_unique - 1])
+			hashes[num_unique++] = hashes[i];
+
+	BppTargets *targets = s_malloc(sizeof *targets);
+	targets->kmer = kmer;
+	targets->mask = kmer == 16 ? UINT32_MAX : (1U << (2 * kmer)) - 1;
+	targets->exact = 2 * kmer <= MAX_BITSET_BITS;
+	targets->bitset_bits = targets->exact ? 2 * kmer : MAX_BITSET_BITS;
+	targets->hashes = hashes;
+	targets->num_hashes = num_unique;
+
+	size_t words = ((1ULL << targets->bitset_bits) + 63) / 64;
+	targets->bitset = s_calloc(words, sizeof *targets->bitset);
+	for(size_t i = 0; i < num_unique; i++) {
+		uint32_t slot = bitset_slot(targets, hashes[i]);
+		targets->bitset[slot >> 6] |= 1ULL << (slot & 63);
+	}
+
+	return targets;
+}
+
+size_t
+bpp_targets_count(const BppTargets *targets)
+{
+	return targets->num_hashes;
+}
+
+bool
+bpp_targets_contains(const BppTargets *targets, const char *kmer)
+{
+	uint32_t hash = 0;
+	for(int i = 0; i < targets->kmer; i++) {
+		int code = nucleotide_code(kmer[i]);
+		if(code < 0)
+			return false;
+		hash = (hash << 2) | (uint32_t)code;
+	}
+	return has_hash(targets, hash);
+}
+
+int
+bpp_targets_find(const BppTargets *targets, const char *sequence, int start)
+{
+	uint32_t hash = 0;
+	int valid = 0;
+
+	for(int i = start; sequence[i]; i++) {
+		int code = nucleotide_code(sequence[i]);
+		if(code < 0) {
+			valid = 0;
+			continue;
+		}
+
+		hash = ((hash << 2) | (uint32_t)code) & targets->mask;
+		if(++valid >= targets->kmer && has_hash(targets, hash))
+			return i - targets->kmer + 1;
+	}
+	return -1;
+}
+
+void
+bpp_targets_free(BppTargets *targets)
+{
+	if(targets == NULL)
+		return;
+	free(targets->bitset);
+	free(targets->hashes);
+	free(targets);
+}
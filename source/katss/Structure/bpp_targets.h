@@ -0,0 +1,66 @@
+#ifndef BPP_TARGETS_H
+#define BPP_TARGETS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ *  @brief Set of k-mers of interest, used to only fold the reads that contain one of them.
+ *
+ *  Reads are scanned with a rolling 2-bit hash of their k-mers, which is looked up in a bitset.
+ *  For k <= 12 the bitset holds every possible k-mer, so a hit is exact; for longer k-mers a hit
+ *  is confirmed against the sorted list of targets.
+*/
+typedef struct BppTargets BppTargets;
+
+
+/**
+ *  @brief Read the k-mers of interest from a file. The file is either a list of k-mers, one per
+ *  line, or the output of ikke or kstruct, in which case the k-mer in the first column of each
+ *  row is used. Header and comment lines are skipped, T and U are treated the same, and rows
+ *  whose k-mer is not of length kmer are ignored.
+ *
+ *  @param filename     Name of the file with the k-mers.
+ *  @param kmer         Length of the k-mers.
+ *  @param max_targets  Only read the first max_targets k-mers, or all of them if 0.
+ *
+ *  @return Pointer to the targets, or NULL if the file could not be read or has no k-mers.
+*/
+BppTargets *bpp_targets_load(const char *filename, int kmer, int max_targets);
+
+
+/**
+ *  @brief Number of distinct k-mers in the targets.
+*/
+size_t bpp_targets_count(const BppTargets *targets);
+
+
+/**
+ *  @brief Check whether the first k nucleotides of kmer are one of the targets.
+ *
+ *  @param targets  Targets to look in.
+ *  @param kmer     K-mer to look for; it does not need to be null-terminated.
+ *
+ *  @return true if the k-mer is a target.
+*/
+bool bpp_targets_contains(const BppTargets *targets, const char *kmer);
+
+
+/**
+ *  @brief Find the next occurrence of any target in a sequence.
+ *
+ *  @param targets  Targets to look for.
+ *  @param sequence Null-terminated sequence.
+ *  @param start    Position of the sequence to start looking from.
+ *
+ *  @return Position where the occurrence starts, or -1 if there is none.
+*/
+int bpp_targets_find(const BppTargets *targets, const char *sequence, int start);
+
+
+/**
+ *  @brief Free the targets.
+*/
+void bpp_targets_free(BppTargets *targets);
+
+#endif // BPP_TARGETS_H
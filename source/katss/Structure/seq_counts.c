@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory_utils.h"
+
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
+#  include <threads.h>
+#else
+#  include <tinycthread.h>
+#endif
+
+#include "seq_counts.h"
+
+#define INITIAL_CAPACITY 1024
+
+struct sc_state {
+	size_t   num_seqs;
+	uint64_t total;
+	size_t   capacity;
+	SeqCount *entries;
+	size_t   cursor;
+	mtx_t    lock;
+};
+typedef struct sc_state *sc_statep;
+
+static uint64_t
+hash(const char *sequence);
+
+static void
+grow(sc_statep state);
+
+
+SeqCounts *
+init_seq_counts(void)
+{
+	sc_statep state = s_malloc(sizeof *state);
+
+	state->num_seqs = 0;
+	state->total    = 0;
+	state->capacity = INITIAL_CAPACITY;
+	state->entries  = s_calloc(INITIAL_CAPACITY, sizeof *state->entries);
+	state->cursor   = 0;
+	mtx_init(&state->lock, mtx_plain);
+
+	return (SeqCounts *)state;
+}
+
+
+void
+seq_counts_add(SeqCounts *counts, const char *sequence)
+{
+	sc_statep state = (sc_statep)counts;
+
+	/* Keep the load factor under 0.7 */
+	if(10 * (state->num_seqs + 1) > 7 * state->capacity)
+		grow(state);
+
+	uint64_t hash_value = hash(sequence);
+	size_t mask = state->capacity - 1;
+	size_t slot = hash_value & mask;
+	while(state->entries[slot].sequence != NULL) {
+		SeqCount *entry = &state->entries[slot];
+		if(entry->hash == hash_value && strcmp(entry->sequence, sequence) == 0) {
+			entry->count++;
+			state->total++;
+			return;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	state->entries[slot].hash = hash_value;
+	state->entries[slot].count = 1;
+	state->entries[slot].sequence = strdup(sequence);
+	if(state->entries[slot].sequence == NULL) {
+		error_message("katss: Failed to allocate memory for sequence");
+		exit(EXIT_FAILURE);
+	}
+	state->num_seqs++;
+	state->total++;
+}
+
+
+char *
+seq_counts_next(SeqCounts *counts, uint32_t *count)
+{
+	sc_statep state = (sc_statep)counts;
+	char *sequence = NULL;
+
+	mtx_lock(&state->lock);
+	while(state->cursor < state->capacity) {
+		SeqCount *entry = &state->entries[state->cursor++];
+		if(entry->sequence != NULL) {
+			sequence = entry->sequence;
+			*count = entry->count;
+			break;
+		}
+	}
+	mtx_unlock(&state->lock);
+
+	return sequence;
+}
+
+
+void
+seq_counts_rewind(SeqCounts *counts)
+{
+	sc_statep state = (sc_statep)counts;
+	mtx_lock(&state->lock);
+	state->cursor = 0;
+	mtx_unlock(&state->lock);
+}
+
+
+void
+free_seq_counts(SeqCounts *counts)
+{
+	if(counts == NULL)
+		return;
+	sc_statep state = (sc_statep)counts;
+
+	for(size_t i = 0; i < state->capacity; i++)
+		free(state->entries[i].sequence);
+
+	mtx_destroy(&state->lock);
+	free(state->entries);
+	free(state);
+}
+
+
+static void
+grow(sc_statep state)
+{
+	size_t   old_capacity = state->capacity;
+	SeqCount *old_entries = state->entries;
+
+	state->capacity = old_capacity * 2;
+	state->entries  = s_calloc(state->capacity, sizeof *state->entries);
+
+	size_t mask = state->capacity - 1;
+	for(size_t i = 0; i < old_capacity; i++) {
+		if(old_entries[i].sequence == NULL)
+			continue;
+		size_t slot = old_entries[i].hash & mask;
+		while(state->entries[slot].sequence != NULL)
+			slot = (slot + 1) & mask;
+		state->entries[slot] = old_entries[i];
+	}
+
+	free(old_entries);
+}
+
+
+static uint64_t
+hash(const char *sequence)
+{
+	/* 64-bit FNV-1a */
+	uint64_t hash_value = 14695981039346656037ULL;
+	while(*sequence) {
+		hash_value ^= (unsigned char)*sequence++;
+		hash_value *= 1099511628211ULL;
+	}
+	return hash_value;
+}
@@ -0,0 +1,77 @@
+#ifndef SEQ_COUNTS_H
+#define SEQ_COUNTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ *  @brief Entries for SeqCounts data structure. Stores a distinct sequence along with the number
+ *  of times it was seen.
+*/
+typedef struct {
+	uint64_t hash;
+	uint32_t count;
+	char     *sequence;
+} SeqCount;
+
+
+/**
+ *  @brief Multiset of sequences, used to fold every distinct sequence of a file only once.
+ *
+ *  Sequences are stored in an open-addressed hash table. Once all sequences have been added,
+ *  the table can be iterated (from multiple threads) with seq_counts_next.
+*/
+struct SeqCounts {
+	size_t   num_seqs;     /** Number of distinct sequences in table */
+	uint64_t total;        /** Number of sequences added to table     */
+	size_t   capacity;     /** Number of slots in entries             */
+	SeqCount *entries;
+};
+typedef struct SeqCounts SeqCounts;
+
+
+/**
+ *  @brief Initializes an empty SeqCounts table.
+ *
+ *  @return Pointer to the initialized SeqCounts
+*/
+SeqCounts *init_seq_counts(void);
+
+
+/**
+ *  @brief Add a sequence to the table, incrementing its count if it was already present.
+ *
+ *  @param counts   SeqCounts to add the sequence to.
+ *  @param sequence Null-terminated sequence to add. The sequence is copied.
+*/
+void seq_counts_add(SeqCounts *counts, const char *sequence);
+
+
+/**
+ *  @brief Get the next distinct sequence in the table along with its count. This function is
+ *  thread-safe, and every sequence will only be returned once across all threads.
+ *
+ *  @param counts   SeqCounts to iterate through.
+ *  @param count    Set to the number of times the returned sequence was seen.
+ *
+ *  @return Pointer to the next distinct sequence, or NULL once all sequences were returned.
+*/
+char *seq_counts_next(SeqCounts *counts, uint32_t *count);
+
+
+/**
+ *  @brief Restart the iteration of seq_counts_next from the first sequence.
+ *
+ *  @param counts   SeqCounts to rewind.
+*/
+void seq_counts_rewind(SeqCounts *counts);
+
+
+/**
+ *  Free all allocated memory in SeqCounts.
+ *
+ *  @param counts   SeqCounts to free memory from.
+*/
+void free_seq_counts(SeqCounts *counts);
+
+#endif // SEQ_COUNTS_H
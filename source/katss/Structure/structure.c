@@ -1,12 +1,24 @@
+#include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <math.h>
 
 #include <ViennaRNA/fold.h>
 #include <ViennaRNA/part_func.h>
+#include <ViennaRNA/fold_compound.h>
+#include <ViennaRNA/mfe.h>
+#include <ViennaRNA/boltzmann_sampling.h>
+#include <ViennaRNA/params/basic.h>
+#include <ViennaRNA/utils/structures.h>
 
 #include "seqfile.h"
 #include "memory_utils.h"
+#include "katss_jobs.h"
 #include "bpp_tables.h"
+#include "bpp_cache.h"
+#include "bpp_linear.h"
+#include "bpp_partners.h"
+#include "seq_counts.h"
 #include "structure.h"
 #include "string_utils.h"
 
@@ -22,11 +34,38 @@
 
 #define BUFFER_SIZE 65536
 
+/* Largest number of reads and nucleotides read into memory at once when
+   folding with multiple threads */
+#define MAX_BATCH_READS 16384
+#define MAX_BATCH_BASES (1 << 22)
+
+/* Base pairs less likely than this are left out of the partner matrix. They make up most of
+   the pair list of a read but add little mass */
+#define PARTNER_MIN_PROBABILITY 0.01F
+
+struct fold_task {
+	char *sequence;
+	double weight;
+	uint64_t id;
+};
+typedef struct fold_task fold_task;
+
+typedef struct fold_scheduler fold_scheduler;
+
 struct record_data {
 	char *sequence;
+	double weight;          /* Number of reads the sequence stands for */
 	kmerHashTable *counts_table;
 	BppOptions *opts;
 	SeqFile read_file;
+	SeqCounts *unique;      /* Distinct sequences, only set with opts->dedup */
+	fold_scheduler *scheduler;  /* Scheduler the record belongs to, if any */
+	bool running_stats;     /* Keep running mean and variance instead of sums */
+	BppCacheWriter *cache;  /* Where to store the probabilities of each read, if any */
+	BppStrata *strata;      /* Paired and unpaired k-mer counts, if any */
+	BppPartners *partners;  /* Partner matrix of this thread, if any */
+	uint64_t id;            /* Index of the read in its file, 0 for distinct sequences */
+	double *replicate_weights;  /* Bootstrap weights of the sequence, with opts->bootstraps */
 };
 
 typedef struct record_data record_data;
@@ -123,15 +162,28 @@ seqfopen_detect(const char *filename)
 	return seqfopen(filename, mode);
 }
 
+/* The probabilities of the base pairs are handed to pairs when it is not NULL, as a list
+   terminated by a pair with i = 0 */
 static float *
-getPositionalProbabilities(char *sequence)
+getPartitionProbabilities(char *sequence, int max_bp_span, vrna_ep_t **pairs)
 {
 	vrna_ep_t *ptr, *pair_probabilities = NULL;
 	float *positional_probabilities = s_calloc(strlen(sequence), sizeof(float));
 	float  probability;
 
 	/* Get the pair probabilities */
-	vrna_pf_fold(sequence, NULL, &pair_probabilities);
+	if(max_bp_span > 0) {
+		vrna_md_t md;
+		vrna_md_set_default(&md);
+		md.max_bp_span = max_bp_span;
+
+		vrna_fold_compound_t *fc = vrna_fold_compound(sequence, &md, VRNA_OPTION_PF);
+		vrna_pf(fc, NULL);
+		pair_probabilities = vrna_plist_from_probs(fc, 1e-6);
+		vrna_fold_compound_free(fc);
+	} else {
+		vrna_pf_fold(sequence, NULL, &pair_probabilities);
+	}
 
 	/* Move pair probabilities into array */
 	for(ptr = pair_probabilities; ptr->i != 0; ptr++) {
@@ -141,45 +193,131 @@ getPositionalProbabilities(char *sequence)
 	}
 
 	/* Clean up memory */
-	free(pair_probabilities);
+	if(pairs != NULL)
+		*pairs = pair_probabilities;
+	else
+		free(pair_probabilities);
 
 	return positional_probabilities;
 }
 
+/* Append the base pairs of a structure in dot-bracket notation to a pair list */
 static void
-process_sequence(record_data *record)
+append_structure_pairs(vrna_ep_t **pairs, size_t *num_pairs, size_t *capacity,
+                       const char *structure, float probability)
 {
-	BppOptions *opts = record->opts;
+	size_t length = strlen(structure);
+	int *stack = s_malloc((length + 1) * sizeof *stack);
+	int depth = 0;
+
+	for(size_t i = 0; i < length; i++) {
+		if(structure[i] == '(') {
+			stack[depth++] = (int)i + 1;
+		} else if(structure[i] == ')' && depth > 0) {
+			if(*num_pairs + 1 >= *capacity) {
+				*capacity = 2 * *capacity + 16;
+				*pairs = s_realloc(*pairs, *capacity * sizeof **pairs);
+			}
+			vrna_ep_t *pair = &(*pairs)[(*num_pairs)++];
+			pair->i = stack[--depth];
+			pair->j = (int)i + 1;
+			pair->p = probability;
+			pair->type = 0;
+		}
+	}
+	(*pairs)[*num_pairs].i = 0;
+	(*pairs)[*num_pairs].j = 0;
+	free(stack);
+}
 
-	char  *sequence  = record->sequence;
-	int   num_kmers_in_seq = strlen(sequence) - opts->kmer + 1;
+static float *
+getMfeProbabilities(char *sequence, vrna_ep_t **pairs)
+{
+	size_t length = strlen(sequence);
+	float *positional_probabilities = s_malloc(length * sizeof *positional_probabilities);
+	char  *structure = s_malloc(length + 1);
+
+	vrna_md_t md;
+	vrna_md_set_default(&md);
+	vrna_fold_compound_t *fc = vrna_fold_compound(sequence, &md, VRNA_OPTION_MFE);
+	vrna_mfe(fc, structure);
+	vrna_fold_compound_free(fc);
+
+	/* Paired nucleotides are either '(' or ')' in dot-bracket notation */
+	for(size_t i = 0; i < length; i++)
+		positional_probabilities[i] = structure[i] == '.' ? 0.0F : 1.0F;
+
+	if(pairs != NULL) {
+		size_t num_pairs = 0, capacity = length / 2 + 1;
+		*pairs = s_malloc(capacity * sizeof **pairs);
+		append_structure_pairs(pairs, &num_pairs, &capacity, structure, 1.0F);
+	}
 
-	float *positional_probabilities = getPositionalProbabilities(sequence);
+	free(structure);
+	return positional_probabilities;
+}
 
-	/* Count kmers and their associated base-pair probability */
-	for(int i=0; i<num_kmers_in_seq; i++) {
-		int shift = opts->kmer+i;
-		char tmp = *(sequence+shift);
-		*(sequence+shift) = '\0'; // terminate the string to k-mer length
+static float *
+getSampledProbabilities(char *sequence, int num_samples, vrna_ep_t **pairs)
+{
+	size_t length = strlen(sequence);
+	float *positional_probabilities = s_calloc(length, sizeof *positional_probabilities);
+	char  *structure = s_malloc(length + 1);
+
+	/* Stochastic backtracking requires unique multiloop decomposition, and the
+	   partition function is scaled by the mfe to avoid overflows */
+	vrna_md_t md;
+	vrna_md_set_default(&md);
+	md.uniq_ML = 1;
+	md.compute_bpp = 0;
+
+	vrna_fold_compound_t *fc = vrna_fold_compound(sequence, &md, VRNA_OPTION_PF);
+	double mfe = (double)vrna_mfe(fc, structure);
+	vrna_exp_params_rescale(fc, &mfe);
+	vrna_pf(fc, NULL);
+
+	/* Every sampled pair stands for 1/num_samples of the probability of the pair */
+	size_t num_pairs = 0, capacity = length / 2 + 1;
+	if(pairs != NULL) {
+		*pairs = s_malloc(capacity * sizeof **pairs);
+		(*pairs)[0].i = 0;
+	}
 
-		kmer_add_value(record->counts_table, sequence+i, 1, opts->kmer);
-		/* Loop through bpp values in file */
-		for(int j=i; j<opts->kmer+i; j++) {
-			kmer_add_value(record->counts_table, sequence+i, positional_probabilities[j], j-i);
-		}
-		*(sequence+shift) = tmp;
+	for(int s = 0; s < num_samples; s++) {
+		char *sample = vrna_pbacktrack(fc);
+		if(sample == NULL)
+			continue;
+		for(size_t i = 0; i < length; i++)
+			if(sample[i] != '.')
+				positional_probabilities[i] += 1.0F;
+		if(pairs != NULL)
+			append_structure_pairs(pairs, &num_pairs, &capacity, sample, 1.0F / num_samples);
+		free(sample);
 	}
+	vrna_fold_compound_free(fc);
 
-	free(positional_probabilities);
+	for(size_t i = 0; i < length; i++)
+		positional_probabilities[i] /= (float)num_samples;
+
+	free(structure);
+	return positional_probabilities;
 }
 
-void
-process_windows(record_data *record)
+static float *
+getPositionalProbabilities(char *sequence, BppOptions *opts, vrna_ep_t **pairs)
 {
-	char       *sequence = record->sequence;
-	BppOptions *opts     = record->opts;
-	kmerHashTable *counts_table = record->counts_table;
+	switch(opts->structure_model) {
+		case BPP_MODEL_MFE:    return getMfeProbabilities(sequence, pairs);
+		case BPP_MODEL_SAMPLE: return getSampledProbabilities(sequence, opts->num_samples, pairs);
+		case BPP_MODEL_SPAN:   return getPartitionProbabilities(sequence, opts->max_bp_span, pairs);
+		case BPP_MODEL_LINEAR: return bpp_linear_fold(sequence, opts->beam_size, pairs);
+		default:               return getPartitionProbabilities(sequence, 0, pairs);
+	}
+}
 
+static float *
+getWindowProbabilities(char *sequence, BppOptions *opts)
+{
 	char    *window_seq;
 	float   *window_probabilities;
 	float   mean_probability;
@@ -191,8 +329,7 @@ process_windows(record_data *record)
 	seq_length = strlen(sequence);
 	num_windows = seq_length - opts->window_size + 1;
 	if(num_windows < 1) {
-		process_sequence(record);
-		return;
+		return getPositionalProbabilities(sequence, opts, NULL);
 	}
 
 	/* Initialize probability matrix with -1 */
@@ -211,7 +348,7 @@ process_windows(record_data *record)
 		window_seq[opts->window_size] = '\0';
 
 		/* Get probabilities from the window sequence */
-		window_probabilities = getPositionalProbabilities(window_seq);
+		window_probabilities = getPositionalProbabilities(window_seq, opts, NULL);
 		window_seq[opts->window_size] = tmp;
 
 		/* Dump probabilities to matrix*/
@@ -245,33 +382,658 @@ process_windows(record_data *record)
 		free(probability_matrix[i]);
 	free(probability_matrix);
 
-	/* Fill counts_table with positional probabilities */
-	int num_kmers_in_seq = seq_length - opts->kmer + 1;
-	for(int i=0; i<num_kmers_in_seq; i++) {
-		int shift = opts->kmer + i;
-		char tmp = *(sequence + shift);
-		*(sequence + shift) = '\0';
-		kmer_add_value(counts_table, sequence+i, 1, opts->kmer);
-		for(int j=i; j<opts->kmer+i; j++) {
-			kmer_add_value(counts_table, sequence+i, positional_probabilities[j], j-i);
+	return positional_probabilities;
+}
+
+static uint64_t
+splitmix64(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/* Reads without any of the target k-mers are not folded at all */
+static bool
+skip_sequence(const char *sequence, BppOptions *opts)
+{
+	return opts->targets != NULL && bpp_targets_find(opts->targets, sequence, 0) < 0;
+}
+
+/* 2-bit hash of the k-mer starting at sequence, false if it has other characters */
+static bool
+hash_kmer(const char *sequence, int kmer, uint32_t *hash)
+{
+	*hash = 0;
+	for(int j = 0; j < kmer; j++) {
+		switch(sequence[j]) {
+			case 'A': *hash = *hash * 4;     break;
+			case 'C': *hash = *hash * 4 + 1; break;
+			case 'G': *hash = *hash * 4 + 2; break;
+			case 'U': *hash = *hash * 4 + 3; break;
+			default:  return false;
 		}
-		*(sequence + shift) = tmp;
 	}
+	return true;
+}
 
-	free(positional_probabilities);
+/* Count an occurrence of a k-mer in the paired or unpaired table, depending on the mean pairing
+   probability of its nucleotides */
+static void
+add_kmer_context(record_data *record, const char *kmer, float *kmer_probabilities)
+{
+	BppOptions *opts   = record->opts;
+	BppStrata  *strata = record->strata;
+	uint32_t    hash;
+	double      mean   = 0.;
+
+	if(!hash_kmer(kmer, opts->kmer, &hash))
+		return;
+	for(int j=0; j<opts->kmer; j++)
+		mean += kmer_probabilities[j];
+	mean = MIN2(MAX2(mean / opts->kmer, 0.), 1.);
+
+	if(opts->strata_weighting == BPP_STRATA_EXPECTED) {
+		uint64_t total  = (uint64_t)llround(record->weight * BPP_STRATA_SCALE);
+		uint64_t paired = (uint64_t)llround(record->weight * BPP_STRATA_SCALE * mean);
+		katss_increment_by(strata->paired, hash, paired);
+		katss_increment_by(strata->unpaired, hash, total - paired);
+	} else {
+		KatssCounter *context = mean >= opts->paired_threshold ? strata->paired : strata->unpaired;
+		katss_increment_by(context, hash, (uint64_t)llround(record->weight));
+	}
+}
+
+/* Poisson distributed count, with a normal approximation for large means */
+static double
+poisson_draw(uint64_t *state, double mean)
+{
+	if(mean > 30.) {
+		double u1 = ((splitmix64(state) >> 11) + 1) * 0x1.0p-53;
+		double u2 = (splitmix64(state) >> 11) * 0x1.0p-53;
+		double z  = sqrt(-2. * log(u1)) * cos(6.283185307179586 * u2);
+		return MAX2(round(mean + sqrt(mean) * z), 0.);
+	}
+
+	double limit = exp(-mean), product = 1.;
+	double count = -1.;
+	do {
+		product *= (splitmix64(state) >> 11) * 0x1.0p-53;
+		count += 1.;
+	} while(product > limit);
+	return count;
+}
+
+/* Draw the number of times the sequence is resampled in every bootstrap replicate. The draws
+   only depend on the seed, the sequence and its index, so they don't change with the number
+   of threads */
+static void
+draw_replicate_weights(record_data *record)
+{
+	uint64_t state = record->opts->seed;
+	uint64_t id = record->id;
+	for(const char *ptr = record->sequence; *ptr; ptr++)
+		state = (state ^ (unsigned char)*ptr) * 0x100000001B3ULL;
+	state ^= splitmix64(&id);
+
+	for(int r = 0; r < record->opts->bootstraps; r++)
+		record->replicate_weights[r] = poisson_draw(&state, record->weight);
+}
+
+static void
+add_kmer(record_data *record, char *kmer, float *kmer_probabilities)
+{
+	int    k      = record->opts->kmer;
+	double weight = record->weight;
+
+	char tmp = kmer[k];
+	kmer[k] = '\0'; // terminate the string to k-mer length
+	if(record->replicate_weights != NULL) {
+		kmer_add_replicates(record->counts_table, kmer, kmer_probabilities, weight,
+		                    record->replicate_weights, record->opts->bootstraps);
+	} else if(record->running_stats) {
+		kmer_add_sample(record->counts_table, kmer, kmer_probabilities, weight);
+	} else {
+		kmer_add_value(record->counts_table, kmer, weight, k);
+		/* Loop through bpp values in file */
+		for(int j=0; j<k; j++)
+			kmer_add_value(record->counts_table, kmer, weight * kmer_probabilities[j], j);
+	}
+	if(record->strata != NULL)
+		add_kmer_context(record, kmer, kmer_probabilities);
+	kmer[k] = tmp;
+}
+
+static void
+add_kmer_probabilities(record_data *record, float *positional_probabilities)
+{
+	BppOptions *opts = record->opts;
+
+	char  *sequence  = record->sequence;
+	int   num_kmers_in_seq = strlen(sequence) - opts->kmer + 1;
+
+	/* Count kmers and their associated base-pair probability */
+	for(int i=0; i<num_kmers_in_seq; i++) {
+		if(opts->targets != NULL && !bpp_targets_contains(opts->targets, sequence+i))
+			continue;
+		add_kmer(record, sequence+i, positional_probabilities+i);
+	}
+}
+
+/* Add each base pair (i, j) to the partner matrix, under the k-mer starting at i and the
+   k-mer ending at j. With targets, only the pairs involving one of them are kept */
+static void
+add_partner_pairs(record_data *record, vrna_ep_t *pairs)
+{
+	BppOptions *opts     = record->opts;
+	char       *sequence = record->sequence;
+	int         length   = strlen(sequence);
+	int         k        = opts->kmer;
+
+	for(vrna_ep_t *pair = pairs; pair->i != 0; pair++) {
+		int five_prime  = pair->i - 1;
+		int three_prime = pair->j - k;
+		if(pair->p < PARTNER_MIN_PROBABILITY || three_prime < 0 || five_prime + k > length)
+			continue;
+		if(opts->targets != NULL && !bpp_targets_contains(opts->targets, sequence + five_prime) &&
+		   !bpp_targets_contains(opts->targets, sequence + three_prime))
+			continue;
+
+		uint32_t five_hash, three_hash;
+		if(!hash_kmer(sequence + five_prime, k, &five_hash) ||
+		   !hash_kmer(sequence + three_prime, k, &three_hash))
+			continue;
+		bpp_partners_add(record->partners, five_hash, three_hash, record->weight * pair->p);
+	}
+}
+
+/* Fold a window of opts->target_window nucleotides centered on every occurrence of a target,
+   and only count the k-mer of that occurrence */
+static void
+process_target_windows(record_data *record)
+{
+	BppOptions *opts     = record->opts;
+	char       *sequence = record->sequence;
+	int         length   = strlen(sequence);
+	int         window   = MIN2(opts->target_window, length);
+
+	for(int pos = bpp_targets_find(opts->targets, sequence, 0); pos >= 0;
+	    pos = bpp_targets_find(opts->targets, sequence, pos + 1)) {
+		int start = pos + opts->kmer / 2 - window / 2;
+		start = MAX2(start, 0);
+		start = MIN2(start, length - window);
+
+		char tmp = sequence[start + window];
+		sequence[start + window] = '\0';
+		float *window_probabilities = katss_bpp_fold(sequence + start, opts);
+		sequence[start + window] = tmp;
+
+		add_kmer(record, sequence + pos, window_probabilities + (pos - start));
+		free(window_probabilities);
+	}
 }
 
 static void
 process_record(record_data *record)
 {
-	/* If --seq-windows was provided, use the sliding window algorithm for calculations */
-	if(record->opts->seq_windows) {
-		process_windows(record);
+	if(record->replicate_weights != NULL)
+		draw_replicate_weights(record);
 
-	/* Default algorithm for getting BPP frequencies */
+	if(record->opts->targets != NULL && record->opts->target_window > 0) {
+		process_target_windows(record);
+		return;
+	}
+
+	/* The partner matrix needs the base pairs, which the sliding windows don't keep */
+	float *positional_probabilities;
+	if(record->partners != NULL) {
+		vrna_ep_t *pairs = NULL;
+		positional_probabilities = getPositionalProbabilities(record->sequence, record->opts, &pairs);
+		add_partner_pairs(record, pairs);
+		free(pairs);
 	} else {
-		process_sequence(record);
+		positional_probabilities = katss_bpp_fold(record->sequence, record->opts);
+	}
+	if(record->cache != NULL)
+		bpp_cache_append(record->cache, record->sequence, record->id, (uint32_t)record->weight,
+		                 positional_probabilities);
+	add_kmer_probabilities(record, positional_probabilities);
+	free(positional_probabilities);
+}
+
+/* Work-stealing scheduler for folding tasks. Tasks are handed out in batches,
+   ordered by their estimated cost (cubic in the sequence length, or linear with
+   the linear model) and dealt to the thread queues so that every queue has
+   about the same amount of work.
+   Threads fold the most expensive task of their own queue first, and once it
+   is empty, steal the cheapest tasks of the queue with the most work left. */
+struct fold_queue {
+	size_t *tasks;        /* Indices of the tasks, most expensive first */
+	size_t head;          /* Next task to be taken by the owner         */
+	size_t tail;          /* One past the next task to be stolen        */
+	double remaining;     /* Estimated cost of the tasks left           */
+	mtx_t  lock;
+};
+typedef struct fold_queue fold_queue;
+
+struct fold_scheduler {
+	int           num_threads;
+	BppOptions    *opts;
+	fold_queue    *queues;
+	record_data   *records;
+	thrd_t        *jobs;
+
+	fold_task     *tasks;       /* Tasks of the current batch                */
+	double        *costs;       /* Estimated cost of the tasks               */
+	size_t        capacity;     /* Allocated size of the task index arrays   */
+
+	mtx_t         lock;
+	cnd_t         work_ready;
+	cnd_t         work_done;
+	unsigned long generation;   /* Incremented every time a batch is posted  */
+	int           active;       /* Threads still working on the batch        */
+	bool          shutdown;
+
+	double        *busy;        /* Seconds each thread spent folding         */
+	uint64_t      *folded;      /* Number of tasks each thread folded        */
+	double        start_time;
+};
+typedef struct fold_scheduler fold_scheduler;
+
+static double *
+new_replicate_weights(BppOptions *opts)
+{
+	if(opts->bootstraps <= 0)
+		return NULL;
+	return s_calloc(opts->bootstraps, sizeof(double));
+}
+
+static double
+wall_time(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double
+fold_cost(const char *sequence, BppOptions *opts)
+{
+	double length = strlen(sequence);
+	if(opts->structure_model == BPP_MODEL_LINEAR)
+		return length;
+	return length * length * length;
+}
+
+static bool
+next_task(fold_scheduler *scheduler, int id, size_t *task)
+{
+	fold_queue *own = &scheduler->queues[id];
+
+	/* Take the most expensive task from our own queue */
+	mtx_lock(&own->lock);
+	if(own->head < own->tail) {
+		*task = own->tasks[own->head++];
+		own->remaining -= scheduler->costs[*task];
+		mtx_unlock(&own->lock);
+		return true;
+	}
+	mtx_unlock(&own->lock);
+
+	/* Otherwise steal the cheapest task from the queue with the most work left */
+	while(true) {
+		int victim = -1;
+		double most = 0.;
+		for(int i = 0; i < scheduler->num_threads; i++) {
+			if(i == id)
+				continue;
+			fold_queue *queue = &scheduler->queues[i];
+			mtx_lock(&queue->lock);
+			if(queue->head < queue->tail && (victim < 0 || queue->remaining > most)) {
+				victim = i;
+				most = queue->remaining;
+			}
+			mtx_unlock(&queue->lock);
+		}
+		if(victim < 0)
+			return false;
+
+		fold_queue *queue = &scheduler->queues[victim];
+		mtx_lock(&queue->lock);
+		if(queue->head < queue->tail) {
+			*task = queue->tasks[--queue->tail];
+			queue->remaining -= scheduler->costs[*task];
+			mtx_unlock(&queue->lock);
+			return true;
+		}
+		mtx_unlock(&queue->lock);
+	}
+}
+
+static int
+scheduler_worker(void *arg)
+{
+	record_data    *record = (record_data *)arg;
+	fold_scheduler *scheduler = record->scheduler;
+	int            id = (int)(record - scheduler->records);
+	unsigned long  generation = 0;
+
+	while(true) {
+		mtx_lock(&scheduler->lock);
+		while(!scheduler->shutdown && scheduler->generation == generation)
+			cnd_wait(&scheduler->work_ready, &scheduler->lock);
+		if(scheduler->shutdown) {
+			mtx_unlock(&scheduler->lock);
+			break;
+		}
+		generation = scheduler->generation;
+		mtx_unlock(&scheduler->lock);
+
+		size_t task;
+		while(next_task(scheduler, id, &task)) {
+			double start = wall_time();
+			record->sequence = scheduler->tasks[task].sequence;
+			record->weight = scheduler->tasks[task].weight;
+			record->id = scheduler->tasks[task].id;
+			process_record(record);
+			scheduler->busy[id] += wall_time() - start;
+			scheduler->folded[id]++;
+		}
+
+		mtx_lock(&scheduler->lock);
+		if(--scheduler->active == 0)
+			cnd_signal(&scheduler->work_done);
+		mtx_unlock(&scheduler->lock);
+	}
+
+	return 0;
+}
+
+static fold_scheduler *
+scheduler_create(BppOptions *opts)
+{
+	fold_scheduler *scheduler = s_malloc(sizeof *scheduler);
+	int num_threads = opts->threads;
+
+	scheduler->num_threads = num_threads;
+	scheduler->opts     = opts;
+	scheduler->queues   = s_malloc(num_threads * sizeof *scheduler->queues);
+	scheduler->records  = s_malloc(num_threads * sizeof *scheduler->records);
+	scheduler->jobs     = s_malloc(num_threads * sizeof *scheduler->jobs);
+	scheduler->busy     = s_calloc(num_threads, sizeof *scheduler->busy);
+	scheduler->folded   = s_calloc(num_threads, sizeof *scheduler->folded);
+	scheduler->tasks    = NULL;
+	scheduler->costs    = NULL;
+	scheduler->capacity = 0;
+	scheduler->generation = 0;
+	scheduler->active   = 0;
+	scheduler->shutdown = false;
+	mtx_init(&scheduler->lock, mtx_plain);
+	cnd_init(&scheduler->work_ready);
+	cnd_init(&scheduler->work_done);
+
+	for(int i = 0; i < num_threads; i++) {
+		scheduler->queues[i].tasks = NULL;
+		scheduler->queues[i].head = 0;
+		scheduler->queues[i].tail = 0;
+		scheduler->queues[i].remaining = 0.;
+		mtx_init(&scheduler->queues[i].lock, mtx_plain);
+	}
+
+	for(int i = 0; i < num_threads; i++) {
+		record_data *record = &scheduler->records[i];
+		record->sequence = NULL;
+		record->weight = 1.;
+		record->counts_table = NULL;
+		record->opts = opts;
+		record->read_file = NULL;
+		record->unique = NULL;
+		record->scheduler = scheduler;
+		record->running_stats = false;
+		record->cache = NULL;
+		record->strata = NULL;
+		record->partners = opts->partners != NULL ? bpp_partners_init(opts->kmer) : NULL;
+		record->id = 0;
+		record->replicate_weights = new_replicate_weights(opts);
+		thrd_create(&scheduler->jobs[i], scheduler_worker, record);
+	}
+
+	scheduler->start_time = wall_time();
+	return scheduler;
+}
+
+struct task_cost {
+	double cost;
+	size_t index;
+};
+
+static int
+compare_costs(const void *p1, const void *p2)
+{
+	double a = ((const struct task_cost *)p1)->cost;
+	double b = ((const struct task_cost *)p2)->cost;
+	return (a < b) - (a > b);
+}
+
+/* Post a batch of tasks to be folded into table. Returns immediately, call
+   scheduler_wait before reusing or freeing the tasks. */
+static void
+scheduler_submit(fold_scheduler *scheduler, fold_task *tasks, size_t num_tasks,
+                 kmerHashTable *table, bool running_stats, BppCacheWriter *cache,
+                 BppStrata *strata)
+{
+	int num_threads = scheduler->num_threads;
+
+	if(num_tasks > scheduler->capacity) {
+		scheduler->capacity = num_tasks;
+		scheduler->costs = s_realloc(scheduler->costs, num_tasks * sizeof *scheduler->costs);
+		for(int i = 0; i < num_threads; i++) {
+			fold_queue *queue = &scheduler->queues[i];
+			queue->tasks = s_realloc(queue->tasks, num_tasks * sizeof *queue->tasks);
+		}
+	}
+
+	/* Sort the tasks by their cost, most expensive first */
+	struct task_cost *order = s_malloc((num_tasks + 1) * sizeof *order);
+	for(size_t i = 0; i < num_tasks; i++) {
+		order[i].cost = fold_cost(tasks[i].sequence, scheduler->opts);
+		order[i].index = i;
+		scheduler->costs[i] = order[i].cost;
+	}
+	qsort(order, num_tasks, sizeof *order, compare_costs);
+
+	/* Deal the tasks to the queue with the least work, so every queue is
+	   also sorted from the most to the least expensive task */
+	for(int j = 0; j < num_threads; j++) {
+		scheduler->queues[j].head = 0;
+		scheduler->queues[j].tail = 0;
+		scheduler->queues[j].remaining = 0.;
+	}
+	for(size_t i = 0; i < num_tasks; i++) {
+		fold_queue *least = &scheduler->queues[0];
+		for(int j = 1; j < num_threads; j++)
+			if(scheduler->queues[j].remaining < least->remaining)
+				least = &scheduler->queues[j];
+		least->tasks[least->tail++] = order[i].index;
+		least->remaining += order[i].cost;
+	}
+	free(order);
+
+	for(int i = 0; i < num_threads; i++) {
+		scheduler->records[i].counts_table = table;
+		scheduler->records[i].running_stats = running_stats;
+		scheduler->records[i].cache = cache;
+		scheduler->records[i].strata = strata;
+	}
+
+	mtx_lock(&scheduler->lock);
+	scheduler->tasks = tasks;
+	scheduler->active = num_threads;
+	scheduler->generation++;
+	cnd_broadcast(&scheduler->work_ready);
+	mtx_unlock(&scheduler->lock);
+}
+
+static void
+scheduler_wait(fold_scheduler *scheduler)
+{
+	mtx_lock(&scheduler->lock);
+	while(scheduler->active > 0)
+		cnd_wait(&scheduler->work_done, &scheduler->lock);
+	mtx_unlock(&scheduler->lock);
+}
+
+static void
+scheduler_destroy(fold_scheduler *scheduler)
+{
+	if(scheduler == NULL)
+		return;
+
+	scheduler_wait(scheduler);
+	mtx_lock(&scheduler->lock);
+	scheduler->shutdown = true;
+	cnd_broadcast(&scheduler->work_ready);
+	mtx_unlock(&scheduler->lock);
+	for(int i = 0; i < scheduler->num_threads; i++)
+		thrd_join(scheduler->jobs[i], NULL);
+
+	/* Merge the partner matrix of every thread */
+	for(int i = 0; i < scheduler->num_threads; i++) {
+		free(scheduler->records[i].replicate_weights);
+		if(scheduler->records[i].partners == NULL)
+			continue;
+		bpp_partners_merge(scheduler->opts->partners, scheduler->records[i].partners);
+		bpp_partners_free(scheduler->records[i].partners);
+	}
+
+	if(scheduler->opts->verbose) {
+		double elapsed = wall_time() - scheduler->start_time;
+		for(int i = 0; i < scheduler->num_threads; i++) {
+			fprintf(stderr, "katss: thread %3d folded %10llu sequences, busy %9.2fs of %9.2fs (%5.1f%%)\n",
+			        i, (unsigned long long)scheduler->folded[i], scheduler->busy[i], elapsed,
+			        elapsed > 0. ? 100. * scheduler->busy[i] / elapsed : 0.);
+		}
+	}
+
+	for(int i = 0; i < scheduler->num_threads; i++) {
+		mtx_destroy(&scheduler->queues[i].lock);
+		free(scheduler->queues[i].tasks);
+	}
+	mtx_destroy(&scheduler->lock);
+	cnd_destroy(&scheduler->work_ready);
+	cnd_destroy(&scheduler->work_done);
+	free(scheduler->queues);
+	free(scheduler->records);
+	free(scheduler->jobs);
+	free(scheduler->costs);
+	free(scheduler->busy);
+	free(scheduler->folded);
+	free(scheduler);
+}
+
+/* Records of a file read into memory, to be folded by the scheduler */
+struct read_batch {
+	fold_task *tasks;
+	size_t    num_tasks;
+	size_t    max_tasks;
+	char      *bases;
+	size_t    num_bases;
+	size_t    max_bases;
+};
+typedef struct read_batch read_batch;
+
+static size_t
+read_next_batch(SeqFile read_file, read_batch *batch, char *buffer, uint64_t *num_read,
+                BppOptions *opts)
+{
+	size_t *offsets = NULL;
+	uint64_t *ids = NULL;
+
+	batch->num_tasks = 0;
+	batch->num_bases = 0;
+	offsets = s_malloc(MAX_BATCH_READS * sizeof *offsets);
+	ids = s_malloc(MAX_BATCH_READS * sizeof *ids);
+	while(batch->num_tasks < MAX_BATCH_READS && batch->num_bases < MAX_BATCH_BASES) {
+		if(seqfgets_unlocked(read_file, buffer, BUFFER_SIZE) == NULL)
+			break;
+		/* Number every record, so skipped ones don't shift the ids of the rest */
+		uint64_t id = (*num_read)++;
+		clean_seq(buffer, true);
+		if(skip_sequence(buffer, opts))
+			continue;
+
+		size_t length = strlen(buffer) + 1;
+		if(batch->num_bases + length > batch->max_bases) {
+			batch->max_bases = MAX2(2 * batch->max_bases, batch->num_bases + length);
+			batch->bases = s_realloc(batch->bases, batch->max_bases);
+		}
+		memcpy(batch->bases + batch->num_bases, buffer, length);
+		ids[batch->num_tasks] = id;
+		offsets[batch->num_tasks++] = batch->num_bases;
+		batch->num_bases += length;
+	}
+
+	if(batch->num_tasks > batch->max_tasks) {
+		batch->max_tasks = batch->num_tasks;
+		batch->tasks = s_realloc(batch->tasks, batch->max_tasks * sizeof *batch->tasks);
+	}
+	for(size_t i = 0; i < batch->num_tasks; i++) {
+		batch->tasks[i].sequence = batch->bases + offsets[i];
+		batch->tasks[i].weight = 1.;
+		batch->tasks[i].id = ids[i];
+	}
+
+	free(offsets);
+	free(ids);
+	return batch->num_tasks;
+}
+
+static void
+fold_file_scheduled(fold_scheduler *scheduler, SeqFile read_file, kmerHashTable *counts_table,
+                    BppCacheWriter *cache, BppStrata *strata)
+{
+	read_batch batches[2] = {{0}, {0}};
+	char *buffer = s_malloc(BUFFER_SIZE * sizeof *buffer);
+	uint64_t num_read = 0;
+	int current = 0;
+
+	/* Read the next batch while the current one is being folded */
+	read_next_batch(read_file, &batches[current], buffer, &num_read, scheduler->opts);
+	while(batches[current].num_tasks > 0) {
+		scheduler_submit(scheduler, batches[current].tasks, batches[current].num_tasks,
+		                 counts_table, false, cache, strata);
+		read_next_batch(read_file, &batches[!current], buffer, &num_read, scheduler->opts);
+		scheduler_wait(scheduler);
+		current = !current;
 	}
+
+	for(int i = 0; i < 2; i++) {
+		free(batches[i].tasks);
+		free(batches[i].bases);
+	}
+	free(buffer);
+}
+
+static void
+fold_unique_scheduled(fold_scheduler *scheduler, SeqCounts *unique, kmerHashTable *counts_table,
+                      BppCacheWriter *cache, BppStrata *strata)
+{
+	fold_task *tasks = s_malloc((unique->num_seqs + 1) * sizeof *tasks);
+	size_t num_tasks = 0;
+	uint32_t count;
+	char *sequence;
+
+	while((sequence = seq_counts_next(unique, &count)) != NULL) {
+		tasks[num_tasks].sequence = sequence;
+		tasks[num_tasks].weight = count;
+		tasks[num_tasks].id = 0;
+		num_tasks++;
+	}
+
+	scheduler_submit(scheduler, tasks, num_tasks, counts_table, false, cache, strata);
+	scheduler_wait(scheduler);
+	free(tasks);
 }
 
 static int
@@ -281,55 +1043,230 @@ bpp_kmer_count(void *arg)
 	char *sequence = s_malloc(BUFFER_SIZE * sizeof *sequence);
 
 	record->sequence = sequence;
+	record->weight = 1.;
+	record->id = 0;
 	while(true) {
 		if(seqfgets(record->read_file, sequence, BUFFER_SIZE) == NULL)
 			break;
 		clean_seq(sequence, true);
-		process_record(record);
+		if(!skip_sequence(sequence, record->opts))
+			process_record(record);
+		record->id++;
 	}
 	free(sequence);
 	return 0;
 }
 
+static int
+bpp_unique_count(void *arg)
+{
+	record_data *record = (record_data *)arg;
+	uint32_t count;
+
+	/* Each distinct sequence is handed to exactly one thread, so it can be
+	   folded in place and weighted by the number of reads it represents */
+	while((record->sequence = seq_counts_next(record->unique, &count)) != NULL) {
+		record->weight = count;
+		process_record(record);
+	}
+	return 0;
+}
+
+static SeqCounts *
+count_unique_sequences(SeqFile read_file, BppOptions *opts)
+{
+	SeqCounts *unique = init_seq_counts();
+	char *sequence = s_malloc(BUFFER_SIZE * sizeof *sequence);
+
+	while(seqfgets_unlocked(read_file, sequence, BUFFER_SIZE) != NULL) {
+		clean_seq(sequence, true);
+		if(skip_sequence(sequence, opts))
+			continue;
+		seq_counts_add(unique, sequence);
+	}
+
+	free(sequence);
+	return unique;
+}
+
+static uint32_t
+fold_params_checksum(BppOptions *opts)
+{
+	char params[256];
+	int  length;
+
+	/* Only the parameters that change the probabilities of the selected model */
+	length = snprintf(params, sizeof params, "structure-model=%s",
+	                  katss_bpp_model_name(opts->structure_model));
+	if(opts->structure_model == BPP_MODEL_SPAN)
+		length += snprintf(params + length, sizeof params - length, " max-bp-span=%d",
+		                   opts->max_bp_span);
+	if(opts->structure_model == BPP_MODEL_SAMPLE)
+		length += snprintf(params + length, sizeof params - length, " samples=%d",
+		                   opts->num_samples);
+	if(opts->structure_model == BPP_MODEL_LINEAR)
+		length += snprintf(params + length, sizeof params - length, " beam-size=%d",
+		                   opts->beam_size);
+	if(opts->seq_windows)
+		length += snprintf(params + length, sizeof params - length, " seq-windows=%d",
+		                   opts->window_size);
+	/* Deduplicated records carry a multiplicity instead of a read index */
+	if(opts->dedup)
+		length += snprintf(params + length, sizeof params - length, " dedup");
+
+	return bpp_cache_crc32(0, params, (size_t)length);
+}
+
+static char *
+fold_cache_path(const char *filename, BppOptions *opts)
+{
+	const char *name = filename;
+	char *path;
+
+	if(opts->cache_dir == NULL) {
+		path = s_malloc(strlen(filename) + 6);
+		sprintf(path, "%s.kbpp", filename);
+		return path;
+	}
+
+	/* Keep only the file name of the source when a directory is given */
+	for(const char *ptr = filename; *ptr; ptr++)
+		if(*ptr == '/' || *ptr == '\\')
+			name = ptr + 1;
+	path = s_malloc(strlen(opts->cache_dir) + strlen(name) + 7);
+	sprintf(path, "%s/%s.kbpp", opts->cache_dir, name);
+	return path;
+}
+
+static void
+accumulate_cached(BppCache *cache, kmerHashTable *counts_table, BppOptions *opts,
+                  BppStrata *strata)
+{
+	record_data record;
+	float *positional_probabilities;
+	uint32_t count;
+
+	record.counts_table = counts_table;
+	record.opts = opts;
+	record.running_stats = false;
+	record.strata = strata;
+	record.partners = NULL;
+	record.replicate_weights = new_replicate_weights(opts);
+	/* Records are in the order the reads were folded in, so the index of each read is taken
+	   from its record for the bootstrap draws to match those of a fresh run */
+	while((record.sequence = bpp_cache_next(cache, &record.id, &count,
+	                                        &positional_probabilities)) != NULL) {
+		record.weight = count;
+		if(record.replicate_weights != NULL)
+			draw_replicate_weights(&record);
+		add_kmer_probabilities(&record, positional_probabilities);
+	}
+	free(record.replicate_weights);
+}
+
+/* The running means of a bootstrap table are already frequencies, only the sums of the
+   replicates have to be divided by their weights */
+static void
+bootstrap_frequencies(kmerHashTable *counts_table, int replicates)
+{
+	unsigned int kmer = counts_table->kmer;
+	for(size_t i = 0; i < counts_table->capacity; i++) {
+		if(counts_table->entries[i] == NULL)
+			continue;
+		for(int r = 0; r < replicates; r++) {
+			double *replicate = counts_table->entries[i]->values + 2*kmer+1 + r*(kmer+1);
+			for(unsigned int j = 0; j < kmer && replicate[kmer] > 0.; j++)
+				replicate[j] /= replicate[kmer];
+		}
+	}
+}
+
 static kmerHashTable *
-bpp_kmer_frequency(const char *filename, BppOptions *opts)
+bpp_kmer_frequency(const char *filename, BppOptions *opts, BppStrata *strata)
 {
 	kmerHashTable   *counts_table;
 	SeqFile         read_file;
 
+	SeqCounts       *unique = NULL;
+	BppCacheWriter  *cache = NULL;
+	thrd_start_t    count_func = bpp_kmer_count;
+
 	read_file    = seqfopen_detect(filename);
 	if(read_file == NULL)
 		return NULL;
-	counts_table = init_bpp_table(opts->kmer);
+	if(opts->bootstraps > 0)
+		counts_table = init_bpp_bootstrap_table(opts->kmer, opts->bootstraps);
+	else
+		counts_table = init_bpp_table(opts->kmer);
+
+	/* Reuse the probabilities of an earlier run if the reads and parameters match,
+	   otherwise store them for the next run. Targeted runs only fold some of the reads, or
+	   windows of them, so they can read a cache but never write one. The cache has no base
+	   pairs, so it is not read when the partner matrix is wanted */
+	if(opts->fold_cache && !(opts->targets != NULL && opts->target_window > 0)) {
+		char *cache_path = fold_cache_path(filename, opts);
+		uint32_t params_crc = fold_params_checksum(opts);
+		BppCache *cached = NULL;
+		if(opts->partners == NULL)
+			cached = bpp_cache_open(cache_path, filename, params_crc, opts->cache_bits);
+		if(cached != NULL) {
+			accumulate_cached(cached, counts_table, opts, strata);
+			bpp_cache_free(cached);
+			free(cache_path);
+			seqfclose(read_file);
+			goto frequencies;
+		}
+		if(opts->targets == NULL)
+			cache = bpp_cache_create(cache_path, filename, params_crc, opts->cache_bits);
+		free(cache_path);
+	}
+
+	/* Collapse identical sequences so each one only gets folded once */
+	if(opts->dedup) {
+		unique = count_unique_sequences(read_file, opts);
+		count_func = bpp_unique_count;
+	}
 
 	/* Multi-threaded bpp counting */
 	if(opts->threads > 1) {
-		record_data *rd = s_malloc(opts->threads * sizeof *rd);
-		thrd_t *jobs = s_malloc(opts->threads * sizeof *jobs);
-		for(int i=0; i<opts->threads; i++) {
-			rd[i].read_file = read_file;
-			rd[i].opts = opts;
-			rd[i].counts_table = counts_table;
-			rd[i].sequence = NULL;
-			thrd_create(&jobs[i], bpp_kmer_count, &rd[i]);
-		}
-		for(int i=0; i<opts->threads; i++) {
-			thrd_join(jobs[i], NULL);
+		fold_scheduler *scheduler = scheduler_create(opts);
+		if(opts->dedup) {
+			fold_unique_scheduled(scheduler, unique, counts_table, cache, strata);
+		} else {
+			fold_file_scheduled(scheduler, read_file, counts_table, cache, strata);
 		}
-		free(jobs);
-		free(rd);
+		scheduler_destroy(scheduler);
 	/* Single-threaded bpp counting */
 	} else {
 		record_data *record = s_malloc(sizeof *record);
 		record->sequence = NULL;
+		record->weight = 1.;
 		record->counts_table = counts_table;
 		record->opts = opts;
 		record->read_file = read_file;
-		bpp_kmer_count((void *)record);
+		record->unique = unique;
+		record->scheduler = NULL;
+		record->running_stats = false;
+		record->cache = cache;
+		record->strata = strata;
+		record->partners = opts->partners;
+		record->id = 0;
+		record->replicate_weights = new_replicate_weights(opts);
+		count_func((void *)record);
+		free(record->replicate_weights);
 		free(record);
 	}
 
+	free_seq_counts(unique);
 	seqfclose(read_file);
+	if(cache != NULL)
+		bpp_cache_finish(cache);
+
+frequencies:
+	if(opts->bootstraps > 0) {
+		bootstrap_frequencies(counts_table, opts->bootstraps);
+		return counts_table;
+	}
 
 	/* Calculate the frequencies */
 	int num_columns = counts_table->cols-1;
@@ -338,7 +1275,7 @@ bpp_kmer_frequency(const char *filename, BppOptions *opts)
 			continue;
 		}
 		for(int j=0; j<num_columns; j++) {
-			int total_count=(int)counts_table->entries[i]->values[num_columns];
+			double total_count=counts_table->entries[i]->values[num_columns];
 			counts_table->entries[i]->values[j]/=total_count;
 		}
 	}
@@ -346,6 +1283,49 @@ bpp_kmer_frequency(const char *filename, BppOptions *opts)
 	return counts_table;
 }
 
+struct fold_job {
+	const char *filename;
+	BppOptions opts;            /* Copy of the options, with the threads allotted to the job */
+	BppStrata *strata;
+	kmerHashTable *frequencies;
+};
+typedef struct fold_job fold_job;
+
+static int
+run_fold_job(void *arg, int threads)
+{
+	fold_job *job = (fold_job *)arg;
+	job->opts.threads = threads;
+	job->frequencies = bpp_kmer_frequency(job->filename, &job->opts, job->strata);
+	return job->frequencies == NULL;
+}
+
+static void
+fold_job_init(katss_job *job, fold_job *fold, const char *filename, BppOptions *opts,
+              BppStrata *strata)
+{
+	fold->filename = filename;
+	fold->opts = *opts;
+	fold->strata = strata;
+	fold->frequencies = NULL;
+	katss_job_init(job, run_fold_job, fold, katss_file_weight(filename));
+}
+
+/* Both files would write to the same fold cache, so they can't be folded at the same time */
+static bool
+shares_fold_cache(const char *test_file, const char *ctrl_file, BppOptions *opts)
+{
+	if(!opts->fold_cache)
+		return false;
+
+	char *test_cache = fold_cache_path(test_file, opts);
+	char *ctrl_cache = fold_cache_path(ctrl_file, opts);
+	bool shared = strcmp(test_cache, ctrl_cache) == 0;
+	free(test_cache);
+	free(ctrl_cache);
+	return shared;
+}
+
 static int
 bpp_compare(const void *p1, const void *p2)
 {
@@ -426,6 +1406,295 @@ bpp_enrichment(kmerHashTable *control_frq, kmerHashTable *bound_frq, int kmer)
 	return enrichments_table;
 }
 
+/* Variance of the natural log fold change of position j, using the delta method on the
+   running mean and variance of the position in the test and control */
+static double
+log_ratio_variance(const double *test_values, const double *ctrl_values, int kmer, int j)
+{
+	double test_mean = test_values[j], test_n = test_values[kmer];
+	double ctrl_mean = ctrl_values[j], ctrl_n = ctrl_values[kmer];
+	if(test_mean <= 0. || ctrl_mean <= 0. || test_n < 2 || ctrl_n < 2)
+		return INFINITY;
+	double test_var = test_values[kmer+1+j] / (test_n - 1);
+	double ctrl_var = ctrl_values[kmer+1+j] / (ctrl_n - 1);
+	return test_var / (test_n * test_mean * test_mean) + ctrl_var / (ctrl_n * ctrl_mean * ctrl_mean);
+}
+
+/* Mean log2 fold change of the k-mer in bootstrap replicate r, NAN if a position is missing */
+static double
+replicate_enrichment(const double *test_values, const double *ctrl_values, int kmer, int r)
+{
+	const double *test = test_values + 2*kmer+1 + r*(kmer+1);
+	const double *ctrl = ctrl_values + 2*kmer+1 + r*(kmer+1);
+	double mean = 0.;
+	for(int j = 0; j < kmer; j++) {
+		if(test[j] <= 0. || ctrl[j] <= 0.)
+			return NAN;
+		mean += log2(test[j] / ctrl[j]);
+	}
+	return mean / kmer;
+}
+
+/* Two-sided p-value of a normally distributed estimate being different from zero */
+static double
+normal_p_value(double estimate, double error)
+{
+	return erfc(fabs(estimate) / (error * sqrt(2.)));
+}
+
+/* Append the standard error of each position and of the mean to the enrichments, followed by
+   their p-values. The errors of the positions come from their running variances. The positions
+   of a k-mer are not independent, so the error of the mean comes from the spread of the mean
+   over the bootstrap replicates instead */
+static void
+bootstrap_errors(kmerHashTable *enrichments, kmerHashTable *ctrl_stats,
+                 kmerHashTable *test_stats, int replicates)
+{
+	int kmer = enrichments->kmer;
+	int cols = 3*(kmer+1);
+
+	for(size_t i = 0; i < enrichments->capacity; i++) {
+		Entry *entry = enrichments->entries[i];
+		if(entry == NULL)
+			continue;
+		const double *test_values = test_stats->entries[entry->hash]->values;
+		const double *ctrl_values = ctrl_stats->entries[entry->hash]->values;
+
+		entry->values = s_realloc(entry->values, cols * sizeof *entry->values);
+		entry->num_values = cols;
+		double *errors   = entry->values + kmer+1;
+		double *p_values = entry->values + 2*(kmer+1);
+		for(int j = 0; j < kmer; j++)
+			errors[j] = sqrt(log_ratio_variance(test_values, ctrl_values, kmer, j)) / log(2.);
+
+		/* Welford's method over the replicates that have every position */
+		double mean = 0., squares = 0.;
+		int num_valid = 0;
+		for(int r = 0; r < replicates; r++) {
+			double value = replicate_enrichment(test_values, ctrl_values, kmer, r);
+			if(isnan(value))
+				continue;
+			num_valid++;
+			double delta = value - mean;
+			mean += delta / num_valid;
+			squares += delta * (value - mean);
+		}
+		errors[kmer] = num_valid > 1 ? sqrt(squares / (num_valid - 1)) : INFINITY;
+
+		for(int j = 0; j <= kmer; j++)
+			p_values[j] = normal_p_value(entry->values[j], errors[j]);
+	}
+	enrichments->cols = cols;
+}
+
+/* Reads of a file kept in memory, visited in a random order */
+struct sampled_reads {
+	SeqCounts *unique;     /* Distinct sequences of the file           */
+	SeqCount  **seqs;      /* Distinct sequences, indexed by order     */
+	uint32_t  *order;      /* Random permutation of all reads          */
+	uint64_t  num_reads;   /* Total number of reads in the file        */
+	uint64_t  cursor;      /* Number of reads that have been folded    */
+};
+typedef struct sampled_reads sampled_reads;
+
+static sampled_reads *
+load_sampled_reads(const char *filename, uint64_t *rng, BppOptions *opts)
+{
+	SeqFile read_file = seqfopen_detect(filename);
+	if(read_file == NULL)
+		return NULL;
+
+	sampled_reads *reads = s_malloc(sizeof *reads);
+	reads->unique = count_unique_sequences(read_file, opts);
+	seqfclose(read_file);
+
+	if(reads->unique->num_seqs > UINT32_MAX) {
+		error_message("katss: %s: Too many distinct sequences for adaptive sampling", filename);
+		free_seq_counts(reads->unique);
+		free(reads);
+		return NULL;
+	}
+
+	reads->num_reads = reads->unique->total;
+	reads->cursor = 0;
+	reads->seqs  = s_malloc((reads->unique->num_seqs + 1) * sizeof *reads->seqs);
+	reads->order = s_malloc((reads->num_reads + 1) * sizeof *reads->order);
+
+	/* Expand every distinct sequence into its reads */
+	uint32_t id = 0;
+	uint64_t pos = 0;
+	for(size_t i = 0; i < reads->unique->capacity; i++) {
+		SeqCount *entry = &reads->unique->entries[i];
+		if(entry->sequence == NULL)
+			continue;
+		reads->seqs[id] = entry;
+		for(uint32_t j = 0; j < entry->count; j++)
+			reads->order[pos++] = id;
+		id++;
+	}
+
+	/* Fisher-Yates shuffle so batches are random samples of the file */
+	for(uint64_t i = reads->num_reads; i > 1; i--) {
+		uint64_t j = splitmix64(rng) % i;
+		uint32_t tmp = reads->order[i-1];
+		reads->order[i-1] = reads->order[j];
+		reads->order[j] = tmp;
+	}
+
+	return reads;
+}
+
+static void
+free_sampled_reads(sampled_reads *reads)
+{
+	if(reads == NULL)
+		return;
+	free_seq_counts(reads->unique);
+	free(reads->seqs);
+	free(reads->order);
+	free(reads);
+}
+
+static int
+compare_ids(const void *p1, const void *p2)
+{
+	uint32_t a = *(const uint32_t *)p1;
+	uint32_t b = *(const uint32_t *)p2;
+	return (a > b) - (a < b);
+}
+
+static uint64_t
+fold_next_batch(fold_scheduler *scheduler, sampled_reads *reads, kmerHashTable *stats,
+                BppOptions *opts)
+{
+	uint64_t num_reads = MIN2((uint64_t)opts->batch_size, reads->num_reads - reads->cursor);
+	if(num_reads == 0)
+		return 0;
+
+	/* Reads repeated within the batch are folded once and weighted */
+	uint32_t *ids = reads->order + reads->cursor;
+	qsort(ids, num_reads, sizeof *ids, compare_ids);
+	reads->cursor += num_reads;
+
+	fold_task *tasks = s_malloc(num_reads * sizeof *tasks);
+	size_t num_tasks = 0;
+	for(uint64_t i = 0; i < num_reads; i++) {
+		if(i > 0 && ids[i] == ids[i-1]) {
+			tasks[num_tasks-1].weight += 1.;
+			continue;
+		}
+		tasks[num_tasks].sequence = reads->seqs[ids[i]]->sequence;
+		tasks[num_tasks].weight = 1.;
+		tasks[num_tasks].id = 0;
+		num_tasks++;
+	}
+
+	scheduler_submit(scheduler, tasks, num_tasks, stats, true, NULL, NULL);
+	scheduler_wait(scheduler);
+	free(tasks);
+
+	return num_reads;
+}
+
+static double
+mean_enrichment_error(kmerHashTable *ctrl_stats, kmerHashTable *test_stats, unsigned int hash)
+{
+	Entry *test_entry = test_stats->entries[hash];
+	Entry *ctrl_entry = ctrl_stats->entries[hash];
+	int kmer = test_stats->kmer;
+	if(test_entry == NULL || ctrl_entry == NULL)
+		return INFINITY;
+
+	/* Standard error of the mean log2 fold change, from the variance of every position */
+	double variance = 0.;
+	for(int j = 0; j < kmer; j++)
+		variance += log_ratio_variance(test_entry->values, ctrl_entry->values, kmer, j);
+
+	return sqrt(variance) / (log(2.) * kmer);
+}
+
+static kmerHashTable *
+bpp_adaptive(const char *test_file, const char *ctrl_file, BppOptions *opts)
+{
+	kmerHashTable *enrichments = NULL;
+	int    top = MAX2(opts->top_kmers, 1);
+	double tolerance = opts->tolerance;
+	double max_change = INFINITY;
+	double confidence = 0.;
+	bool   converged = false;
+	bool   have_previous = false;
+
+	uint64_t rng = opts->seed;
+	sampled_reads *test_reads = load_sampled_reads(test_file, &rng, opts);
+	if(test_reads == NULL)
+		return NULL;
+	sampled_reads *ctrl_reads = load_sampled_reads(ctrl_file, &rng, opts);
+	if(ctrl_reads == NULL) {
+		free_sampled_reads(test_reads);
+		return NULL;
+	}
+
+	kmerHashTable *test_stats = init_bpp_stats_table(opts->kmer);
+	kmerHashTable *ctrl_stats = init_bpp_stats_table(opts->kmer);
+	fold_scheduler *scheduler = scheduler_create(opts);
+	unsigned int *top_hash = s_calloc(top, sizeof *top_hash);
+	double       *top_mean = s_calloc(top, sizeof *top_mean);
+
+	while(!converged) {
+		uint64_t folded = fold_next_batch(scheduler, test_reads, test_stats, opts);
+		folded += fold_next_batch(scheduler, ctrl_reads, ctrl_stats, opts);
+
+		free_kmer_table(enrichments);
+		enrichments = bpp_enrichment(ctrl_stats, test_stats, opts->kmer);
+		if(folded == 0)
+			break;
+
+		/* The top k-mers have to keep their rank, and their estimates have to
+		   move less than the tolerance, between two consecutive batches */
+		bool same_ranking = have_previous;
+		max_change = 0.;
+		for(int i = 0; i < top; i++) {
+			Entry *entry = enrichments->entries[i];
+			unsigned int hash = entry ? entry->hash : 0;
+			double mean = entry ? entry->values[opts->kmer] : 0.;
+			if(!have_previous || hash != top_hash[i] || entry == NULL) {
+				same_ranking = false;
+			} else {
+				max_change = MAX2(max_change, fabs(mean - top_mean[i]));
+			}
+			top_hash[i] = hash;
+			top_mean[i] = mean;
+		}
+		have_previous = true;
+		converged = same_ranking && max_change < tolerance;
+	}
+
+	/* Confidence that every top k-mer is within the tolerance of its true value */
+	confidence = 1.;
+	for(int i = 0; i < top && enrichments->entries[i] != NULL; i++) {
+		double error = mean_enrichment_error(ctrl_stats, test_stats, enrichments->entries[i]->hash);
+		double within = (error == INFINITY) ? 0. : (error == 0.) ? 1. : erf(tolerance / (error * sqrt(2.)));
+		confidence = MIN2(confidence, within);
+	}
+
+	fprintf(stderr, "katss: adaptive sampling %s after folding %llu/%llu test reads and "
+	        "%llu/%llu control reads (confidence %.4f at tolerance %g)\n",
+	        converged ? "converged" : "did not converge",
+	        (unsigned long long)test_reads->cursor, (unsigned long long)test_reads->num_reads,
+	        (unsigned long long)ctrl_reads->cursor, (unsigned long long)ctrl_reads->num_reads,
+	        confidence, tolerance);
+
+	scheduler_destroy(scheduler);
+	free(top_hash);
+	free(top_mean);
+	free_kmer_table(test_stats);
+	free_kmer_table(ctrl_stats);
+	free_sampled_reads(test_reads);
+	free_sampled_reads(ctrl_reads);
+
+	return enrichments;
+}
+
 void
 katss_free_bpp(kmerHashTable *bpp)
 {
@@ -437,11 +1706,84 @@ katss_bpp_init_default_opts(BppOptions *opts)
 {
 	opts->kmer = 5;
 	opts->seq_windows = false;
+	opts->window_size = 20;
 	opts->threads = 1;
+	opts->dedup = false;
+	opts->structure_model = BPP_MODEL_PF;
+	opts->max_bp_span = 100;
+	opts->num_samples = 100;
+	opts->beam_size = BPP_LINEAR_DEFAULT_BEAM;
+	opts->fold_cache = false;
+	opts->cache_dir = NULL;
+	opts->cache_bits = 16;
+	opts->targets = NULL;
+	opts->target_window = 0;
+	opts->strata_weighting = BPP_STRATA_THRESHOLD;
+	opts->paired_threshold = 0.5;
+	opts->partners = NULL;
+	opts->bootstraps = 0;
+	opts->adaptive = false;
+	opts->tolerance = 0.01;
+	opts->batch_size = 5000;
+	opts->top_kmers = 10;
+	opts->seed = 1;
+	opts->verbose = false;
+}
+
+const char *
+katss_bpp_model_name(BppStructureModel model)
+{
+	switch(model) {
+		case BPP_MODEL_PF:     return "pf";
+		case BPP_MODEL_SPAN:   return "span";
+		case BPP_MODEL_LINEAR: return "linear";
+		case BPP_MODEL_SAMPLE: return "sample";
+		case BPP_MODEL_MFE:    return "mfe";
+		default:               return "unknown";
+	}
+}
+
+float *
+katss_bpp_fold(char *sequence, BppOptions *opts)
+{
+	/* If --seq-windows was provided, use the sliding window algorithm for calculations */
+	if(opts->seq_windows)
+		return getWindowProbabilities(sequence, opts);
+
+	/* Default algorithm for getting BPP frequencies */
+	return getPositionalProbabilities(sequence, opts, NULL);
 }
 
 kmerHashTable *
 katss_bpp(const char *test_file, const char *ctrl_file, BppOptions *opts)
+{
+	return katss_bpp_stratified(test_file, ctrl_file, opts, NULL, NULL);
+}
+
+static bool
+init_strata(BppStrata *strata, int kmer)
+{
+	if(strata == NULL)
+		return true;
+	strata->paired   = katss_init_counter(kmer);
+	strata->unpaired = katss_init_counter(kmer);
+	return strata->paired != NULL && strata->unpaired != NULL;
+}
+
+void
+katss_free_strata(BppStrata *strata)
+{
+	if(strata == NULL)
+		return;
+	katss_free_counter(strata->paired);
+	katss_free_counter(strata->unpaired);
+	strata->paired = NULL;
+	strata->unpaired = NULL;
+}
+
+kmerHashTable *
+katss_bpp_stratified(const char *test_file, const char *ctrl_file, BppOptions *opts,
+                     BppStrata *test_strata, BppStrata *ctrl_strata)
 {
 	bool provided_opts = opts != NULL;
 	if(opts == NULL) {
@@ -458,19 +1800,74 @@ katss_bpp(const char *test_file, const char *ctrl_file, BppOptions *opts)
 	opts->threads = MAX2(opts->threads, 1);
 	opts->threads = MIN2(opts->threads, 128);
 
-	kmerHashTable *test_frq = bpp_kmer_frequency(test_file, opts);
-	if(test_frq == NULL)
+	if(opts->targets != NULL && opts->target_window > 0 && opts->target_window < opts->kmer) {
+		error_message("katss: The target window must be at least as long as the k-mers");
+		goto exit;
+	}
+
+	if((opts->structure_model == BPP_MODEL_SPAN && opts->max_bp_span < 1) ||
+	   (opts->structure_model == BPP_MODEL_SAMPLE && opts->num_samples < 1) ||
+	   (opts->structure_model == BPP_MODEL_LINEAR && opts->beam_size < 0)) {
+		error_message("katss: The structure model requires a positive base-pair span and number of samples, and a non-negative beam size");
+		goto exit;
+	}
+
+	if(opts->bootstraps < 0) {
+		error_message("katss: The number of bootstrap replicates can't be negative");
+		goto exit;
+	}
+
+	if(opts->adaptive) {
+		if(opts->batch_size < 1 || opts->tolerance <= 0.) {
+			error_message("katss: Adaptive sampling requires a positive batch size and tolerance");
+			goto exit;
+		}
+		if(test_strata != NULL || ctrl_strata != NULL || opts->partners != NULL ||
+		   opts->bootstraps > 0) {
+			error_message("katss: Adaptive sampling can't count k-mers by structural context or base-pair partners, or bootstrap them");
+			goto exit;
+		}
+		enrichments = bpp_adaptive(test_file, ctrl_file, opts);
 		goto exit;
-	kmerHashTable *ctrl_frq = bpp_kmer_frequency(ctrl_file, opts);
-	if(ctrl_frq == NULL)
-		goto undo_test;
-	enrichments = bpp_enrichment(ctrl_frq, test_frq, opts->kmer);
+	}
+
+	if(opts->partners != NULL && (opts->seq_windows || (opts->targets != NULL && opts->target_window > 0))) {
+		error_message("katss: The partner matrix can't be built from sequence or target windows");
+		goto exit;
+	}
 
+	if(!init_strata(test_strata, opts->kmer) || !init_strata(ctrl_strata, opts->kmer))
+		goto undo_strata;
+
+	/* Fold the test and control files at the same time, splitting the threads between
+	   them by file size */
+	katss_job jobs[2];
+	fold_job test, ctrl;
+	fold_job_init(&jobs[0], &test, test_file, opts, test_strata);
+	fold_job_init(&jobs[1], &ctrl, ctrl_file, opts, ctrl_strata);
+	ctrl.opts.partners = NULL;
+	int status;
+	if(shares_fold_cache(test_file, ctrl_file, opts)) {
+		status  = katss_run_jobs(&jobs[0], 1, opts->threads);
+		status |= katss_run_jobs(&jobs[1], 1, opts->threads);
+	} else {
+		status = katss_run_jobs(jobs, 2, opts->threads);
+	}
+	if(status == 0)
+		enrichments = bpp_enrichment(ctrl.frequencies, test.frequencies, opts->kmer);
+	if(enrichments != NULL && opts->bootstraps > 0)
+		bootstrap_errors(enrichments, ctrl.frequencies, test.frequencies, opts->bootstraps);
+
+	free_kmer_table(ctrl.frequencies);
+	free_kmer_table(test.frequencies);
+	if(enrichments != NULL)
+		goto exit;
+
+undo_strata:
+	katss_free_strata(test_strata);
+	katss_free_strata(ctrl_strata);
+exit:
 	if(!provided_opts)
 		free(opts);
-	free_kmer_table(ctrl_frq);
-undo_test:
-	free_kmer_table(test_frq);
-exit:
 	return enrichments;
 }
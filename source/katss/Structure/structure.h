@@ -3,12 +3,78 @@
 
 #include <stdbool.h>
 #include "bpp_tables.h"
+#include "bpp_targets.h"
+#include "bpp_partners.h"
+#include "counter.h"
+
+/**
+ *  @brief Models used to get the base-pair probability of each nucleotide, from the most accurate
+ *  to the cheapest.
+*/
+typedef enum {
+	BPP_MODEL_PF,      /** Base-pair probabilities from the partition function         */
+	BPP_MODEL_SPAN,    /** Partition function restricted to a maximum base-pair span   */
+	BPP_MODEL_LINEAR,  /** Beam-pruned partition function, linear in the sequence length */
+	BPP_MODEL_SAMPLE,  /** Fraction of sampled structures in which a nucleotide pairs  */
+	BPP_MODEL_MFE,     /** Paired (1) or unpaired (0) in the minimum free energy structure */
+} BppStructureModel;
+
+/**
+ *  @brief How each occurrence of a k-mer is split between the paired and unpaired counts.
+*/
+typedef enum {
+	BPP_STRATA_THRESHOLD,  /** Paired if the mean probability of its nucleotides reaches a threshold */
+	BPP_STRATA_EXPECTED,   /** Split by the mean probability of its nucleotides */
+} BppStrataWeighting;
+
+/**
+ *  @brief Scale of the counts with BPP_STRATA_EXPECTED. KatssCounter only holds whole numbers,
+ *  so each occurrence adds up to BPP_STRATA_SCALE between its paired and unpaired counts.
+*/
+#define BPP_STRATA_SCALE 1000
+
+/**
+ *  @brief K-mer counts split by structural context.
+*/
+struct BppStrata {
+	KatssCounter *paired;    /** Occurrences of each k-mer in a paired context */
+	KatssCounter *unpaired;  /** Occurrences of each k-mer in an unpaired context */
+};
+typedef struct BppStrata BppStrata;
 
 struct BppOptions {
 	int kmer;
 	int threads;
 	bool seq_windows;
 	int window_size;
+	bool dedup;         /** Fold identical sequences only once */
+
+	BppStructureModel structure_model;  /** Model used to fold each sequence */
+	int max_bp_span;    /** Largest base-pair span with BPP_MODEL_SPAN */
+	int num_samples;    /** Structures sampled per sequence with BPP_MODEL_SAMPLE */
+	int beam_size;      /** States kept per nucleotide with BPP_MODEL_LINEAR, 0 to keep all */
+
+	bool fold_cache;    /** Store and reuse the probabilities of each read in a sidecar file */
+	const char *cache_dir;  /** Directory of the sidecar files, NULL to use the read files' */
+	int cache_bits;     /** Bits used to store each probability in the sidecar, 8 or 16 */
+
+	BppTargets *targets;    /** Only fold reads containing these k-mers, NULL to fold all */
+	int target_window;  /** Fold this many nucleotides around each target, 0 for the whole read */
+
+	BppStrataWeighting strata_weighting;  /** Used by katss_bpp_stratified */
+	double paired_threshold;  /** Smallest mean probability of a paired k-mer, BPP_STRATA_THRESHOLD */
+
+	BppPartners *partners;  /** Add the base pairs of the test reads to this matrix, NULL to skip */
+
+	int bootstraps;     /** Poisson bootstrap replicates used for the standard errors, 0 to skip them */
+
+	bool adaptive;      /** Fold random batches of reads until the top k-mers converge */
+	double tolerance;   /** Largest change of a top k-mer's mean enrichment to be converged */
+	int batch_size;     /** Number of reads folded per batch from each file */
+	int top_kmers;      /** Number of top k-mers that have to converge */
+	unsigned int seed;  /** Seed of the read order with adaptive, and of the bootstrap draws */
+
+	bool verbose;       /** Report how busy each folding thread was */
 };
 
 typedef struct BppOptions BppOptions;
@@ -17,10 +83,70 @@ void
 katss_bpp_init_default_opts(BppOptions *opts);
 
 
+/**
+ * @brief Get the name of a structure model, as accepted by kstruct's
+ * --structure-model option.
+ * 
+ * @param model 
+ * @return const char* 
+ */
+const char *
+katss_bpp_model_name(BppStructureModel model);
+
+
+/**
+ * @brief Fold a single sequence with the structure model in opts, and get the
+ * probability that each of its nucleotides is paired. The sliding window
+ * algorithm is used when opts->seq_windows is set.
+ * 
+ * @param sequence Sequence to fold; it is temporarily modified but restored.
+ * @param opts 
+ * @return float* Array with one probability per nucleotide, to be freed.
+ */
+float *
+katss_bpp_fold(char *sequence, BppOptions *opts);
+
+
 /**
  * @brief Get the k-mer base-pair probabilities from the test file, normalized
  * by the control file. Set the k-mer length, number of threads, and algorithm
- * in the BppOptions struct.
+ * in the BppOptions struct. The test and control files are folded at the same
+ * time, with opts->threads split between them by file size.
+ *
+ * With opts->fold_cache set, the probabilities of every read are stored in a
+ * sidecar file named after the reads file with a ".kbpp" extension. Later
+ * calls with the same reads file and structure parameters read the sidecar
+ * instead of folding, whatever the k-mer length. The sidecar is not used with
+ * opts->adaptive.
+ *
+ * With opts->targets set, only the reads containing one of the target k-mers
+ * are folded, and only the target k-mers are reported. With a positive
+ * opts->target_window, a window of that many nucleotides centered on each
+ * occurrence of a target is folded instead of the whole read. Window folds are
+ * not stored in the sidecar.
+ *
+ * With opts->partners set, the base pairs of every test read are also added
+ * to the partner matrix, keyed by the k-mers on both sides of each pair. The
+ * base pairs come from the same fold, so the reads are not folded again, but
+ * the sidecar is not read since it only holds per-nucleotide probabilities.
+ * Not available with sliding or target windows, or opts->adaptive.
+ *
+ * With a positive opts->bootstraps, the running mean and variance of every
+ * k-mer position are kept instead of sums, along with opts->bootstraps
+ * replicates in which every read is drawn a Poisson(1) number of times. The
+ * table then has 3*(kmer+1) columns: the kmer enrichments and their mean, the
+ * standard error of each of them, and the two-sided p-value of each of them
+ * being zero. The errors of the positions use the delta method on their
+ * variances, and the error of the mean is the standard deviation of the mean
+ * over the replicates. The draws only depend on opts->seed and the reads, so
+ * they are the same for any number of threads. Not available with
+ * opts->adaptive.
+ *
+ * With opts->adaptive set, reads from both files are folded in random batches
+ * of opts->batch_size reads, stopping once the ranking of the top
+ * opts->top_kmers k-mers is unchanged and none of their mean enrichments moved
+ * more than opts->tolerance from the previous batch. The number of reads used
+ * and the confidence of the estimates are reported to stderr.
  * 
  * @param test_file 
  * @param ctrl_file 
@@ -30,6 +156,38 @@ katss_bpp_init_default_opts(BppOptions *opts);
 kmerHashTable *
 katss_bpp(const char *test_file, const char *ctrl_file, BppOptions *opts);
 
+
+/**
+ * @brief Same as katss_bpp, but also count the k-mers of each file by their
+ * structural context in the same pass, without folding the reads again.
+ *
+ * Every occurrence of a k-mer is counted as paired or unpaired by the mean
+ * base-pair probability of its nucleotides. With BPP_STRATA_THRESHOLD, it is
+ * paired if the mean reaches opts->paired_threshold. With BPP_STRATA_EXPECTED,
+ * it is split between both counts by the mean, in units of 1/BPP_STRATA_SCALE.
+ * The counts can be passed to katss_compute_enrichments. Not available with
+ * opts->adaptive.
+ *
+ * @param test_file     Name of the test file
+ * @param ctrl_file     Name of the control file
+ * @param opts          Options, see katss_bpp
+ * @param test_strata   Set to the counts of the test file, or NULL to skip them
+ * @param ctrl_strata   Set to the counts of the control file, or NULL to skip them
+ * @return kmerHashTable* Same as katss_bpp, NULL on failure
+ */
+kmerHashTable *
+katss_bpp_stratified(const char *test_file, const char *ctrl_file, BppOptions *opts,
+                     BppStrata *test_strata, BppStrata *ctrl_strata);
+
+
+/**
+ * @brief Free the counters of a BppStrata filled by katss_bpp_stratified.
+ *
+ * @param strata
+ */
+void
+katss_free_strata(BppStrata *strata);
+
 void
 katss_free_bpp(kmerHashTable *bpp);
 
@@ -0,0 +1,114 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "memory_utils.h"
+#include "katss_jobs.h"
+#include "binom_test.h"
+#include "toms708.h"
+
+/* Median of a chi-squared distribution with one degree of freedom */
+#define CHISQ1_MEDIAN 0.454936423119572
+
+/* Least number of successes and failures a count must be expected to have to
+   estimate the dispersion */
+#define DISPERSION_MIN_EXPECTED 5.0
+
+/**
+ * @brief Find the median of an array, reordering it (Wirth's selection).
+ */
+static double
+median(double *values, size_t size)
+{
+	ptrdiff_t lo = 0, hi = (ptrdiff_t)size - 1, mid = (ptrdiff_t)size / 2;
+	while(lo < hi) {
+		double pivot = values[mid];
+		ptrdiff_t i = lo, j = hi;
+		do {
+			while(values[i] < pivot) i++;
+			while(pivot < values[j]) j--;
+			if(i <= j) {
+				double tmp = values[i];
+				values[i++] = values[j];
+				values[j--] = tmp;
+			}
+		} while(i <= j);
+		if(j < mid) lo = i;
+		if(mid < i) hi = j;
+	}
+	return values[mid];
+}
+
+double
+binom_test_dispersion(const double *x, const double *n, const double *p, size_t size)
+{
+	double *residuals = s_malloc(MAX2(size, 1) * sizeof *residuals);
+	size_t used = 0;
+	for(size_t i = 0; i < size; i++) {
+		double expected = n[i] * p[i];
+		double variance = expected * (1 - p[i]);
+		if(expected < DISPERSION_MIN_EXPECTED || n[i] - expected < DISPERSION_MIN_EXPECTED)
+			continue;
+		double residual = x[i] - expected;
+		residuals[used++] = residual * residual / variance;
+	}
+
+	double phi = used == 0 ? 1.0 : median(residuals, used) / CHISQ1_MEDIAN;
+	free(residuals);
+	return MAX2(phi, 1.0);
+}
+
+/**
+ * @brief Two-sided p-value of `x` successes in `n` trials of probability `p`.
+ */
+static double
+binom_test(double x, double n, double p)
+{
+	if(!(n > 0) || !(p > 0) || !(p < 1))
+		return 1.0;
+
+	double w, wc;
+	int ierr;
+
+	/* P(X >= x) = I_p(x, n - x + 1) */
+	double upper = 1.0;
+	if(x > 0) {
+		bratio(x, n - x + 1, p, 0.5 - p + 0.5, &w, &wc, &ierr, 0);
+		upper = w;
+	}
+
+	/* P(X <= x) = I_(1-p)(n - x, x + 1) */
+	double lower = 1.0;
+	if(x < n) {
+		bratio(n - x, x + 1, 0.5 - p + 0.5, p, &w, &wc, &ierr, 0);
+		lower = w;
+	}
+
+	return MIN2(1.0, 2 * MIN2(upper, lower));
+}
+
+/* Tests of a batch, split between threads */
+struct binom_batch {
+	const double *x;
+	const double *n;
+	const double *p;
+	double phi;
+	double *pval;
+};
+
+static void
+binom_test_range(void *arg, size_t start, size_t end)
+{
+	struct binom_batch *batch = (struct binom_batch *)arg;
+	for(size_t i = start; i < end; i++)
+		batch->pval[i] = binom_test(batch->x[i] / batch->phi, batch->n[i] / batch->phi,
+		                            batch->p[i]);
+}
+
+void
+binom_test_batch(const double *x, const double *n, const double *p, double phi,
+                 double *pval, size_t size, int threads)
+{
+	struct binom_batch batch = {.x = x, .n = n, .p = p, .phi = phi, .pval = pval};
+	katss_run_range(size, 4096, threads, binom_test_range, &batch);
+}
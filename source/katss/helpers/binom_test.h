@@ -0,0 +1,44 @@
+#ifndef KATSS_BINOM_TEST_H
+#define KATSS_BINOM_TEST_H
+
+#include <stddef.h>
+
+/**
+ * @brief Estimate how overdispersed counts are with respect to the binomial
+ * distributions they are tested against.
+ *
+ * The dispersion is the median of the squared Pearson residuals of the counts
+ * expected at least 5 times each way, over the median of a chi-squared
+ * distribution with one degree of freedom. The median keeps the few enriched
+ * counts from inflating it. It is never below 1.
+ *
+ * @param x    Array of `size` observed counts
+ * @param n    Array of `size` numbers of trials
+ * @param p    Array of `size` probabilities of success under the null hypothesis
+ * @param size Number of counts
+ * @return double Dispersion factor of the variance
+ */
+double binom_test_dispersion(const double *x, const double *n, const double *p, size_t size);
+
+
+/**
+ * @brief Compute the two-sided p-values of many binomial tests, splitting them
+ * between threads.
+ *
+ * The counts and trials are divided by the dispersion `phi`, as in a
+ * quasi-binomial model, and the tails are computed from the incomplete beta
+ * function, so they are exact when `phi` is 1. Tests with no trials, or with a
+ * probability of 0 or 1, get a p-value of 1.
+ *
+ * @param x       Array of `size` observed counts
+ * @param n       Array of `size` numbers of trials
+ * @param p       Array of `size` probabilities of success under the null hypothesis
+ * @param phi     Dispersion factor, see `binom_test_dispersion()`
+ * @param pval    Array of `size` p-values to fill
+ * @param size    Number of tests
+ * @param threads Number of threads to use
+ */
+void binom_test_batch(const double *x, const double *n, const double *p, double phi,
+                      double *pval, size_t size, int threads);
+
+#endif // KATSS_BINOM_TEST_H
@@ -0,0 +1,325 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
+#  include <threads.h>
+#else
+#  include <tinycthread.h>
+#endif
+
+#include "memory_utils.h"
+#include "katss_jobs.h"
+
+struct job_queue {
+	katss_job *jobs;
+	int *order;
+	int num_jobs;
+	int next;
+	mtx_t lock;
+};
+
+struct ordered_run {
+	katss_ordered_fn run;
+	katss_collect_fn collect;
+	void *arg;
+	int num_jobs;
+	int slots;
+	int next;        /* Next job to start */
+	int collected;   /* Jobs collected so far */
+	bool *done;      /* Whether the job in every slot is done */
+	int *status;     /* Value returned by the job in every slot */
+	bool stop;
+	mtx_t lock;
+	cnd_t slot_free;
+};
+
+struct ordered_worker {
+	struct ordered_run *run;
+	int threads;
+};
+
+struct range_chunk {
+	katss_range_fn run;
+	void *arg;
+	size_t start;
+	size_t end;
+};
+
+
+void
+katss_job_init(katss_job *job, katss_job_fn run, void *arg, double weight)
+{
+	job->run = run;
+	job->arg = arg;
+	job->weight = weight > 0 ? weight : 1;
+	job->threads = 1;
+	job->status = 0;
+}
+
+
+double
+katss_file_weight(const char *filename)
+{
+	struct stat st;
+	if(filename == NULL || stat(filename, &st) != 0 || st.st_size <= 0)
+		return 1;
+	return (double)st.st_size;
+}
+
+
+static int
+run_job(void *arg)
+{
+	katss_job *job = (katss_job *)arg;
+	job->status = job->run(job->arg, job->threads);
+	return job->status;
+}
+
+
+static int
+run_queue(void *arg)
+{
+	struct job_queue *queue = (struct job_queue *)arg;
+	while(1) {
+		mtx_lock(&queue->lock);
+		int idx = queue->next < queue->num_jobs ? queue->order[queue->next++] : -1;
+		mtx_unlock(&queue->lock);
+
+		if(idx < 0)
+			break;
+		run_job(&queue->jobs[idx]);
+	}
+	return 0;
+}
+
+
+/* Give every job one thread, then split the rest in proportion to the weights, handing the
+   threads lost to rounding to the jobs with the largest remainders */
+static void
+allot_threads(katss_job *jobs, int num_jobs, int threads)
+{
+	double total = 0;
+	for(int i = 0; i < num_jobs; i++)
+		total += jobs[i].weight;
+
+	int spare = threads - num_jobs;
+	int given = 0;
+	double *remainder = s_malloc(num_jobs * sizeof *remainder);
+	for(int i = 0; i < num_jobs; i++) {
+		double share = spare * jobs[i].weight / total;
+		jobs[i].threads = 1 + (int)share;
+		remainder[i] = share - (int)share;
+		given += (int)share;
+	}
+
+	for(; given < spare; given++) {
+		int best = 0;
+		for(int i = 1; i < num_jobs; i++)
+			if(remainder[i] > remainder[best])
+				best = i;
+		jobs[best].threads++;
+		remainder[best] = -1;
+	}
+	free(remainder);
+}
+
+
+int
+katss_run_jobs(katss_job *jobs, int num_jobs, int threads)
+{
+	int ret = 0;
+	if(num_jobs < 1)
+		return 0;
+	if(threads < 1)
+		threads = 1;
+
+	/* Nothing to overlap, run the jobs in order */
+	if(threads == 1 || num_jobs == 1) {
+		for(int i = 0; i < num_jobs; i++) {
+			jobs[i].threads = threads;
+			ret |= run_job(&jobs[i]) != 0;
+		}
+		return ret;
+	}
+
+	/* Enough threads for every job to run at once */
+	if(threads >= num_jobs) {
+		allot_threads(jobs, num_jobs, threads);
+		thrd_t *workers = s_malloc(num_jobs * sizeof *workers);
+		int started = 0;
+		for(int i = 1; i < num_jobs; i++, started++)
+			if(thrd_create(&workers[i], run_job, &jobs[i]) != thrd_success)
+				break;
+
+		/* Run the first job here, along with any that could not get a thread */
+		run_job(&jobs[0]);
+		for(int i = started + 1; i < num_jobs; i++)
+			run_job(&jobs[i]);
+		for(int i = 1; i <= started; i++)
+			thrd_join(workers[i], NULL);
+		free(workers);
+
+		for(int i = 0; i < num_jobs; i++)
+			ret |= jobs[i].status != 0;
+		return ret;
+	}
+
+	/* More jobs than threads, start the heaviest jobs first */
+	struct job_queue queue = {.jobs = jobs, .num_jobs = num_jobs, .next = 0};
+	queue.order = s_malloc(num_jobs * sizeof *queue.order);
+	for(int i = 0; i < num_jobs; i++) {
+		int j = i;
+		for(; j > 0 && jobs[queue.order[j - 1]].weight < jobs[i].weight; j--)
+			queue.order[j] = queue.order[j - 1];
+		queue.order[j] = i;
+		jobs[i].threads = 1;
+	}
+	mtx_init(&queue.lock, mtx_plain);
+
+	thrd_t *workers = s_malloc(threads * sizeof *workers);
+	int started = 0;
+	for(int i = 1; i < threads; i++, started++)
+		if(thrd_create(&workers[i], run_queue, &queue) != thrd_success)
+			break;
+	run_queue(&queue);
+	for(int i = 1; i <= started; i++)
+		thrd_join(workers[i], NULL);
+
+	mtx_destroy(&queue.lock);
+	free(workers);
+	free(queue.order);
+
+	for(int i = 0; i < num_jobs; i++)
+		ret |= jobs[i].status != 0;
+	return ret;
+}
+
+
+static int
+run_ordered(void *arg)
+{
+	struct ordered_worker *worker = (struct ordered_worker *)arg;
+	struct ordered_run *run = worker->run;
+
+	mtx_lock(&run->lock);
+	while(1) {
+		while(!run->stop && run->next < run->num_jobs && run->next >= run->collected + run->slots)
+			cnd_wait(&run->slot_free, &run->lock);
+		if(run->stop || run->next >= run->num_jobs)
+			break;
+		int index = run->next++;
+		mtx_unlock(&run->lock);
+
+		int status = run->run(run->arg, index, index % run->slots, worker->threads);
+
+		mtx_lock(&run->lock);
+		run->done[index % run->slots] = true;
+		run->status[index % run->slots] = status;
+
+		/* Collect the jobs done so far, in order */
+		while(run->collected < run->next && run->done[run->collected % run->slots]) {
+			int slot = run->collected % run->slots;
+			run->done[slot] = false;
+			if(run->collect(run->arg, run->collected, slot, run->status[slot]) != 0)
+				run->stop = true;
+			run->collected++;
+		}
+		cnd_broadcast(&run->slot_free);
+	}
+	mtx_unlock(&run->lock);
+	return 0;
+}
+
+
+int
+katss_run_ordered(int num_jobs, int slots, int threads, katss_ordered_fn run,
+                  katss_collect_fn collect, void *arg)
+{
+	if(num_jobs < 1)
+		return 0;
+	if(threads < 1)
+		threads = 1;
+	if(slots < 1)
+		slots = 1;
+	if(slots > num_jobs)
+		slots = num_jobs;
+	int num_workers = slots < threads ? slots : threads;
+
+	struct ordered_run ordered = {
+		.run = run, .collect = collect, .arg = arg, .num_jobs = num_jobs, .slots = slots,
+	};
+	ordered.done = s_calloc(slots, sizeof *ordered.done);
+	ordered.status = s_calloc(slots, sizeof *ordered.status);
+	mtx_init(&ordered.lock, mtx_plain);
+	cnd_init(&ordered.slot_free);
+
+	/* Split the threads between the workers, the first ones getting the rest */
+	struct ordered_worker *workers = s_malloc(num_workers * sizeof *workers);
+	for(int i = 0; i < num_workers; i++) {
+		workers[i].run = &ordered;
+		workers[i].threads = threads / num_workers + (i < threads % num_workers);
+	}
+
+	/* Run the first worker here, it runs every job if no other could get a thread */
+	thrd_t *handles = s_malloc(num_workers * sizeof *handles);
+	int started = 0;
+	for(int i = 1; i < num_workers; i++, started++)
+		if(thrd_create(&handles[i], run_ordered, &workers[i]) != thrd_success)
+			break;
+	run_ordered(&workers[0]);
+	for(int i = 1; i <= started; i++)
+		thrd_join(handles[i], NULL);
+
+	cnd_destroy(&ordered.slot_free);
+	mtx_destroy(&ordered.lock);
+	free(handles);
+	free(workers);
+	free(ordered.done);
+	free(ordered.status);
+	return ordered.stop;
+}
+
+
+static int
+run_chunk(void *arg)
+{
+	struct range_chunk *chunk = (struct range_chunk *)arg;
+	chunk->run(chunk->arg, chunk->start, chunk->end);
+	return 0;
+}
+
+
+void
+katss_run_range(size_t size, size_t grain, int threads, katss_range_fn run, void *arg)
+{
+	/* Small ranges are not worth the threads */
+	size_t max_threads = size / (grain > 0 ? grain : 1) + 1;
+	threads = threads < 1 ? 1 : threads;
+	threads = (size_t)threads > max_threads ? (int)max_threads : threads;
+
+	struct range_chunk *chunks = s_malloc(threads * sizeof *chunks);
+	size_t chunk_size = (size + threads - 1) / threads;
+	for(int i = 0; i < threads; i++) {
+		chunks[i].run = run;
+		chunks[i].arg = arg;
+		chunks[i].start = MIN2(i * chunk_size, size);
+		chunks[i].end = MIN2(chunks[i].start + chunk_size, size);
+	}
+
+	/* Run the first chunk here, along with any that could not get a thread */
+	thrd_t *workers = s_malloc(threads * sizeof *workers);
+	int started = 0;
+	for(int i = 1; i < threads; i++, started++)
+		if(thrd_create(&workers[i], run_chunk, &chunks[i]) != thrd_success)
+			break;
+	run_chunk(&chunks[0]);
+	for(int i = started + 1; i < threads; i++)
+		run_chunk(&chunks[i]);
+	for(int i = 1; i <= started; i++)
+		thrd_join(workers[i], NULL);
+
+	free(workers);
+	free(chunks);
+}
@@ -0,0 +1,122 @@
+#ifndef KATSS_JOBS_H
+#define KATSS_JOBS_H
+
+#include <stddef.h>
+
+/**
+ * @brief Function run by a job. It receives the argument of the job and the number of
+ * threads it was allotted, and returns 0 on success.
+ */
+typedef int (*katss_job_fn)(void *arg, int threads);
+
+
+/**
+ * @brief Independent unit of work, such as counting or folding one file.
+ */
+struct katss_job {
+	katss_job_fn run;   /** Function to run */
+	void *arg;          /** Argument passed to run */
+	double weight;      /** Relative amount of work, e.g. the size of the input file */
+	int threads;        /** Threads allotted to the job, set by katss_run_jobs */
+	int status;         /** Value returned by run */
+};
+typedef struct katss_job katss_job;
+
+
+/**
+ * @brief Initialize a job.
+ *
+ * @param job       Job to initialize
+ * @param run       Function to run
+ * @param arg       Argument passed to run
+ * @param weight    Relative amount of work of the job, e.g. katss_file_weight(file)
+ */
+void katss_job_init(katss_job *job, katss_job_fn run, void *arg, double weight);
+
+
+/**
+ * @brief Get the weight of a job that reads the given file, which is the size of the file
+ * in bytes. Unreadable files and streams get a weight of 1.
+ *
+ * @param filename Name of the file
+ * @return double Weight of the file
+ */
+double katss_file_weight(const char *filename);
+
+
+/**
+ * @brief Run independent jobs concurrently on a shared budget of threads.
+ *
+ * When there are at least as many threads as jobs, every job runs at once and the threads
+ * are split between the jobs in proportion to their weights, each job getting at least one.
+ * Otherwise, the heaviest jobs are started first on single-threaded workers. With a single
+ * thread the jobs simply run one after the other in the calling thread.
+ *
+ * @param jobs      Jobs to run
+ * @param num_jobs  Number of jobs
+ * @param threads   Total number of threads available
+ * @return int 0 if every job returned 0, non-zero otherwise.
+ */
+int katss_run_jobs(katss_job *jobs, int num_jobs, int threads);
+
+
+/**
+ * @brief Function running the job `index` of katss_run_ordered in the slot `slot`, with the
+ * threads it was allotted. It returns 0 on success.
+ */
+typedef int (*katss_ordered_fn)(void *arg, int index, int slot, int threads);
+
+
+/**
+ * @brief Function collecting the job `index` of katss_run_ordered from the slot `slot`, given
+ * the value its run returned. It returns non-zero to stop starting jobs.
+ */
+typedef int (*katss_collect_fn)(void *arg, int index, int slot, int status);
+
+
+/**
+ * @brief Run a sequence of jobs, at most `slots` at a time, on a shared budget of threads,
+ * and collect them in order.
+ *
+ * Job i runs in slot i % slots, and it only starts once job i - slots was collected, so the
+ * caller keeps at most `slots` jobs in memory. A job starts as soon as a worker is free,
+ * without waiting for the other running jobs, and the jobs are collected one at a time in
+ * their order, so their results do not depend on the number of threads. Once a collect asks
+ * to stop, no job starts, but the jobs already started are still collected. Up to `slots`
+ * workers run, splitting the threads between them.
+ *
+ * @param num_jobs  Number of jobs
+ * @param slots     Most jobs run or waiting to be collected at the same time
+ * @param threads   Total number of threads available
+ * @param run       Function running a job
+ * @param collect   Function collecting a job, called with a lock held
+ * @param arg       Argument passed to run and collect
+ * @return int 0 if no collect asked to stop, non-zero otherwise.
+ */
+int katss_run_ordered(int num_jobs, int slots, int threads, katss_ordered_fn run,
+                      katss_collect_fn collect, void *arg);
+
+
+
+/**
+ * @brief Function run on the elements `start` to `end - 1` of a range split by katss_run_range.
+ */
+typedef void (*katss_range_fn)(void *arg, size_t start, size_t end);
+
+
+/**
+ * @brief Split a range of independent elements into one chunk per thread, and run the chunks
+ * concurrently.
+ *
+ * Ranges of less than `grain` elements per thread use fewer threads, as they are not worth
+ * starting threads for. A chunk that could not get a thread runs in the calling thread.
+ *
+ * @param size      Number of elements
+ * @param grain     Least number of elements worth a thread of their own
+ * @param threads   Most threads to use
+ * @param run       Function run on every chunk
+ * @param arg       Argument passed to run
+ */
+void katss_run_range(size_t size, size_t grain, int threads, katss_range_fn run, void *arg);
+
+#endif // KATSS_JOBS_H
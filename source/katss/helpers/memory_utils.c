@@ -7,6 +7,7 @@
 #if KATSS_VERBOSE == 1
 static void _error_message(const char *format);
 static void _warning_message(const char *format);
+static void _info_message(const char *format);
 #endif
 
 void
@@ -69,6 +70,36 @@ _warning_message(const char *message)
 }
 
 
+void
+info_message(const char *format, ...)
+{
+#if KATSS_VERBOSE == 1
+	va_list args;
+	char buffer[MAX_MESSAGE_LENGTH];
+
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	_info_message(buffer);
+}
+
+static void 
+_info_message(const char *message)
+{
+	char full_message[MAX_MESSAGE_LENGTH];
+
+	snprintf(full_message, sizeof(full_message), 
+	 ANSI_COLOR_GREEN "INFO: " ANSI_COLOR_RESET ANSI_COLOR_BRIGHT "%s" ANSI_COLOR_RESET "\n", message);
+
+	fprintf(stderr, "%s", full_message);
+#else
+	(void)format;
+	return;
+#endif // KATSS_VERBOSE==1
+}
+
+
 void *s_malloc(size_t mem_size) {
 	void *pointer = malloc(mem_size);
 
@@ -76,4 +76,13 @@ void error_message(const char *format, ...);
 */
 void warning_message(const char *format, ...);
 
+
+/**
+ *  @brief Print an informational message to stderr
+ * 
+ *  @param format   The message to be printed
+ *  @param ...      Optional arguments for the format string
+*/
+void info_message(const char *format, ...);
+
 #endif
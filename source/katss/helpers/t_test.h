@@ -1,6 +1,7 @@
 #ifndef KATSS_T_TEST_H
 #define KATSS_T_TEST_H
 
+#include <stddef.h>
 
 /**
  * @brief Two sample T-test aggregate
@@ -22,6 +23,22 @@ struct t_test2_aggregate {
 typedef struct t_test2_aggregate t_test2_aggregate;
 
 
+/**
+ * @brief Two sample T-tests of many variables at once, such as every k-mer of a
+ * bootstrap, stored as one array per field.
+ */
+struct t_test2_batch {
+	size_t size;        /* Number of T-tests */
+	double *x_mean;
+	double *x_M2;
+	double *x_count;    /* Counts are doubles so the updates vectorize */
+	double *y_mean;
+	double *y_M2;
+	double *y_count;
+};
+typedef struct t_test2_batch t_test2_batch;
+
+
 /**
  * @brief One-sample T-test aggregate
  * 
@@ -76,6 +93,50 @@ void t_test2_update(t_test2_aggregate *aggregate, double x_value, double y_value
 void t_test2_finalize(t_test2_aggregate *aggregate);
 
 
+/**
+ * @brief Create `size` two-sample T-tests with no values.
+ * 
+ * @param size Number of T-tests
+ * @return t_test2_batch* 
+ */
+t_test2_batch *t_test2_batch_create(size_t size);
+
+
+/**
+ * @brief Free all resources allocated to the T-tests.
+ * 
+ * @param batch T-tests to destroy
+ */
+void t_test2_batch_destroy(t_test2_batch *batch);
+
+
+/**
+ * @brief Add a value to the T-tests `start` to `start + n - 1`, as
+ * `t_test2_update()` does for each.
+ * 
+ * @param batch    T-tests to update
+ * @param start    First T-test to update
+ * @param n        Number of T-tests to update
+ * @param x_values `n` X values to add, NAN if none
+ * @param y_values `n` Y values to add, NAN if none
+ */
+void t_test2_batch_update(t_test2_batch *batch, size_t start, size_t n,
+                          const double *x_values, const double *y_values);
+
+
+/**
+ * @brief Compute the p-value of every T-test, as `t_test2_finalize()` does for
+ * each, splitting them between threads.
+ * 
+ * T-tests with less than two X or Y values get a p-value of 0.
+ * 
+ * @param batch   T-tests to compute
+ * @param pval    Array of `batch->size` p-values to fill
+ * @param threads Number of threads to use
+ */
+void t_test2_batch_finalize(const t_test2_batch *batch, double *pval, int threads);
+
+
 /**
  * @brief Create the student's T-test aggregate.
  * 
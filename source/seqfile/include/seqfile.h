@@ -268,6 +268,104 @@ char *seqfqgets(SeqFile file, char *buffer, size_t bufsize);
 char *seqfqgets_unlocked(SeqFile file, char *buffer, size_t bufsize);
 
 
+/**
+ * @brief Read a record's header and sequence.
+ * 
+ * Works like `seqfgets()`, but also stores the record's header line into `header`, without the
+ * leading `'>'` or `'@'` and the newline. At most `hsize - 1` characters of the header are stored
+ * and the rest is skipped. Files without headers (reads files) store an empty string.
+ * 
+ * @param file    SeqFile to read from
+ * @param header  Buffer to fill with the header
+ * @param hsize   Size of the header buffer, at least 1
+ * @param buffer  Buffer to fill with the sequence
+ * @param bufsize Size of the buffer being passed
+ * @return char* Pointer to the record's sequence, or NULL if unable to find the next record.
+ */
+char *seqfgetr(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize);
+
+
+/**
+ * @brief Read a record's header and sequence. See `seqfgetr()`.
+ * 
+ * @note
+ * This function does not use a mutex to lock access to the SeqFile internal buffer. As such, it is not
+ * thread-safe. Only use in single-threaded applications.
+ */
+char *seqfgetr_unlocked(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize);
+
+
+/**
+ * @brief Read a record's header, sequence and quality scores.
+ * 
+ * Works like `seqfgetr()`, but also stores the quality line of fastq records into `quality`, of
+ * which at most `qsize - 1` characters are stored. Records of other files have no quality scores
+ * and store an empty string. `header` or `quality` can be NULL to skip them.
+ * 
+ * @param file    SeqFile to read from
+ * @param header  Buffer to fill with the header, or NULL
+ * @param hsize   Size of the header buffer
+ * @param buffer  Buffer to fill with the sequence
+ * @param bufsize Size of the buffer being passed
+ * @param quality Buffer to fill with the quality scores, or NULL
+ * @param qsize   Size of the quality buffer
+ * @return char* Pointer to the record's sequence, or NULL if unable to find the next record.
+ */
+char *seqfgetq(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize, char *quality,
+               size_t qsize);
+
+
+/**
+ * @brief Read a record's header, sequence and quality scores. See `seqfgetq()`.
+ * 
+ * @note
+ * This function does not use a mutex to lock access to the SeqFile internal buffer. As such, it is not
+ * thread-safe. Only use in single-threaded applications.
+ */
+char *seqfgetq_unlocked(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize,
+                        char *quality, size_t qsize);
+
+
+/** Undocumented getr functions. See seqfgetr() for more information. */
+char *seqfagetr(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize);
+char *seqfagetr_unlocked(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize);
+char *seqfqgetr(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize);
+char *seqfqgetr_unlocked(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize);
+char *seqfqgetq_unlocked(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize,
+                         char *quality, size_t qsize);
+
+
+/**
+ * @brief Skip the next `n` records without copying them.
+ * 
+ * A skipped record is the one `seqfgets()` would have read with a buffer large enough to hold it,
+ * so skipping `n` records and then reading one gives the same record as reading `n + 1` of them. Only the bytes needed to find the
+ * end of each record are looked at, which makes subsampling a file much cheaper than reading and
+ * discarding the records it leaves out.
+ * 
+ * @param file SeqFile to skip records of
+ * @param n    Number of records to skip
+ * @return size_t Number of records skipped, less than `n` at the end of the file or on error.
+ */
+size_t seqfskip(SeqFile file, size_t n);
+
+
+/**
+ * @brief Skip the next `n` records without copying them. See `seqfskip()`.
+ * 
+ * @note
+ * This function does not use a mutex to lock access to the SeqFile internal buffer. As such, it is not
+ * thread-safe. Only use in single-threaded applications.
+ */
+size_t seqfskip_unlocked(SeqFile file, size_t n);
+
+
+/** Undocumented skip functions. See seqfskip() for more information. */
+size_t seqfaskip_unlocked(SeqFile file, size_t n);
+size_t seqfqskip_unlocked(SeqFile file, size_t n);
+size_t seqfsskip_unlocked(SeqFile file, size_t n);
+
+
 /**
  * @brief Read only one nucleotide from the SeqFile stream. 
  * 
@@ -56,7 +56,7 @@ seqfaread_unlocked(SeqFile file, char *buffer, size_t bufsize)
 }
 
 char *
-seqfagets_unlocked(SeqFile file, char *buffer, size_t bufsize)
+seqfagetr_unlocked(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize)
 {
 	/* Sanity checks & early return in case we're at eof */
 	if(file == NULL)
@@ -65,8 +65,10 @@ seqfagets_unlocked(SeqFile file, char *buffer, size_t bufsize)
 	if(state->eof)
 		return NULL;
 
-	/* Skip past fasta header info, we want the sequence */
-	if(seqf_skipheader(state, '>') == NULL)
+	/* Skip past fasta header info, or copy it if requested */
+	if(header == NULL && seqf_skipheader(state, '>') == NULL)
+		return NULL;
+	if(header != NULL && seqf_copyheader(state, '>', (unsigned char *)header, hsize) == NULL)
 		return NULL;
 	
 	/* Variables to be used in obtaining the sequence */
@@ -94,6 +96,24 @@ seqfagets_unlocked(SeqFile file, char *buffer, size_t bufsize)
 	return buffer;
 }
 
+char *
+seqfagets_unlocked(SeqFile file, char *buffer, size_t bufsize)
+{
+	return seqfagetr_unlocked(file, NULL, 0, buffer, bufsize);
+}
+
+char *
+seqfagetr(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize)
+{
+	seqf_statep state = (seqf_statep)file;
+
+	mtx_lock(&state->mutex);
+	char *ret = seqfagetr_unlocked(file, header, hsize, buffer, bufsize);
+	mtx_unlock(&state->mutex);
+
+	return ret;
+}
+
 char *
 seqfagets(SeqFile file, char *buffer, size_t bufsize)
 {
@@ -106,6 +126,21 @@ seqfagets(SeqFile file, char *buffer, size_t bufsize)
 	return ret;
 }
 
+size_t
+seqfaskip_unlocked(SeqFile file, size_t n)
+{
+	if(file == NULL)
+		return 0;
+	seqf_statep state = (seqf_statep)file;
+
+	/* Only the headers have to be found, reading the next record skips the
+	   rest of the sequence */
+	size_t skipped = 0;
+	while(skipped < n && !state->eof && seqf_skipheader(state, '>') != NULL)
+		skipped++;
+	return skipped;
+}
+
 int
 seqfagetnt_unlocked(SeqFile file)
 {
@@ -67,7 +67,8 @@ seqfqread_unlocked(SeqFile file, char *buffer, size_t bufsize)
 }
 
 char *
-seqfqgets_unlocked(SeqFile file, char *buffer, size_t bufsize)
+seqfqgetq_unlocked(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize,
+                   char *quality, size_t qsize)
 {
 	if(file == NULL)
 		return NULL;
@@ -75,8 +76,10 @@ seqfqgets_unlocked(SeqFile file, char *buffer, size_t bufsize)
 	if(state->eof)
 		return NULL;
 	
-	/* Find start of next sequence */
-	if(seqf_skipheader(state, '@') == NULL)
+	/* Find start of next sequence, copying the header if requested */
+	if(header == NULL && seqf_skipheader(state, '@') == NULL)
+		return NULL;
+	if(header != NULL && seqf_copyheader(state, '@', (unsigned char *)header, hsize) == NULL)
 		return NULL;
 
 	/* Declare variables */
@@ -97,13 +100,40 @@ seqfqgets_unlocked(SeqFile file, char *buffer, size_t bufsize)
 	} while(left);
 
 	seqf_skipline(state); /* Skip '+' line */
-	seqf_skipline(state); /* Skip quality scores */
+	if(quality == NULL)
+		seqf_skipline(state); /* Skip quality scores */
+	else
+		seqf_copyline(state, (unsigned char *)quality, qsize);
 
 	/* Null terminate and return buffer */
 	buf[0] = '\0';
 	return buffer;
 }
 
+char *
+seqfqgetr_unlocked(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize)
+{
+	return seqfqgetq_unlocked(file, header, hsize, buffer, bufsize, NULL, 0);
+}
+
+char *
+seqfqgets_unlocked(SeqFile file, char *buffer, size_t bufsize)
+{
+	return seqfqgetq_unlocked(file, NULL, 0, buffer, bufsize, NULL, 0);
+}
+
+char *
+seqfqgetr(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize)
+{
+	seqf_statep state = (seqf_statep)file;
+
+	mtx_lock(&state->mutex);
+	char *ret = seqfqgetr_unlocked(file, header, hsize, buffer, bufsize);
+	mtx_unlock(&state->mutex);
+
+	return ret;
+}
+
 char *
 seqfqgets(SeqFile file, char *buffer, size_t bufsize)
 {
@@ -116,6 +146,35 @@ seqfqgets(SeqFile file, char *buffer, size_t bufsize)
 	return ret;
 }
 
+size_t
+seqfqskip_unlocked(SeqFile file, size_t n)
+{
+	if(file == NULL)
+		return 0;
+	seqf_statep state = (seqf_statep)file;
+
+	size_t skipped = 0;
+	while(skipped < n && !state->eof) {
+		if(seqf_skipheader(state, '@') == NULL)
+			break;
+
+		/* Skip sequence lines up to the '+' line, as seqfqgets reads them */
+		for(;;) {
+			if(state->have == 0 && seqf_fetch(state) != 0)
+				return skipped;
+			if(state->have == 0 || *state->next == '+')
+				break;
+			if(seqf_skipline(state) == NULL)
+				break;
+		}
+
+		seqf_skipline(state); /* Skip '+' line */
+		seqf_skipline(state); /* Skip quality scores */
+		skipped++;
+	}
+	return skipped;
+}
+
 int
 seqfqgetnt_unlocked(SeqFile file)
 {
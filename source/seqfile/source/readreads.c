@@ -98,6 +98,32 @@ seqfsgets(SeqFile file, char *buffer, size_t bufsize)
 	return ret;
 }
 
+size_t
+seqfsskip_unlocked(SeqFile file, size_t n)
+{
+	if(file == NULL)
+		return 0;
+	seqf_statep state = (seqf_statep)file;
+
+	size_t skipped = 0;
+	while(skipped < n && !state->eof) {
+		if(state->have == 0 && seqf_fetch(state) != 0)
+			break;
+		if(state->have == 0)
+			break;
+
+		/* seqfsgets stops at an empty line, so stop there as well */
+		if(*state->next == '\n') {
+			state->have--;
+			state->next++;
+			break;
+		}
+		seqf_skipline(state);
+		skipped++;
+	}
+	return skipped;
+}
+
 int
 seqfsgetnt_unlocked(SeqFile file)
 {
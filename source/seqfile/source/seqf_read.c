@@ -179,6 +179,59 @@ seqf_skipheader(seqf_statep state, char skip)
 	return state->next;
 }
 
+extern unsigned char *
+seqf_copyheader(seqf_statep state, char skip, unsigned char *header, size_t hsize)
+{
+	/* Find the start of the header */
+	unsigned char *start;
+	do {
+		if(state->have == 0 && seqf_fetch(state) != 0)
+			return NULL;
+		if(state->have == 0)
+			return NULL;
+
+		start = memchr(state->next, skip, state->have);
+		size_t n = start != NULL ? (size_t)(start - state->next + 1) : state->have;
+		state->have -= n;
+		state->next += n;
+	} while(start == NULL);
+
+	/* Copy the rest of the line */
+	return seqf_copyline(state, header, hsize);
+}
+
+extern unsigned char *
+seqf_copyline(seqf_statep state, unsigned char *line, size_t size)
+{
+	/* Copy the line, keeping what fits within `line` */
+	size_t n, left = size - 1;
+	unsigned char *eol;
+	do {
+		if(state->have == 0 && seqf_fetch(state) != 0)
+			return NULL;
+		if(state->have == 0)
+			break;
+
+		n = state->have;
+		eol = memchr(state->next, '\n', n);
+		if(eol != NULL)
+			n = (size_t)(eol - state->next);
+
+		size_t ncopy = MIN2(n, left);
+		memcpy(line, state->next, ncopy);
+		line += ncopy;
+		left -= ncopy;
+
+		if(eol != NULL)
+			n++;
+		state->have -= n;
+		state->next += n;
+	} while(eol == NULL);
+	line[0] = '\0';
+
+	return state->next;
+}
+
 extern unsigned char *
 seqf_skipline(seqf_statep state)
 {
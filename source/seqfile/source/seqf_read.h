@@ -89,6 +89,42 @@ extern size_t seqf_fill(seqf_statep state, unsigned char *buffer, size_t bufsize
 extern unsigned char *seqf_skipheader(seqf_statep state, char skip);
 
 
+/**
+ * @brief Like `seqf_skipheader()`, but copies the header line (without the
+ * `skip` character and the newline) into `header`.
+ * 
+ * At most `hsize - 1` characters are copied, the rest of a longer header is
+ * skipped. `header` is always null terminated.
+ * 
+ * @param state  Pointer to the internal `SeqFile` state
+ * @param skip   Character to identify the start of a header line.
+ * @param header Buffer to copy the header into
+ * @param hsize  Size of `header`, at least 1
+ * 
+ * @return unsigned char* Pointer to the next position in the buffer after the
+ *         header line. Returns `NULL` if the header line is not found or if an
+ *         error occurs.
+ */
+extern unsigned char *seqf_copyheader(seqf_statep state, char skip, unsigned char *header, size_t hsize);
+
+
+/**
+ * @brief Copy the current line (without the newline) into `line`, and move
+ * past it.
+ * 
+ * At most `size - 1` characters are copied, the rest of a longer line is
+ * skipped. `line` is always null terminated.
+ * 
+ * @param state Pointer to the internal `SeqFile` state
+ * @param line  Buffer to copy the line into
+ * @param size  Size of `line`, at least 1
+ * 
+ * @return unsigned char* Pointer to the start of the next line in the buffer.
+ *         Returns `NULL` if an error occurs.
+ */
+extern unsigned char *seqf_copyline(seqf_statep state, unsigned char *line, size_t size);
+
+
 /**
  * @brief Skip the current line in the internal buffer of a SeqFile state.
  * 
@@ -112,6 +112,125 @@ seqfgets(SeqFile file, char *buffer, size_t bufsize)
 	return ret;
 }
 
+char *
+seqfgetr_unlocked(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize)
+{
+	if(file == NULL || header == NULL || hsize == 0)
+		return NULL;
+	seqf_statep state = (seqf_statep)file;
+
+	switch(state->type) {
+	case 'a':
+		return seqfagetr_unlocked(file, header, hsize, buffer, bufsize);
+	case 'q':
+		return seqfqgetr_unlocked(file, header, hsize, buffer, bufsize);
+	case 's':
+		header[0] = '\0';
+		return seqfsgets_unlocked(file, buffer, bufsize);
+	case 'b':
+		header[0] = '\0';
+		return seqf_line(state, (unsigned char *)buffer, bufsize);
+	default:
+		seqferrno_ = 5;
+		return NULL;
+	}
+}
+
+char *
+seqfgetr(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize)
+{
+	if(file == NULL)
+		return NULL;
+	seqf_statep state = (seqf_statep)file;
+
+	mtx_lock(&state->mutex);
+	char *ret = seqfgetr_unlocked(file, header, hsize, buffer, bufsize);
+	mtx_unlock(&state->mutex);
+
+	return ret;
+}
+
+char *
+seqfgetq_unlocked(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize,
+                  char *quality, size_t qsize)
+{
+	if(file == NULL)
+		return NULL;
+	if((header != NULL && hsize == 0) || (quality != NULL && qsize == 0))
+		return NULL;
+	seqf_statep state = (seqf_statep)file;
+
+	/* Only fastq records have quality scores */
+	if(state->type == 'q')
+		return seqfqgetq_unlocked(file, header, hsize, buffer, bufsize, quality, qsize);
+	if(quality != NULL)
+		quality[0] = '\0';
+	if(header != NULL)
+		return seqfgetr_unlocked(file, header, hsize, buffer, bufsize);
+	return seqfgets_unlocked(file, buffer, bufsize);
+}
+
+char *
+seqfgetq(SeqFile file, char *header, size_t hsize, char *buffer, size_t bufsize, char *quality,
+         size_t qsize)
+{
+	if(file == NULL)
+		return NULL;
+	seqf_statep state = (seqf_statep)file;
+
+	mtx_lock(&state->mutex);
+	char *ret = seqfgetq_unlocked(file, header, hsize, buffer, bufsize, quality, qsize);
+	mtx_unlock(&state->mutex);
+
+	return ret;
+}
+
+static size_t
+seqf_lskip(seqf_statep state, size_t n)
+{
+	/* Lines are counted as seqf_line returns them, including the empty one at
+	   the end of the file */
+	size_t skipped = 0;
+	while(skipped < n && !state->eof) {
+		if(seqf_skipline(state) == NULL && seqferrno_)
+			break;
+		skipped++;
+	}
+	return skipped;
+}
+
+size_t
+seqfskip_unlocked(SeqFile file, size_t n)
+{
+	if(file == NULL)
+		return 0;
+	seqf_statep state = (seqf_statep)file;
+
+	switch(state->type) {
+	case 'a': return seqfaskip_unlocked(file, n);
+	case 'q': return seqfqskip_unlocked(file, n);
+	case 's': return seqfsskip_unlocked(file, n);
+	case 'b': return seqf_lskip(state, n);
+	default:
+		seqferrno_ = 5;
+		return 0;
+	}
+}
+
+size_t
+seqfskip(SeqFile file, size_t n)
+{
+	if(file == NULL)
+		return 0;
+	seqf_statep state = (seqf_statep)file;
+
+	mtx_lock(&state->mutex);
+	size_t skipped = seqfskip_unlocked(file, n);
+	mtx_unlock(&state->mutex);
+
+	return skipped;
+}
+
 int
 seqfgetc_unlocked(SeqFile file)
 {
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "minunit.h"
 
@@ -141,6 +142,145 @@ test_seqfgetc(void)
 	unit_tests_end;
 }
 
+static UTEST_TYPE
+test_seqfgetr(void)
+{
+	init_unit_tests("Testing seqfgetr");
+
+	char header[32], buffer[128], small[8];
+	SeqFile file = seqfopen(TXT2STR(EXAMPLE_FASTA), "a");
+
+	bool passed = seqfgetr(file, header, sizeof header, buffer, sizeof buffer) != NULL &&
+	              strcmp(header, "sequence_1") == 0 &&
+	              strcmp(buffer, "ACTTGACTGACGTATCGTCAGTAC") == 0;
+	mu_assert("getr header and sequence of fasta record", passed);
+
+	passed = seqfgetr(file, header, sizeof header, buffer, sizeof buffer) != NULL &&
+	         strcmp(header, "sequence_2#someinfohere") == 0;
+	mu_assert("getr full fasta header", passed);
+
+	passed = seqfgetr(file, small, sizeof small, buffer, sizeof buffer) != NULL &&
+	         strcmp(small, "sequenc") == 0 && strncmp(buffer, "TGACTAGTACG", 11) == 0;
+	mu_assert("getr truncates long headers", passed);
+
+	seqfgetr(file, header, sizeof header, buffer, sizeof buffer);
+	passed = seqfgetr(file, header, sizeof header, buffer, sizeof buffer) != NULL &&
+	         strcmp(header, "sequence_5") == 0 && strcmp(buffer, "TAGAGGC") == 0;
+	mu_assert("getr last fasta record", passed);
+
+	passed = seqfgetr(file, header, sizeof header, buffer, sizeof buffer) == NULL;
+	mu_assert("getr at end of fasta file", passed);
+	seqfclose(file);
+
+	file = seqfopen(TXT2STR(EXAMPLE_FASTQ_GZ), "q");
+	seqfgetr(file, header, sizeof header, buffer, sizeof buffer);
+	passed = seqfgetr(file, header, sizeof header, buffer, sizeof buffer) != NULL &&
+	         strcmp(header, "SEQ_ID_2") == 0 && strcmp(buffer, "GATCTANNNNNAGTGTGTA") == 0;
+	mu_assert("getr compressed fastq record", passed);
+	seqfclose(file);
+
+	file = seqfopen(TXT2STR(EXAMPLE_READS), "s");
+	passed = seqfgetr(file, header, sizeof header, buffer, sizeof buffer) != NULL &&
+	         header[0] == '\0' && strncmp(buffer, "GCATACGGTG", 10) == 0;
+	mu_assert("getr empty header of reads file", passed);
+	seqfclose(file);
+
+	unit_tests_end;
+}
+
+static UTEST_TYPE
+test_seqfgetq(void)
+{
+	init_unit_tests("Testing seqfgetq");
+
+	char header[32], buffer[128], quality[128], small[8];
+	SeqFile file = seqfopen(TXT2STR(EXAMPLE_FASTQ), "q");
+
+	bool passed = seqfgetq(file, header, sizeof header, buffer, sizeof buffer, quality,
+	                       sizeof quality) != NULL &&
+	              strcmp(header, "SEQ_ID_1") == 0 &&
+	              strcmp(buffer, "GATTTGGGGTTTAAATGGAAGAAA") == 0 &&
+	              strcmp(quality, "IIIIIIIIIIIIIIIIIIIIIIII") == 0;
+	mu_assert("getq header, sequence and quality", passed);
+
+	passed = seqfgetq(file, NULL, 0, buffer, sizeof buffer, quality, sizeof quality) != NULL &&
+	         strcmp(buffer, "GATCTANNNNNAGTGTGTA") == 0 &&
+	         strcmp(quality, "#$%&'()*+,-./012345") == 0;
+	mu_assert("getq without header", passed);
+	seqfclose(file);
+
+	file = seqfopen(TXT2STR(EXAMPLE_FASTQ_GZ), "q");
+	passed = seqfgetq(file, NULL, 0, buffer, sizeof buffer, small, sizeof small) != NULL &&
+	         strcmp(small, "IIIIIII") == 0 &&
+	         seqfgetq(file, NULL, 0, buffer, sizeof buffer, quality, sizeof quality) != NULL &&
+	         strcmp(buffer, "GATCTANNNNNAGTGTGTA") == 0;
+	mu_assert("getq truncates long quality lines", passed);
+	seqfclose(file);
+
+	file = seqfopen(TXT2STR(EXAMPLE_FASTA), "a");
+	passed = seqfgetq(file, header, sizeof header, buffer, sizeof buffer, quality,
+	                  sizeof quality) != NULL &&
+	         strcmp(header, "sequence_1") == 0 && quality[0] == '\0';
+	mu_assert("getq empty quality of fasta record", passed);
+	seqfclose(file);
+
+	unit_tests_end;
+}
+
+/* Whether skipping n records and reading the next one gives record n of the file */
+static bool
+skips_to_record(const char *filename, const char *mode, size_t n)
+{
+	static char buffer[16384], expected[16384];
+	SeqFile file = seqfopen(filename, mode);
+	size_t count = 0;
+	while(count < n && seqfgets(file, buffer, sizeof buffer) != NULL)
+		count++;
+	char *ret = seqfgets(file, expected, sizeof expected);
+	seqfclose(file);
+
+	file = seqfopen(filename, mode);
+	bool passed = seqfskip(file, n) == count;
+	if(ret == NULL)
+		passed = passed && seqfgets(file, buffer, sizeof buffer) == NULL;
+	else
+		passed = passed && seqfgets(file, buffer, sizeof buffer) != NULL &&
+		         strcmp(buffer, expected) == 0;
+	seqfclose(file);
+	return passed;
+}
+
+static UTEST_TYPE
+test_seqfskip(void)
+{
+	init_unit_tests("Testing seqfskip");
+
+	bool passed = true;
+	for(size_t n = 0; n < 8; n++)
+		passed = passed && skips_to_record(TXT2STR(EXAMPLE_FASTA), "a", n);
+	mu_assert("skip fasta records", passed);
+
+	passed = true;
+	for(size_t n = 0; n < 8; n++)
+		passed = passed && skips_to_record(TXT2STR(EXAMPLE_FASTQ_GZ), "q", n);
+	mu_assert("skip compressed fastq records", passed);
+
+	passed = true;
+	for(size_t n = 0; n < 8; n++)
+		passed = passed && skips_to_record(TXT2STR(EXAMPLE_READS), "s", n) &&
+		         skips_to_record(TXT2STR(EXAMPLE_READS_GZ), "b", n);
+	mu_assert("skip reads and lines", passed);
+
+	SeqFile file = seqfopen(TXT2STR(EXAMPLE_FASTQ), "q");
+	passed = seqfskip(file, 1000) < 1000 && seqfskip(file, 1) == 0;
+	seqfclose(file);
+	passed = passed && skips_to_record(TXT2STR(EXAMPLE_READS), "s", 1000) &&
+	         skips_to_record(TXT2STR(EXAMPLE_READS), "b", 1000);
+	mu_assert("skip past end of file", passed);
+
+	unit_tests_end;
+}
+
 static void all_tests() {
 	init_run_test;
 
@@ -149,6 +289,9 @@ static void all_tests() {
 	mu_run_test(test_seqfclose);
 	mu_run_test(test_seqferrno);
 	mu_run_test(test_seqfgetc);
+	mu_run_test(test_seqfgetr);
+	mu_run_test(test_seqfgetq);
+	mu_run_test(test_seqfskip);
 
 	/* End of tests */
 	run_test_end;